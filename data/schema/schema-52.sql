@@ -0,0 +1,7 @@
+CREATE TABLE moodbars (
+  song_id INTEGER PRIMARY KEY,
+  mtime INTEGER NOT NULL,
+  data BLOB NOT NULL
+);
+
+UPDATE schema_version SET version=52;
@@ -0,0 +1,26 @@
+CREATE TABLE library_changes (
+  revision INTEGER PRIMARY KEY AUTOINCREMENT,
+  song_id INTEGER NOT NULL UNIQUE
+);
+
+INSERT INTO library_changes (song_id) SELECT ROWID FROM songs;
+
+CREATE TABLE library_changes_database (
+  id TEXT NOT NULL
+);
+
+INSERT INTO library_changes_database (id) VALUES (lower(hex(randomblob(16))));
+
+CREATE TRIGGER library_changes_insert AFTER INSERT ON songs BEGIN
+  INSERT OR REPLACE INTO library_changes (song_id) VALUES (new.ROWID);
+END;
+
+CREATE TRIGGER library_changes_update AFTER UPDATE ON songs BEGIN
+  INSERT OR REPLACE INTO library_changes (song_id) VALUES (new.ROWID);
+END;
+
+CREATE TRIGGER library_changes_delete AFTER DELETE ON songs BEGIN
+  INSERT OR REPLACE INTO library_changes (song_id) VALUES (old.ROWID);
+END;
+
+UPDATE schema_version SET version=53;
@@ -97,6 +97,7 @@ SpotifyClient::SpotifyClient(QObject* parent)
   events_timer_->setSingleShot(true);
   connect(events_timer_, SIGNAL(timeout()), SLOT(ProcessEvents()));
 
+  connect(protocol_socket_, SIGNAL(connected()), SLOT(SocketConnected()));
   connect(protocol_socket_, SIGNAL(disconnected()),
           QCoreApplication::instance(), SLOT(quit()));
 }
@@ -116,6 +117,12 @@ void SpotifyClient::Init(quint16 port) {
   protocol_socket_->connectToHost(QHostAddress::LocalHost, port);
 }
 
+void SpotifyClient::SocketConnected() {
+  // Album art and search results are sent through shared memory if Clementine
+  // can attach to it.
+  EnableSharedMemoryTransport();
+}
+
 void SpotifyClient::LoggedInCallback(sp_session* session, sp_error error) {
   SpotifyClient* me =
       reinterpret_cast<SpotifyClient*>(sp_session_userdata(session));
@@ -53,6 +53,7 @@ class SpotifyClient : public AbstractMessageHandler<pb::spotify::Message> {
 
  private slots:
   void ProcessEvents();
+  void SocketConnected();
 
  private:
   void SendLoginCompleted(bool success, const QString& error,
@@ -62,5 +62,9 @@ int main(int argc, char** argv) {
 
   TagReaderWorker worker(&socket);
 
+  // Embedded album art can be several megabytes - send it through shared
+  // memory if Clementine can attach to it.
+  worker.EnableSharedMemoryTransport();
+
   return a.exec();
 }
@@ -42,6 +42,14 @@ void TagReaderWorker::MessageArrived(const pb::tagreader::Message& message) {
     tag_reader_.ReadFile(
         QStringFromStdString(message.read_file_request().filename()),
         reply.mutable_read_file_response()->mutable_metadata());
+  } else if (message.has_read_files_request()) {
+    const pb::tagreader::ReadFilesRequest& req = message.read_files_request();
+    pb::tagreader::ReadFilesResponse* response =
+        reply.mutable_read_files_response();
+    for (int i = 0; i < req.filenames_size(); ++i) {
+      tag_reader_.ReadFile(QStringFromStdString(req.filenames(i)),
+                           response->add_metadata());
+    }
   } else if (message.has_save_file_request()) {
     reply.mutable_save_file_response()->set_success(tag_reader_.SaveFile(
         QStringFromStdString(message.save_file_request().filename()),
@@ -22,7 +22,47 @@
 #include "core/logging.h"
 
 #include <QAbstractSocket>
+#include <QCoreApplication>
+#include <QDataStream>
 #include <QLocalSocket>
+#include <QSharedMemory>
+
+#include <cstring>
+
+namespace {
+
+const quint32 kSharedMemoryFrame = 0x80000000;
+const quint32 kSharedMemoryAttachFrame = 0x40000000;
+const quint32 kFrameTypeMask = 0xC0000000;
+
+// Lives at the start of each ring buffer, and is only accessed while the
+// segment is locked.  The positions are absolute byte counts since the ring
+// buffer was created - the writer advances write_position and the reader
+// advances read_position.
+struct SharedMemoryHeader {
+  quint64 write_position;
+  quint64 read_position;
+};
+
+const int kSharedMemoryHeaderSize = 64;
+
+SharedMemoryHeader* Header(QSharedMemory* memory) {
+  return reinterpret_cast<SharedMemoryHeader*>(memory->data());
+}
+
+char* RingData(QSharedMemory* memory) {
+  return reinterpret_cast<char*>(memory->data()) + kSharedMemoryHeaderSize;
+}
+
+int RingCapacity(QSharedMemory* memory) {
+  return memory->size() - kSharedMemoryHeaderSize;
+}
+
+}  // namespace
+
+const int _MessageHandlerBase::kDefaultSharedMemorySize = 8 * 1024 * 1024;
+const int _MessageHandlerBase::kSharedMemoryThreshold = 64 * 1024;
+const int _MessageHandlerBase::kMaxMessageSize = ~kFrameTypeMask;
 
 _MessageHandlerBase::_MessageHandlerBase(QIODevice* device, QObject* parent)
     : QObject(parent),
@@ -31,6 +71,12 @@ _MessageHandlerBase::_MessageHandlerBase(QIODevice* device, QObject* parent)
       flush_local_socket_(nullptr),
       reading_protobuf_(false),
       expected_length_(0),
+      frame_type_(0),
+      bytes_read_(0),
+      max_message_size_(kMaxMessageSize),
+      outgoing_memory_(nullptr),
+      outgoing_memory_attached_(false),
+      incoming_memory_(nullptr),
       is_device_closed_(false) {
   if (device) {
     SetDevice(device);
@@ -40,8 +86,6 @@ _MessageHandlerBase::_MessageHandlerBase(QIODevice* device, QObject* parent)
 void _MessageHandlerBase::SetDevice(QIODevice* device) {
   device_ = device;
 
-  buffer_.open(QIODevice::ReadWrite);
-
   connect(device, SIGNAL(readyRead()), SLOT(DeviceReadyRead()));
 
   // Yeah I know.
@@ -56,6 +100,43 @@ void _MessageHandlerBase::SetDevice(QIODevice* device) {
   }
 }
 
+bool _MessageHandlerBase::EnableSharedMemoryTransport(int size) {
+  Q_ASSERT(device_);
+  Q_ASSERT(!outgoing_memory_);
+
+  // Create a segment with an unused name
+  QSharedMemory* memory = nullptr;
+  for (int attempt = 0; attempt < 10; ++attempt) {
+    const QString key = QString("%1_messagehandler_%2_%3")
+                            .arg(QCoreApplication::applicationName())
+                            .arg(QCoreApplication::applicationPid())
+                            .arg(qrand());
+    memory = new QSharedMemory(key, this);
+    if (memory->create(kSharedMemoryHeaderSize + size)) break;
+
+    qLog(Debug) << "Couldn't create shared memory" << key
+                << memory->errorString();
+    delete memory;
+    memory = nullptr;
+  }
+
+  if (!memory) {
+    qLog(Warning) << "Shared memory transport disabled - using the socket";
+    return false;
+  }
+
+  memory->lock();
+  memset(memory->data(), 0, kSharedMemoryHeaderSize);
+  memory->unlock();
+
+  outgoing_memory_ = memory;
+
+  const QByteArray key = memory->key().toUtf8();
+  WriteFrame(kSharedMemoryAttachFrame | key.length(), key.constData(),
+             key.length());
+  return true;
+}
+
 void _MessageHandlerBase::DeviceReadyRead() {
   while (device_->bytesAvailable()) {
     if (!reading_protobuf_) {
@@ -63,34 +144,184 @@ void _MessageHandlerBase::DeviceReadyRead() {
       QDataStream s(device_);
       s >> expected_length_;
 
+      frame_type_ = expected_length_ & kFrameTypeMask;
+      expected_length_ &= ~kFrameTypeMask;
+
+      buffer_.resize(expected_length_);
+      bytes_read_ = 0;
       reading_protobuf_ = true;
     }
 
-    // Read some of the message
-    buffer_.write(device_->read(expected_length_ - buffer_.size()));
+    // Read some of the message straight into the buffer
+    const qint64 bytes =
+        device_->read(buffer_.data() + bytes_read_,
+                      expected_length_ - bytes_read_);
+    if (bytes > 0) {
+      bytes_read_ += bytes;
+    }
 
     // Did we get everything?
-    if (buffer_.size() == expected_length_) {
-      // Parse the message
-      if (!RawMessageArrived(buffer_.data())) {
+    if (bytes_read_ == int(expected_length_)) {
+      reading_protobuf_ = false;
+
+      if (!FrameArrived()) {
         qLog(Error) << "Malformed protobuf message";
         device_->close();
         return;
       }
-
-      // Clear the buffer
-      buffer_.close();
-      buffer_.setData(QByteArray());
-      buffer_.open(QIODevice::ReadWrite);
-      reading_protobuf_ = false;
     }
   }
 }
 
+bool _MessageHandlerBase::FrameArrived() {
+  switch (frame_type_) {
+    case kSharedMemoryFrame:
+      return SharedMemoryFrameArrived();
+
+    case kSharedMemoryAttachFrame:
+      SharedMemoryAttachFrameArrived();
+      return true;
+
+    case 0:
+      return RawMessageArrived(buffer_);
+
+    default:
+      return false;
+  }
+}
+
+bool _MessageHandlerBase::SharedMemoryFrameArrived() {
+  QDataStream s(buffer_);
+  quint64 position = 0;
+  quint32 length = 0;
+  s >> position >> length;
+
+  if (!incoming_memory_ || s.status() != QDataStream::Ok) {
+    return false;
+  }
+
+  // length comes from the other process, so compare it without narrowing it
+  // to an int first.
+  const qint64 capacity = RingCapacity(incoming_memory_);
+  if (capacity <= 0) {
+    return false;
+  }
+  const qint64 offset = position % capacity;
+  if (qint64(length) > capacity - offset) {
+    return false;
+  }
+
+  // Parse the message where it is, without copying it out of the segment.
+  const bool ret = RawMessageArrived(QByteArray::fromRawData(
+      RingData(incoming_memory_) + offset, length));
+
+  // Let the writer reuse this space.
+  incoming_memory_->lock();
+  Header(incoming_memory_)->read_position = position + length;
+  incoming_memory_->unlock();
+
+  return ret;
+}
+
+void _MessageHandlerBase::SharedMemoryAttachFrameArrived() {
+  if (buffer_.isEmpty()) {
+    // The other end attached to our ring buffer.
+    outgoing_memory_attached_ = outgoing_memory_ != nullptr;
+    return;
+  }
+
+  delete incoming_memory_;
+  incoming_memory_ = new QSharedMemory(QString::fromUtf8(buffer_), this);
+
+  if (!incoming_memory_->attach() ||
+      incoming_memory_->size() <= kSharedMemoryHeaderSize) {
+    qLog(Warning) << "Couldn't attach to shared memory"
+                  << incoming_memory_->key()
+                  << incoming_memory_->errorString();
+    delete incoming_memory_;
+    incoming_memory_ = nullptr;
+    return;
+  }
+
+  // Tell the other end it can start using it.
+  WriteFrame(kSharedMemoryAttachFrame, nullptr, 0);
+}
+
+char* _MessageHandlerBase::ReserveSharedMemory(int size, quint64* position) {
+  if (!outgoing_memory_attached_ || size < kSharedMemoryThreshold) {
+    return nullptr;
+  }
+
+  const int capacity = RingCapacity(outgoing_memory_);
+  if (size > capacity) {
+    return nullptr;
+  }
+
+  outgoing_memory_->lock();
+  const SharedMemoryHeader* header = Header(outgoing_memory_);
+  quint64 start = header->write_position;
+  const quint64 read_position = header->read_position;
+  outgoing_memory_->unlock();
+
+  // Messages are always contiguous, so skip to the start of the ring if this
+  // one wouldn't fit before the end.
+  const int offset = start % capacity;
+  if (size > capacity - offset) {
+    start += capacity - offset;
+  }
+
+  if (start + size - read_position > quint64(capacity)) {
+    // The reader hasn't caught up yet.
+    return nullptr;
+  }
+
+  *position = start;
+  return RingData(outgoing_memory_) + start % capacity;
+}
+
+void _MessageHandlerBase::CommitSharedMemory(quint64 position, int size) {
+  outgoing_memory_->lock();
+  Header(outgoing_memory_)->write_position = position + size;
+  outgoing_memory_->unlock();
+
+  QByteArray frame;
+  {
+    QDataStream s(&frame, QIODevice::WriteOnly);
+    s << position << quint32(size);
+  }
+  WriteFrame(kSharedMemoryFrame | frame.length(), frame.constData(),
+             frame.length());
+}
+
+bool _MessageHandlerBase::CheckMessageSize(int size) const {
+  if (size > max_message_size_) {
+    qLog(Error) << "Not sending a message of" << size
+                << "bytes - the limit is" << max_message_size_;
+    return false;
+  }
+  return true;
+}
+
 void _MessageHandlerBase::WriteMessage(const QByteArray& data) {
+  if (!CheckMessageSize(data.length())) {
+    return;
+  }
+
+  quint64 position = 0;
+  if (char* dest = ReserveSharedMemory(data.length(), &position)) {
+    memcpy(dest, data.constData(), data.length());
+    CommitSharedMemory(position, data.length());
+    return;
+  }
+
+  WriteFrame(data.length(), data.constData(), data.length());
+}
+
+void _MessageHandlerBase::WriteFrame(quint32 header, const char* data,
+                                     int length) {
   QDataStream s(device_);
-  s << quint32(data.length());
-  s.writeRawData(data.data(), data.length());
+  s << header;
+  s.writeRawData(data, length);
 
   // Sorry.
   if (flush_abstract_socket_) {
@@ -102,5 +333,15 @@ void _MessageHandlerBase::WriteMessage(const QByteArray& data) {
 
 void _MessageHandlerBase::DeviceClosed() {
   is_device_closed_ = true;
+  outgoing_memory_attached_ = false;
+
+  // On Unix the segments outlive a process that crashed, and are only removed
+  // when the last process still attached to them detaches.  The other end is
+  // gone, so detach now rather than when this handler is eventually deleted.
+  delete incoming_memory_;
+  incoming_memory_ = nullptr;
+  delete outgoing_memory_;
+  outgoing_memory_ = nullptr;
+
   AbortAll();
 }
@@ -35,6 +35,7 @@
 class QAbstractSocket;
 class QIODevice;
 class QLocalSocket;
+class QSharedMemory;
 
 #define QStringFromStdString(x) QString::fromUtf8(x.data(), x.size())
 #define DataCommaSizeFromQString(x) x.toUtf8().constData(), x.toUtf8().length()
@@ -42,6 +43,16 @@ class QLocalSocket;
 // Reads and writes uint32 length encoded protobufs to a socket.
 // This base QObject is separate from AbstractMessageHandler because moc can't
 // handle templated classes.  Use AbstractMessageHandler instead.
+//
+// Large messages can optionally be sent through a shared memory ring buffer
+// instead of the socket - see EnableSharedMemoryTransport.  The top two bits
+// of the length are used to mark these frames, which leaves 30 bits for the
+// length itself, so messages larger than kMaxMessageSize are never sent:
+//   kSharedMemoryFrame: the payload is the position and length of the
+//     message in the sender's ring buffer.
+//   kSharedMemoryAttachFrame: the payload is the key of the sender's ring
+//     buffer.  The receiver answers with an empty kSharedMemoryAttachFrame
+//     once it has attached to it.
 class _MessageHandlerBase : public QObject {
   Q_OBJECT
 
@@ -50,11 +61,28 @@ class _MessageHandlerBase : public QObject {
   // any messages.
   _MessageHandlerBase(QIODevice* device, QObject* parent);
 
+  static const int kDefaultSharedMemorySize;
+  static const int kSharedMemoryThreshold;
+  static const int kMaxMessageSize;
+
   void SetDevice(QIODevice* device);
 
+  // Creates a shared memory ring buffer and offers it to the other end.  Once
+  // the other end has attached to it, messages of at least
+  // kSharedMemoryThreshold bytes are serialised straight into the ring buffer
+  // and only their position is sent on the socket.  Messages that are smaller
+  // or don't fit in the free space still go through the socket, as does
+  // everything if the other end can't attach.  Returns false if the shared
+  // memory couldn't be created.  Must be called from my thread after the
+  // device has been set.
+  bool EnableSharedMemoryTransport(int size = kDefaultSharedMemorySize);
+
   // After this is true, messages cannot be sent to the handler any more.
   bool is_device_closed() const { return is_device_closed_; }
 
+  // True once the other end has attached to our shared memory ring buffer.
+  bool is_shared_memory_attached() const { return outgoing_memory_attached_; }
+
  protected slots:
   void WriteMessage(const QByteArray& data);
   void DeviceReadyRead();
@@ -64,6 +92,24 @@ class _MessageHandlerBase : public QObject {
   virtual bool RawMessageArrived(const QByteArray& data) = 0;
   virtual void AbortAll() = 0;
 
+  // Logs an error and returns false if the message is too large to send.
+  bool CheckMessageSize(int size) const;
+
+  // Lowers the largest message size that will be sent, for the tests.
+  void set_max_message_size(int size) { max_message_size_ = size; }
+
+  // Returns a pointer to size contiguous bytes in the shared memory ring
+  // buffer, or NULL if the message should go through the socket instead.  The
+  // message must be written there and then sent with CommitSharedMemory.
+  char* ReserveSharedMemory(int size, quint64* position);
+  void CommitSharedMemory(quint64 position, int size);
+
+ private:
+  void WriteFrame(quint32 header, const char* data, int length);
+  bool FrameArrived();
+  bool SharedMemoryFrameArrived();
+  void SharedMemoryAttachFrameArrived();
+
  protected:
   typedef bool (QAbstractSocket::*FlushAbstractSocket)();
   typedef bool (QLocalSocket::*FlushLocalSocket)();
@@ -74,7 +120,15 @@ class _MessageHandlerBase : public QObject {
 
   bool reading_protobuf_;
   quint32 expected_length_;
-  QBuffer buffer_;
+  quint32 frame_type_;
+  int bytes_read_;
+  QByteArray buffer_;
+  int max_message_size_;
+
+  // The ring buffer we write to, and the other end's ring buffer we read from.
+  QSharedMemory* outgoing_memory_;
+  bool outgoing_memory_attached_;
+  QSharedMemory* incoming_memory_;
 
   bool is_device_closed_;
 };
@@ -93,7 +147,8 @@ class AbstractMessageHandler : public _MessageHandlerBase {
 
   // Serialises the message and writes it to the socket.  This version MUST be
   // called from the thread in which the AbstractMessageHandler was created.
-  void SendMessage(const MessageType& message);
+  // Returns false if the message was too large to send.
+  bool SendMessage(const MessageType& message);
 
   // Serialises the message and writes it to the socket.  This version may be
   // called from any thread.
@@ -101,7 +156,8 @@ class AbstractMessageHandler : public _MessageHandlerBase {
 
   // Sends the request message inside and takes ownership of the MessageReply.
   // The MessageReply's Finished() signal will be emitted when a reply arrives
-  // with the same ID.  Must be called from my thread.
+  // with the same ID, or straight away with success=false if the request was
+  // too large to send.  Must be called from my thread.
   void SendRequest(ReplyType* reply);
 
   // Sets the "id" field of reply to the same as the request, and sends the
@@ -126,11 +182,24 @@ AbstractMessageHandler<MT>::AbstractMessageHandler(QIODevice* device,
     : _MessageHandlerBase(device, parent) {}
 
 template <typename MT>
-void AbstractMessageHandler<MT>::SendMessage(const MessageType& message) {
+bool AbstractMessageHandler<MT>::SendMessage(const MessageType& message) {
   Q_ASSERT(QThread::currentThread() == thread());
 
+  const int size = message.ByteSize();
+  if (!CheckMessageSize(size)) {
+    return false;
+  }
+
+  quint64 position = 0;
+  if (char* dest = ReserveSharedMemory(size, &position)) {
+    message.SerializeToArray(dest, size);
+    CommitSharedMemory(position, size);
+    return true;
+  }
+
   std::string data = message.SerializeAsString();
   WriteMessage(QByteArray(data.data(), data.size()));
+  return true;
 }
 
 template <typename MT>
@@ -144,7 +213,10 @@ void AbstractMessageHandler<MT>::SendMessageAsync(const MessageType& message) {
 template <typename MT>
 void AbstractMessageHandler<MT>::SendRequest(ReplyType* reply) {
   pending_replies_[reply->id()] = reply;
-  SendMessage(reply->request_message());
+  if (!SendMessage(reply->request_message())) {
+    pending_replies_.remove(reply->id());
+    reply->Abort();
+  }
 }
 
 template <typename MT>
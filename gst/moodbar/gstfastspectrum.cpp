@@ -273,18 +273,29 @@ gst_fastspectrum_stop (GstBaseTransform * trans)
   return TRUE;
 }
 
-/* mixing data readers */
+/* mixing data readers
+ *
+ * These copy len samples into the ring buffer starting at position op.  Each
+ * run of samples up to the end of the ring buffer is converted with a plain
+ * loop over contiguous memory, which the compiler can vectorize, rather than
+ * wrapping the output position around after every sample. */
 
 static void
 input_data_mixed_float(const guint8* _in, double* out, guint len,
                        double max_value, guint op, guint nfft)
 {
-  guint j, ip = 0;
-  gfloat *in = (gfloat *) _in;
+  const gfloat *in = (const gfloat *) _in;
 
-  for (j = 0; j < len; j++) {
-    out[op] = in[ip++];
-    op = (op + 1) % nfft;
+  while (len > 0) {
+    guint j, run = MIN (len, nfft - op);
+    double *dest = out + op;
+
+    for (j = 0; j < run; j++)
+      dest[j] = in[j];
+
+    in += run;
+    len -= run;
+    op = 0;
   }
 }
 
@@ -292,12 +303,16 @@ static void
 input_data_mixed_double (const guint8 * _in, double* out, guint len,
     double max_value, guint op, guint nfft)
 {
-  guint j, ip = 0;
-  gdouble *in = (gdouble *) _in;
+  const gdouble *in = (const gdouble *) _in;
 
-  for (j = 0; j < len; j++) {
-    out[op] = in[ip++];
-    op = (op + 1) % nfft;
+  while (len > 0) {
+    guint run = MIN (len, nfft - op);
+
+    memcpy (out + op, in, run * sizeof (double));
+
+    in += run;
+    len -= run;
+    op = 0;
   }
 }
 
@@ -305,12 +320,19 @@ static void
 input_data_mixed_int32_max (const guint8 * _in, double* out, guint len,
     double max_value, guint op, guint nfft)
 {
-  guint j, ip = 0;
-  gint32 *in = (gint32 *) _in;
+  const gint32 *in = (const gint32 *) _in;
+  const double scale = 1.0 / max_value;
 
-  for (j = 0; j < len; j++) {
-    out[op] = in[ip++] / max_value;
-    op = (op + 1) % nfft;
+  while (len > 0) {
+    guint j, run = MIN (len, nfft - op);
+    double *dest = out + op;
+
+    for (j = 0; j < run; j++)
+      dest[j] = in[j] * scale;
+
+    in += run;
+    len -= run;
+    op = 0;
   }
 }
 
@@ -339,12 +361,19 @@ static void
 input_data_mixed_int16_max (const guint8 * _in, double * out, guint len,
     double max_value, guint op, guint nfft)
 {
-  guint j, ip = 0;
-  gint16 *in = (gint16 *) _in;
+  const gint16 *in = (const gint16 *) _in;
+  const double scale = 1.0 / max_value;
 
-  for (j = 0; j < len; j++) {
-    out[op] = in[ip++] / max_value;
-    op = (op + 1) % nfft;
+  while (len > 0) {
+    guint j, run = MIN (len, nfft - op);
+    double *dest = out + op;
+
+    for (j = 0; j < run; j++)
+      dest[j] = in[j] * scale;
+
+    in += run;
+    len -= run;
+    op = 0;
   }
 }
 
@@ -390,20 +419,23 @@ gst_fastspectrum_run_fft (GstFastSpectrum * spectrum, guint input_pos)
   guint bands = spectrum->bands;
   guint nfft = 2 * bands - 2;
 
-  for (i = 0; i < nfft; i++)
-    spectrum->fft_input[i] =
-        spectrum->input_ring_buffer[(input_pos + i) % nfft];
+  /* Unroll the ring buffer into the FFT input, oldest sample first */
+  memcpy (spectrum->fft_input, spectrum->input_ring_buffer + input_pos,
+      (nfft - input_pos) * sizeof (double));
+  memcpy (spectrum->fft_input + nfft - input_pos, spectrum->input_ring_buffer,
+      input_pos * sizeof (double));
 
   // Should be safe to execute the same plan multiple times in parallel.
   fftw_execute(spectrum->plan);
 
-  gdouble val;
-  /* Calculate magnitude in db */
+  /* Calculate magnitude in db.  fftw_complex is just two doubles, so this
+   * reads the real and imaginary parts from one flat array. */
+  const double *out = (const double *) spectrum->fft_output;
+  const double scale = 1.0 / ((double) nfft * nfft);
+  double *magnitude = spectrum->spect_magnitude;
   for (i = 0; i < bands; i++) {
-    val = spectrum->fft_output[i][0] * spectrum->fft_output[i][0];
-    val += spectrum->fft_output[i][1] * spectrum->fft_output[i][1];
-    val /= nfft * nfft;
-    spectrum->spect_magnitude[i] += val;
+    magnitude[i] += (out[2 * i] * out[2 * i] +
+        out[2 * i + 1] * out[2 * i + 1]) * scale;
   }
 }
 
@@ -32,6 +32,7 @@
 #include <QPaintEvent>
 #include <QtDebug>
 
+#include "spectrumservice.h"
 #include "engines/enginebase.h"
 #include "core/arraysize.h"
 
@@ -67,6 +68,7 @@ Analyzer::Base::Base(QWidget* parent, uint scopeSize)
       ,
       fht_(new FHT(scopeSize)),
       engine_(nullptr),
+      spectrum_service_(nullptr),
       lastScope_(512),
       new_frame_(false),
       is_playing_(false),
@@ -83,19 +85,11 @@ void Analyzer::Base::transform(Scope& scope) {
   // this is a standard transformation that should give
   // an FFT scope that has bands for pretty analyzers
 
-  // NOTE resizing here is redundant as FHT routines only calculate FHT::size()
-  // values
-  // scope.resize( fht_->size() );
-
   float* front = static_cast<float*>(&scope.front());
 
-  float* f = new float[fht_->size()];
-  fht_->copy(&f[0], front);
-  fht_->logSpectrum(front, &f[0]);
+  transformScope_.assign(scope.begin(), scope.end());
+  fht_->logSpectrumFromPower2(front, &transformScope_.front());
   fht_->scale(front, 1.0 / 20);
-
-  scope.resize(fht_->size() / 2);  // second half of values are rubbish
-  delete[] f;
 }
 
 void Analyzer::Base::paintEvent(QPaintEvent* e) {
@@ -104,23 +98,23 @@ void Analyzer::Base::paintEvent(QPaintEvent* e) {
 
   switch (engine_->state()) {
     case Engine::Playing: {
-      const Engine::Scope& thescope = engine_->scope(timeout_);
-      int i = 0;
-
-      // convert to mono here - our built in analyzers need mono, but the
-      // engines provide interleaved pcm
-      for (uint x = 0; static_cast<int>(x) < fht_->size(); ++x) {
-        lastScope_[x] = static_cast<double>(thescope[i] + thescope[i + 1]) /
-                        (2 * (1 << 15));
-        i += 2;
+      if (spectrum_service_) {
+        SpectrumFramePtr frame =
+            spectrum_service_->Latest(fht_->sizeExp());
+        if (frame) {
+          lastScope_ = frame->power;
+        } else {
+          lastScope_.assign(fht_->size() / 2, 0);
+        }
+      } else {
+        SpectrumService::Transform(engine_->scope(timeout_), fht_,
+                                   &lastScope_);
       }
 
       is_playing_ = true;
       transform(lastScope_);
       analyze(p, lastScope_, new_frame_);
 
-      // scope.resize( fht_->size() );
-
       break;
     }
     case Engine::Paused:
@@ -285,6 +279,11 @@ void Analyzer::Base::timerEvent(QTimerEvent* e) {
   QWidget::timerEvent(e);
   if (e->timerId() != timer_.timerId()) return;
 
+  // Ask for the next frame now, it'll be ready by the time we paint again.
+  if (spectrum_service_ && engine_ && engine_->state() == Engine::Playing) {
+    spectrum_service_->Request(fht_->sizeExp());
+  }
+
   new_frame_ = true;
   update();
 }
@@ -52,6 +52,8 @@ class QResizeEvent;
 
 namespace Analyzer {
 
+class SpectrumService;
+
 typedef std::vector<float> Scope;
 
 class Base : public QWidget {
@@ -64,6 +66,12 @@ class Base : public QWidget {
 
   void set_engine(EngineBase* engine) { engine_ = engine; }
 
+  // If there's a spectrum service the analyzer shows the frames it computes
+  // instead of transforming the engine's scope itself.
+  void set_spectrum_service(SpectrumService* service) {
+    spectrum_service_ = service;
+  }
+
   void changeTimeout(uint newTimeout) {
     timeout_ = newTimeout;
     if (timer_.isActive()) {
@@ -91,6 +99,8 @@ class Base : public QWidget {
   void updateBandSize(const int);
   QColor getPsychedelicColor(const Scope&, const int, const int);
   virtual void init() {}
+  // Called with the FHT::power2 spectrum of the scope, fht_->size() / 2
+  // values, to turn it into whatever analyze() wants to draw.
   virtual void transform(Scope&);
   virtual void analyze(QPainter& p, const Scope&, bool new_frame) = 0;
   virtual void demo(QPainter& p);
@@ -103,7 +113,10 @@ class Base : public QWidget {
   uint timeout_;
   FHT* fht_;
   EngineBase* engine_;
+  SpectrumService* spectrum_service_;
   Scope lastScope_;
+  // Scratch space for transform(), kept to avoid allocating every frame.
+  Scope transformScope_;
 
   bool new_frame_;
   bool is_playing_;
@@ -27,6 +27,7 @@
 #include "nyancatanalyzer.h"
 #include "rainbowdashanalyzer.h"
 #include "sonogram.h"
+#include "spectrumservice.h"
 #include "turbine.h"
 #include "core/logging.h"
 
@@ -59,6 +60,7 @@ AnalyzerContainer::AnalyzerContainer(QWidget* parent)
       ignore_next_click_(false),
       psychedelic_colors_on_(false),
       current_analyzer_(nullptr),
+      spectrum_service_(new Analyzer::SpectrumService(this)),
       engine_(nullptr) {
   QHBoxLayout* layout = new QHBoxLayout(this);
   setLayout(layout);
@@ -141,6 +143,7 @@ void AnalyzerContainer::wheelEvent(QWheelEvent* e) {
 
 void AnalyzerContainer::SetEngine(EngineBase* engine) {
   if (current_analyzer_) current_analyzer_->set_engine(engine);
+  spectrum_service_->set_engine(engine);
   engine_ = engine;
 }
 
@@ -171,6 +174,7 @@ void AnalyzerContainer::ChangeAnalyzer(int id) {
   delete current_analyzer_;
   current_analyzer_ = qobject_cast<Analyzer::Base*>(instance);
   current_analyzer_->set_engine(engine_);
+  current_analyzer_->set_spectrum_service(spectrum_service_);
   // Even if it is not supposed to happen, I don't want to get a dbz error
   current_framerate_ =
       current_framerate_ == 0 ? kMediumFramerate : current_framerate_;
@@ -92,6 +92,7 @@ signals:
   bool psychedelic_colors_on_;
 
   Analyzer::Base* current_analyzer_;
+  Analyzer::SpectrumService* spectrum_service_;
   EngineBase* engine_;
 };
 
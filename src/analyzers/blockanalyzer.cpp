@@ -125,12 +125,11 @@ void BlockAnalyzer::framerateChanged() {  // virtual
 }
 
 void BlockAnalyzer::transform(Analyzer::Scope& s) {
-  for (uint x = 0; x < s.size(); ++x) s[x] *= 2;
-
   float* front = static_cast<float*>(&s.front());
 
-  fht_->spectrum(front);
-  fht_->scale(front, 1.0 / 20);
+  // Doubling the spectrum is the same as doubling the scope it came from.
+  fht_->spectrumFromPower2(front);
+  fht_->scale(front, 1.0 / 10);
 
   // the second half is pretty dull, so only show it if the user has a large
   // analyzer
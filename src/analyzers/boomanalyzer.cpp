@@ -95,7 +95,7 @@ void BoomAnalyzer::resizeEvent(QResizeEvent* e) {
 void BoomAnalyzer::transform(Scope& s) {
   float* front = static_cast<float*>(&s.front());
 
-  fht_->spectrum(front);
+  fht_->spectrumFromPower2(front);
   fht_->scale(front, 1.0 / 50);
 
   s.resize(scope_.size() <= kMaxBandCount / 2 ? kMaxBandCount / 2
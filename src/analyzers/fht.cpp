@@ -24,7 +24,55 @@
 #include <string.h>
 #include "fht.h"
 
-FHT::FHT(int n) : buf_(0), tab_(0), log_(0) {
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// For 0 < i < half, sums[i] = lo[i] + a and diffs[i] = lo[i] - a, where
+// a = cos_tab[i] * hi[i] + sin_tab[i] * hi[half - i].  Four at a time where
+// SSE or NEON is available, with the same operations in the same order as
+// the scalar loop so the results don't change.
+void butterflies(const float* lo, const float* hi, const float* cos_tab,
+                 const float* sin_tab, int half, float* sums, float* diffs) {
+  int i = 1;
+#if defined(__SSE__)
+  for (; i + 4 <= half; i += 4) {
+    const __m128 rev = _mm_loadu_ps(hi + half - i - 3);
+    const __m128 a = _mm_add_ps(
+        _mm_mul_ps(_mm_loadu_ps(cos_tab + i), _mm_loadu_ps(hi + i)),
+        _mm_mul_ps(_mm_loadu_ps(sin_tab + i),
+                   _mm_shuffle_ps(rev, rev, _MM_SHUFFLE(0, 1, 2, 3))));
+    const __m128 l = _mm_loadu_ps(lo + i);
+    _mm_storeu_ps(sums + i, _mm_add_ps(l, a));
+    _mm_storeu_ps(diffs + i, _mm_sub_ps(l, a));
+  }
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+  for (; i + 4 <= half; i += 4) {
+    const float32x4_t pairs = vrev64q_f32(vld1q_f32(hi + half - i - 3));
+    const float32x4_t rev =
+        vcombine_f32(vget_high_f32(pairs), vget_low_f32(pairs));
+    const float32x4_t a =
+        vaddq_f32(vmulq_f32(vld1q_f32(cos_tab + i), vld1q_f32(hi + i)),
+                  vmulq_f32(vld1q_f32(sin_tab + i), rev));
+    const float32x4_t l = vld1q_f32(lo + i);
+    vst1q_f32(sums + i, vaddq_f32(l, a));
+    vst1q_f32(diffs + i, vsubq_f32(l, a));
+  }
+#endif
+  for (; i < half; i++) {
+    const float a = cos_tab[i] * hi[i] + sin_tab[i] * hi[half - i];
+    sums[i] = lo[i] + a;
+    diffs[i] = lo[i] - a;
+  }
+}
+
+}  // namespace
+
+FHT::FHT(int n) : buf_(0), tab_(0), twiddles_(0), log_(0) {
   if (n < 3) {
     num_ = 0;
     exp2_ = -1;
@@ -35,13 +83,16 @@ FHT::FHT(int n) : buf_(0), tab_(0), log_(0) {
   if (n > 3) {
     buf_ = new float[num_];
     tab_ = new float[num_ * 2];
+    twiddles_ = new float[num_ * 2];
     makeCasTable();
+    makeTwiddles();
   }
 }
 
 FHT::~FHT() {
   delete[] buf_;
   delete[] tab_;
+  delete[] twiddles_;
   delete[] log_;
 }
 
@@ -58,6 +109,21 @@ void FHT::makeCasTable(void) {
   }
 }
 
+void FHT::makeTwiddles() {
+  // Level half of _transform() uses the pair of values at every
+  // (num_ / half)th position of tab_.  The levels are stored one after
+  // another from half = 8, so level half starts at 2 * (half - 8).
+  float* t = twiddles_;
+  for (int half = 8; half < num_; half *= 2) {
+    const int step = num_ / half;
+    for (int i = 0; i < half; i++) {
+      t[i] = tab_[i * step];
+      t[half + i] = tab_[i * step + 1];
+    }
+    t += half * 2;
+  }
+}
+
 float* FHT::copy(float* d, float* s) {
   return static_cast<float*>(memcpy(d, s, num_ * sizeof(float)));
 }
@@ -75,6 +141,11 @@ void FHT::ewma(float* d, float* s, float w) {
 }
 
 void FHT::logSpectrum(float* out, float* p) {
+  power2(p);
+  logSpectrumFromPower2(out, p);
+}
+
+void FHT::logSpectrumFromPower2(float* out, float* p) {
   int n = num_ / 2, i, j, k, *r;
   if (!log_) {
     log_ = new int[n];
@@ -84,7 +155,7 @@ void FHT::logSpectrum(float* out, float* p) {
       *r = j >= n ? n - 1 : j;
     }
   }
-  semiLogSpectrum(p);
+  semiLogSpectrumFromPower2(p);
   *out++ = *p = *p / 100;
   for (k = i = 1, r = log_; i < n; i++) {
     j = *r++;
@@ -99,18 +170,27 @@ void FHT::logSpectrum(float* out, float* p) {
 }
 
 void FHT::semiLogSpectrum(float* p) {
-  float e;
   power2(p);
-  for (int i = 0; i < (num_ / 2); i++, p++) {
-    e = 10.0 * log10(sqrt(*p * .5));
-    *p = e < 0 ? 0 : e;
+  semiLogSpectrumFromPower2(p);
+}
+
+void FHT::semiLogSpectrumFromPower2(float* p) {
+  // 10 * log10(sqrt(x)) == 5 * log10(x), which saves a square root per value.
+  const int n = num_ / 2;
+  for (int i = 0; i < n; i++) {
+    const float e = 5.0f * log10f(p[i] * .5f);
+    p[i] = e < 0 ? 0 : e;
   }
 }
 
 void FHT::spectrum(float* p) {
   power2(p);
-  for (int i = 0; i < (num_ / 2); i++, p++)
-    *p = static_cast<float>(sqrt(*p * .5));
+  spectrumFromPower2(p);
+}
+
+void FHT::spectrumFromPower2(float* p) {
+  const int n = num_ / 2;
+  for (int i = 0; i < n; i++) p[i] = sqrtf(p[i] * .5f);
 }
 
 void FHT::power(float* p) {
@@ -169,8 +249,8 @@ void FHT::_transform(float* p, int n, int k) {
     return;
   }
 
-  int i, j, ndiv2 = n / 2;
-  float a, *t1, *t2, *t3, *t4, *ptab, *pp;
+  int i, ndiv2 = n / 2;
+  float *t1, *t2, *pp;
 
   for (i = 0, t1 = buf_, t2 = buf_ + ndiv2, pp = &p[k]; i < ndiv2; i++)
     *t1++ = *pp++, *t2++ = *pp++;
@@ -180,26 +260,16 @@ void FHT::_transform(float* p, int n, int k) {
   _transform(p, ndiv2, k);
   _transform(p, ndiv2, k + ndiv2);
 
-  j = num_ / ndiv2 - 1;
-  t1 = buf_;
-  t2 = t1 + ndiv2;
-  t3 = p + k + ndiv2;
-  ptab = tab_;
-  pp = p + k;
-
-  a = *ptab++ * *t3++;
-  a += *ptab * *pp;
-  ptab += j;
+  const float* cos_tab = twiddles_ + 2 * (ndiv2 - 8);
+  const float* sin_tab = cos_tab + ndiv2;
+  const float* lo = p + k;
+  const float* hi = lo + ndiv2;
 
-  *t1++ = *pp + a;
-  *t2++ = *pp++ - a;
+  // The first butterfly pairs lo[0] with itself.
+  const float a = cos_tab[0] * hi[0] + sin_tab[0] * lo[0];
+  buf_[0] = lo[0] + a;
+  buf_[ndiv2] = lo[0] - a;
 
-  for (i = 1, t4 = p + k + n; i < ndiv2; i++, ptab += j) {
-    a = *ptab++ * *t3++;
-    a += *ptab * *--t4;
-
-    *t1++ = *pp + a;
-    *t2++ = *pp++ - a;
-  }
+  butterflies(lo, hi, cos_tab, sin_tab, ndiv2, buf_, buf_ + ndiv2);
   memcpy(p + k, buf_, sizeof(float) * n);
 }
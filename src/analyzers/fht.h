@@ -36,6 +36,7 @@ class FHT {
   int num_;
   float* buf_;
   float* tab_;
+  float* twiddles_;
   int* log_;
 
   /**
@@ -45,6 +46,13 @@ class FHT {
    */
   void makeCasTable();
 
+  /**
+   * Copy the cas values that each level of _transform() uses into their own
+   * contiguous cosine and sine arrays, so its butterflies can be computed
+   * several at a time.
+   */
+  void makeTwiddles();
+
   /**
    * Recursive in-place Hartley transform. For internal use only!
    */
@@ -82,16 +90,32 @@ class FHT {
    */
   void logSpectrum(float* out, float* p);
 
+  /**
+   * Same as logSpectrum(), for data that has already been through power2().
+   */
+  void logSpectrumFromPower2(float* out, float* p);
+
   /**
    * Semi-logarithmic audio spectrum.
    */
   void semiLogSpectrum(float*);
 
+  /**
+   * Same as semiLogSpectrum(), for data that has already been through
+   * power2().
+   */
+  void semiLogSpectrumFromPower2(float*);
+
   /**
    * Fourier spectrum.
    */
   void spectrum(float*);
 
+  /**
+   * Same as spectrum(), for data that has already been through power2().
+   */
+  void spectrumFromPower2(float*);
+
   /**
    * Calculates a mathematically correct FFT power spectrum.
    * If further scaling is applied later, use power2 instead
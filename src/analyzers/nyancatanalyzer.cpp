@@ -57,7 +57,9 @@ NyanCatAnalyzer::NyanCatAnalyzer(QWidget* parent)
   }
 }
 
-void NyanCatAnalyzer::transform(Scope& s) { fht_->spectrum(&s.front()); }
+void NyanCatAnalyzer::transform(Scope& s) {
+  fht_->spectrumFromPower2(&s.front());
+}
 
 void NyanCatAnalyzer::timerEvent(QTimerEvent* e) {
   if (e->timerId() == timer_id_) {
@@ -81,8 +83,7 @@ void NyanCatAnalyzer::resizeEvent(QResizeEvent* e) {
 
 void NyanCatAnalyzer::analyze(QPainter& p, const Analyzer::Scope& s,
                               bool new_frame) {
-  // Discard the second half of the transform
-  const int scope_size = s.size() / 2;
+  const int scope_size = s.size();
 
   if ((new_frame && is_playing_) ||
       (buffer_[0].isNull() && buffer_[1].isNull())) {
@@ -57,7 +57,9 @@ RainbowDashAnalyzer::RainbowDashAnalyzer(QWidget* parent)
   }
 }
 
-void RainbowDashAnalyzer::transform(Scope& s) { fht_->spectrum(&s.front()); }
+void RainbowDashAnalyzer::transform(Scope& s) {
+  fht_->spectrumFromPower2(&s.front());
+}
 
 void RainbowDashAnalyzer::timerEvent(QTimerEvent* e) {
   if (e->timerId() == timer_id_) {
@@ -81,8 +83,7 @@ void RainbowDashAnalyzer::resizeEvent(QResizeEvent* e) {
 
 void RainbowDashAnalyzer::analyze(QPainter& p, const Analyzer::Scope& s,
                                   bool new_frame) {
-  // Discard the second half of the transform
-  const int scope_size = s.size() / 2;
+  const int scope_size = s.size();
 
   if ((new_frame && is_playing_) ||
       (buffer_[0].isNull() && buffer_[1].isNull())) {
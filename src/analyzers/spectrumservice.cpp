@@ -0,0 +1,154 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "spectrumservice.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "core/concurrentrun.h"
+#include "fht.h"
+
+using std::bind;
+
+namespace Analyzer {
+
+SpectrumService::SpectrumService(QObject* parent)
+    : QObject(parent),
+      engine_(nullptr),
+      requested_(0),
+      in_progress_(0),
+      watcher_(new QFutureWatcher<void>(this)) {
+  // Frames are transformed one after another, so one thread is enough, and
+  // it's never let go so each frame doesn't have to wait for a new one.
+  thread_pool_.setMaxThreadCount(1);
+  thread_pool_.setExpiryTimeout(-1);
+
+  connect(watcher_, SIGNAL(finished()), SLOT(TransformFinished()));
+}
+
+SpectrumService::~SpectrumService() { watcher_->waitForFinished(); }
+
+SpectrumFramePtr SpectrumService::Latest(int size_exp) const {
+  if (size_exp < kMinSizeExp || size_exp > kMaxSizeExp) {
+    return SpectrumFramePtr();
+  }
+  return sizes_[size_exp].latest_;
+}
+
+void SpectrumService::Request(int size_exp) {
+  if (size_exp < kMinSizeExp || size_exp > kMaxSizeExp) {
+    return;
+  }
+
+  requested_ |= 1 << size_exp;
+
+  if (!in_progress_) {
+    StartTransform();
+  }
+}
+
+void SpectrumService::StartTransform() {
+  if (!engine_ || !requested_) {
+    return;
+  }
+
+  // The engine's scope can only be read from this thread, so take a copy for
+  // the worker.
+  const Engine::Scope& scope = engine_->scope(0);
+  pcm_.assign(scope.begin(), scope.end());
+
+  for (int exp = kMinSizeExp; exp <= kMaxSizeExp; ++exp) {
+    if (!(requested_ & (1 << exp))) {
+      continue;
+    }
+
+    Size* size = &sizes_[exp];
+    if (!size->fht_) {
+      size->fht_.reset(new FHT(exp));
+    }
+
+    // Find a frame that no analyzer is looking at.
+    for (const std::shared_ptr<SpectrumFrame>& frame : size->pool_) {
+      if (frame.use_count() == 1) {
+        size->pending_ = frame;
+        break;
+      }
+    }
+    if (!size->pending_) {
+      size->pending_.reset(new SpectrumFrame);
+      size->pending_->size_exp = exp;
+      size->pool_ << size->pending_;
+    }
+  }
+
+  in_progress_ = requested_;
+  requested_ = 0;
+
+  watcher_->setFuture(ConcurrentRun::Run<void>(
+      &thread_pool_, bind(&SpectrumService::TransformPending, this)));
+}
+
+void SpectrumService::TransformPending() {
+  for (int exp = kMinSizeExp; exp <= kMaxSizeExp; ++exp) {
+    if (in_progress_ & (1 << exp)) {
+      Size* size = &sizes_[exp];
+      Transform(pcm_, size->fht_.get(), &size->pending_->power);
+    }
+  }
+}
+
+void SpectrumService::TransformFinished() {
+  for (int exp = kMinSizeExp; exp <= kMaxSizeExp; ++exp) {
+    if (in_progress_ & (1 << exp)) {
+      Size* size = &sizes_[exp];
+      size->latest_ = size->pending_;
+      size->pending_.reset();
+    }
+  }
+  in_progress_ = 0;
+
+  emit FrameReady();
+
+  StartTransform();
+}
+
+void SpectrumService::Transform(const Engine::Scope& pcm, FHT* fht,
+                                Scope* power) {
+  const int size = fht->size();
+  const int frames = std::min(size, static_cast<int>(pcm.size() / 2));
+
+  // Resizing never shrinks the capacity, so this only allocates the first
+  // time.
+  power->resize(size);
+  float* p = &power->front();
+
+  // Convert to mono here - our built in analyzers need mono, but the engines
+  // provide interleaved pcm.
+  const int16_t* in = pcm.data();
+  for (int i = 0; i < frames; ++i) {
+    p[i] = static_cast<double>(in[i * 2] + in[i * 2 + 1]) / (2 * (1 << 15));
+  }
+  std::fill(p + frames, p + size, 0.0f);
+
+  fht->power2(p);
+
+  // The second half of the values are rubbish.
+  power->resize(size / 2);
+}
+
+}  // namespace Analyzer
@@ -0,0 +1,113 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ANALYZERS_SPECTRUMSERVICE_H_
+#define ANALYZERS_SPECTRUMSERVICE_H_
+
+#include <memory>
+
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
+#include <QThreadPool>
+
+#include "analyzerbase.h"
+#include "engines/enginebase.h"
+
+class FHT;
+
+namespace Analyzer {
+
+// The power spectrum of one scope.  Frames are never changed after they have
+// been published, so all the analyzers can share them.
+struct SpectrumFrame {
+  SpectrumFrame() : size_exp(0) {}
+
+  int size_exp;
+
+  // FHT::power2 of 2^size_exp mono samples, so 2^(size_exp - 1) values.
+  Scope power;
+};
+
+typedef std::shared_ptr<const SpectrumFrame> SpectrumFramePtr;
+
+// Transforms the samples the engine is playing into power spectra on a worker
+// thread of its own, which is kept for as long as the service.  Each frame is
+// computed once no matter how many analyzers ask for it, and the frames are
+// recycled so nothing is allocated once playback has started.
+class SpectrumService : public QObject {
+  Q_OBJECT
+
+ public:
+  explicit SpectrumService(QObject* parent = nullptr);
+  ~SpectrumService();
+
+  static const int kMinSizeExp = 3;
+  static const int kMaxSizeExp = 9;
+
+  void set_engine(EngineBase* engine) { engine_ = engine; }
+
+  // Returns the newest spectrum of 2^size_exp samples, or null if there isn't
+  // one yet.
+  SpectrumFramePtr Latest(int size_exp) const;
+
+  // Asks for a spectrum of 2^size_exp samples of what the engine is playing
+  // now.  FrameReady is emitted once it's available from Latest().  Requests
+  // made while a frame is being computed are handled together straight after
+  // it.
+  void Request(int size_exp);
+
+  // Mixes the interleaved stereo samples in pcm down to mono and replaces
+  // power with their power spectrum.  Reuses power's storage.
+  static void Transform(const Engine::Scope& pcm, FHT* fht, Scope* power);
+
+ signals:
+  void FrameReady();
+
+ private slots:
+  void TransformFinished();
+
+ private:
+  struct Size {
+    std::unique_ptr<FHT> fht_;
+    SpectrumFramePtr latest_;
+    std::shared_ptr<SpectrumFrame> pending_;
+
+    // Frames that have been used before.  A frame is free again once nothing
+    // else holds a reference to it.
+    QList<std::shared_ptr<SpectrumFrame>> pool_;
+  };
+
+  void StartTransform();
+  void TransformPending();
+
+  EngineBase* engine_;
+  Engine::Scope pcm_;
+
+  Size sizes_[kMaxSizeExp + 1];
+
+  // Bitmasks of size exponents.
+  int requested_;
+  int in_progress_;
+
+  QThreadPool thread_pool_;
+  QFutureWatcher<void>* watcher_;
+};
+
+}  // namespace Analyzer
+
+#endif  // ANALYZERS_SPECTRUMSERVICE_H_
@@ -25,8 +25,10 @@
 #include "config.h"
 #include "database.h"
 #include "player.h"
+#include "stringpool.h"
 #include "tagreaderclient.h"
 #include "taskmanager.h"
+#include "core/logging.h"
 #include "covers/albumcoverloader.h"
 #include "covers/coverproviders.h"
 #include "covers/currentartloader.h"
@@ -159,6 +161,8 @@ Application::~Application() {
   for (QThread* thread : threads_) {
     thread->wait();
   }
+
+  qLog(Debug) << StringPool::statistics();
 }
 
 void Application::MoveToNewThread(QObject* object) {
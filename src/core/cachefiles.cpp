@@ -0,0 +1,80 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cachefiles.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryFile>
+
+#include "core/logging.h"
+
+namespace {
+
+// Files are written under a name containing this, and renamed once they're
+// complete.
+const char* kTempFileInfix = ".tmp.";
+
+}  // namespace
+
+namespace CacheFiles {
+
+const int kStaleTempFileAgeSecs = 60 * 60;
+
+bool Save(const QString& filename, std::function<bool(QIODevice*)> write) {
+  QTemporaryFile file(filename + kTempFileInfix + "XXXXXX");
+  if (!file.open()) {
+    qLog(Warning) << "Couldn't save" << filename << file.errorString();
+    return false;
+  }
+  if (!write(&file)) return false;
+
+  QFile::remove(filename);
+  if (!file.rename(filename)) return false;
+  file.setAutoRemove(false);
+  return true;
+}
+
+void Trim(const QString& path, qint64 max_size) {
+  QFileInfoList files =
+      QDir(path).entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
+  const QDateTime stale_before =
+      QDateTime::currentDateTime().addSecs(-kStaleTempFileAgeSecs);
+
+  qint64 size = 0;
+  QFileInfoList entries;
+  for (const QFileInfo& info : files) {
+    if (info.fileName().contains(kTempFileInfix)) {
+      if (info.lastModified() < stale_before) {
+        QFile::remove(info.absoluteFilePath());
+      }
+      continue;
+    }
+    size += info.size();
+    entries << info;
+  }
+
+  for (const QFileInfo& info : entries) {
+    if (size <= max_size) break;
+    size -= info.size();
+    QFile::remove(info.absoluteFilePath());
+  }
+}
+
+}  // namespace CacheFiles
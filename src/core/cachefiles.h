@@ -0,0 +1,46 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_CACHEFILES_H_
+#define CORE_CACHEFILES_H_
+
+#include <functional>
+
+#include <QString>
+
+class QIODevice;
+
+// Helpers for the caches that keep one file per entry in a directory and can
+// be written from several threads at once.
+namespace CacheFiles {
+
+// Temporary files older than this were left behind by a crash.
+extern const int kStaleTempFileAgeSecs;
+
+// Calls write with a new temporary file next to filename, and renames it to
+// filename if write returns true.  Readers never see half a file, and saving
+// the same file twice at once can't mix up the two.
+bool Save(const QString& filename, std::function<bool(QIODevice*)> write);
+
+// Deletes the least recently written files in path until they take up less
+// than max_size, and any stale temporary files.  Newer temporary files are
+// left alone, since another thread might still be writing them.
+void Trim(const QString& path, qint64 max_size);
+
+}  // namespace CacheFiles
+
+#endif  // CORE_CACHEFILES_H_
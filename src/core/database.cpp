@@ -47,7 +47,7 @@
 #include <QVariant>
 
 const char* Database::kDatabaseFilename = "clementine.db";
-const int Database::kSchemaVersion = 50;
+const int Database::kSchemaVersion = 53;
 const char* Database::kMagicAllSongsTables = "%allsongstables";
 
 int Database::sNextConnectionId = 1;
@@ -212,6 +212,7 @@ Database::Database(Application* app, QObject* parent,
     : QObject(parent),
       app_(app),
       mutex_(QMutex::Recursive),
+      wal_enabled_(false),
       injected_database_name_(database_name),
       query_hash_(0),
       startup_schema_version_(-1) {
@@ -230,7 +231,25 @@ Database::Database(Application* app, QObject* parent,
   Connect();
 }
 
-QSqlDatabase Database::Connect() {
+QSqlDatabase Database::Connect() { return OpenConnection(false); }
+
+QSqlDatabase Database::ConnectReadOnly() {
+  if (!wal_enabled_) return Connect();
+
+  // A reader can't create the files of attached databases, so use the writer
+  // connection until they exist.
+  if (injected_database_name_.isNull()) {
+    for (const AttachedDatabase& database : attached_databases_) {
+      if (!database.is_temporary_ && !QFile::exists(database.filename_)) {
+        return Connect();
+      }
+    }
+  }
+
+  return OpenConnection(true);
+}
+
+QSqlDatabase Database::OpenConnection(bool read_only) {
   QMutexLocker l(&connect_mutex_);
 
   // Create the directory if it doesn't exist
@@ -240,8 +259,9 @@ QSqlDatabase Database::Connect() {
     }
   }
 
-  const QString connection_id = QString("%1_thread_%2").arg(connection_id_).arg(
+  QString connection_id = QString("%1_thread_%2").arg(connection_id_).arg(
       reinterpret_cast<quint64>(QThread::currentThread()));
+  if (read_only) connection_id += "_readonly";
 
   // Try to find an existing connection for this thread
   QSqlDatabase db = QSqlDatabase::database(connection_id);
@@ -256,6 +276,8 @@ QSqlDatabase Database::Connect() {
   else
     db.setDatabaseName(directory_ + "/" + kDatabaseFilename);
 
+  if (read_only) db.setConnectOptions("QSQLITE_OPEN_READONLY");
+
   if (!db.open()) {
     app_->AddError("Database: " + db.lastError().text());
     return db;
@@ -277,7 +299,17 @@ QSqlDatabase Database::Connect() {
     // to release any remaining database locks!
   }
 
-  if (db.tables().count() == 0) {
+  // Only the first connection, opened by our constructor, switches the
+  // database to WAL mode.  That happens before any other thread can use this
+  // object, so wal_enabled_ never changes while readers are looking at it.
+  // The journal mode is stored in the database file, so later connections
+  // use WAL anyway.
+  if (!read_only && startup_schema_version_ == -1 &&
+      injected_database_name_ != ":memory:") {
+    EnableWal(db);
+  }
+
+  if (!read_only && db.tables().count() == 0) {
     // Set up initial schema
     qLog(Info) << "Creating initial database schema";
     UpdateDatabaseSchema(0, db);
@@ -299,6 +331,20 @@ QSqlDatabase Database::Connect() {
     }
   }
 
+  // Readers don't touch the schema - the writer connection opened in our
+  // constructor has already set it up.
+  if (read_only) {
+    return db;
+  }
+
+  if (wal_enabled_) {
+    for (const QString& key : attached_databases_.keys()) {
+      if (attached_databases_[key].is_temporary_) continue;
+      QSqlQuery q(QString("PRAGMA %1.journal_mode = WAL").arg(key), db);
+      q.exec();
+    }
+  }
+
   if (startup_schema_version_ == -1) {
     UpdateMainSchema(&db);
   }
@@ -323,6 +369,18 @@ QSqlDatabase Database::Connect() {
   return db;
 }
 
+void Database::EnableWal(QSqlDatabase& db) {
+  // journal_mode is persistent, but still returns the current mode.
+  QSqlQuery q("PRAGMA journal_mode = WAL", db);
+  if (q.exec() && q.next() &&
+      q.value(0).toString().compare("wal", Qt::CaseInsensitive) == 0) {
+    qLog(Info) << "Database is in WAL mode";
+    wal_enabled_ = true;
+  } else {
+    qLog(Warning) << "Couldn't enable WAL mode - readers will block writers";
+  }
+}
+
 void Database::UpdateMainSchema(QSqlDatabase* db) {
   // Get the database's schema version
   int schema_version = 0;
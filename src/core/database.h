@@ -69,6 +69,16 @@ class Database : public QObject {
   bool CheckErrors(const QSqlQuery& query);
   QMutex* Mutex() { return &mutex_; }
 
+  // Returns a connection for this thread that can only be used for reading.
+  // The database is put in WAL mode when it's opened, and then readers see the
+  // last committed state without blocking, or being blocked by, the writer.
+  // Lock ReadMutex() instead of Mutex() while using these connections.  If
+  // WAL mode isn't available (like for in-memory databases) this is the same
+  // as Connect().
+  QSqlDatabase ConnectReadOnly();
+  QMutex* ReadMutex() { return wal_enabled_ ? nullptr : &mutex_; }
+  bool is_wal_enabled() const { return wal_enabled_; }
+
   void RecreateAttachedDb(const QString& database_name);
   void ExecSchemaCommands(QSqlDatabase& db, const QString& schema,
                           int schema_version, bool in_transaction = false);
@@ -104,6 +114,8 @@ class Database : public QObject {
   bool IntegrityCheck(QSqlDatabase db);
   void BackupFile(const QString& filename);
   bool OpenDatabase(const QString& filename, sqlite3** connection) const;
+  QSqlDatabase OpenConnection(bool read_only);
+  void EnableWal(QSqlDatabase& db);
 
   Application* app_;
 
@@ -114,6 +126,10 @@ class Database : public QObject {
   QMutex connect_mutex_;
   QMutex mutex_;
 
+  // Only written when our constructor opens the first connection, so other
+  // threads can read it without locking.
+  bool wal_enabled_;
+
   // This ID makes the QSqlDatabase name unique to the object as well as the
   // thread
   int connection_id_;
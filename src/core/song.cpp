@@ -29,12 +29,14 @@
 #include "song.h"
 
 #include <algorithm>
+#include <atomic>
 
 #include <QCoreApplication>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QLatin1Literal>
+#include <QMutex>
 #include <QSharedData>
 #include <QSqlQuery>
 #include <QTextCodec>
@@ -65,6 +67,7 @@
 #include "core/logging.h"
 #include "core/messagehandler.h"
 #include "core/mpris_common.h"
+#include "core/stringpool.h"
 #include "core/timeconstants.h"
 #include "core/utilities.h"
 #include "covers/albumcoverloader.h"
@@ -141,6 +144,87 @@ const QString Song::kFtsUpdateSpec =
 const QString Song::kManuallyUnsetCover = "(unset)";
 const QString Song::kEmbeddedCover = "(embedded)";
 
+namespace {
+
+QUrl PortableUrl(const QUrl& url) {
+  if (Application::kIsPortable) {
+    QUrl base =
+        QUrl::fromLocalFile(QCoreApplication::applicationDirPath() + "/");
+    return base.resolved(url);
+  }
+  return url;
+}
+
+QMutex sDecodeUrlMutex;
+
+// A song's URL and the filename part of it.  Songs loaded from the database
+// only keep the encoded URL, and it's decoded the first time either part is
+// asked for - most songs in a big library never are.  Const Songs can be used
+// from any thread, so decoding is done under a lock.
+class SongUrl {
+ public:
+  SongUrl() : pending_(false) {}
+
+  SongUrl(const SongUrl& other) : pending_(false) {
+    // Another thread might be decoding other while it's copied.
+    QMutexLocker l(other.pending_.load(std::memory_order_acquire)
+                       ? &sDecodeUrlMutex
+                       : nullptr);
+    pending_.store(other.pending_.load(std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+    encoded_ = other.encoded_;
+    url_ = other.url_;
+    basefilename_ = other.basefilename_;
+  }
+
+  const QUrl& url() const {
+    Decode();
+    return url_;
+  }
+  const QString& basefilename() const {
+    Decode();
+    return basefilename_;
+  }
+
+  void set_url(const QUrl& url) {
+    Decode();
+    url_ = url;
+  }
+  void set_basefilename(const QString& basefilename) {
+    Decode();
+    basefilename_ = basefilename;
+  }
+
+  // Sets the URL and the filename part of it from the URL as it's stored in
+  // the database.
+  void set_encoded(const QByteArray& encoded) {
+    encoded_ = encoded;
+    pending_.store(true, std::memory_order_relaxed);
+  }
+
+ private:
+  SongUrl& operator=(const SongUrl&);
+
+  void Decode() const {
+    if (!pending_.load(std::memory_order_acquire)) return;
+
+    QMutexLocker l(&sDecodeUrlMutex);
+    if (!pending_.load(std::memory_order_relaxed)) return;
+
+    url_ = PortableUrl(QUrl::fromEncoded(encoded_));
+    basefilename_ = QFileInfo(url_.toLocalFile()).fileName();
+    encoded_.clear();
+    pending_.store(false, std::memory_order_release);
+  }
+
+  mutable std::atomic<bool> pending_;
+  mutable QByteArray encoded_;
+  mutable QUrl url_;
+  mutable QString basefilename_;
+};
+
+}  // namespace
+
 struct Song::Private : public QSharedData {
   Private();
 
@@ -197,8 +281,7 @@ struct Song::Private : public QSharedData {
   int samplerate_;
 
   int directory_id_;
-  QUrl url_;
-  QString basefilename_;
+  SongUrl url_;
   int mtime_;
   int ctime_;
   int filesize_;
@@ -313,8 +396,8 @@ qint64 Song::length_nanosec() const { return d->end_ - d->beginning_; }
 int Song::bitrate() const { return d->bitrate_; }
 int Song::samplerate() const { return d->samplerate_; }
 int Song::directory_id() const { return d->directory_id_; }
-const QUrl& Song::url() const { return d->url_; }
-const QString& Song::basefilename() const { return d->basefilename_; }
+const QUrl& Song::url() const { return d->url_.url(); }
+const QString& Song::basefilename() const { return d->url_.basefilename(); }
 uint Song::mtime() const { return d->mtime_; }
 uint Song::ctime() const { return d->ctime_; }
 int Song::filesize() const { return d->filesize_; }
@@ -381,17 +464,9 @@ void Song::set_cue_path(const QString& v) { d->cue_path_ = v; }
 void Song::set_unavailable(bool v) { d->unavailable_ = v; }
 void Song::set_etag(const QString& etag) { d->etag_ = etag; }
 
-void Song::set_url(const QUrl& v) {
-  if (Application::kIsPortable) {
-    QUrl base =
-        QUrl::fromLocalFile(QCoreApplication::applicationDirPath() + "/");
-    d->url_ = base.resolved(v);
-  } else {
-    d->url_ = v;
-  }
-}
+void Song::set_url(const QUrl& v) { d->url_.set_url(PortableUrl(v)); }
 
-void Song::set_basefilename(const QString& v) { d->basefilename_ = v; }
+void Song::set_basefilename(const QString& v) { d->url_.set_basefilename(v); }
 void Song::set_directory_id(int v) { d->directory_id_ = v; }
 
 QString Song::JoinSpec(const QString& table) {
@@ -497,10 +572,11 @@ void Song::InitFromProtobuf(const pb::tagreader::SongMetadata& pb) {
   d->init_from_file_ = true;
   d->valid_ = pb.valid();
   d->title_ = QStringFromStdString(pb.title());
-  d->album_ = QStringFromStdString(pb.album());
-  d->artist_ = QStringFromStdString(pb.artist());
-  d->albumartist_ = QStringFromStdString(pb.albumartist());
-  d->composer_ = QStringFromStdString(pb.composer());
+  // These repeat across many songs, so share one copy of each.
+  d->album_ = StringPool::Intern(QStringFromStdString(pb.album()));
+  d->artist_ = StringPool::Intern(QStringFromStdString(pb.artist()));
+  d->albumartist_ = StringPool::Intern(QStringFromStdString(pb.albumartist()));
+  d->composer_ = StringPool::Intern(QStringFromStdString(pb.composer()));
   d->performer_ = QStringFromStdString(pb.performer());
   d->grouping_ = QStringFromStdString(pb.grouping());
   d->lyrics_ = QStringFromStdString(pb.lyrics());
@@ -509,7 +585,7 @@ void Song::InitFromProtobuf(const pb::tagreader::SongMetadata& pb) {
   d->bpm_ = pb.bpm();
   d->year_ = pb.year();
   d->originalyear_ = pb.originalyear();
-  d->genre_ = QStringFromStdString(pb.genre());
+  d->genre_ = StringPool::Intern(QStringFromStdString(pb.genre()));
   d->comment_ = QStringFromStdString(pb.comment());
   d->compilation_ = pb.compilation();
   d->playcount_ = pb.playcount();
@@ -520,7 +596,7 @@ void Song::InitFromProtobuf(const pb::tagreader::SongMetadata& pb) {
   d->bitrate_ = pb.bitrate();
   d->samplerate_ = pb.samplerate();
   set_url(QUrl::fromEncoded(QByteArray(pb.url().data(), pb.url().size())));
-  d->basefilename_ = QStringFromStdString(pb.basefilename());
+  set_basefilename(QStringFromStdString(pb.basefilename()));
   d->mtime_ = pb.mtime();
   d->ctime_ = pb.ctime();
   d->filesize_ = pb.filesize();
@@ -540,7 +616,7 @@ void Song::InitFromProtobuf(const pb::tagreader::SongMetadata& pb) {
 }
 
 void Song::ToProtobuf(pb::tagreader::SongMetadata* pb) const {
-  const QByteArray url(d->url_.toEncoded());
+  const QByteArray url(this->url().toEncoded());
 
   pb->set_valid(d->valid_);
   pb->set_title(DataCommaSizeFromQString(d->title_));
@@ -568,7 +644,7 @@ void Song::ToProtobuf(pb::tagreader::SongMetadata* pb) const {
   pb->set_bitrate(d->bitrate_);
   pb->set_samplerate(d->samplerate_);
   pb->set_url(url.constData(), url.size());
-  pb->set_basefilename(DataCommaSizeFromQString(d->basefilename_));
+  pb->set_basefilename(DataCommaSizeFromQString(basefilename()));
   pb->set_mtime(d->mtime_);
   pb->set_ctime(d->ctime_);
   pb->set_filesize(d->filesize_);
@@ -581,62 +657,62 @@ void Song::InitFromQuery(const SqlRow& q, bool reliable_metadata, int col) {
   d->valid_ = true;
   d->init_from_file_ = reliable_metadata;
 
-#define tostr(n) (q.value(n).isNull() ? QString::null : q.value(n).toString())
-#define toint(n) (q.value(n).isNull() ? -1 : q.value(n).toInt())
-#define tolonglong(n) (q.value(n).isNull() ? -1 : q.value(n).toLongLong())
-#define tofloat(n) (q.value(n).isNull() ? -1 : q.value(n).toDouble())
+#define tostr(n) (q.IsNull(n) ? QString::null : q.ToString(n))
+#define toint(n) (q.IsNull(n) ? -1 : q.ToInt(n))
+#define tolonglong(n) (q.IsNull(n) ? -1 : q.ToLongLong(n))
+#define tofloat(n) (q.IsNull(n) ? -1 : q.ToDouble(n))
 
   d->id_ = toint(col + 0);
   d->title_ = tostr(col + 1);
-  d->album_ = tostr(col + 2);
-  d->artist_ = tostr(col + 3);
-  d->albumartist_ = tostr(col + 4);
-  d->composer_ = tostr(col + 5);
+  // These repeat across many songs, so share one copy of each.
+  d->album_ = StringPool::Intern(tostr(col + 2));
+  d->artist_ = StringPool::Intern(tostr(col + 3));
+  d->albumartist_ = StringPool::Intern(tostr(col + 4));
+  d->composer_ = StringPool::Intern(tostr(col + 5));
   d->track_ = toint(col + 6);
   d->disc_ = toint(col + 7);
   d->bpm_ = tofloat(col + 8);
   d->year_ = toint(col + 9);
   d->originalyear_ = toint(col + 41);
-  d->genre_ = tostr(col + 10);
+  d->genre_ = StringPool::Intern(tostr(col + 10));
   d->comment_ = tostr(col + 11);
-  d->compilation_ = q.value(col + 12).toBool();
+  d->compilation_ = q.ToBool(col + 12);
 
   d->bitrate_ = toint(col + 13);
   d->samplerate_ = toint(col + 14);
 
   d->directory_id_ = toint(col + 15);
-  set_url(QUrl::fromEncoded(tostr(col + 16).toUtf8()));
-  d->basefilename_ = QFileInfo(d->url_.toLocalFile()).fileName();
+  // The URL is only decoded when it's needed.
+  d->url_.set_encoded(q.ToByteArray(col + 16));
   d->mtime_ = toint(col + 17);
   d->ctime_ = toint(col + 18);
   d->filesize_ = toint(col + 19);
 
-  d->sampler_ = q.value(col + 20).toBool();
+  d->sampler_ = q.ToBool(col + 20);
 
-  d->art_automatic_ = q.value(col + 21).toString();
-  d->art_manual_ = q.value(col + 22).toString();
+  d->art_automatic_ = q.ToString(col + 21);
+  d->art_manual_ = q.ToString(col + 22);
 
-  d->filetype_ = FileType(q.value(col + 23).toInt());
-  d->playcount_ = q.value(col + 24).isNull() ? 0 : q.value(col + 24).toInt();
+  d->filetype_ = FileType(q.ToInt(col + 23));
+  d->playcount_ = q.ToInt(col + 24);
   d->lastplayed_ = toint(col + 25);
   d->rating_ = tofloat(col + 26);
 
-  d->forced_compilation_on_ = q.value(col + 27).toBool();
-  d->forced_compilation_off_ = q.value(col + 28).toBool();
+  d->forced_compilation_on_ = q.ToBool(col + 27);
+  d->forced_compilation_off_ = q.ToBool(col + 28);
 
   // effective_compilation = 29
 
-  d->skipcount_ = q.value(col + 30).isNull() ? 0 : q.value(col + 30).toInt();
-  d->score_ = q.value(col + 31).isNull() ? 0 : q.value(col + 31).toInt();
+  d->skipcount_ = q.ToInt(col + 30);
+  d->score_ = q.ToInt(col + 31);
 
   // do not move those statements - beginning must be initialized before
   // length is!
-  d->beginning_ =
-      q.value(col + 32).isNull() ? 0 : q.value(col + 32).toLongLong();
+  d->beginning_ = q.ToLongLong(col + 32);
   set_length_nanosec(tolonglong(col + 33));
 
   d->cue_path_ = tostr(col + 34);
-  d->unavailable_ = q.value(col + 35).toBool();
+  d->unavailable_ = q.ToBool(col + 35);
 
   // effective_albumartist = 36
   // etag = 37
@@ -660,7 +736,7 @@ void Song::InitFromFilePartial(const QString& filename) {
   // we rely on TagLib which seems to have the behavior (filename checks).
   // Someday, it would be nice to perform some magic tests everywhere.
   QFileInfo info(filename);
-  d->basefilename_ = info.fileName();
+  set_basefilename(info.fileName());
   QString suffix = info.suffix().toLower();
   if (suffix == "mp3" || suffix == "ogg" || suffix == "flac" ||
       suffix == "mpc" || suffix == "m4a" || suffix == "aac" ||
@@ -736,7 +812,7 @@ void Song::InitFromItdb(const Itdb_Track* track, const QString& prefix) {
     set_url(QUrl::fromLocalFile(prefix + filename));
   }
 
-  d->basefilename_ = QFileInfo(filename).fileName();
+  set_basefilename(QFileInfo(filename).fileName());
 }
 
 void Song::ToItdb(Itdb_Track* track) const {
@@ -778,8 +854,8 @@ void Song::InitFromMTP(const LIBMTP_track_t* track, const QString& host) {
   d->album_ = QString::fromUtf8(track->album);
   d->composer_ = QString::fromUtf8(track->composer);
   d->genre_ = QString::fromUtf8(track->genre);
-  d->url_ = QUrl(QString("mtp://%1/%2").arg(host, track->item_id));
-  d->basefilename_ = QString::number(track->item_id);
+  d->url_.set_url(QUrl(QString("mtp://%1/%2").arg(host, track->item_id)));
+  set_basefilename(QString::number(track->item_id));
 
   d->track_ = track->tracknumber;
   set_length_nanosec(track->duration * kNsecPerMsec);
@@ -839,7 +915,7 @@ void Song::ToMTP(LIBMTP_track_t* track) const {
   track->title = strdup(d->title_.toUtf8().constData());
   track->date = nullptr;
 
-  track->filename = strdup(d->basefilename_.toUtf8().constData());
+  track->filename = strdup(basefilename().toUtf8().constData());
 
   track->tracknumber = d->track_;
   track->duration = length_nanosec() / kNsecPerMsec;
@@ -882,7 +958,7 @@ void Song::ToMTP(LIBMTP_track_t* track) const {
 #endif
 
 void Song::MergeFromSimpleMetaBundle(const Engine::SimpleMetaBundle& bundle) {
-  if (d->init_from_file_ || d->url_.scheme() == "file") {
+  if (d->init_from_file_ || url().scheme() == "file") {
     // This Song was already loaded using taglib. Our tags are probably better
     // than the engine's.  Note: init_from_file_ is used for non-file:// URLs
     // when the metadata is known to be good, like from Jamendo.
@@ -902,79 +978,95 @@ void Song::MergeFromSimpleMetaBundle(const Engine::SimpleMetaBundle& bundle) {
   if (!bundle.tracknr.isEmpty()) d->track_ = bundle.tracknr.toInt();
 }
 
-void Song::BindToQuery(QSqlQuery* query) const {
+QVariantList Song::ColumnValues() const {
+  QVariantList ret;
+
 #define strval(x) (x.isNull() ? "" : x)
 #define intval(x) (x <= 0 ? -1 : x)
 #define notnullintval(x) (x == -1 ? QVariant() : x)
 
-  // Remember to bind these in the same order as kBindSpec
+  // Remember to add these in the same order as kColumns
 
-  query->bindValue(":title", strval(d->title_));
-  query->bindValue(":album", strval(d->album_));
-  query->bindValue(":artist", strval(d->artist_));
-  query->bindValue(":albumartist", strval(d->albumartist_));
-  query->bindValue(":composer", strval(d->composer_));
-  query->bindValue(":track", intval(d->track_));
-  query->bindValue(":disc", intval(d->disc_));
-  query->bindValue(":bpm", intval(d->bpm_));
-  query->bindValue(":year", intval(d->year_));
-  query->bindValue(":genre", strval(d->genre_));
-  query->bindValue(":comment", strval(d->comment_));
-  query->bindValue(":compilation", d->compilation_ ? 1 : 0);
+  ret << QVariant(strval(d->title_));
+  ret << QVariant(strval(d->album_));
+  ret << QVariant(strval(d->artist_));
+  ret << QVariant(strval(d->albumartist_));
+  ret << QVariant(strval(d->composer_));
+  ret << QVariant(intval(d->track_));
+  ret << QVariant(intval(d->disc_));
+  ret << QVariant(intval(d->bpm_));
+  ret << QVariant(intval(d->year_));
+  ret << QVariant(strval(d->genre_));
+  ret << QVariant(strval(d->comment_));
+  ret << QVariant(d->compilation_ ? 1 : 0);
 
-  query->bindValue(":bitrate", intval(d->bitrate_));
-  query->bindValue(":samplerate", intval(d->samplerate_));
+  ret << QVariant(intval(d->bitrate_));
+  ret << QVariant(intval(d->samplerate_));
 
-  query->bindValue(":directory", notnullintval(d->directory_id_));
+  ret << QVariant(notnullintval(d->directory_id_));
 
   if (Application::kIsPortable &&
-      Utilities::UrlOnSameDriveAsClementine(d->url_)) {
-    query->bindValue(":filename", Utilities::GetRelativePathToClementineBin(
-                                      d->url_).toEncoded());
+      Utilities::UrlOnSameDriveAsClementine(url())) {
+    ret << Utilities::GetRelativePathToClementineBin(url()).toEncoded();
   } else {
-    query->bindValue(":filename", d->url_.toEncoded());
+    ret << url().toEncoded();
   }
 
-  query->bindValue(":mtime", notnullintval(d->mtime_));
-  query->bindValue(":ctime", notnullintval(d->ctime_));
-  query->bindValue(":filesize", notnullintval(d->filesize_));
+  ret << QVariant(notnullintval(d->mtime_));
+  ret << QVariant(notnullintval(d->ctime_));
+  ret << QVariant(notnullintval(d->filesize_));
 
-  query->bindValue(":sampler", d->sampler_ ? 1 : 0);
-  query->bindValue(":art_automatic", d->art_automatic_);
-  query->bindValue(":art_manual", d->art_manual_);
+  ret << QVariant(d->sampler_ ? 1 : 0);
+  ret << QVariant(d->art_automatic_);
+  ret << QVariant(d->art_manual_);
 
-  query->bindValue(":filetype", d->filetype_);
-  query->bindValue(":playcount", d->playcount_);
-  query->bindValue(":lastplayed", intval(d->lastplayed_));
-  query->bindValue(":rating", intval(d->rating_));
+  ret << QVariant(d->filetype_);
+  ret << QVariant(d->playcount_);
+  ret << QVariant(intval(d->lastplayed_));
+  ret << QVariant(intval(d->rating_));
 
-  query->bindValue(":forced_compilation_on", d->forced_compilation_on_ ? 1 : 0);
-  query->bindValue(":forced_compilation_off",
-                   d->forced_compilation_off_ ? 1 : 0);
+  ret << QVariant(d->forced_compilation_on_ ? 1 : 0);
+  ret << QVariant(d->forced_compilation_off_ ? 1 : 0);
 
-  query->bindValue(":effective_compilation", is_compilation() ? 1 : 0);
+  ret << QVariant(is_compilation() ? 1 : 0);
 
-  query->bindValue(":skipcount", d->skipcount_);
-  query->bindValue(":score", d->score_);
+  ret << QVariant(d->skipcount_);
+  ret << QVariant(d->score_);
 
-  query->bindValue(":beginning", d->beginning_);
-  query->bindValue(":length", intval(length_nanosec()));
+  ret << QVariant(d->beginning_);
+  ret << QVariant(intval(length_nanosec()));
 
-  query->bindValue(":cue_path", d->cue_path_);
-  query->bindValue(":unavailable", d->unavailable_ ? 1 : 0);
-  query->bindValue(":effective_albumartist", this->effective_albumartist());
+  ret << QVariant(d->cue_path_);
+  ret << QVariant(d->unavailable_ ? 1 : 0);
+  ret << QVariant(this->effective_albumartist());
 
-  query->bindValue(":etag", strval(d->etag_));
+  ret << QVariant(strval(d->etag_));
 
-  query->bindValue(":performer", strval(d->performer_));
-  query->bindValue(":grouping", strval(d->grouping_));
-  query->bindValue(":lyrics", strval(d->lyrics_));
-  query->bindValue(":originalyear", intval(d->originalyear_));
-  query->bindValue(":effective_originalyear", intval(this->effective_originalyear()));
+  ret << QVariant(strval(d->performer_));
+  ret << QVariant(strval(d->grouping_));
+  ret << QVariant(strval(d->lyrics_));
+  ret << QVariant(intval(d->originalyear_));
+  ret << QVariant(intval(this->effective_originalyear()));
 
 #undef intval
 #undef notnullintval
 #undef strval
+
+  return ret;
+}
+
+void Song::BindToQuery(QSqlQuery* query) const {
+  const QVariantList values = ColumnValues();
+  for (int i = 0; i < values.count(); ++i) {
+    query->bindValue(":" + kColumns[i], values[i]);
+  }
+}
+
+void Song::BindToQuery(QSqlQuery* query, int first_position) const {
+  const QVariantList values = ColumnValues();
+  for (int i = 0; i < values.count(); ++i) {
+    query->bindValue(first_position + i, values[i]);
+  }
 }
 
 void Song::BindToFtsQuery(QSqlQuery* query) const {
@@ -1025,8 +1117,8 @@ QString Song::PrettyRating() const {
 QString Song::PrettyTitle() const {
   QString title(d->title_);
 
-  if (title.isEmpty()) title = d->basefilename_;
-  if (title.isEmpty()) title = d->url_.toString();
+  if (title.isEmpty()) title = basefilename();
+  if (title.isEmpty()) title = url().toString();
 
   return title;
 }
@@ -1034,7 +1126,7 @@ QString Song::PrettyTitle() const {
 QString Song::PrettyTitleWithArtist() const {
   QString title(d->title_);
 
-  if (title.isEmpty()) title = d->basefilename_;
+  if (title.isEmpty()) title = basefilename();
 
   if (!d->artist_.isEmpty()) title = d->artist_ + " - " + title;
 
@@ -1056,7 +1148,7 @@ QString Song::PrettyYear() const {
 QString Song::TitleWithCompilationArtist() const {
   QString title(d->title_);
 
-  if (title.isEmpty()) title = d->basefilename_;
+  if (title.isEmpty()) title = basefilename();
 
   if (is_compilation() && !d->artist_.isEmpty() &&
       !d->artist_.toLower().contains("various"))
@@ -1088,8 +1180,10 @@ bool Song::IsMetadataEqual(const Song& other) const {
          d->lyrics_ == other.d->lyrics_;
 }
 
+bool Song::IsSharedWith(const Song& other) const { return d == other.d; }
+
 bool Song::IsEditable() const {
-  return d->valid_ && !d->url_.isEmpty() && !is_stream() &&
+  return d->valid_ && !url().isEmpty() && !is_stream() &&
          d->filetype_ != Type_Unknown && !has_cue();
 }
 
@@ -147,6 +147,9 @@ class Song {
 
   // Save
   void BindToQuery(QSqlQuery* query) const;
+  // Binds the columns to positional placeholders instead, in the same order
+  // as kColumns, starting at first_position.  For INSERTs of several songs.
+  void BindToQuery(QSqlQuery* query, int first_position) const;
   void BindToFtsQuery(QSqlQuery* query) const;
 #ifdef HAVE_LIBLASTFM
   void ToLastFM(lastfm::Track* track, bool prefer_album_artist) const;
@@ -296,6 +299,9 @@ class Song {
   bool IsMetadataEqual(const Song& other) const;
   bool IsOnSameAlbum(const Song& other) const;
   bool IsSimilar(const Song& other) const;
+  // True if neither song has been changed since one was copied from the other.
+  // This is much cheaper than comparing the metadata.
+  bool IsSharedWith(const Song& other) const;
 
   bool operator==(const Song& other) const;
 
@@ -307,6 +313,9 @@ class Song {
   Song& operator=(const Song& other);
 
  private:
+  // The values of the columns in kColumns, in the same order.
+  QVariantList ColumnValues() const;
+
   struct Private;
   QSharedDataPointer<Private> d;
 };
@@ -253,8 +253,32 @@ void SongLoader::LoadLocalAsync(const QString& filename) {
 }
 
 void SongLoader::LoadMetadataBlocking() {
+  // Songs that aren't in the library have their tags read in batches, so the
+  // tagreader workers can read them in parallel.
+  QList<int> unread_indexes;
+  QStringList unread_filenames;
+  SongList unread_songs;
+
   for (int i = 0; i < songs_.size(); i++) {
-    EffectiveSongLoad(&songs_[i]);
+    Song* song = &songs_[i];
+    if (song->filetype() != Song::Type_Unknown) continue;
+
+    Song library_song = library_->GetSongByUrl(song->url());
+    if (library_song.is_valid()) {
+      *song = library_song;
+    } else {
+      unread_indexes << i;
+      unread_filenames << song->url().toLocalFile();
+      unread_songs << *song;
+    }
+  }
+
+  if (unread_songs.isEmpty()) return;
+
+  TagReaderClient::Instance()->ReadFilesBlocking(unread_filenames,
+                                                 &unread_songs);
+  for (int i = 0; i < unread_indexes.count(); ++i) {
+    songs_[unread_indexes[i]] = unread_songs[i];
   }
 }
 
@@ -0,0 +1,117 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <davidsansome@gmail.com>
+   Copyright 2014, Krzysztof Sobiecki <sobkas@gmail.com>
+   Copyright 2014, John Maguire <john.maguire@gmail.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sqlitequery.h"
+#include "core/logging.h"
+
+#include <sqlite3.h>
+
+#include <QSqlDriver>
+
+SqliteQuery::SqliteQuery(QSqlDatabase db, const QString& sql)
+    : db_(db), sql_(sql), handle_(nullptr), stmt_(nullptr) {
+  const QVariant handle = db.driver()->handle();
+  if (handle.isValid() && qstrcmp(handle.typeName(), "sqlite3*") == 0) {
+    handle_ = *static_cast<sqlite3* const*>(handle.constData());
+  }
+
+  if (!handle_) {
+    qLog(Error) << "Not a sqlite database:" << db.driverName();
+    return;
+  }
+
+  if (sqlite3_prepare16_v2(handle_, sql.utf16(), (sql.size() + 1) * 2, &stmt_,
+                           nullptr) != SQLITE_OK) {
+    LogError("prepare");
+    stmt_ = nullptr;
+  }
+}
+
+SqliteQuery::~SqliteQuery() {
+  // Harmless to call sqlite3_finalize() with a nullptr pointer.
+  sqlite3_finalize(stmt_);
+}
+
+void SqliteQuery::BindValue(const QString& placeholder, const QVariant& value) {
+  if (!stmt_) return;
+
+  const int index =
+      sqlite3_bind_parameter_index(stmt_, placeholder.toUtf8().constData());
+  if (index == 0) {
+    qLog(Warning) << "No placeholder" << placeholder << "in" << sql_;
+    return;
+  }
+
+  if (value.isNull()) {
+    sqlite3_bind_null(stmt_, index);
+    return;
+  }
+
+  switch (value.type()) {
+    case QVariant::Bool:
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+      sqlite3_bind_int64(stmt_, index, value.toLongLong());
+      break;
+
+    case QVariant::Double:
+      sqlite3_bind_double(stmt_, index, value.toDouble());
+      break;
+
+    case QVariant::ByteArray: {
+      const QByteArray data = value.toByteArray();
+      sqlite3_bind_blob(stmt_, index, data.constData(), data.size(),
+                        SQLITE_TRANSIENT);
+      break;
+    }
+
+    default: {
+      const QString data = value.toString();
+      sqlite3_bind_text16(stmt_, index, data.utf16(), data.size() * 2,
+                          SQLITE_TRANSIENT);
+      break;
+    }
+  }
+}
+
+bool SqliteQuery::Exec() {
+  if (!stmt_) return false;
+  sqlite3_reset(stmt_);
+  return true;
+}
+
+bool SqliteQuery::Next() {
+  if (!stmt_) return false;
+
+  switch (sqlite3_step(stmt_)) {
+    case SQLITE_ROW:
+      return true;
+    case SQLITE_DONE:
+      return false;
+    default:
+      LogError("step");
+      return false;
+  }
+}
+
+void SqliteQuery::LogError(const char* what) const {
+  qLog(Error) << "db error in" << what << ":" << sqlite3_errmsg(handle_);
+  qLog(Error) << "faulty query: " << sql_;
+}
@@ -0,0 +1,67 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <davidsansome@gmail.com>
+   Copyright 2014, Krzysztof Sobiecki <sobkas@gmail.com>
+   Copyright 2014, John Maguire <john.maguire@gmail.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SQLITEQUERY_H
+#define SQLITEQUERY_H
+
+#include <boost/noncopyable.hpp>
+
+#include <QSqlDatabase>
+#include <QString>
+#include <QVariant>
+
+#include "library/sqlrow.h"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+// Runs a SELECT straight on the sqlite connection behind a QSqlDatabase.
+// QSqlQuery copies every column of every row into a QVariant as it steps
+// through the results - this leaves the columns in sqlite until they're read
+// through row(), which is much faster for big queries like loading the whole
+// library or a playlist.
+class SqliteQuery : boost::noncopyable {
+ public:
+  SqliteQuery(QSqlDatabase db, const QString& sql);
+  ~SqliteQuery();
+
+  // Binds a value to a named placeholder like ":playlist".
+  void BindValue(const QString& placeholder, const QVariant& value);
+
+  // Starts the query from the beginning.  Returns false and logs the error if
+  // the statement couldn't be prepared.
+  bool Exec();
+
+  // Moves to the next row.  Returns false at the end of the results, or on an
+  // error, which is logged.
+  bool Next();
+
+  // The current row.  It's only valid until the next call to Next().
+  SqlRow row() const { return SqlRow(stmt_); }
+
+ private:
+  void LogError(const char* what) const;
+
+  QSqlDatabase db_;
+  QString sql_;
+  sqlite3* handle_;
+  sqlite3_stmt* stmt_;
+};
+
+#endif  // SQLITEQUERY_H
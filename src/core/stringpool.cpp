@@ -0,0 +1,96 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <davidsansome@gmail.com>
+   Copyright 2014, Krzysztof Sobiecki <sobkas@gmail.com>
+   Copyright 2014, John Maguire <john.maguire@gmail.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "stringpool.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QtDebug>
+
+namespace {
+
+// The pool is split into shards by hash, each with its own lock, so threads
+// loading songs at the same time rarely wait for each other.
+const int kShardCount = 16;
+
+struct Shard {
+  Shard() : lookups(0), hits(0), bytes(0), bytes_saved(0) {}
+
+  QMutex mutex;
+  QSet<QString> strings;
+
+  quint64 lookups;
+  quint64 hits;
+  qint64 bytes;
+  qint64 bytes_saved;
+};
+
+Shard* Shards() {
+  static Shard shards[kShardCount];
+  return shards;
+}
+
+}  // namespace
+
+QString StringPool::Intern(const QString& value) {
+  if (value.isEmpty()) return value;
+
+  const uint hash = qHash(value);
+  Shard* shard = &Shards()[hash % kShardCount];
+
+  QMutexLocker l(&shard->mutex);
+  shard->lookups++;
+
+  QSet<QString>::const_iterator it = shard->strings.constFind(value);
+  if (it != shard->strings.constEnd()) {
+    shard->hits++;
+    if (!it->isSharedWith(value)) {
+      shard->bytes_saved += value.size() * sizeof(QChar);
+    }
+    return *it;
+  }
+
+  shard->strings.insert(value);
+  shard->bytes += value.size() * sizeof(QChar);
+  return value;
+}
+
+StringPool::Statistics StringPool::statistics() {
+  Statistics ret;
+  for (int i = 0; i < kShardCount; ++i) {
+    Shard* shard = &Shards()[i];
+    QMutexLocker l(&shard->mutex);
+
+    ret.lookups += shard->lookups;
+    ret.hits += shard->hits;
+    ret.strings += shard->strings.count();
+    ret.bytes += shard->bytes;
+    ret.bytes_saved += shard->bytes_saved;
+  }
+  return ret;
+}
+
+QDebug operator<<(QDebug debug, const StringPool::Statistics& stats) {
+  debug.nospace() << "StringPool(" << stats.strings << " strings, "
+                  << stats.bytes / 1024 << " KB, " << stats.hits << "/"
+                  << stats.lookups << " hits, " << stats.bytes_saved / 1024
+                  << " KB saved)";
+  return debug.space();
+}
@@ -0,0 +1,54 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <davidsansome@gmail.com>
+   Copyright 2014, Krzysztof Sobiecki <sobkas@gmail.com>
+   Copyright 2014, John Maguire <john.maguire@gmail.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_STRINGPOOL_H_
+#define CORE_STRINGPOOL_H_
+
+#include <QString>
+
+class QDebug;
+
+// A process-wide pool of strings that are repeated many times, like the
+// artists and albums of songs.  Intern() returns the pool's copy of a string,
+// so every song by the same artist shares one QString instead of having its
+// own.  Strings are never removed.  Thread-safe.
+class StringPool {
+ public:
+  struct Statistics {
+    Statistics()
+        : lookups(0), hits(0), strings(0), bytes(0), bytes_saved(0) {}
+
+    quint64 lookups;
+    quint64 hits;
+    // The number of strings in the pool and the size of their characters.
+    int strings;
+    qint64 bytes;
+    // The size of the characters of strings that were freed because the pool
+    // had a copy already.
+    qint64 bytes_saved;
+  };
+
+  static QString Intern(const QString& value);
+
+  static Statistics statistics();
+};
+
+QDebug operator<<(QDebug debug, const StringPool::Statistics& stats);
+
+#endif  // CORE_STRINGPOOL_H_
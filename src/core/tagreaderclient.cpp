@@ -28,6 +28,7 @@
 #include <QUrl>
 
 const char* TagReaderClient::kWorkerExecutableName = "clementine-tagreader";
+const int TagReaderClient::kReadFilesBatchSize = 16;
 TagReaderClient* TagReaderClient::sInstance = nullptr;
 
 TagReaderClient::TagReaderClient(QObject* parent)
@@ -57,6 +58,24 @@ TagReaderReply* TagReaderClient::ReadFile(const QString& filename) {
   return worker_pool_->SendMessageWithReply(&message);
 }
 
+QList<TagReaderReply*> TagReaderClient::ReadFiles(
+    const QStringList& filenames) {
+  QList<TagReaderReply*> ret;
+
+  for (int i = 0; i < filenames.count(); i += kReadFilesBatchSize) {
+    pb::tagreader::Message message;
+    pb::tagreader::ReadFilesRequest* req = message.mutable_read_files_request();
+
+    for (const QString& filename : filenames.mid(i, kReadFilesBatchSize)) {
+      req->add_filenames(DataCommaSizeFromQString(filename));
+    }
+
+    ret << worker_pool_->SendMessageWithReply(&message);
+  }
+
+  return ret;
+}
+
 TagReaderReply* TagReaderClient::SaveFile(const QString& filename,
                                           const Song& metadata) {
   pb::tagreader::Message message;
@@ -151,6 +170,28 @@ void TagReaderClient::ReadFileBlocking(const QString& filename, Song* song) {
   reply->deleteLater();
 }
 
+void TagReaderClient::ReadFilesBlocking(const QStringList& filenames,
+                                        SongList* songs) {
+  Q_ASSERT(QThread::currentThread() != thread());
+  Q_ASSERT(filenames.count() == songs->count());
+
+  int index = 0;
+  for (TagReaderReply* reply : ReadFiles(filenames)) {
+    const int batch_size = qMin(kReadFilesBatchSize, filenames.count() - index);
+
+    if (reply->WaitForFinished()) {
+      const pb::tagreader::ReadFilesResponse& response =
+          reply->message().read_files_response();
+      for (int i = 0; i < response.metadata_size() && i < batch_size; ++i) {
+        (*songs)[index + i].InitFromProtobuf(response.metadata(i));
+      }
+    }
+    reply->deleteLater();
+
+    index += batch_size;
+  }
+}
+
 bool TagReaderClient::SaveFileBlocking(const QString& filename,
                                        const Song& metadata) {
   Q_ASSERT(QThread::currentThread() != thread());
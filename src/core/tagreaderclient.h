@@ -42,9 +42,17 @@ class TagReaderClient : public QObject {
 
   static const char* kWorkerExecutableName;
 
+  // Maximum number of files sent to a worker in one ReadFilesRequest.
+  static const int kReadFilesBatchSize;
+
   void Start();
 
   ReplyType* ReadFile(const QString& filename);
+  // Reads the tags of several files.  The files are split into batches of at
+  // most kReadFilesBatchSize that are spread over all the workers, so each
+  // reply finishes as soon as its own batch has been read.  The replies are
+  // returned in the same order as the filenames.
+  QList<ReplyType*> ReadFiles(const QStringList& filenames);
   ReplyType* SaveFile(const QString& filename, const Song& metadata);
   ReplyType* UpdateSongStatistics(const Song& metadata);
   ReplyType* UpdateSongRating(const Song& metadata);
@@ -58,6 +66,9 @@ class TagReaderClient : public QObject {
   // response.  These block the calling thread with a semaphore, and must NOT
   // be called from the TagReaderClient's thread.
   void ReadFileBlocking(const QString& filename, Song* song);
+  // songs must have one entry for each filename.  Songs whose batch couldn't
+  // be read are left unchanged.
+  void ReadFilesBlocking(const QStringList& filenames, SongList* songs);
   bool SaveFileBlocking(const QString& filename, const Song& metadata);
   bool UpdateSongStatisticsBlocking(const Song& metadata);
   bool UpdateSongRatingBlocking(const Song& metadata);
@@ -356,6 +356,9 @@ QString GetConfigPath(ConfigPath config) {
     case Path_MoodbarCache:
       return GetConfigPath(Path_CacheRoot) + "/moodbarcache";
 
+    case Path_CoverCache:
+      return GetConfigPath(Path_CacheRoot) + "/covercache";
+
     case Path_GstreamerRegistry:
       return GetConfigPath(Path_Root) +
              QString("/gst-registry-%1-bin")
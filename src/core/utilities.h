@@ -132,6 +132,7 @@ enum ConfigPath {
   Path_LocalSpotifyBlob,
   Path_MoodbarCache,
   Path_CacheRoot,
+  Path_CoverCache,
 };
 QString GetConfigPath(ConfigPath config);
 
@@ -20,12 +20,15 @@
 */
 
 #include "albumcoverloader.h"
+#include "covercache.h"
 
 #include <QPainter>
 #include <QDir>
 #include <QCoreApplication>
 #include <QUrl>
 #include <QNetworkReply>
+#include <QThread>
+#include <QtConcurrentRun>
 
 #include "config.h"
 #include "core/closure.h"
@@ -40,6 +43,8 @@ AlbumCoverLoader::AlbumCoverLoader(QObject* parent)
     : QObject(parent),
       stop_requested_(false),
       next_id_(1),
+      active_tasks_(0),
+      max_active_tasks_(qMax(2, QThread::idealThreadCount())),
       network_(new NetworkAccessManager(this)),
       connected_spotify_(false) {}
 
@@ -48,24 +53,53 @@ QString AlbumCoverLoader::ImageCacheDir() {
 }
 
 void AlbumCoverLoader::CancelTask(quint64 id) {
-  QMutexLocker l(&mutex_);
-  for (QQueue<Task>::iterator it = tasks_.begin(); it != tasks_.end(); ++it) {
-    if (it->id == id) {
-      tasks_.erase(it);
-      break;
-    }
-  }
+  CancelTasks(QSet<quint64>() << id);
 }
 
 void AlbumCoverLoader::CancelTasks(const QSet<quint64>& ids) {
   QMutexLocker l(&mutex_);
-  for (QQueue<Task>::iterator it = tasks_.begin(); it != tasks_.end();) {
-    if (ids.contains(it->id)) {
-      it = tasks_.erase(it);
+
+  // Stop waiting for other tasks.
+  for (QHash<quint64, QList<quint64>>::iterator it = duplicate_ids_.begin();
+       it != duplicate_ids_.end();) {
+    QList<quint64>& duplicates = it.value();
+    for (QList<quint64>::iterator dup = duplicates.begin();
+         dup != duplicates.end();) {
+      if (ids.contains(*dup)) {
+        dup = duplicates.erase(dup);
+      } else {
+        ++dup;
+      }
+    }
+
+    if (duplicates.isEmpty()) {
+      it = duplicate_ids_.erase(it);
     } else {
       ++it;
     }
   }
+
+  // Remove queued tasks that nobody is waiting for any more.
+  for (QQueue<Task>* queue : QList<QQueue<Task>*>() << &interactive_tasks_
+                                                    << &bulk_tasks_) {
+    for (QQueue<Task>::iterator it = queue->begin(); it != queue->end();) {
+      if (ids.contains(it->id) && !duplicate_ids_.contains(it->id)) {
+        task_ids_by_key_.remove(it->key);
+        it = queue->erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // The rest have already started, or are still needed by their duplicates.
+  const QSet<quint64> unfinished_ids =
+      QSet<quint64>::fromList(task_ids_by_key_.values());
+  for (quint64 id : ids) {
+    if (unfinished_ids.contains(id)) {
+      cancelled_ids_.insert(id);
+    }
+  }
 }
 
 quint64 AlbumCoverLoader::LoadImageAsync(const AlbumCoverLoaderOptions& options,
@@ -84,7 +118,7 @@ quint64 AlbumCoverLoader::LoadImageAsync(const AlbumCoverLoaderOptions& options,
   {
     QMutexLocker l(&mutex_);
     task.id = next_id_++;
-    tasks_.enqueue(task);
+    QueueTask(task);
   }
 
   metaObject()->invokeMethod(this, "ProcessTasks", Qt::QueuedConnection);
@@ -92,36 +126,123 @@ quint64 AlbumCoverLoader::LoadImageAsync(const AlbumCoverLoaderOptions& options,
   return task.id;
 }
 
+QString AlbumCoverLoader::TaskKey(const Task& task) {
+  const AlbumCoverLoaderOptions& options = task.options;
+  return QString("%1\n%2\n%3\n%4\n%5 %6 %7 %8 %9")
+      .arg(task.art_automatic, task.art_manual, task.song_filename)
+      .arg(task.embedded_image.cacheKey())
+      .arg(options.desired_height_)
+      .arg(int(options.scale_output_image_))
+      .arg(int(options.pad_output_image_))
+      .arg(int(options.use_cover_cache_))
+      .arg(options.default_output_image_.cacheKey());
+}
+
+void AlbumCoverLoader::QueueTask(Task task) {
+  task.key = TaskKey(task);
+
+  if (task_ids_by_key_.contains(task.key)) {
+    const quint64 existing_id = task_ids_by_key_[task.key];
+    duplicate_ids_[existing_id] << task.id;
+
+    // Don't make an interactive request wait behind the bulk ones.
+    if (task.options.priority_ ==
+        AlbumCoverLoaderOptions::Priority_Interactive) {
+      for (QQueue<Task>::iterator it = bulk_tasks_.begin();
+           it != bulk_tasks_.end(); ++it) {
+        if (it->id == existing_id) {
+          interactive_tasks_.enqueue(*it);
+          bulk_tasks_.erase(it);
+          break;
+        }
+      }
+    }
+    return;
+  }
+
+  task_ids_by_key_[task.key] = task.id;
+  if (task.options.priority_ == AlbumCoverLoaderOptions::Priority_Bulk) {
+    bulk_tasks_.enqueue(task);
+  } else {
+    interactive_tasks_.enqueue(task);
+  }
+}
+
 void AlbumCoverLoader::ProcessTasks() {
-  while (!stop_requested_) {
+  while (!stop_requested_ && active_tasks_ < max_active_tasks_) {
     // Get the next task
     Task task;
     {
       QMutexLocker l(&mutex_);
-      if (tasks_.isEmpty()) return;
-      task = tasks_.dequeue();
+      if (!interactive_tasks_.isEmpty()) {
+        task = interactive_tasks_.dequeue();
+      } else if (!bulk_tasks_.isEmpty() &&
+                 active_tasks_ < max_active_tasks_ - 1) {
+        // Keep a worker free for the next interactive task.
+        task = bulk_tasks_.dequeue();
+      } else {
+        return;
+      }
     }
 
     ProcessTask(&task);
   }
 }
 
+bool AlbumCoverLoader::IsRemote(const QString& filename) {
+  const QString lower = filename.toLower();
+  return lower.startsWith("http://") || lower.startsWith("https://") ||
+         lower.startsWith("spotify://image/");
+}
+
 void AlbumCoverLoader::ProcessTask(Task* task) {
-  TryLoadResult result = TryLoadImage(*task);
-  if (result.started_async) {
-    // The image is being loaded from a remote URL, we'll carry on later
-    // when it's done
-    return;
+  // An image embedded in the song itself takes priority
+  if (task->embedded_image.isNull()) {
+    if (task->filename() == Song::kManuallyUnsetCover) {
+      const QImage& image = task->options.default_output_image_;
+      EmitImageLoaded(*task, ScaleAndPad(task->options, image), image);
+      return;
+    }
+
+    if (IsRemote(task->filename())) {
+      // The image is being loaded from a remote URL, we'll carry on later
+      // when it's done
+      LoadRemoteImage(*task);
+      return;
+    }
+  }
+
+  ++active_tasks_;
+
+  // The cache is only created once something wants it, so loaders that never
+  // use it don't touch its directory.
+  if (task->options.use_cover_cache_ && !cover_cache_) {
+    cover_cache_.reset(new CoverCache);
   }
 
+  QFutureWatcher<LocalLoadResult>* watcher =
+      new QFutureWatcher<LocalLoadResult>(this);
+  watcher->setFuture(QtConcurrent::run(&AlbumCoverLoader::LoadLocalImage,
+                                       cover_cache_, *task));
+  NewClosure(watcher, SIGNAL(finished()), this,
+             SLOT(LocalLoadFinished(
+                 QFutureWatcher<AlbumCoverLoader::LocalLoadResult>*)),
+             watcher);
+}
+
+void AlbumCoverLoader::LocalLoadFinished(
+    QFutureWatcher<AlbumCoverLoader::LocalLoadResult>* watcher) {
+  watcher->deleteLater();
+  --active_tasks_;
+
+  LocalLoadResult result = watcher->result();
   if (result.loaded_success) {
-    QImage scaled = ScaleAndPad(task->options, result.image);
-    emit ImageLoaded(task->id, scaled);
-    emit ImageLoaded(task->id, scaled, result.image);
-    return;
+    EmitImageLoaded(result.task, result.scaled, result.original);
+  } else {
+    NextState(&result.task);
   }
 
-  NextState(task);
+  ProcessTasks();
 }
 
 void AlbumCoverLoader::NextState(Task* task) {
@@ -131,77 +252,114 @@ void AlbumCoverLoader::NextState(Task* task) {
     ProcessTask(task);
   } else {
     // Give up
-    emit ImageLoaded(task->id, task->options.default_output_image_);
-    emit ImageLoaded(task->id, task->options.default_output_image_,
-                     task->options.default_output_image_);
+    EmitImageLoaded(*task, task->options.default_output_image_,
+                    task->options.default_output_image_);
   }
 }
 
-AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(
-    const Task& task) {
-  // An image embedded in the song itself takes priority
-  if (!task.embedded_image.isNull())
-    return TryLoadResult(false, true,
-                         ScaleAndPad(task.options, task.embedded_image));
-
-  QString filename;
-  switch (task.state) {
-    case State_TryingAuto:
-      filename = task.art_automatic;
-      break;
-    case State_TryingManual:
-      filename = task.art_manual;
-      break;
+void AlbumCoverLoader::EmitImageLoaded(const Task& task, const QImage& scaled,
+                                       const QImage& original) {
+  QList<quint64> ids;
+  {
+    QMutexLocker l(&mutex_);
+    if (!cancelled_ids_.remove(task.id)) {
+      ids << task.id;
+    }
+    ids << duplicate_ids_.take(task.id);
+    task_ids_by_key_.remove(task.key);
+  }
+
+  for (quint64 id : ids) {
+    emit ImageLoaded(id, scaled);
+    emit ImageLoaded(id, scaled, original);
   }
+}
 
-  if (filename == Song::kManuallyUnsetCover)
-    return TryLoadResult(false, true, task.options.default_output_image_);
+AlbumCoverLoader::LocalLoadResult AlbumCoverLoader::LoadLocalImage(
+    std::shared_ptr<CoverCache> cover_cache, const Task& task) {
+  LocalLoadResult result;
+  result.task = task;
 
-  if (filename == Song::kEmbeddedCover && !task.song_filename.isEmpty()) {
-    const QImage taglib_image =
-        TagReaderClient::Instance()->LoadEmbeddedArtBlocking(
+  QImage image;
+  if (!task.embedded_image.isNull()) {
+    image = ScaleAndPad(task.options, task.embedded_image);
+  } else {
+    // Try a scaled down copy of the image first, it's much quicker to decode.
+    const QString cache_key = cover_cache ? CoverCacheKey(task) : QString();
+    if (!cache_key.isEmpty()) {
+      image = cover_cache->Load(cache_key, task.options.desired_height_);
+    }
+
+    if (image.isNull()) {
+      if (task.filename() == Song::kEmbeddedCover &&
+          !task.song_filename.isEmpty()) {
+        image = TagReaderClient::Instance()->LoadEmbeddedArtBlocking(
             task.song_filename);
+      } else {
+        image = QImage(task.filename());
+      }
+      if (!cache_key.isEmpty()) {
+        cover_cache->SaveAsync(cache_key, image);
+      }
+    }
+  }
+
+  if (image.isNull()) return result;
+
+  result.loaded_success = true;
+  result.scaled = ScaleAndPad(task.options, image);
+  result.original = image;
+  return result;
+}
 
-    if (!taglib_image.isNull())
-      return TryLoadResult(false, true,
-                           ScaleAndPad(task.options, taglib_image));
+QString AlbumCoverLoader::CoverCacheKey(const Task& task) {
+  // Only the small sizes are cached, and only if nobody needs the original.
+  if (!task.options.use_cover_cache_ || !task.options.scale_output_image_ ||
+      CoverCache::VariantSize(task.options.desired_height_) == -1) {
+    return QString();
   }
 
-  if (filename.toLower().startsWith("http://") ||
-      filename.toLower().startsWith("https://")) {
+  const QString& filename = task.filename();
+  if (filename == Song::kEmbeddedCover) {
+    if (task.song_filename.isEmpty()) return QString();
+    return CoverCache::KeyForFile(task.song_filename, true);
+  }
+
+  if (filename.isEmpty()) return QString();
+  return CoverCache::KeyForFile(filename, false);
+}
+
+void AlbumCoverLoader::LoadRemoteImage(const Task& task) {
+  const QString& filename = task.filename();
+
+  if (!filename.toLower().startsWith("spotify://image/")) {
     QUrl url(filename);
     QNetworkReply* reply = network_->get(QNetworkRequest(url));
     NewClosure(reply, SIGNAL(finished()), this,
                SLOT(RemoteFetchFinished(QNetworkReply*)), reply);
 
     remote_tasks_.insert(reply, task);
-    return TryLoadResult(true, false, QImage());
-  } else if (filename.toLower().startsWith("spotify://image/")) {
-    // HACK: we should add generic image URL handlers
-    SpotifyService* spotify = InternetModel::Service<SpotifyService>();
-
-    if (!connected_spotify_) {
-      connect(spotify, SIGNAL(ImageLoaded(QString, QImage)),
-              SLOT(SpotifyImageLoaded(QString, QImage)));
-      connected_spotify_ = true;
-    }
+    return;
+  }
 
-    QString id = QUrl(filename).path();
-    if (id.startsWith('/')) {
-      id.remove(0, 1);
-    }
-    remote_spotify_tasks_.insert(id, task);
+  // HACK: we should add generic image URL handlers
+  SpotifyService* spotify = InternetModel::Service<SpotifyService>();
+
+  if (!connected_spotify_) {
+    connect(spotify, SIGNAL(ImageLoaded(QString, QImage)),
+            SLOT(SpotifyImageLoaded(QString, QImage)));
+    connected_spotify_ = true;
+  }
 
-    // Need to schedule this in the spotify service's thread
-    QMetaObject::invokeMethod(spotify, "LoadImage", Qt::QueuedConnection,
-                              Q_ARG(QString, id));
-    return TryLoadResult(true, false, QImage());
+  QString id = QUrl(filename).path();
+  if (id.startsWith('/')) {
+    id.remove(0, 1);
   }
+  remote_spotify_tasks_.insert(id, task);
 
-  QImage image(filename);
-  return TryLoadResult(
-      false, !image.isNull(),
-      image.isNull() ? task.options.default_output_image_ : image);
+  // Need to schedule this in the spotify service's thread
+  QMetaObject::invokeMethod(spotify, "LoadImage", Qt::QueuedConnection,
+                            Q_ARG(QString, id));
 }
 
 void AlbumCoverLoader::SpotifyImageLoaded(const QString& id,
@@ -209,9 +367,7 @@ void AlbumCoverLoader::SpotifyImageLoaded(const QString& id,
   if (!remote_spotify_tasks_.contains(id)) return;
 
   Task task = remote_spotify_tasks_.take(id);
-  QImage scaled = ScaleAndPad(task.options, image);
-  emit ImageLoaded(task.id, scaled);
-  emit ImageLoaded(task.id, scaled, image);
+  EmitImageLoaded(task, ScaleAndPad(task.options, image), image);
 }
 
 void AlbumCoverLoader::RemoteFetchFinished(QNetworkReply* reply) {
@@ -224,7 +380,9 @@ void AlbumCoverLoader::RemoteFetchFinished(QNetworkReply* reply) {
       reply->attribute(QNetworkRequest::RedirectionTargetAttribute);
   if (redirect.isValid()) {
     if (++task.redirects > kMaxRedirects) {
-      return;  // Give up.
+      // Give up.
+      NextState(&task);
+      return;
     }
     QNetworkRequest request = reply->request();
     request.setUrl(redirect.toUrl());
@@ -240,9 +398,7 @@ void AlbumCoverLoader::RemoteFetchFinished(QNetworkReply* reply) {
     // Try to load the image
     QImage image;
     if (image.load(reply, 0)) {
-      QImage scaled = ScaleAndPad(task.options, image);
-      emit ImageLoaded(task.id, scaled);
-      emit ImageLoaded(task.id, scaled, image);
+      EmitImageLoaded(task, ScaleAndPad(task.options, image), image);
       return;
     }
   }
@@ -21,18 +21,28 @@
 #ifndef COVERS_ALBUMCOVERLOADER_H_
 #define COVERS_ALBUMCOVERLOADER_H_
 
+#include <memory>
+
 #include "albumcoverloaderoptions.h"
 #include "core/song.h"
 
+#include <QFutureWatcher>
+#include <QHash>
 #include <QImage>
 #include <QMutex>
 #include <QObject>
 #include <QQueue>
+#include <QSet>
 #include <QUrl>
 
+class CoverCache;
 class NetworkAccessManager;
 class QNetworkReply;
 
+// Loads album art and scales it for display.  Local images are decoded on
+// several worker threads at once.  Requests with Priority_Bulk only start when
+// there are no interactive ones waiting, and never use the last free worker.
+// Requests for an image that's already being loaded share that task.
 class AlbumCoverLoader : public QObject {
   Q_OBJECT
 
@@ -63,20 +73,22 @@ class AlbumCoverLoader : public QObject {
   void ImageLoaded(quint64 id, const QImage& image);
   void ImageLoaded(quint64 id, const QImage& scaled, const QImage& original);
 
- protected slots:
-  void ProcessTasks();
-  void RemoteFetchFinished(QNetworkReply* reply);
-  void SpotifyImageLoaded(const QString& url, const QImage& image);
-
  protected:
   enum State { State_TryingManual, State_TryingAuto, };
 
   struct Task {
-    Task() : redirects(0) {}
+    Task() : id(0), state(State_TryingManual), redirects(0) {}
+
+    const QString& filename() const {
+      return state == State_TryingAuto ? art_automatic : art_manual;
+    }
 
     AlbumCoverLoaderOptions options;
 
     quint64 id;
+    // Identifies the image this task loads, so that requests for the same
+    // image can share one task.
+    QString key;
     QString art_automatic;
     QString art_manual;
     QString song_filename;
@@ -85,31 +97,72 @@ class AlbumCoverLoader : public QObject {
     int redirects;
   };
 
-  struct TryLoadResult {
-    TryLoadResult(bool async, bool success, const QImage& i)
-        : started_async(async), loaded_success(success), image(i) {}
+  struct LocalLoadResult {
+    LocalLoadResult() : loaded_success(false) {}
 
-    bool started_async;
+    Task task;
     bool loaded_success;
-    QImage image;
+    QImage scaled;
+    QImage original;
   };
 
+ protected slots:
+  void ProcessTasks();
+  void LocalLoadFinished(
+      QFutureWatcher<AlbumCoverLoader::LocalLoadResult>* watcher);
+  void RemoteFetchFinished(QNetworkReply* reply);
+  void SpotifyImageLoaded(const QString& url, const QImage& image);
+
+ protected:
+  // Adds the task to the queue for its priority, or makes it wait for an
+  // existing task that loads the same image.  mutex_ must be held.
+  void QueueTask(Task task);
+
   void ProcessTask(Task* task);
   void NextState(Task* task);
-  TryLoadResult TryLoadImage(const Task& task);
+  void LoadRemoteImage(const Task& task);
+  void EmitImageLoaded(const Task& task, const QImage& scaled,
+                       const QImage& original);
+
+  // Loads an image from a local file or from the song's tags.  Runs on a
+  // worker thread.
+  static LocalLoadResult LoadLocalImage(std::shared_ptr<CoverCache> cover_cache,
+                                        const Task& task);
+
+  // Returns the key of the source of this art in the CoverCache, or an empty
+  // string if it shouldn't be cached.
+  static QString CoverCacheKey(const Task& task);
+
+  static QString TaskKey(const Task& task);
+  static bool IsRemote(const QString& filename);
 
   bool stop_requested_;
 
   QMutex mutex_;
-  QQueue<Task> tasks_;
+  QQueue<Task> interactive_tasks_;
+  QQueue<Task> bulk_tasks_;
+  // The ids of the tasks that haven't finished yet keyed by Task::key, and
+  // the ids of the duplicate requests waiting for each of them.
+  QHash<QString, quint64> task_ids_by_key_;
+  QHash<quint64, QList<quint64>> duplicate_ids_;
+  // Tasks that were cancelled while they were loading, or that are still
+  // needed by their duplicates.  Their own ids aren't told about the result.
+  QSet<quint64> cancelled_ids_;
+  quint64 next_id_;
+
+  // Only used in this object's thread.
+  int active_tasks_;
+  const int max_active_tasks_;
   QMap<QNetworkReply*, Task> remote_tasks_;
   QMap<QString, Task> remote_spotify_tasks_;
-  quint64 next_id_;
 
   NetworkAccessManager* network_;
 
   bool connected_spotify_;
 
+  // Created by the first task with use_cover_cache_ set.
+  std::shared_ptr<CoverCache> cover_cache_;
+
   static const int kMaxRedirects = 3;
 };
 
@@ -23,14 +23,27 @@
 #include <QImage>
 
 struct AlbumCoverLoaderOptions {
+  enum Priority {
+    // Images the user is waiting for, like the cover of the current song.
+    Priority_Interactive,
+    // Images for long lists, which are loaded after the interactive ones.
+    Priority_Bulk,
+  };
+
   AlbumCoverLoaderOptions()
       : desired_height_(120),
         scale_output_image_(true),
-        pad_output_image_(true) {}
+        pad_output_image_(true),
+        use_cover_cache_(true),
+        priority_(Priority_Interactive) {}
 
   int desired_height_;
   bool scale_output_image_;
   bool pad_output_image_;
+  // Whether the image may be loaded from a scaled down copy in the CoverCache.
+  // Turn this off if the original image is needed as well.
+  bool use_cover_cache_;
+  Priority priority_;
   QImage default_output_image_;
 };
 
@@ -0,0 +1,116 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "covercache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QtConcurrentRun>
+
+#include "core/cachefiles.h"
+#include "core/utilities.h"
+
+const int CoverCache::kVariantSizes[] = {32, 64, 128, 500};
+const int CoverCache::kVariantCount =
+    sizeof(CoverCache::kVariantSizes) / sizeof(CoverCache::kVariantSizes[0]);
+const int CoverCache::kMemoryCacheSizeKb = 20 * 1024;      // 20MB
+const qint64 CoverCache::kDiskCacheSize = 200 * 1024 * 1024;  // 200MB
+
+namespace {
+
+QString VariantFilename(const QString& path, const QString& key, int size) {
+  return QString("%1/%2-%3").arg(path, key).arg(size);
+}
+
+void SaveVariants(const QString& path, const QString& key,
+                  const QImage& original) {
+  // Scale each variant from the next biggest one, which is quicker than
+  // scaling them all from the original and looks the same.
+  QImage image = original;
+  for (int i = CoverCache::kVariantCount - 1; i >= 0; --i) {
+    const int size = CoverCache::kVariantSizes[i];
+    if (image.width() > size || image.height() > size) {
+      image = image.scaled(size, size, Qt::KeepAspectRatio,
+                           Qt::SmoothTransformation);
+    }
+
+    const bool saved = CacheFiles::Save(
+        VariantFilename(path, key, size), [&image](QIODevice* file) {
+          return image.save(file, image.hasAlphaChannel() ? "PNG" : "JPG", 90);
+        });
+    if (!saved) return;
+  }
+}
+
+}  // namespace
+
+CoverCache::CoverCache(const QString& path)
+    : path_(path.isEmpty()
+                ? Utilities::GetConfigPath(Utilities::Path_CoverCache)
+                : path),
+      memory_cache_(kMemoryCacheSizeKb) {
+  QDir().mkpath(path_);
+  QtConcurrent::run(CacheFiles::Trim, path_, kDiskCacheSize);
+}
+
+QString CoverCache::KeyForFile(const QString& filename, bool embedded) {
+  const QFileInfo info(filename);
+  if (!info.exists()) return QString();
+
+  const QString key = QString("%1\n%2\n%3\n%4")
+                          .arg(info.absoluteFilePath())
+                          .arg(embedded ? "embedded" : "file")
+                          .arg(info.lastModified().toTime_t())
+                          .arg(info.size());
+  return QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1)
+      .toHex();
+}
+
+int CoverCache::VariantSize(int size) {
+  for (int i = 0; i < kVariantCount; ++i) {
+    if (kVariantSizes[i] >= size) return kVariantSizes[i];
+  }
+  return -1;
+}
+
+QImage CoverCache::Load(const QString& key, int size) {
+  const int variant_size = VariantSize(size);
+  if (key.isEmpty() || variant_size == -1) return QImage();
+
+  const QString filename = VariantFilename(path_, key, variant_size);
+  {
+    QMutexLocker l(&mutex_);
+    QImage* image = memory_cache_.object(filename);
+    if (image) return *image;
+  }
+
+  QImage image(filename);
+  if (image.isNull()) return image;
+
+  QMutexLocker l(&mutex_);
+  memory_cache_.insert(filename, new QImage(image),
+                       qMax(1, image.byteCount() / 1024));
+  return image;
+}
+
+void CoverCache::SaveAsync(const QString& key, const QImage& original) {
+  if (key.isEmpty() || original.isNull()) return;
+  QtConcurrent::run(SaveVariants, path_, key, original);
+}
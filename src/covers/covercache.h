@@ -0,0 +1,63 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COVERS_COVERCACHE_H_
+#define COVERS_COVERCACHE_H_
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+
+// Keeps scaled down copies of album art on disk, so showing a small cover
+// doesn't mean decoding the full size image again.  Each cover is saved once
+// per size in kVariantSizes, under a key made from the path and modification
+// time of the file the art came from.  Recently used images are also kept in
+// memory.  Thread-safe.
+class CoverCache {
+ public:
+  explicit CoverCache(const QString& path = QString());
+
+  static const int kVariantSizes[];
+  static const int kVariantCount;
+  static const int kMemoryCacheSizeKb;
+  static const qint64 kDiskCacheSize;
+
+  // Returns the key for the art in the image file filename, or for the art
+  // embedded in the song file filename if embedded is true.  Returns an empty
+  // string if the file doesn't exist.
+  static QString KeyForFile(const QString& filename, bool embedded);
+
+  // Returns the smallest variant size that is at least size pixels, or -1 if
+  // size is bigger than all of them.
+  static int VariantSize(int size);
+
+  // Returns the cached variant of the cover that's big enough to be scaled
+  // down to size pixels, or a null image if it hasn't been cached.
+  QImage Load(const QString& key, int size);
+
+  // Scales original to each variant size and saves them on a worker thread.
+  void SaveAsync(const QString& key, const QImage& original);
+
+ private:
+  QString path_;
+
+  QMutex mutex_;
+  QCache<QString, QImage> memory_cache_;
+};
+
+#endif  // COVERS_COVERCACHE_H_
@@ -42,6 +42,7 @@ FilesystemDevice::FilesystemDevice(const QUrl& url, DeviceLister* lister,
       manager->data(manager->index(manager->FindDeviceById(unique_id)),
                     DeviceManager::Role_FriendlyName).toString());
   watcher_->set_backend(backend_);
+  backend_->set_track_dirty_albums(true);
   watcher_->set_task_manager(app_->task_manager());
 
   connect(backend_, SIGNAL(DirectoryDiscovered(Directory, SubdirectoryList)),
@@ -60,6 +61,10 @@ FilesystemDevice::FilesystemDevice(const QUrl& url, DeviceLister* lister,
           SLOT(AddOrUpdateSubdirs(SubdirectoryList)));
   connect(watcher_, SIGNAL(CompilationsNeedUpdating()), backend_,
           SLOT(UpdateCompilations()));
+  connect(watcher_, SIGNAL(NewDirectoryScanStarted()), backend_,
+          SLOT(BeginBulkIngest()));
+  connect(watcher_, SIGNAL(NewDirectoryScanFinished()), backend_,
+          SLOT(EndBulkIngest()));
   connect(watcher_, SIGNAL(ScanStarted(int)), SIGNAL(TaskStarted(int)));
 }
 
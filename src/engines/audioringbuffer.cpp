@@ -0,0 +1,121 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "audioringbuffer.h"
+
+#include <cstring>
+
+const int AudioRingBuffer::kDefaultCapacity = 1 << 17;
+
+std::atomic<int> AudioRingBuffer::sNextId(0);
+
+namespace {
+
+int RoundUpToPowerOfTwo(int value) {
+  int ret = 1;
+  while (ret < value) ret <<= 1;
+  return ret;
+}
+
+}  // namespace
+
+AudioRingBuffer::AudioRingBuffer(int capacity)
+    : id_(sNextId++),
+      mask_(RoundUpToPowerOfTwo(capacity) - 1),
+      data_(mask_ + 1),
+      writing_(0),
+      written_(0) {}
+
+void AudioRingBuffer::Write(const sample_type* data, int count) {
+  quint64 position = written_.load(std::memory_order_relaxed);
+
+  // Only the last capacity() samples would survive anyway.
+  if (count > capacity()) {
+    data += count - capacity();
+    position += count - capacity();
+    count = capacity();
+  }
+
+  writing_.store(position + count, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  const int start = position & mask_;
+  const int first = qMin(count, capacity() - start);
+  memcpy(&data_[start], data, first * sizeof(sample_type));
+  memcpy(&data_[0], data + first, (count - first) * sizeof(sample_type));
+
+  written_.store(position + count, std::memory_order_release);
+}
+
+int AudioRingBuffer::Copy(quint64 position, sample_type* dest,
+                          int count) const {
+  const int start = position & mask_;
+  const int first = qMin(count, capacity() - start);
+  memcpy(dest, &data_[start], first * sizeof(sample_type));
+  memcpy(dest + first, &data_[0], (count - first) * sizeof(sample_type));
+
+  // Anything the writer started overwriting before the copy finished is no
+  // longer valid.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const quint64 writing = writing_.load(std::memory_order_relaxed);
+  const quint64 oldest_valid =
+      writing > quint64(capacity()) ? writing - capacity() : 0;
+  if (oldest_valid <= position) return 0;
+  return int(qMin(oldest_valid - position, quint64(count)));
+}
+
+int AudioRingBuffer::Read(Cursor* cursor, sample_type* dest,
+                          int max_count) const {
+  const quint64 end = written_.load(std::memory_order_acquire);
+
+  if (cursor->buffer_id != id_) {
+    cursor->buffer_id = id_;
+    cursor->position = end;
+    return 0;
+  }
+
+  // If the reader fell too far behind, skip to the oldest sample still here.
+  const quint64 oldest = end > quint64(capacity()) ? end - capacity() : 0;
+  const quint64 position = qMax(cursor->position, oldest);
+
+  const int count = int(qMin(end - position, quint64(max_count)));
+  cursor->position = position + count;
+  if (count <= 0) return 0;
+
+  const int overwritten = Copy(position, dest, count);
+  if (overwritten) {
+    memmove(dest, dest + overwritten,
+            (count - overwritten) * sizeof(sample_type));
+  }
+  return count - overwritten;
+}
+
+int AudioRingBuffer::ReadLatest(sample_type* dest, int count) const {
+  const quint64 end = written_.load(std::memory_order_acquire);
+
+  count = int(qMin(quint64(qMin(count, capacity())), end));
+  if (count <= 0) return 0;
+
+  // The newest samples are the ones least likely to be overwritten, but if the
+  // writer lapped this copy keep only the part that's still good.
+  const int overwritten = Copy(end - count, dest, count);
+  if (overwritten) {
+    memmove(dest, dest + overwritten,
+            (count - overwritten) * sizeof(sample_type));
+  }
+  return count - overwritten;
+}
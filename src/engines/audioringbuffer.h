@@ -0,0 +1,86 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENGINES_AUDIORINGBUFFER_H
+#define ENGINES_AUDIORINGBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <QtGlobal>
+
+// Holds the most recent audio samples written by one thread (the GStreamer
+// streaming thread), so any number of readers can copy them out at their own
+// rate without taking a lock.  The writer never waits for the readers - a
+// reader that falls more than capacity() samples behind skips ahead to the
+// oldest samples still in the buffer.
+class AudioRingBuffer {
+ public:
+  typedef int16_t sample_type;
+
+  // Where a reader has got up to in a buffer.  A default-constructed cursor,
+  // or one used with a different buffer, starts at the newest sample.
+  struct Cursor {
+    Cursor() : buffer_id(-1), position(0) {}
+
+    int buffer_id;
+    quint64 position;
+  };
+
+  // capacity is rounded up to a power of two.
+  explicit AudioRingBuffer(int capacity = kDefaultCapacity);
+
+  // About a second of 16-bit stereo audio at 48kHz.
+  static const int kDefaultCapacity;
+
+  int id() const { return id_; }
+  int capacity() const { return mask_ + 1; }
+
+  // The total number of samples written so far.
+  quint64 position() const { return written_.load(); }
+
+  // Appends count samples.  Must only be called from one thread at a time.
+  void Write(const sample_type* data, int count);
+
+  // Copies up to max_count of the samples written since the cursor's position
+  // into dest, advances the cursor and returns the number of samples copied.
+  int Read(Cursor* cursor, sample_type* dest, int max_count) const;
+
+  // Copies the newest count samples into dest.  Returns the number of samples
+  // copied, which is less than count if fewer have been written.
+  int ReadLatest(sample_type* dest, int count) const;
+
+ private:
+  // Copies count samples starting at position into dest, and returns how many
+  // of them at the start of dest may have been overwritten by the writer
+  // while they were being copied.
+  int Copy(quint64 position, sample_type* dest, int count) const;
+
+  static std::atomic<int> sNextId;
+
+  const int id_;
+  const int mask_;
+  std::vector<sample_type> data_;
+  // The writer moves writing_ forward before overwriting old samples, and
+  // written_ once the new samples are in place.  Readers only read up to
+  // written_, and check writing_ afterwards to see what was overwritten.
+  std::atomic<quint64> writing_;
+  std::atomic<quint64> written_;
+};
+
+#endif  // ENGINES_AUDIORINGBUFFER_H
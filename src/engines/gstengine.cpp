@@ -25,6 +25,7 @@
 #include <cmath>
 #include <unistd.h>
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <vector>
@@ -93,7 +94,6 @@ GstEngine::GstEngine(TaskManager* task_manager)
     : Engine::Base(),
       task_manager_(task_manager),
       buffering_task_id_(-1),
-      latest_buffer_(nullptr),
       equalizer_enabled_(false),
       stereo_balance_(0.0f),
       rg_enabled_(false),
@@ -109,8 +109,8 @@ GstEngine::GstEngine(TaskManager* task_manager)
       next_element_id_(0),
       is_fading_out_to_pause_(false),
       has_faded_out_(false),
-      scope_chunk_(0),
-      have_new_buffer_(false) {
+      scope_buffer_id_(-1),
+      scope_position_(0) {
   seek_timer_->setSingleShot(true);
   seek_timer_->setInterval(kSeekDelayNanosec / kNsecPerMsec);
   connect(seek_timer_, SIGNAL(timeout()), SLOT(SeekNow()));
@@ -245,101 +245,31 @@ Engine::State GstEngine::state() const {
   }
 }
 
-void GstEngine::ConsumeBuffer(GstBuffer* buffer, int pipeline_id) {
-  // Schedule this to run in the GUI thread.  The buffer gets added to the
-  // queue and unreffed by UpdateScope.
-  if (!QMetaObject::invokeMethod(this, "AddBufferToScope",
-                                 Q_ARG(GstBuffer*, buffer),
-                                 Q_ARG(int, pipeline_id))) {
-    qLog(Warning) << "Failed to invoke AddBufferToScope on GstEngine";
-  }
-}
-
-void GstEngine::AddBufferToScope(GstBuffer* buf, int pipeline_id) {
-  if (!current_pipeline_ || current_pipeline_->id() != pipeline_id) {
-    gst_buffer_unref(buf);
-    return;
-  }
+const Engine::Scope& GstEngine::scope(int) {
+  if (!current_pipeline_) return scope_;
 
-  if (latest_buffer_ != nullptr) {
-    gst_buffer_unref(latest_buffer_);
+  // Leave the scope alone if nothing new has been played since last time.
+  const AudioRingBuffer& buffer = current_pipeline_->audio_buffer();
+  if (buffer.id() == scope_buffer_id_ &&
+      buffer.position() == scope_position_) {
+    return scope_;
   }
+  scope_buffer_id_ = buffer.id();
+  scope_position_ = buffer.position();
 
-  latest_buffer_ = buf;
-  have_new_buffer_ = true;
-}
-
-const Engine::Scope& GstEngine::scope(int chunk_length) {
-  // the new buffer could have a different size
-  if (have_new_buffer_) {
-    if (latest_buffer_ != nullptr) {
-      scope_chunks_ = ceil(((double)GST_BUFFER_DURATION(latest_buffer_) /
-                            (double)(chunk_length * kNsecPerMsec)));
-    }
-
-    // if the buffer is shorter than the chunk length
-    if (scope_chunks_ <= 0) {
-      scope_chunks_ = 1;
-    }
-
-    scope_chunk_ = 0;
-    have_new_buffer_ = false;
-  }
-
-  if (latest_buffer_ != nullptr) {
-    UpdateScope(chunk_length);
-  }
+  // The probe sink is synchronised to the clock, so the newest samples in the
+  // buffer are the ones being played right now.
+  const int count = buffer.ReadLatest(scope_.data(), scope_.size());
+  std::fill(scope_.begin() + count, scope_.end(), 0);
 
   return scope_;
 }
 
-void GstEngine::UpdateScope(int chunk_length) {
-  typedef Engine::Scope::value_type sample_type;
-
-  // prevent dbz or invalid chunk size
-  if (!GST_CLOCK_TIME_IS_VALID(GST_BUFFER_DURATION(latest_buffer_))) return;
-  if (GST_BUFFER_DURATION(latest_buffer_) == 0) return;
-
-  GstMapInfo map;
-  gst_buffer_map(latest_buffer_, &map, GST_MAP_READ);
-
-  // determine where to split the buffer
-  int chunk_density =
-      (map.size * kNsecPerMsec) / GST_BUFFER_DURATION(latest_buffer_);
-
-  int chunk_size = chunk_length * chunk_density;
-
-  // in case a buffer doesn't arrive in time
-  if (scope_chunk_ >= scope_chunks_) {
-    scope_chunk_ = 0;
-    return;
-  }
-
-  const sample_type* source = reinterpret_cast<sample_type*>(map.data);
-  sample_type* dest = scope_.data();
-  source += (chunk_size / sizeof(sample_type)) * scope_chunk_;
-
-  int bytes = 0;
-
-  // make sure we don't go beyond the end of the buffer
-  if (scope_chunk_ == scope_chunks_ - 1) {
-    bytes = qMin(static_cast<Engine::Scope::size_type>(
-                     map.size - (chunk_size * scope_chunk_)),
-                 scope_.size() * sizeof(sample_type));
-  } else {
-    bytes = qMin(static_cast<Engine::Scope::size_type>(chunk_size),
-                 scope_.size() * sizeof(sample_type));
-  }
-
-  scope_chunk_++;
-  memcpy(dest, source, bytes);
-
-  gst_buffer_unmap(latest_buffer_, &map);
-
-  if (scope_chunk_ == scope_chunks_) {
-    gst_buffer_unref(latest_buffer_);
-    latest_buffer_ = nullptr;
-  }
+int GstEngine::ReadAudio(AudioRingBuffer::Cursor* cursor,
+                         AudioRingBuffer::sample_type* dest,
+                         int max_count) const {
+  if (!current_pipeline_) return 0;
+  return current_pipeline_->audio_buffer().Read(cursor, dest, max_count);
 }
 
 void GstEngine::StartPreloading(const QUrl& url, bool force_stop_at_end,
@@ -423,7 +353,6 @@ void GstEngine::StartFadeout() {
 
   fadeout_pipeline_ = current_pipeline_;
   disconnect(fadeout_pipeline_.get(), 0, 0, 0);
-  fadeout_pipeline_->RemoveAllBufferConsumers();
 
   fadeout_pipeline_->StartFader(fadeout_duration_nanosec_, QTimeLine::Backward);
   connect(fadeout_pipeline_.get(), SIGNAL(FaderFinished()),
@@ -792,11 +721,6 @@ shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline() {
   ret->set_mono_playback(mono_playback_);
   ret->set_sample_rate(sample_rate_);
 
-  ret->AddBufferConsumer(this);
-  for (BufferConsumer* consumer : buffer_consumers_) {
-    ret->AddBufferConsumer(consumer);
-  }
-
   connect(ret.get(), SIGNAL(EndOfStreamReached(int, bool)),
           SLOT(EndOfStreamReached(int, bool)));
   connect(ret.get(), SIGNAL(Error(int, QString, int, int)),
@@ -830,16 +754,6 @@ shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline(const QUrl& url,
   return ret;
 }
 
-void GstEngine::AddBufferConsumer(BufferConsumer* consumer) {
-  buffer_consumers_ << consumer;
-  if (current_pipeline_) current_pipeline_->AddBufferConsumer(consumer);
-}
-
-void GstEngine::RemoveBufferConsumer(BufferConsumer* consumer) {
-  buffer_consumers_.removeAll(consumer);
-  if (current_pipeline_) current_pipeline_->RemoveBufferConsumer(consumer);
-}
-
 int GstEngine::AddBackgroundStream(shared_ptr<GstEnginePipeline> pipeline) {
   // We don't want to get metadata messages or end notifications.
   disconnect(pipeline.get(),
@@ -33,7 +33,7 @@
 #include <QStringList>
 #include <QTimerEvent>
 
-#include "bufferconsumer.h"
+#include "audioringbuffer.h"
 #include "enginebase.h"
 #include "core/boundfuturewatcher.h"
 #include "core/timeconstants.h"
@@ -55,7 +55,7 @@ typedef struct _GTlsDatabase GTlsDatabase;
  * @short GStreamer engine plugin
  * @author Mark Kretschmann <markey@web.de>
  */
-class GstEngine : public Engine::Base, public BufferConsumer {
+class GstEngine : public Engine::Base {
   Q_OBJECT
 
  public:
@@ -92,8 +92,11 @@ class GstEngine : public Engine::Base, public BufferConsumer {
 
   GstElement* CreateElement(const QString& factoryName, GstElement* bin = 0);
 
-  // BufferConsumer
-  void ConsumeBuffer(GstBuffer* buffer, int pipeline_id);
+  // Copies up to max_count of the samples played by the current pipeline
+  // since the last call with this cursor into dest, and returns the number of
+  // samples copied.  The samples are interleaved 16-bit stereo.
+  int ReadAudio(AudioRingBuffer::Cursor* cursor,
+                AudioRingBuffer::sample_type* dest, int max_count) const;
 
  public slots:
   void StartPreloading(const QUrl& url, bool force_stop_at_end,
@@ -118,9 +121,6 @@ class GstEngine : public Engine::Base, public BufferConsumer {
 
   void ReloadSettings();
 
-  void AddBufferConsumer(BufferConsumer* consumer);
-  void RemoveBufferConsumer(BufferConsumer* consumer);
-
 #ifdef Q_OS_DARWIN
   GTlsDatabase* tls_database() const { return tls_database_; }
 #endif
@@ -134,7 +134,6 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   void HandlePipelineError(int pipeline_id, const QString& message, int domain,
                            int error_code);
   void NewMetaData(int pipeline_id, const Engine::SimpleMetaBundle& bundle);
-  void AddBufferToScope(GstBuffer* buf, int pipeline_id);
   void FadeoutFinished();
   void FadeoutPauseFinished();
   void SeekNow();
@@ -170,8 +169,6 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   std::shared_ptr<GstEnginePipeline> CreatePipeline(const QUrl& url,
                                                     qint64 end_nanosec);
 
-  void UpdateScope(int chunk_length);
-
   int AddBackgroundStream(std::shared_ptr<GstEnginePipeline> pipeline);
 
   static QUrl FixupUrl(const QUrl& url);
@@ -197,10 +194,6 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   std::shared_ptr<GstEnginePipeline> fadeout_pause_pipeline_;
   QUrl preloaded_url_;
 
-  QList<BufferConsumer*> buffer_consumers_;
-
-  GstBuffer* latest_buffer_;
-
   bool equalizer_enabled_;
   int equalizer_preamp_;
   QList<int> equalizer_gains_;
@@ -234,9 +227,9 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   bool is_fading_out_to_pause_;
   bool has_faded_out_;
 
-  int scope_chunk_;
-  bool have_new_buffer_;
-  int scope_chunks_;
+  // The audio buffer and position scope_ was last filled from.
+  int scope_buffer_id_;
+  quint64 scope_position_;
 
   QList<DeviceFinder*> device_finders_;
 
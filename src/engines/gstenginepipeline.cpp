@@ -23,7 +23,6 @@
 #include <QRegExp>
 #include <QUuid>
 
-#include "bufferconsumer.h"
 #include "config.h"
 #include "gstelementdeleter.h"
 #include "gstengine.h"
@@ -830,15 +829,12 @@ GstPadProbeReturn GstEnginePipeline::HandoffCallback(GstPad*,
   GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
   GstBuffer* buf = gst_pad_probe_info_get_buffer(info);
 
-  QList<BufferConsumer*> consumers;
-  {
-    QMutexLocker l(&instance->buffer_consumers_mutex_);
-    consumers = instance->buffer_consumers_;
-  }
-
-  for (BufferConsumer* consumer : consumers) {
-    gst_buffer_ref(buf);
-    consumer->ConsumeBuffer(buf, instance->id());
+  GstMapInfo map;
+  if (gst_buffer_map(buf, &map, GST_MAP_READ)) {
+    instance->audio_buffer_.Write(
+        reinterpret_cast<const AudioRingBuffer::sample_type*>(map.data),
+        map.size / sizeof(AudioRingBuffer::sample_type));
+    gst_buffer_unmap(buf, &map);
   }
 
   // Calculate the end time of this buffer so we can stop playback if it's
@@ -1185,21 +1181,6 @@ void GstEnginePipeline::timerEvent(QTimerEvent* e) {
   QObject::timerEvent(e);
 }
 
-void GstEnginePipeline::AddBufferConsumer(BufferConsumer* consumer) {
-  QMutexLocker l(&buffer_consumers_mutex_);
-  buffer_consumers_ << consumer;
-}
-
-void GstEnginePipeline::RemoveBufferConsumer(BufferConsumer* consumer) {
-  QMutexLocker l(&buffer_consumers_mutex_);
-  buffer_consumers_.removeAll(consumer);
-}
-
-void GstEnginePipeline::RemoveAllBufferConsumers() {
-  QMutexLocker l(&buffer_consumers_mutex_);
-  buffer_consumers_.clear();
-}
-
 void GstEnginePipeline::SetNextUrl(const QUrl& url, qint64 beginning_nanosec,
                                    qint64 end_nanosec) {
   next_url_ = url;
@@ -22,7 +22,6 @@
 
 #include <QBasicTimer>
 #include <QFuture>
-#include <QMutex>
 #include <QObject>
 #include <QThreadPool>
 #include <QTimeLine>
@@ -30,11 +29,11 @@
 
 #include <gst/gst.h>
 
+#include "audioringbuffer.h"
 #include "engine_fwd.h"
 
 class GstElementDeleter;
 class GstEngine;
-class BufferConsumer;
 
 struct GstQueue;
 struct GstURIDecodeBin;
@@ -61,10 +60,9 @@ class GstEnginePipeline : public QObject {
   bool InitFromUrl(const QUrl& url, qint64 end_nanosec);
   bool InitFromString(const QString& pipeline);
 
-  // BufferConsumers get fed audio data.  Thread-safe.
-  void AddBufferConsumer(BufferConsumer* consumer);
-  void RemoveBufferConsumer(BufferConsumer* consumer);
-  void RemoveAllBufferConsumers();
+  // The 16-bit audio data that's been played by this pipeline.  It's written
+  // by the GStreamer streaming thread and can be read from any thread.
+  const AudioRingBuffer& audio_buffer() const { return audio_buffer_; }
 
   // Control the music playback
   QFuture<GstStateChangeReturn> SetState(GstState state);
@@ -190,9 +188,7 @@ signals:
   QString sink_;
   QVariant device_;
 
-  // These get called when there is a new audio buffer available
-  QList<BufferConsumer*> buffer_consumers_;
-  QMutex buffer_consumers_mutex_;
+  AudioRingBuffer audio_buffer_;
   qint64 segment_start_;
   bool segment_start_received_;
   bool emit_track_ended_on_stream_start_;
@@ -0,0 +1,176 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cataloguestream.h"
+
+#include <cstring>
+
+#include <QNetworkReply>
+
+#include "core/logging.h"
+
+const int CatalogueStream::kBufferSize = 1024 * 1024;  // 1MB
+
+CatalogueStream::CatalogueStream(QIODevice* source, QObject* parent,
+                                 int buffer_size)
+    : QIODevice(parent),
+      source_(source),
+      buffer_size_(buffer_size),
+      source_finished_(false),
+      buffer_(buffer_size, '\0'),
+      buffer_start_(0),
+      buffer_used_(0),
+      space_requested_(false),
+      at_end_(false),
+      error_(false),
+      bytes_read_(0),
+      total_bytes_(-1) {
+  open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+
+  connect(this, SIGNAL(SpaceAvailable()), SLOT(ReadFromSource()),
+          Qt::QueuedConnection);
+
+  if (source_->isSequential()) {
+    connect(source_, SIGNAL(readyRead()), SLOT(ReadFromSource()));
+
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(source_);
+    if (reply) {
+      reply->setReadBufferSize(buffer_size_);
+      connect(reply, SIGNAL(finished()), SLOT(SourceFinished()));
+    } else {
+      connect(source_, SIGNAL(readChannelFinished()), SLOT(SourceFinished()));
+    }
+  }
+
+  ReadFromSource();
+}
+
+CatalogueStream::~CatalogueStream() { Abort(); }
+
+void CatalogueStream::Abort() {
+  QMutexLocker l(&mutex_);
+  at_end_ = true;
+  buffer_.clear();
+  buffer_start_ = 0;
+  buffer_used_ = 0;
+  data_available_.wakeAll();
+}
+
+qint64 CatalogueStream::bytes_read() const {
+  QMutexLocker l(&mutex_);
+  return bytes_read_;
+}
+
+qint64 CatalogueStream::total_bytes() const {
+  QMutexLocker l(&mutex_);
+  return total_bytes_;
+}
+
+int CatalogueStream::progress() const {
+  QMutexLocker l(&mutex_);
+  if (total_bytes_ <= 0) return -1;
+  return qBound(0, int(bytes_read_ * 100 / total_bytes_), 100);
+}
+
+bool CatalogueStream::has_error() const {
+  QMutexLocker l(&mutex_);
+  return error_;
+}
+
+void CatalogueStream::ReadFromSource() {
+  QMutexLocker l(&mutex_);
+  space_requested_ = false;
+  if (at_end_) return;
+
+  if (total_bytes_ == -1) {
+    QNetworkReply* reply = qobject_cast<QNetworkReply*>(source_);
+    if (!source_->isSequential()) {
+      total_bytes_ = source_->size();
+    } else if (reply) {
+      const QVariant length =
+          reply->header(QNetworkRequest::ContentLengthHeader);
+      if (length.isValid()) total_bytes_ = length.toLongLong();
+    }
+  }
+
+  // Fill the free space after the unread data, which is in up to two pieces
+  // if it wraps round the end of the buffer.
+  while (buffer_used_ < buffer_size_) {
+    const int end = (buffer_start_ + buffer_used_) % buffer_size_;
+    const int space = qMin(buffer_size_ - buffer_used_, buffer_size_ - end);
+    const qint64 bytes = source_->read(buffer_.data() + end, space);
+    if (bytes <= 0) break;
+
+    buffer_used_ += bytes;
+    if (bytes < space) break;
+  }
+
+  if ((source_finished_ || (!source_->isSequential() && source_->atEnd())) &&
+      source_->bytesAvailable() <= 0) {
+    at_end_ = true;
+  }
+
+  data_available_.wakeAll();
+}
+
+void CatalogueStream::SourceFinished() {
+  source_finished_ = true;
+
+  QNetworkReply* reply = qobject_cast<QNetworkReply*>(source_);
+  if (reply && reply->error() != QNetworkReply::NoError) {
+    qLog(Warning) << "Error downloading" << reply->url()
+                  << reply->errorString();
+
+    QMutexLocker l(&mutex_);
+    error_ = true;
+    at_end_ = true;
+    data_available_.wakeAll();
+    return;
+  }
+
+  ReadFromSource();
+}
+
+qint64 CatalogueStream::readData(char* data, qint64 max_size) {
+  QMutexLocker l(&mutex_);
+
+  while (buffer_used_ == 0 && !at_end_) {
+    data_available_.wait(&mutex_);
+  }
+
+  const int bytes = int(qMin(max_size, qint64(buffer_used_)));
+  if (bytes == 0) return 0;
+
+  // The data might wrap round the end of the buffer.
+  const int first = qMin(bytes, buffer_size_ - buffer_start_);
+  memcpy(data, buffer_.constData() + buffer_start_, first);
+  memcpy(data + first, buffer_.constData(), bytes - first);
+
+  buffer_start_ = (buffer_start_ + bytes) % buffer_size_;
+  buffer_used_ -= bytes;
+  bytes_read_ += bytes;
+
+  // Ask for the buffer to be filled again on the source's thread.
+  if (!space_requested_ && !at_end_) {
+    space_requested_ = true;
+    emit SpaceAvailable();
+  }
+
+  return bytes;
+}
+
+qint64 CatalogueStream::writeData(const char*, qint64) { return -1; }
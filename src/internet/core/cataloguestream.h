@@ -0,0 +1,103 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INTERNET_CORE_CATALOGUESTREAM_H_
+#define INTERNET_CORE_CATALOGUESTREAM_H_
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QMutex>
+#include <QWaitCondition>
+
+// A read-only sequential device that passes on the data of another device,
+// usually a QNetworkReply that's still downloading.  It lets a service's
+// catalogue be decompressed, parsed and added to the database on a worker
+// thread while it arrives, instead of after the whole download has finished.
+//
+// The source is read on the thread the CatalogueStream lives in, as its data
+// arrives, into a buffer of at most buffer_size bytes.  read() is meant to be
+// called from a worker thread, and blocks until there is something in the
+// buffer or the source has finished.  The source isn't read any more while
+// the buffer is full, and a QNetworkReply's own read buffer is limited to the
+// same size, so the download is held back to the speed of the parser instead
+// of piling up in memory.
+//
+// Sources that aren't sequential, like a QFile, are read as the buffer
+// empties.  Sequential sources have to emit readyRead(), and
+// readChannelFinished() or QNetworkReply::finished() at the end.
+class CatalogueStream : public QIODevice {
+  Q_OBJECT
+
+ public:
+  static const int kBufferSize;
+
+  explicit CatalogueStream(QIODevice* source, QObject* parent = nullptr,
+                           int buffer_size = kBufferSize);
+  ~CatalogueStream();
+
+  bool isSequential() const { return true; }
+
+  // Makes read() return 0 straight away from now on, and stops reading the
+  // source.
+  void Abort();
+
+  // These can be called from any thread.
+
+  // The number of bytes of the source that have been read() so far.
+  qint64 bytes_read() const;
+  // The size of the source, or -1 if it isn't known.
+  qint64 total_bytes() const;
+  // The percentage of the source that has been read(), or -1 if its size
+  // isn't known.
+  int progress() const;
+  // True if the source was a QNetworkReply that failed.
+  bool has_error() const;
+
+ signals:
+  // Emitted by read() when it has made room in the buffer.
+  void SpaceAvailable();
+
+ protected:
+  qint64 readData(char* data, qint64 max_size);
+  qint64 writeData(const char* data, qint64 max_size);
+
+ private slots:
+  void ReadFromSource();
+  void SourceFinished();
+
+ private:
+  QIODevice* source_;
+  const int buffer_size_;
+  // Only touched on the CatalogueStream's own thread.
+  bool source_finished_;
+
+  mutable QMutex mutex_;
+  QWaitCondition data_available_;
+
+  // A ring buffer of buffer_size_ bytes.  The unread data is the buffer_used_
+  // bytes from buffer_start_ onwards, wrapping round at the end.
+  QByteArray buffer_;
+  int buffer_start_;
+  int buffer_used_;
+  bool space_requested_;
+  bool at_end_;
+  bool error_;
+  qint64 bytes_read_;
+  qint64 total_bytes_;
+};
+
+#endif  // INTERNET_CORE_CATALOGUESTREAM_H_
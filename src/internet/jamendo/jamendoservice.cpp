@@ -29,14 +29,16 @@
 #include <QMessageBox>
 #include <QNetworkReply>
 #include <QSortFilterProxyModel>
-#include <QtConcurrentRun>
 #include <QXmlStreamReader>
 #include "qtiocompressor.h"
 
 #include "jamendodynamicplaylist.h"
 #include "jamendoplaylistitem.h"
+#include "internet/core/cataloguestream.h"
 #include "internet/core/internetmodel.h"
 #include "core/application.h"
+#include "core/closure.h"
+#include "core/concurrentrun.h"
 #include "core/database.h"
 #include "core/logging.h"
 #include "core/mergedproxymodel.h"
@@ -53,6 +55,8 @@
 #include "smartplaylists/querygenerator.h"
 #include "ui/iconloader.h"
 
+using std::bind;
+
 const char* JamendoService::kServiceName = "Jamendo";
 const char* JamendoService::kDirectoryUrl =
     "https://imgjam.com/data/dbdump_artistalbumtrack.xml.gz";
@@ -91,6 +95,8 @@ JamendoService::JamendoService(Application* app, InternetModel* parent)
       load_database_task_id_(0),
       total_song_count_(0),
       accepted_download_(false) {
+  thread_pool_.setMaxThreadCount(1);
+
   library_backend_ = new LibraryBackend;
   library_backend_->moveToThread(app_->database()->thread());
   library_backend_->Init(app_->database(), kSongsTable, QString::null,
@@ -143,7 +149,13 @@ JamendoService::JamendoService(Application* app, InternetModel* parent)
           SLOT(SearchProviderToggled(const SearchProvider*, bool)));
 }
 
-JamendoService::~JamendoService() {}
+JamendoService::~JamendoService() {
+  // thread_pool_ waits for the parser when it's destroyed, so stop it from
+  // waiting for more of the catalogue first.
+  for (CatalogueStream* stream : findChildren<CatalogueStream*>()) {
+    stream->Abort();
+  }
+}
 
 QStandardItem* JamendoService::CreateRootItem() {
   QStandardItem* item =
@@ -176,6 +188,9 @@ void JamendoService::UpdateTotalSongCount(int count) {
 }
 
 void JamendoService::DownloadDirectory() {
+  // The catalogue is already being loaded
+  if (load_database_task_id_) return;
+
   // don't ask if we're refreshing the database
   if (total_song_count_ == 0) {
     if (QMessageBox::question(context_menu_, tr("Jamendo database"),
@@ -192,61 +207,38 @@ void JamendoService::DownloadDirectory() {
                    QNetworkRequest::AlwaysNetwork);
 
   QNetworkReply* reply = network_->get(req);
-  connect(reply, SIGNAL(finished()), SLOT(DownloadDirectoryFinished()));
-  connect(reply, SIGNAL(downloadProgress(qint64, qint64)),
-          SLOT(DownloadDirectoryProgress(qint64, qint64)));
-
-  if (!load_database_task_id_) {
-    load_database_task_id_ =
-        app_->task_manager()->StartTask(tr("Downloading Jamendo catalogue"));
-  }
-}
 
-void JamendoService::DownloadDirectoryProgress(qint64 received, qint64 total) {
-  float progress = static_cast<float>(received) / total;
-  app_->task_manager()->SetTaskProgress(load_database_task_id_,
-                                        static_cast<int>(progress * 100),
-                                        100);
-}
-
-void JamendoService::DownloadDirectoryFinished() {
-  QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-  Q_ASSERT(reply);
-
-  app_->task_manager()->SetTaskFinished(load_database_task_id_);
-  load_database_task_id_ = 0;
-
-  // TODO(John Maguire): Not leak reply.
-  QtIOCompressor* gzip = new QtIOCompressor(reply);
+  // The catalogue is decompressed, parsed and added to the database while
+  // it's still downloading.
+  CatalogueStream* stream = new CatalogueStream(reply, reply);
+  QtIOCompressor* gzip = new QtIOCompressor(stream);
+  gzip->setParent(stream);
   gzip->setStreamFormat(QtIOCompressor::GzipFormat);
   if (!gzip->open(QIODevice::ReadOnly)) {
     qLog(Warning) << "Jamendo library not in gzip format";
-    delete gzip;
+    reply->abort();
+    reply->deleteLater();
     return;
   }
 
   load_database_task_id_ =
-      app_->task_manager()->StartTask(tr("Parsing Jamendo catalogue"));
+      app_->task_manager()->StartTask(tr("Loading Jamendo catalogue"));
 
-  QFuture<void> future =
-      QtConcurrent::run(this, &JamendoService::ParseDirectory, gzip);
-  QFutureWatcher<void>* watcher = new QFutureWatcher<void>();
+  QFuture<void> future = ConcurrentRun::Run<void>(
+      &thread_pool_, bind(&JamendoService::ParseDirectory, this, gzip, stream));
+  QFutureWatcher<void>* watcher = new QFutureWatcher<void>(this);
   watcher->setFuture(future);
-  connect(watcher, SIGNAL(finished()), SLOT(ParseDirectoryFinished()));
+  NewClosure(watcher, SIGNAL(finished()), this,
+             SLOT(ParseDirectoryFinished(QFutureWatcher<void>*,
+                                         QNetworkReply*)),
+             watcher, reply);
 }
 
-void JamendoService::ParseDirectory(QIODevice* device) const {
+void JamendoService::ParseDirectory(QIODevice* device,
+                                    CatalogueStream* stream) const {
   int total_count = 0;
-
-  // Bit of a hack: don't update the model while we're parsing the xml
-  disconnect(library_backend_, SIGNAL(SongsDiscovered(SongList)),
-             library_model_, SLOT(SongsDiscovered(SongList)));
-  disconnect(library_backend_, SIGNAL(TotalSongCountUpdated(int)), this,
-             SLOT(UpdateTotalSongCount(int)));
-
-  // Delete the database and recreate it.  This is faster than dropping tables
-  // or removing rows.
-  library_backend_->db()->RecreateAttachedDb("jamendo");
+  int progress = -1;
+  bool started = false;
 
   TrackIdList track_ids;
   SongList songs;
@@ -255,7 +247,25 @@ void JamendoService::ParseDirectory(QIODevice* device) const {
     reader.readNext();
     if (reader.tokenType() == QXmlStreamReader::StartElement &&
         reader.name() == "artist") {
+      if (!started) {
+        // Only throw away the old catalogue once the new one has started
+        // arriving.  Delete the database and recreate it.  This is faster
+        // than dropping tables or removing rows.
+        library_backend_->db()->RecreateAttachedDb("jamendo");
+
+        // Don't update the model while we're parsing the xml
+        library_backend_->BeginBulkIngest();
+        started = true;
+      }
+
       songs << ReadArtist(&reader, &track_ids);
+
+      // Update progress info
+      if (stream->progress() != progress) {
+        progress = stream->progress();
+        app_->task_manager()->SetTaskProgress(load_database_task_id_, progress,
+                                              100);
+      }
     }
 
     if (songs.count() >= kBatchSize) {
@@ -267,21 +277,33 @@ void JamendoService::ParseDirectory(QIODevice* device) const {
       songs.clear();
       track_ids.clear();
 
-      // Update progress info
-      app_->task_manager()->SetTaskProgress(load_database_task_id_, total_count,
-                                            kApproxDatabaseSize);
+      // Fall back to counting songs if the size of the download isn't known
+      if (progress == -1) {
+        app_->task_manager()->SetTaskProgress(load_database_task_id_,
+                                              total_count, kApproxDatabaseSize);
+      }
     }
   }
 
+  const bool error = reader.hasError() || stream->has_error();
+  if (error) {
+    qLog(Warning) << "Error reading Jamendo catalogue" << reader.errorString();
+  }
+
+  if (!started) return;
+
+  if (error) {
+    // Don't keep half a catalogue.  The old one has been thrown away already,
+    // so the service is left empty until it's downloaded again.
+    library_backend_->db()->RecreateAttachedDb("jamendo");
+    library_backend_->AbortBulkIngest();
+    return;
+  }
+
   library_backend_->AddOrUpdateSongs(songs);
   InsertTrackIds(track_ids);
 
-  connect(library_backend_, SIGNAL(SongsDiscovered(SongList)), library_model_,
-          SLOT(SongsDiscovered(SongList)));
-  connect(library_backend_, SIGNAL(TotalSongCountUpdated(int)),
-          SLOT(UpdateTotalSongCount(int)));
-
-  library_backend_->UpdateTotalSongCount();
+  library_backend_->EndBulkIngest();
 }
 
 void JamendoService::InsertTrackIds(const TrackIdList& ids) const {
@@ -407,13 +429,13 @@ Song JamendoService::ReadTrack(const QString& artist, const QString& album,
   return song;
 }
 
-void JamendoService::ParseDirectoryFinished() {
-  QFutureWatcher<void>* watcher = static_cast<QFutureWatcher<void>*>(sender());
-  delete watcher;
+void JamendoService::ParseDirectoryFinished(QFutureWatcher<void>* watcher,
+                                            QNetworkReply* reply) {
+  watcher->deleteLater();
+  reply->deleteLater();
 
   // show smart playlists
   library_model_->set_show_smart_playlists(true);
-  library_model_->Reset();
 
   app_->task_manager()->SetTaskFinished(load_database_task_id_);
   load_database_task_id_ = 0;
@@ -24,10 +24,13 @@
 
 #include "internet/core/internetservice.h"
 
+#include <QFutureWatcher>
+#include <QThreadPool>
 #include <QXmlStreamReader>
 
 #include "core/song.h"
 
+class CatalogueStream;
 class LibraryBackend;
 class LibraryFilterWidget;
 class LibraryModel;
@@ -37,6 +40,7 @@ class SearchProvider;
 
 class QIODevice;
 class QMenu;
+class QNetworkReply;
 class QSortFilterProxyModel;
 
 class JamendoService : public InternetService {
@@ -75,7 +79,9 @@ class JamendoService : public InternetService {
   static const int kApproxDatabaseSize;
 
  private:
-  void ParseDirectory(QIODevice* device) const;
+  // Reads the songs from the catalogue and replaces the ones in the database
+  // with them.  Called on a worker thread while the catalogue downloads.
+  void ParseDirectory(QIODevice* device, CatalogueStream* stream) const;
 
   typedef QList<int> TrackIdList;
 
@@ -91,9 +97,8 @@ class JamendoService : public InternetService {
 
  private slots:
   void DownloadDirectory();
-  void DownloadDirectoryProgress(qint64 received, qint64 total);
-  void DownloadDirectoryFinished();
-  void ParseDirectoryFinished();
+  void ParseDirectoryFinished(QFutureWatcher<void>* watcher,
+                              QNetworkReply* reply);
   void UpdateTotalSongCount(int count);
 
   void AlbumInfo();
@@ -121,6 +126,10 @@ class JamendoService : public InternetService {
   int total_song_count_;
 
   bool accepted_download_;
+
+  // The catalogue is parsed here, so the slow parse doesn't hold up a thread
+  // in the global pool.
+  QThreadPool thread_pool_;
 };
 
 #endif  // INTERNET_JAMENDO_JAMENDOSERVICE_H_
@@ -30,6 +30,7 @@
 #include <QSortFilterProxyModel>
 #include <QMenu>
 #include <QDesktopServices>
+#include <QFutureWatcher>
 #include <QCoreApplication>
 #include <QSettings>
 
@@ -41,8 +42,11 @@
 #include "magnatunedownloaddialog.h"
 #include "magnatuneplaylistitem.h"
 #include "magnatuneurlhandler.h"
+#include "internet/core/cataloguestream.h"
 #include "internet/core/internetmodel.h"
 #include "core/application.h"
+#include "core/closure.h"
+#include "core/concurrentrun.h"
 #include "core/database.h"
 #include "core/logging.h"
 #include "core/mergedproxymodel.h"
@@ -59,10 +63,13 @@
 #include "ui/iconloader.h"
 #include "ui/settingsdialog.h"
 
+using std::bind;
+
 const char* MagnatuneService::kServiceName = "Magnatune";
 const char* MagnatuneService::kSettingsGroup = "Magnatune";
 const char* MagnatuneService::kSongsTable = "magnatune_songs";
 const char* MagnatuneService::kFtsTable = "magnatune_songs_fts";
+const int MagnatuneService::kBatchSize = 10000;
 
 const char* MagnatuneService::kHomepage = "http://magnatune.com";
 const char* MagnatuneService::kDatabaseUrl =
@@ -88,6 +95,8 @@ MagnatuneService::MagnatuneService(Application* app, InternetModel* parent)
       format_(Format_Ogg),
       total_song_count_(0),
       network_(new NetworkAccessManager(this)) {
+  thread_pool_.setMaxThreadCount(1);
+
   // Create the library backend in the database thread
   library_backend_ = new LibraryBackend;
   library_backend_->moveToThread(app_->database()->thread());
@@ -111,7 +120,15 @@ MagnatuneService::MagnatuneService(Application* app, InternetModel* parent)
       true, app_, this));
 }
 
-MagnatuneService::~MagnatuneService() { delete context_menu_; }
+MagnatuneService::~MagnatuneService() {
+  // thread_pool_ waits for the parser when it's destroyed, so stop it from
+  // waiting for more of the catalogue first.
+  for (CatalogueStream* stream : findChildren<CatalogueStream*>()) {
+    stream->Abort();
+  }
+
+  delete context_menu_;
+}
 
 void MagnatuneService::ReloadSettings() {
   QSettings s;
@@ -150,58 +167,109 @@ void MagnatuneService::UpdateTotalSongCount(int count) {
 }
 
 void MagnatuneService::ReloadDatabase() {
+  // The catalogue is already being loaded
+  if (load_database_task_id_) return;
+
   QNetworkRequest request = QNetworkRequest(QUrl(kDatabaseUrl));
   request.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
                        QNetworkRequest::AlwaysNetwork);
 
   QNetworkReply* reply = network_->get(request);
-  connect(reply, SIGNAL(finished()), SLOT(ReloadDatabaseFinished()));
-
-  if (!load_database_task_id_)
-    load_database_task_id_ =
-        app_->task_manager()->StartTask(tr("Downloading Magnatune catalogue"));
-}
-
-void MagnatuneService::ReloadDatabaseFinished() {
-  QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
-
-  app_->task_manager()->SetTaskFinished(load_database_task_id_);
-  load_database_task_id_ = 0;
-
-  if (reply->error() != QNetworkReply::NoError) {
-    // TODO(David Sansome): Error handling
-    qLog(Error) << reply->errorString();
-    return;
-  }
 
   if (root_->hasChildren()) root_->removeRows(0, root_->rowCount());
 
-  // The XML file is compressed
-  QtIOCompressor gzip(reply);
-  gzip.setStreamFormat(QtIOCompressor::GzipFormat);
-  if (!gzip.open(QIODevice::ReadOnly)) {
+  // The XML file is compressed.  It's decompressed, parsed and added to the
+  // database while it's still downloading.
+  CatalogueStream* stream = new CatalogueStream(reply, reply);
+  QtIOCompressor* gzip = new QtIOCompressor(stream);
+  gzip->setParent(stream);
+  gzip->setStreamFormat(QtIOCompressor::GzipFormat);
+  if (!gzip->open(QIODevice::ReadOnly)) {
     qLog(Warning) << "Error opening gzip stream";
+    reply->abort();
+    reply->deleteLater();
     return;
   }
 
-  // Remove all existing songs in the database
-  library_backend_->DeleteAll();
+  load_database_task_id_ =
+      app_->task_manager()->StartTask(tr("Loading Magnatune catalogue"));
+
+  QFuture<void> future = ConcurrentRun::Run<void>(
+      &thread_pool_,
+      bind(&MagnatuneService::ParseDatabase, this, gzip, stream));
+  QFutureWatcher<void>* watcher = new QFutureWatcher<void>(this);
+  watcher->setFuture(future);
+  NewClosure(watcher, SIGNAL(finished()), this,
+             SLOT(ParseDatabaseFinished(QFutureWatcher<void>*,
+                                        QNetworkReply*)),
+             watcher, reply);
+}
+
+void MagnatuneService::ParseDatabase(QIODevice* device,
+                                     CatalogueStream* stream) {
+  int progress = -1;
+  bool started = false;
 
   // Parse the XML we got from Magnatune
-  QXmlStreamReader reader(&gzip);
+  QXmlStreamReader reader(device);
   SongList songs;
   while (!reader.atEnd()) {
     reader.readNext();
 
     if (reader.tokenType() == QXmlStreamReader::StartElement &&
         reader.name() == "Track") {
+      if (!started) {
+        // Remove all existing songs in the database, but only once the new
+        // catalogue has started arriving.
+        library_backend_->DeleteAll();
+        library_backend_->BeginBulkIngest();
+        started = true;
+      }
+
       songs << ReadTrack(reader);
+
+      if (stream->progress() != progress) {
+        progress = stream->progress();
+        app_->task_manager()->SetTaskProgress(load_database_task_id_, progress,
+                                              100);
+      }
     }
+
+    if (songs.count() >= kBatchSize) {
+      // Add the songs to the database in batches
+      library_backend_->AddOrUpdateSongs(songs);
+      songs.clear();
+    }
+  }
+
+  const bool error = reader.hasError() || stream->has_error();
+  if (error) {
+    qLog(Warning) << "Error reading Magnatune catalogue"
+                  << reader.errorString();
   }
 
-  // Add the songs to the database
+  if (!started) return;
+
+  if (error) {
+    // Don't keep half a catalogue.  The old one has been deleted already, so
+    // the service is left empty until it's downloaded again.
+    library_backend_->AbortBulkIngest();
+    return;
+  }
+
+  // Add the rest of the songs to the database.  The model is reset when it's
+  // done.
   library_backend_->AddOrUpdateSongs(songs);
-  library_model_->Reset();
+  library_backend_->EndBulkIngest();
+}
+
+void MagnatuneService::ParseDatabaseFinished(QFutureWatcher<void>* watcher,
+                                             QNetworkReply* reply) {
+  watcher->deleteLater();
+  reply->deleteLater();
+
+  app_->task_manager()->SetTaskFinished(load_database_task_id_);
+  load_database_task_id_ = 0;
 }
 
 Song MagnatuneService::ReadTrack(QXmlStreamReader& reader) {
@@ -20,14 +20,19 @@
 #ifndef INTERNET_MAGNATUNE_MAGNATUNESERVICE_H_
 #define INTERNET_MAGNATUNE_MAGNATUNESERVICE_H_
 
+#include <QFutureWatcher>
+#include <QThreadPool>
 #include <QXmlStreamReader>
 
 #include "internet/core/internetservice.h"
 
+class QIODevice;
 class QNetworkAccessManager;
+class QNetworkReply;
 class QSortFilterProxyModel;
 class QMenu;
 
+class CatalogueStream;
 class LibraryBackend;
 class LibraryModel;
 class MagnatuneUrlHandler;
@@ -62,6 +67,8 @@ class MagnatuneService : public InternetService {
   static const char* kDatabaseUrl;
   static const char* kSongsTable;
   static const char* kFtsTable;
+  // The catalogue is added to the database this many songs at a time.
+  static const int kBatchSize;
   static const char* kHomepage;
   static const char* kStreamingHostname;
   static const char* kDownloadHostname;
@@ -94,7 +101,8 @@ class MagnatuneService : public InternetService {
  private slots:
   void UpdateTotalSongCount(int count);
   void ReloadDatabase();
-  void ReloadDatabaseFinished();
+  void ParseDatabaseFinished(QFutureWatcher<void>* watcher,
+                             QNetworkReply* reply);
 
   void Download();
   void Homepage();
@@ -103,6 +111,9 @@ class MagnatuneService : public InternetService {
  private:
   void EnsureMenuCreated();
 
+  // Runs on a worker thread, parsing the catalogue as it downloads and adding
+  // its tracks to the database in batches.
+  void ParseDatabase(QIODevice* device, CatalogueStream* stream);
   Song ReadTrack(QXmlStreamReader& reader);
 
  private:
@@ -127,6 +138,10 @@ class MagnatuneService : public InternetService {
   int total_song_count_;
 
   QNetworkAccessManager* network_;
+
+  // The catalogue is parsed here, so the slow parse doesn't hold up a thread
+  // in the global pool.
+  QThreadPool thread_pool_;
 };
 
 #endif  // INTERNET_MAGNATUNE_MAGNATUNESERVICE_H_
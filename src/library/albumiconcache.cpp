@@ -0,0 +1,109 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "albumiconcache.h"
+
+#include <cstring>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+
+#include "core/cachefiles.h"
+#include "core/logging.h"
+#include "core/utilities.h"
+
+namespace {
+
+struct AlbumIconHeader {
+  quint32 magic;
+  quint16 width;
+  quint16 height;
+};
+const quint32 kAlbumIconMagic = 0x434c4149;  // "CLAI"
+
+}  // namespace
+
+AlbumIconCache::AlbumIconCache(const QString& path) : path_(path) {}
+
+QString AlbumIconCache::Filename(const QString& cache_key) const {
+  return path_ + "/" +
+         QCryptographicHash::hash(cache_key.toUtf8(), QCryptographicHash::Sha1)
+             .toHex();
+}
+
+QImage AlbumIconCache::Load(const QString& cache_key) const {
+  QFile file(Filename(cache_key));
+  if (!file.open(QIODevice::ReadOnly)) return QImage();
+
+  const QByteArray data = file.readAll();
+  if (data.size() < int(sizeof(AlbumIconHeader))) return QImage();
+
+  AlbumIconHeader header;
+  memcpy(&header, data.constData(), sizeof(header));
+  const int bytes_per_line = header.width * 4;
+  if (header.magic != kAlbumIconMagic ||
+      data.size() != int(sizeof(header)) + bytes_per_line * header.height) {
+    return QImage();
+  }
+
+  QImage image(header.width, header.height,
+               QImage::Format_ARGB32_Premultiplied);
+  const char* pixels = data.constData() + sizeof(header);
+  for (int y = 0; y < header.height; ++y) {
+    memcpy(image.scanLine(y), pixels + y * bytes_per_line, bytes_per_line);
+  }
+  return image;
+}
+
+void AlbumIconCache::Save(const QString& cache_key,
+                          const QImage& image) const {
+  const QImage icon =
+      image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+  AlbumIconHeader header;
+  header.magic = kAlbumIconMagic;
+  header.width = icon.width();
+  header.height = icon.height();
+  const int bytes_per_line = header.width * 4;
+
+  CacheFiles::Save(Filename(cache_key), [&](QIODevice* file) {
+    const qint64 header_size = sizeof(header);
+    if (file->write(reinterpret_cast<const char*>(&header), header_size) !=
+        header_size) {
+      return false;
+    }
+    for (int y = 0; y < header.height; ++y) {
+      if (file->write(reinterpret_cast<const char*>(icon.constScanLine(y)),
+                      bytes_per_line) != bytes_per_line) {
+        return false;
+      }
+    }
+    return true;
+  });
+}
+
+void AlbumIconCache::Prepare(const QString& old_path, qint64 max_size) const {
+  if (!old_path.isEmpty() && QFile::exists(old_path)) {
+    qLog(Info) << "Removing the old album icon cache" << old_path;
+    Utilities::RemoveRecursive(old_path);
+  }
+
+  QDir().mkpath(path_);
+
+  CacheFiles::Trim(path_, max_size);
+}
@@ -0,0 +1,48 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARY_ALBUMICONCACHE_H_
+#define LIBRARY_ALBUMICONCACHE_H_
+
+#include <QImage>
+#include <QString>
+
+// The album icons shown in the library, kept on disk one file per album.
+// Each file is a small header followed by the pixels of a
+// QImage::Format_ARGB32_Premultiplied image, so loading one is just a read and
+// a copy.  Copies of this class can be used from any thread.
+class AlbumIconCache {
+ public:
+  explicit AlbumIconCache(const QString& path);
+
+  const QString& path() const { return path_; }
+  QString Filename(const QString& cache_key) const;
+
+  // Returns a null image if the icon isn't cached.
+  QImage Load(const QString& cache_key) const;
+  void Save(const QString& cache_key, const QImage& image) const;
+
+  // Creates the directory and deletes the least recently written icons until
+  // the cache is smaller than max_size.  Also deletes old_path, where a
+  // QNetworkDiskCache used to keep the icons, if it's still there.
+  void Prepare(const QString& old_path, qint64 max_size) const;
+
+ private:
+  QString path_;
+};
+
+#endif  // LIBRARY_ALBUMICONCACHE_H_
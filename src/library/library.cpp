@@ -48,6 +48,7 @@ Library::Library(Application* app, QObject* parent)
 
   backend_->Init(app->database(), kSongsTable, kDirsTable, kSubdirsTable,
                  kFtsTable);
+  backend_->set_track_dirty_albums(true);
 
   using smart_playlists::Generator;
   using smart_playlists::GeneratorPtr;
@@ -159,6 +160,10 @@ void Library::Init() {
           SLOT(AddOrUpdateSubdirs(SubdirectoryList)));
   connect(watcher_, SIGNAL(CompilationsNeedUpdating()), backend_,
           SLOT(UpdateCompilations()));
+  connect(watcher_, SIGNAL(NewDirectoryScanStarted()), backend_,
+          SLOT(BeginBulkIngest()));
+  connect(watcher_, SIGNAL(NewDirectoryScanFinished()), backend_,
+          SLOT(EndBulkIngest()));
   connect(app_->playlist_manager(), SIGNAL(CurrentSongChanged(Song)),
           SLOT(CurrentSongChanged(Song)));
   connect(app_->player(), SIGNAL(Stopped()), SLOT(Stopped()));
@@ -16,11 +16,15 @@
 */
 
 #include "librarybackend.h"
+
+#include <limits>
+
 #include "libraryquery.h"
 #include "sqlrow.h"
 #include "core/application.h"
 #include "core/database.h"
 #include "core/scopedtransaction.h"
+#include "core/sqlitequery.h"
 #include "core/tagreaderclient.h"
 #include "core/utilities.h"
 #include "smartplaylists/search.h"
@@ -29,11 +33,14 @@
 #include <QDateTime>
 #include <QDir>
 #include <QFileInfo>
+#include <QHash>
 #include <QSettings>
 #include <QVariant>
 #include <QtDebug>
 
 const char* LibraryBackend::kSettingsGroup = "LibraryBackend";
+const int LibraryBackend::kUrlsPerQuery = 500;
+const int LibraryBackend::kMaxBindValuesPerQuery = 999;
 
 const char* LibraryBackend::kNewScoreSql =
     "case when playcount <= 0 then (%1 * 100 + score) / 2"
@@ -44,7 +51,12 @@ const char* LibraryBackend::kNewScoreSql =
 LibraryBackend::LibraryBackend(QObject* parent)
     : LibraryBackendInterface(parent),
       save_statistics_in_file_(false),
-      save_ratings_in_file_(false) {}
+      save_ratings_in_file_(false),
+      track_dirty_albums_(false),
+      compilations_updated_(false),
+      bulk_ingest_(false),
+      bulk_ingest_first_id_(-1),
+      bulk_ingest_changed_(false) {}
 
 void LibraryBackend::Init(Database* db, const QString& songs_table,
                           const QString& dirs_table,
@@ -151,8 +163,8 @@ void LibraryBackend::ChangeDirPath(int id, const QString& old_path,
 }
 
 DirectoryList LibraryBackend::GetAllDirectories() {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   DirectoryList ret;
 
@@ -171,8 +183,8 @@ DirectoryList LibraryBackend::GetAllDirectories() {
 }
 
 SubdirectoryList LibraryBackend::SubdirsInDirectory(int id) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db = db_->Connect();
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db = db_->ConnectReadOnly();
   return SubdirsInDirectory(id, db);
 }
 
@@ -198,8 +210,8 @@ SubdirectoryList LibraryBackend::SubdirsInDirectory(int id, QSqlDatabase& db) {
 }
 
 void LibraryBackend::UpdateTotalSongCount() {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QSqlQuery q(QString("SELECT COUNT(*) FROM %1 WHERE unavailable = 0")
                   .arg(songs_table_),
@@ -269,8 +281,8 @@ void LibraryBackend::RemoveDirectory(const Directory& dir) {
 }
 
 SongList LibraryBackend::FindSongsInDirectory(int id) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QSqlQuery q(
       QString("SELECT ROWID, " + Song::kColumnSpec +
@@ -349,86 +361,87 @@ void LibraryBackend::AddOrUpdateSongs(const SongList& songs) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery check_dir(
-      QString("SELECT ROWID FROM %1 WHERE ROWID = :id").arg(dirs_table_), db);
-  QSqlQuery add_song(QString("INSERT INTO %1 (" + Song::kColumnSpec +
-                             ")"
-                             " VALUES (" +
-                             Song::kBindSpec + ")").arg(songs_table_),
-                     db);
   QSqlQuery update_song(QString("UPDATE %1 SET " + Song::kUpdateSpec +
                                 " WHERE ROWID = :id").arg(songs_table_),
                         db);
-  QSqlQuery add_song_fts(
-      QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec +
-              ")"
-              " VALUES (:id, " +
-              Song::kFtsBindSpec + ")").arg(fts_table_),
-      db);
   QSqlQuery update_song_fts(QString("UPDATE %1 SET " + Song::kFtsUpdateSpec +
                                     " WHERE ROWID = :id").arg(fts_table_),
                             db);
 
   ScopedTransaction transaction(&db);
 
-  SongList added_songs;
-  SongList deleted_songs;
+  // Do a sanity check first - make sure each song's directory still exists.
+  // This is to fix a possible race condition when a directory is removed
+  // while LibraryWatcher is scanning it.  The directories are read once
+  // here rather than looked up for every song.
+  QSet<int> directory_ids;
+  if (!dirs_table_.isEmpty()) {
+    QSqlQuery q(QString("SELECT ROWID FROM %1").arg(dirs_table_), db);
+    q.exec();
+    if (db_->CheckErrors(q)) return;
+    while (q.next()) {
+      directory_ids.insert(q.value(0).toInt());
+    }
+  }
 
+  SongList new_songs;
+  QStringList updated_ids;
   for (const Song& song : songs) {
-    // Do a sanity check first - make sure the song's directory still exists
-    // This is to fix a possible race condition when a directory is removed
-    // while LibraryWatcher is scanning it.
-    if (!dirs_table_.isEmpty()) {
-      check_dir.bindValue(":id", song.directory_id());
-      check_dir.exec();
-      if (db_->CheckErrors(check_dir)) continue;
-
-      if (!check_dir.next()) continue;  // Directory didn't exist
+    if (!dirs_table_.isEmpty() && !directory_ids.contains(song.directory_id()))
+      continue;  // Directory didn't exist
+
+    if (song.id() == -1)
+      new_songs << song;
+    else
+      updated_ids << QString::number(song.id());
+  }
+
+  // Get the previous song data of all the updated songs in one go
+  QHash<int, Song> old_songs;
+  if (!updated_ids.isEmpty()) {
+    for (const Song& old_song : GetSongsById(updated_ids, db)) {
+      old_songs[old_song.id()] = old_song;
     }
+  }
 
-    if (song.id() == -1) {
-      // Create
+  SongList added_songs;
+  SongList deleted_songs;
 
-      // Insert the row and create a new ID
-      song.BindToQuery(&add_song);
-      add_song.exec();
-      if (db_->CheckErrors(add_song)) continue;
+  for (const Song& song : songs) {
+    if (song.id() == -1) continue;
 
-      // Get the new ID
-      const int id = add_song.lastInsertId().toInt();
+    const Song old_song = old_songs.value(song.id());
+    if (!old_song.is_valid()) continue;
 
-      // Add to the FTS index
-      add_song_fts.bindValue(":id", id);
-      song.BindToFtsQuery(&add_song_fts);
-      add_song_fts.exec();
-      if (db_->CheckErrors(add_song_fts)) continue;
+    // Update
+    song.BindToQuery(&update_song);
+    update_song.bindValue(":id", song.id());
+    update_song.exec();
+    if (db_->CheckErrors(update_song)) continue;
 
-      Song copy(song);
-      copy.set_id(id);
-      added_songs << copy;
-    } else {
-      // Get the previous song data first
-      Song old_song(GetSongById(song.id()));
-      if (!old_song.is_valid()) continue;
-
-      // Update
-      song.BindToQuery(&update_song);
-      update_song.bindValue(":id", song.id());
-      update_song.exec();
-      if (db_->CheckErrors(update_song)) continue;
-
-      song.BindToFtsQuery(&update_song_fts);
-      update_song_fts.bindValue(":id", song.id());
-      update_song_fts.exec();
-      if (db_->CheckErrors(update_song_fts)) continue;
-
-      deleted_songs << old_song;
-      added_songs << song;
-    }
+    song.BindToFtsQuery(&update_song_fts);
+    update_song_fts.bindValue(":id", song.id());
+    update_song_fts.exec();
+    if (db_->CheckErrors(update_song_fts)) continue;
+
+    deleted_songs << old_song;
+    added_songs << song;
+    AddDirtyCompilationAlbums(SongList() << old_song << song);
   }
 
+  // Create
+  const SongList inserted_songs = InsertSongs(new_songs, db);
+  added_songs << inserted_songs;
+  AddDirtyCompilationAlbums(inserted_songs);
+
   transaction.Commit();
 
+  if (bulk_ingest_) {
+    // Everything is announced at once in EndBulkIngest()
+    bulk_ingest_changed_ |= !added_songs.isEmpty();
+    return;
+  }
+
   if (!deleted_songs.isEmpty()) emit SongsDeleted(deleted_songs);
 
   if (!added_songs.isEmpty()) emit SongsDiscovered(added_songs);
@@ -436,6 +449,127 @@ void LibraryBackend::AddOrUpdateSongs(const SongList& songs) {
   UpdateTotalSongCountAsync();
 }
 
+SongList LibraryBackend::InsertSongs(const SongList& songs, QSqlDatabase& db) {
+  SongList ret;
+
+  const int column_count = Song::kColumns.count();
+  const int max_rows = qMax(1, kMaxBindValuesPerQuery / column_count);
+
+  const QString row_placeholders =
+      "(" + QString("?, ").repeated(column_count - 1) + "?)";
+
+  // The statement for a full batch of songs is prepared once and reused.  The
+  // last batch usually has fewer songs and gets its own statement.
+  QSqlQuery insert(db);
+  int prepared_rows = 0;
+
+  for (int first = 0; first < songs.count(); first += max_rows) {
+    const int rows = qMin(max_rows, songs.count() - first);
+
+    if (rows != prepared_rows) {
+      QStringList values;
+      for (int i = 0; i < rows; ++i) values << row_placeholders;
+
+      insert.prepare(QString("INSERT INTO %1 (" + Song::kColumnSpec +
+                             ") VALUES " + values.join(", "))
+                         .arg(songs_table_));
+      prepared_rows = rows;
+    }
+
+    for (int i = 0; i < rows; ++i) {
+      songs[first + i].BindToQuery(&insert, i * column_count);
+    }
+    insert.exec();
+    if (db_->CheckErrors(insert)) continue;
+
+    // sqlite gives the rows of one INSERT consecutive IDs, so the ID of each
+    // song can be worked out from the last one.
+    const int last_id = insert.lastInsertId().toInt();
+    const int first_id = last_id - rows + 1;
+
+    if (bulk_ingest_) {
+      if (bulk_ingest_first_id_ == -1) bulk_ingest_first_id_ = first_id;
+    } else if (!InsertSongsFts(first_id, last_id, db)) {
+      continue;
+    }
+
+    for (int i = 0; i < rows; ++i) {
+      Song copy(songs[first + i]);
+      copy.set_id(first_id + i);
+      ret << copy;
+    }
+  }
+
+  return ret;
+}
+
+bool LibraryBackend::InsertSongsFts(int first_id, int last_id,
+                                    QSqlDatabase& db) {
+  // The columns of the songs table that go into each of Song::kFtsColumns.
+  QSqlQuery q(
+      QString(
+          "INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec +
+          ")"
+          " SELECT ROWID, title, album, artist, albumartist, composer,"
+          "        performer, grouping, genre, comment"
+          " FROM %2 WHERE ROWID BETWEEN :first AND :last")
+          .arg(fts_table_, songs_table_),
+      db);
+  q.bindValue(":first", first_id);
+  q.bindValue(":last", last_id);
+  q.exec();
+  return !db_->CheckErrors(q);
+}
+
+void LibraryBackend::BeginBulkIngest() {
+  QMutexLocker l(db_->Mutex());
+
+  bulk_ingest_ = true;
+  bulk_ingest_first_id_ = -1;
+  bulk_ingest_changed_ = false;
+}
+
+void LibraryBackend::EndBulkIngest() { FinishBulkIngest(true); }
+
+void LibraryBackend::AbortBulkIngest() { FinishBulkIngest(false); }
+
+void LibraryBackend::FinishBulkIngest(bool keep_songs) {
+  bool changed = false;
+
+  {
+    QMutexLocker l(db_->Mutex());
+    QSqlDatabase db(db_->Connect());
+
+    // Each new song gets a higher ID than the songs already there, so the
+    // songs added since BeginBulkIngest() are all the songs from the first
+    // one onwards.
+    if (bulk_ingest_first_id_ != -1 && keep_songs) {
+      ScopedTransaction transaction(&db);
+      if (InsertSongsFts(bulk_ingest_first_id_,
+                         std::numeric_limits<int>::max(), db)) {
+        transaction.Commit();
+      }
+    } else if (bulk_ingest_first_id_ != -1) {
+      // None of them are in the FTS index yet.
+      QSqlQuery q(QString("DELETE FROM %1 WHERE ROWID >= :first_id")
+                      .arg(songs_table_),
+                  db);
+      q.bindValue(":first_id", bulk_ingest_first_id_);
+      q.exec();
+      db_->CheckErrors(q);
+    }
+
+    changed = bulk_ingest_changed_;
+    bulk_ingest_ = false;
+    bulk_ingest_first_id_ = -1;
+    bulk_ingest_changed_ = false;
+  }
+
+  if (changed) emit DatabaseReset();
+
+  UpdateTotalSongCountAsync();
+}
+
 void LibraryBackend::UpdateMTimesOnly(const SongList& songs) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
@@ -475,6 +609,8 @@ void LibraryBackend::DeleteSongs(const SongList& songs) {
   }
   transaction.Commit();
 
+  AddDirtyCompilationAlbums(songs);
+
   emit SongsDeleted(songs);
 
   UpdateTotalSongCountAsync();
@@ -498,6 +634,8 @@ void LibraryBackend::MarkSongsUnavailable(const SongList& songs,
   }
   transaction.Commit();
 
+  AddDirtyCompilationAlbums(songs);
+
   emit SongsDeleted(songs);
   UpdateTotalSongCountAsync();
 }
@@ -508,7 +646,7 @@ QStringList LibraryBackend::GetAll(const QString& column,
   query.SetColumnSpec("DISTINCT " + column);
   query.AddCompilationRequirement(false);
 
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(db_->ReadMutex());
   if (!ExecQuery(&query)) return QStringList();
 
   QStringList ret;
@@ -528,7 +666,7 @@ QStringList LibraryBackend::GetAllArtistsWithAlbums(const QueryOptions& opt) {
   query.AddCompilationRequirement(false);
   query.AddWhere("album", "", "!=");
 
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(db_->ReadMutex());
   if (!ExecQuery(&query)) return QStringList();
 
   QStringList ret;
@@ -567,7 +705,7 @@ SongList LibraryBackend::GetSongs(const QString& artist, const QString& album,
 
 SongList LibraryBackend::ExecLibraryQuery(LibraryQuery* query) {
   query->SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(db_->ReadMutex());
   if (!ExecQuery(query)) return SongList();
 
   SongList ret;
@@ -580,14 +718,14 @@ SongList LibraryBackend::ExecLibraryQuery(LibraryQuery* query) {
 }
 
 Song LibraryBackend::GetSongById(int id) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
   return GetSongById(id, db);
 }
 
 SongList LibraryBackend::GetSongsById(const QList<int>& ids) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QStringList str_ids;
   for (int id : ids) {
@@ -598,8 +736,8 @@ SongList LibraryBackend::GetSongsById(const QList<int>& ids) {
 }
 
 SongList LibraryBackend::GetSongsById(const QStringList& ids) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   return GetSongsById(ids, db);
 }
@@ -607,8 +745,8 @@ SongList LibraryBackend::GetSongsById(const QStringList& ids) {
 SongList LibraryBackend::GetSongsByForeignId(const QStringList& ids,
                                              const QString& table,
                                              const QString& column) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QString in = ids.join(",");
 
@@ -673,6 +811,32 @@ Song LibraryBackend::GetSongByUrl(const QUrl& url, qint64 beginning) {
   return song;
 }
 
+SongList LibraryBackend::GetSongsByUrls(const QList<QUrl>& urls) {
+  SongList songlist;
+
+  // SQLite limits the number of bound values in one query.
+  for (int i = 0; i < urls.count(); i += kUrlsPerQuery) {
+    QVariantList filenames;
+    for (const QUrl& url : urls.mid(i, kUrlsPerQuery)) {
+      filenames << url.toEncoded();
+    }
+
+    LibraryQuery query;
+    query.SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
+    query.AddWhere("filename", filenames, "IN");
+
+    if (ExecQuery(&query)) {
+      while (query.Next()) {
+        Song song;
+        song.InitFromQuery(query, true);
+
+        songlist << song;
+      }
+    }
+  }
+  return songlist;
+}
+
 SongList LibraryBackend::GetSongsByUrl(const QUrl& url) {
   LibraryQuery query;
   query.SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
@@ -702,7 +866,7 @@ SongList LibraryBackend::GetCompilationSongs(const QString& album,
   query.AddCompilationRequirement(true);
   query.AddWhere("album", album);
 
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(db_->ReadMutex());
   if (!ExecQuery(&query)) return SongList();
 
   SongList ret;
@@ -714,43 +878,85 @@ SongList LibraryBackend::GetCompilationSongs(const QString& album,
   return ret;
 }
 
+void LibraryBackend::AddDirtyCompilationAlbums(const SongList& songs) {
+  if (!track_dirty_albums_) return;
+
+  for (const Song& song : songs) {
+    // Songs that don't have an album field set are never compilations
+    if (!song.album().isEmpty()) dirty_compilation_albums_.insert(song.album());
+  }
+}
+
+void LibraryBackend::AddCompilationInfo(const QSqlQuery& q,
+                                        const QString& album,
+                                        QMap<QString, CompilationInfo>* info) {
+  // Ignore songs that don't have an album field set
+  if (album.isEmpty()) return;
+
+  QString artist = q.value(0).toString();
+  QString filename = q.value(1).toString();
+  bool sampler = q.value(2).toBool();
+
+  // Find the directory the song is in
+  int last_separator = filename.lastIndexOf('/');
+  if (last_separator == -1) return;
+
+  CompilationInfo& album_info = (*info)[album];
+  album_info.artists.insert(artist);
+  album_info.directories.insert(filename.left(last_separator));
+  if (sampler)
+    album_info.has_samplers = true;
+  else
+    album_info.has_not_samplers = true;
+}
+
 void LibraryBackend::UpdateCompilations() {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
+  // Only albums that have changed since last time need to be looked at again.
+  // Nothing is known about changes made before the backend was created, so
+  // the first time every album is looked at.
+  const bool all_albums = !track_dirty_albums_ || !compilations_updated_;
+  const QSet<QString> albums = dirty_compilation_albums_;
+  dirty_compilation_albums_.clear();
+  if (!all_albums && albums.isEmpty()) return;
+
   // Look for albums that have songs by more than one 'effective album artist'
   // in the same
   // directory
 
-  QSqlQuery q(
-      QString(
-          "SELECT effective_albumartist, album, filename, sampler "
-          "FROM %1 WHERE unavailable = 0 ORDER BY album").arg(songs_table_),
-      db);
-  q.exec();
-  if (db_->CheckErrors(q)) return;
-
   QMap<QString, CompilationInfo> compilation_info;
-  while (q.next()) {
-    QString artist = q.value(0).toString();
-    QString album = q.value(1).toString();
-    QString filename = q.value(2).toString();
-    bool sampler = q.value(3).toBool();
-
-    // Ignore songs that don't have an album field set
-    if (album.isEmpty()) continue;
-
-    // Find the directory the song is in
-    int last_separator = filename.lastIndexOf('/');
-    if (last_separator == -1) continue;
-
-    CompilationInfo& info = compilation_info[album];
-    info.artists.insert(artist);
-    info.directories.insert(filename.left(last_separator));
-    if (sampler)
-      info.has_samplers = true;
-    else
-      info.has_not_samplers = true;
+  if (all_albums) {
+    QSqlQuery q(
+        QString(
+            "SELECT effective_albumartist, filename, sampler, album "
+            "FROM %1 WHERE unavailable = 0").arg(songs_table_),
+        db);
+    q.exec();
+    if (db_->CheckErrors(q)) return;
+
+    while (q.next()) {
+      AddCompilationInfo(q, q.value(3).toString(), &compilation_info);
+    }
+    compilations_updated_ = true;
+  } else {
+    QSqlQuery q(
+        QString(
+            "SELECT effective_albumartist, filename, sampler "
+            "FROM %1 WHERE album = :album AND unavailable = 0")
+            .arg(songs_table_),
+        db);
+
+    for (const QString& album : albums) {
+      q.bindValue(":album", album);
+      q.exec();
+      if (db_->CheckErrors(q)) return;
+
+      while (q.next()) {
+        AddCompilationInfo(q, album, &compilation_info);
+      }
+    }
   }
 
   // Now mark the songs that we think are in compilations
@@ -847,7 +1053,7 @@ LibraryBackend::AlbumList LibraryBackend::GetAlbums(const QString& artist,
     query.AddWhere("artist", artist);
   }
 
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(db_->ReadMutex());
   if (!ExecQuery(&query)) return ret;
 
   QString last_album;
@@ -884,7 +1090,7 @@ LibraryBackend::Album LibraryBackend::GetAlbumArt(const QString& artist,
   query.AddWhere("artist", artist);
   query.AddWhere("album", album);
 
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(db_->ReadMutex());
   if (!ExecQuery(&query)) return ret;
 
   if (query.Next()) {
@@ -1013,31 +1219,54 @@ void LibraryBackend::ForceCompilation(const QString& album,
 }
 
 bool LibraryBackend::ExecQuery(LibraryQuery* q) {
-  return !db_->CheckErrors(q->Exec(db_->Connect(), songs_table_, fts_table_));
+  return !db_->CheckErrors(
+      q->Exec(db_->ConnectReadOnly(), songs_table_, fts_table_));
+}
+
+bool LibraryBackend::ExecQueries(const QList<LibraryQuery>& queries,
+                                 QSqlQuery* result) {
+  *result = LibraryQuery::ExecUnion(queries, db_->ConnectReadOnly(),
+                                    songs_table_, fts_table_);
+  return !db_->CheckErrors(*result);
 }
 
 SongList LibraryBackend::FindSongs(const smart_playlists::Search& search) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   // Build the query
   QString sql = search.ToSql(songs_table());
 
-  // Run the query
+  // Run the query.  This can return the whole library, so read the rows
+  // straight out of sqlite.
   SongList ret;
-  QSqlQuery query(sql, db);
-  query.exec();
-  if (db_->CheckErrors(query)) return ret;
+  SqliteQuery query(db, sql);
+  if (!query.Exec()) return ret;
 
   // Read the results
-  while (query.next()) {
+  while (query.Next()) {
     Song song;
-    song.InitFromQuery(query, true);
+    song.InitFromQuery(query.row(), true);
     ret << song;
   }
   return ret;
 }
 
+QList<int> LibraryBackend::FindSongIds(
+    const smart_playlists::Search& search) {
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
+
+  QList<int> ret;
+  SqliteQuery query(db, search.ToIdSql(songs_table()));
+  if (!query.Exec()) return ret;
+
+  while (query.Next()) {
+    ret << query.row().ToInt(0);
+  }
+  return ret;
+}
+
 SongList LibraryBackend::GetAllSongs() {
   // Get all the songs!
   return FindSongs(smart_playlists::Search(
@@ -18,6 +18,7 @@
 #ifndef LIBRARYBACKEND_H
 #define LIBRARYBACKEND_H
 
+#include <QMap>
 #include <QObject>
 #include <QSet>
 #include <QUrl>
@@ -108,6 +109,8 @@ class LibraryBackendInterface : public QObject {
   // Using default beginning value is suitable when searching for single-section
   // songs.
   virtual Song GetSongByUrl(const QUrl& url, qint64 beginning = 0) = 0;
+  // Returns all sections of all the songs with any of the given filenames.
+  virtual SongList GetSongsByUrls(const QList<QUrl>& urls) = 0;
 
   virtual void AddDirectory(const QString& path) = 0;
   virtual void RemoveDirectory(const Directory& dir) = 0;
@@ -121,10 +124,23 @@ class LibraryBackend : public LibraryBackendInterface {
  public:
   static const char* kSettingsGroup;
 
+  // GetSongsByUrls looks up this many URLs in each query.
+  static const int kUrlsPerQuery;
+
+  // The most values sqlite lets us bind to one statement.  AddOrUpdateSongs
+  // inserts as many songs as fit in this with each INSERT.
+  static const int kMaxBindValuesPerQuery;
+
   Q_INVOKABLE LibraryBackend(QObject* parent = nullptr);
   void Init(Database* db, const QString& songs_table, const QString& dirs_table,
             const QString& subdirs_table, const QString& fts_table);
 
+  // Makes UpdateCompilations() only look at the albums that have had songs
+  // added, changed or removed since it last ran, instead of every album.  The
+  // first UpdateCompilations() still looks at every album.  Must be called
+  // before the backend is used.
+  void set_track_dirty_albums(bool track) { track_dirty_albums_ = track; }
+
   Database* db() const { return db_; }
 
   QString songs_table() const { return songs_table_; }
@@ -171,13 +187,19 @@ class LibraryBackend : public LibraryBackendInterface {
 
   SongList GetSongsByUrl(const QUrl& url);
   Song GetSongByUrl(const QUrl& url, qint64 beginning = 0);
+  SongList GetSongsByUrls(const QList<QUrl>& urls);
 
   void AddDirectory(const QString& path);
   void RemoveDirectory(const Directory& dir);
 
   bool ExecQuery(LibraryQuery* q);
+  // Runs the queries as one statement - see LibraryQuery::ExecUnion.
+  bool ExecQueries(const QList<LibraryQuery>& queries, QSqlQuery* result);
   SongList ExecLibraryQuery(LibraryQuery* query);
   SongList FindSongs(const smart_playlists::Search& search);
+  // Returns the ROWIDs of all the songs matching the search, in no particular
+  // order.
+  QList<int> FindSongIds(const smart_playlists::Search& search);
   SongList GetAllSongs();
 
   void IncrementPlayCountAsync(int id);
@@ -189,6 +211,20 @@ class LibraryBackend : public LibraryBackendInterface {
   void DeleteAll();
 
  public slots:
+  // Puts the backend into bulk ingest mode, for loading lots of new songs at
+  // once like a first scan or an internet service's catalogue.  Until
+  // EndBulkIngest() is called, songs added with AddOrUpdateSongs() aren't
+  // added to the FTS index, and no SongsDiscovered, SongsDeleted or
+  // TotalSongCountUpdated signals are emitted for them.  EndBulkIngest() then
+  // indexes all the new songs in one go and emits DatabaseReset() once, so
+  // views reload everything.
+  void BeginBulkIngest();
+  void EndBulkIngest();
+  // Ends bulk ingest mode by deleting the songs added since BeginBulkIngest()
+  // instead of indexing them, for when a load fails part way through.  Songs
+  // that were updated rather than added keep their changes.
+  void AbortBulkIngest();
+
   void LoadDirectories();
   void UpdateTotalSongCount();
   void AddOrUpdateSongs(const SongList& songs);
@@ -233,6 +269,24 @@ signals:
 
   static const char* kNewScoreSql;
 
+  // Remembers the albums of these songs so the next UpdateCompilations()
+  // looks at them again.  Must be called with the database mutex held.
+  void AddDirtyCompilationAlbums(const SongList& songs);
+  // Adds the song in the current row of the query to the album's info.  The
+  // query returns effective_albumartist, filename and sampler.
+  static void AddCompilationInfo(const QSqlQuery& q, const QString& album,
+                                 QMap<QString, CompilationInfo>* info);
+
+  // Inserts the songs with as few INSERTs as possible and returns them with
+  // their new IDs.  Adds them to the FTS index too, unless a bulk ingest is
+  // in progress.  Must be called inside a transaction.
+  SongList InsertSongs(const SongList& songs, QSqlDatabase& db);
+  // Adds the songs with IDs from first_id to last_id to the FTS index.
+  bool InsertSongsFts(int first_id, int last_id, QSqlDatabase& db);
+  // Indexes or deletes the songs added during this bulk ingest, and leaves
+  // bulk ingest mode.
+  void FinishBulkIngest(bool keep_songs);
+
   void UpdateCompilations(QSqlQuery& find_songs, QSqlQuery& update,
                           SongList& deleted_songs, SongList& added_songs,
                           const QString& album, int sampler);
@@ -251,6 +305,20 @@ signals:
   QString fts_table_;
   bool save_statistics_in_file_;
   bool save_ratings_in_file_;
+
+  // Albums that have had songs added, changed or removed since compilations
+  // were last updated, if track_dirty_albums_ is set.  compilations_updated_
+  // is set once UpdateCompilations() has looked at every album.  Protected by
+  // the database mutex.
+  bool track_dirty_albums_;
+  bool compilations_updated_;
+  QSet<QString> dirty_compilation_albums_;
+
+  // Protected by the database mutex.
+  bool bulk_ingest_;
+  // The ID of the first song inserted during this bulk ingest, or -1.
+  int bulk_ingest_first_id_;
+  bool bulk_ingest_changed_;
 };
 
 #endif  // LIBRARYBACKEND_H
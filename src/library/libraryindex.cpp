@@ -0,0 +1,240 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "libraryindex.h"
+
+#include <algorithm>
+
+#include "core/song.h"
+
+const char* LibraryIndex::kColumnSpec =
+    "%songs_table.ROWID, artist, album, effective_albumartist, composer, "
+    "performer, grouping, genre, year, originalyear, effective_originalyear, "
+    "disc, bitrate, filetype, effective_compilation, ctime";
+
+namespace {
+
+// Columns from Column_Year onwards hold integers, the others hold text.
+bool IsIntColumn(int column) { return column >= LibraryIndex::Column_Year; }
+
+void InsertSorted(QVector<int>* rows, int row) {
+  rows->insert(std::lower_bound(rows->begin(), rows->end(), row), row);
+}
+
+void RemoveSorted(QVector<int>* rows, int row) {
+  QVector<int>::iterator it = std::lower_bound(rows->begin(), rows->end(), row);
+  if (it != rows->end() && *it == row) rows->erase(it);
+}
+
+}  // namespace
+
+LibraryIndex::LibraryIndex() {}
+
+void LibraryIndex::Clear() {
+  for (int i = 0; i < ColumnCount; ++i) {
+    columns_[i] = ColumnData();
+  }
+  ids_.clear();
+  compilation_.clear();
+  ctime_.clear();
+  row_by_id_.clear();
+  free_rows_.clear();
+}
+
+void LibraryIndex::AddRow(const SqlRow& row) {
+  QVariant values[ColumnCount];
+  for (int i = 0; i < ColumnCount; ++i) {
+    if (IsIntColumn(i))
+      values[i] = row.ToInt(i + 1);
+    else
+      values[i] = row.ToString(i + 1);
+  }
+
+  SetRow(row.ToInt(0), values, row.ToBool(ColumnCount + 1),
+         row.ToLongLong(ColumnCount + 2));
+}
+
+void LibraryIndex::AddOrUpdateSong(const Song& song) {
+  if (song.is_unavailable()) {
+    RemoveSong(song.id());
+    return;
+  }
+
+  QVariant values[ColumnCount];
+  values[Column_Artist] = song.artist();
+  values[Column_Album] = song.album();
+  values[Column_EffectiveAlbumArtist] = song.effective_albumartist();
+  values[Column_Composer] = song.composer();
+  values[Column_Performer] = song.performer();
+  values[Column_Grouping] = song.grouping();
+  values[Column_Genre] = song.genre();
+  values[Column_Year] = song.year();
+  values[Column_OriginalYear] = song.originalyear();
+  values[Column_EffectiveOriginalYear] = song.effective_originalyear();
+  values[Column_Disc] = song.disc();
+  values[Column_Bitrate] = song.bitrate();
+  values[Column_FileType] = int(song.filetype());
+
+  SetRow(song.id(), values, song.is_compilation(), song.ctime());
+}
+
+void LibraryIndex::RemoveSong(int id) {
+  QHash<int, int>::iterator it = row_by_id_.find(id);
+  if (it == row_by_id_.end()) return;
+
+  const int row = it.value();
+  row_by_id_.erase(it);
+
+  ClearRow(row);
+  ids_[row] = -1;
+  free_rows_ << row;
+}
+
+void LibraryIndex::SetRow(int id, const QVariant* values, bool compilation,
+                          uint ctime) {
+  int row = row_by_id_.value(id, -1);
+  if (row != -1) {
+    ClearRow(row);
+  } else if (!free_rows_.isEmpty()) {
+    row = free_rows_.last();
+    free_rows_.removeLast();
+  } else {
+    row = ids_.count();
+    ids_.append(-1);
+    compilation_.append(false);
+    ctime_.append(0);
+    for (int i = 0; i < ColumnCount; ++i) {
+      columns_[i].codes.append(-1);
+    }
+  }
+
+  for (int i = 0; i < ColumnCount; ++i) {
+    ColumnData* column = &columns_[i];
+    const int code = Encode(column, values[i]);
+    column->codes[row] = code;
+    InsertSorted(&column->rows[code], row);
+  }
+
+  ids_[row] = id;
+  compilation_[row] = compilation;
+  ctime_[row] = ctime;
+  row_by_id_[id] = row;
+}
+
+void LibraryIndex::ClearRow(int row) {
+  for (int i = 0; i < ColumnCount; ++i) {
+    ColumnData* column = &columns_[i];
+    RemoveSorted(&column->rows[column->codes[row]], row);
+    column->codes[row] = -1;
+  }
+}
+
+int LibraryIndex::Encode(ColumnData* column, const QVariant& value) {
+  const QString text = value.toString();
+  QHash<QString, int>::const_iterator it = column->code_by_text.find(text);
+  if (it != column->code_by_text.end()) return it.value();
+
+  const int code = column->values.count();
+  column->values.append(value);
+  column->rows.append(QVector<int>());
+  column->code_by_text.insert(text, code);
+  return code;
+}
+
+template <typename F>
+void LibraryIndex::ForEachMatchingRow(const Query& query, F f) const {
+  if (query.require_compilation && query.require_not_compilation) return;
+
+  // Look up the code of each value first.  The shortest list of rows for one
+  // of them is where the matching rows will be found.
+  QVector<QPair<const ColumnData*, int>> where;
+  const QVector<int>* candidates = nullptr;
+  for (const QPair<Column, QString>& condition : query.where) {
+    const ColumnData& column = columns_[condition.first];
+    QHash<QString, int>::const_iterator it =
+        column.code_by_text.find(condition.second);
+    if (it == column.code_by_text.end()) return;
+
+    where << qMakePair(&column, it.value());
+    const QVector<int>& rows = column.rows[it.value()];
+    if (!candidates || rows.count() < candidates->count()) {
+      candidates = &rows;
+    }
+  }
+
+  auto matches = [&](int row) {
+    if (ids_[row] == -1) return false;
+    for (const QPair<const ColumnData*, int>& condition : where) {
+      if (condition.first->codes[row] != condition.second) return false;
+    }
+    if (query.require_compilation && !compilation_[row]) return false;
+    if (query.require_not_compilation && compilation_[row]) return false;
+    if (query.ctime_after != -1 && ctime_[row] <= query.ctime_after) {
+      return false;
+    }
+    if (query.song_ids && !query.song_ids->contains(ids_[row])) return false;
+    return true;
+  };
+
+  if (candidates) {
+    for (int row : *candidates) {
+      if (matches(row) && !f(row)) return;
+    }
+  } else {
+    for (int row = 0; row < ids_.count(); ++row) {
+      if (matches(row) && !f(row)) return;
+    }
+  }
+}
+
+bool LibraryIndex::Contains(const Query& query) const {
+  bool ret = false;
+  ForEachMatchingRow(query, [&ret](int) {
+    ret = true;
+    return false;
+  });
+  return ret;
+}
+
+SqlRowList LibraryIndex::Distinct(const Query& query,
+                                  const QList<Column>& columns) const {
+  SqlRowList ret;
+  if (columns.isEmpty()) return ret;
+
+  // The codes of the values in a row identify it.
+  QSet<QByteArray> seen;
+  QVector<int> codes(columns.count());
+
+  ForEachMatchingRow(query, [&](int row) {
+    for (int i = 0; i < columns.count(); ++i) {
+      codes[i] = columns_[columns[i]].codes[row];
+    }
+    const QByteArray key(reinterpret_cast<const char*>(codes.constData()),
+                         codes.count() * sizeof(int));
+    if (seen.contains(key)) return true;
+    seen.insert(key);
+
+    QList<QVariant> values;
+    for (int i = 0; i < columns.count(); ++i) {
+      values << columns_[columns[i]].values[codes[i]];
+    }
+    ret << SqlRow(values);
+    return true;
+  });
+
+  return ret;
+}
@@ -0,0 +1,151 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARYINDEX_H
+#define LIBRARYINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QSet>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+#include "sqlrow.h"
+
+class Song;
+
+// An in-memory copy of the columns LibraryModel groups songs by, so it can
+// build the containers in the library tree without querying the database.
+//
+// The index is stored a column at a time.  The values in each column are
+// dictionary encoded - every distinct value is stored once, and each song's
+// row holds the value's code.  Each value also has a sorted list of the rows
+// that contain it, so the songs under a container can be found without
+// looking at every row.
+//
+// The database is still the source of truth.  The index is loaded from it
+// with kColumnSpec, and kept up to date with AddOrUpdateSong() and
+// RemoveSong() as the LibraryBackend reports changes.  Unavailable songs are
+// left out, like they are from a LibraryQuery.
+class LibraryIndex {
+ public:
+  LibraryIndex();
+
+  enum Column {
+    Column_Artist = 0,
+    Column_Album,
+    Column_EffectiveAlbumArtist,
+    Column_Composer,
+    Column_Performer,
+    Column_Grouping,
+    Column_Genre,
+    Column_Year,
+    Column_OriginalYear,
+    Column_EffectiveOriginalYear,
+    Column_Disc,
+    Column_Bitrate,
+    Column_FileType,
+
+    ColumnCount
+  };
+
+  // The columns to select from the songs table for AddRow(): the ROWID, each
+  // Column in order, effective_compilation and ctime.
+  static const char* kColumnSpec;
+
+  // Conditions that songs must match.  Every condition must be true, like
+  // the WHERE clauses of a LibraryQuery.
+  struct Query {
+    Query()
+        : require_compilation(false),
+          require_not_compilation(false),
+          ctime_after(-1),
+          song_ids(nullptr) {}
+
+    // The value of the column, as text, must be equal to this.
+    void AddWhere(Column column, const QString& value) {
+      where << qMakePair(column, value);
+    }
+    void AddCompilationRequirement(bool compilation) {
+      if (compilation)
+        require_compilation = true;
+      else
+        require_not_compilation = true;
+    }
+
+    QList<QPair<Column, QString>> where;
+    bool require_compilation;
+    bool require_not_compilation;
+    // Only songs with a greater ctime, if not -1.
+    qint64 ctime_after;
+    // Only songs with these IDs, if not null.
+    const QSet<int>* song_ids;
+  };
+
+  int song_count() const { return row_by_id_.count(); }
+
+  void Clear();
+
+  // Adds a song read from the database with kColumnSpec, replacing the song
+  // with the same ID if there is one.
+  void AddRow(const SqlRow& row);
+  // Adds the song or replaces the one with the same ID.  Removes it if it's
+  // unavailable.
+  void AddOrUpdateSong(const Song& song);
+  void RemoveSong(int id);
+
+  // Returns true if any song matches the query.
+  bool Contains(const Query& query) const;
+
+  // Returns the distinct values of the columns for the songs that match the
+  // query, like a SELECT DISTINCT.  Each row has a value for each of the
+  // columns, in the same order.
+  SqlRowList Distinct(const Query& query, const QList<Column>& columns) const;
+
+ private:
+  struct ColumnData {
+    // Row number -> value code.
+    QVector<int> codes;
+    // Value code -> value.
+    QVector<QVariant> values;
+    // The value as text -> value code.
+    QHash<QString, int> code_by_text;
+    // Value code -> sorted rows that contain it.
+    QVector<QVector<int>> rows;
+  };
+
+  void SetRow(int id, const QVariant* values, bool compilation, uint ctime);
+  void ClearRow(int row);
+  int Encode(ColumnData* column, const QVariant& value);
+
+  // Calls f with each row that matches the query until it returns false.
+  template <typename F>
+  void ForEachMatchingRow(const Query& query, F f) const;
+
+  ColumnData columns_[ColumnCount];
+  // Row number -> song ID, or -1 if the row isn't used.
+  QVector<int> ids_;
+  QVector<bool> compilation_;
+  QVector<uint> ctime_;
+
+  QHash<int, int> row_by_id_;
+  QVector<int> free_rows_;
+};
+
+#endif  // LIBRARYINDEX_H
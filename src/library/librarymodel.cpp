@@ -19,13 +19,12 @@
 
 #include <functional>
 
+#include <QDateTime>
 #include <QFuture>
 #include <QFutureWatcher>
-#include <QIODevice>
 #include <QMetaEnum>
-#include <QNetworkCacheMetaData>
-#include <QNetworkDiskCache>
 #include <QPixmapCache>
+#include <QSqlRecord>
 #include <QSettings>
 #include <QStringList>
 #include <QUrl>
@@ -37,6 +36,7 @@
 #include "libraryview.h"
 #include "sqlrow.h"
 #include "core/application.h"
+#include "core/closure.h"
 #include "core/database.h"
 #include "core/logging.h"
 #include "core/taskmanager.h"
@@ -63,6 +63,8 @@ const char* LibraryModel::kSmartPlaylistsSettingsGroup =
 const int LibraryModel::kSmartPlaylistsVersion = 4;
 const int LibraryModel::kPrettyCoverSize = 32;
 const qint64 LibraryModel::kIconCacheSize = 100000000;  //~100MB
+const int LibraryModel::kIconPrefetchCount = 20;
+const int LibraryModel::kLazyPopulateQueriesPerStatement = 100;
 typedef QFuture<LibraryModel::QueryResult> RootQueryFuture;
 typedef QFutureWatcher<LibraryModel::QueryResult> RootQueryWatcher;
 
@@ -88,10 +90,13 @@ LibraryModel::LibraryModel(LibraryBackend* backend, Application* app,
       album_icon_(IconLoader::Load("x-clementine-album", IconLoader::Base)),
       playlists_dir_icon_(IconLoader::Load("folder-sound", IconLoader::Base)),
       playlist_icon_(IconLoader::Load("x-clementine-albums", IconLoader::Base)),
-      icon_cache_(new QNetworkDiskCache(this)),
+      icon_cache_(Utilities::GetConfigPath(Utilities::Path_CacheRoot) +
+                  "/albumicons"),
       init_task_id_(-1),
       use_pretty_covers_(false),
-      show_dividers_(true) {
+      show_dividers_(true),
+      next_lazy_populate_id_(0),
+      index_generation_(0) {
   root_->lazy_loaded = true;
 
   group_by_[0] = GroupBy_Artist;
@@ -101,13 +106,16 @@ LibraryModel::LibraryModel(LibraryBackend* backend, Application* app,
   cover_loader_options_.desired_height_ = kPrettyCoverSize;
   cover_loader_options_.pad_output_image_ = true;
   cover_loader_options_.scale_output_image_ = true;
+  cover_loader_options_.priority_ = AlbumCoverLoaderOptions::Priority_Bulk;
 
   connect(app_->album_cover_loader(), SIGNAL(ImageLoaded(quint64, QImage)),
           SLOT(AlbumArtLoaded(quint64, QImage)));
 
-  icon_cache_->setCacheDirectory(
-      Utilities::GetConfigPath(Utilities::Path_CacheRoot) + "/pixmapcache");
-  icon_cache_->setMaximumCacheSize(LibraryModel::kIconCacheSize);
+  // Icons used to be kept in a QNetworkDiskCache in "pixmapcache".
+  QtConcurrent::run(icon_cache_, &AlbumIconCache::Prepare,
+                    Utilities::GetConfigPath(Utilities::Path_CacheRoot) +
+                        "/pixmapcache",
+                    kIconCacheSize);
 
   no_cover_icon_ = QPixmap(":nocover.png")
                        .scaled(kPrettyCoverSize, kPrettyCoverSize,
@@ -121,14 +129,25 @@ LibraryModel::LibraryModel(LibraryBackend* backend, Application* app,
           SLOT(SongsSlightlyChanged(SongList)));
   connect(backend_, SIGNAL(SongsRatingChanged(SongList)),
           SLOT(SongsSlightlyChanged(SongList)));
-  connect(backend_, SIGNAL(DatabaseReset()), SLOT(Reset()));
+  connect(backend_, SIGNAL(DatabaseReset()), SLOT(DatabaseReset()));
   connect(backend_, SIGNAL(TotalSongCountUpdated(int)),
           SLOT(TotalSongCountUpdatedSlot(int)));
 
   backend_->UpdateTotalSongCountAsync();
 }
 
-LibraryModel::~LibraryModel() { delete root_; }
+LibraryModel::~LibraryModel() {
+  // Queries running on worker threads use this model and the backend.
+  for (QFutureWatcherBase* watcher : findChildren<QFutureWatcherBase*>()) {
+    watcher->waitForFinished();
+  }
+  // Nothing is going to take these now.
+  for (const QFuture<LibraryIndex*>& future : loading_indexes_) {
+    delete future.result();
+  }
+
+  delete root_;
+}
 
 void LibraryModel::set_pretty_covers(bool use_pretty_covers) {
   if (use_pretty_covers != use_pretty_covers_) {
@@ -145,6 +164,8 @@ void LibraryModel::set_show_dividers(bool show_dividers) {
 }
 
 void LibraryModel::Init(bool async) {
+  LoadIndexAsync();
+
   if (async) {
     // Show a loading indicator in the model.
     LibraryItem* loading =
@@ -163,11 +184,17 @@ void LibraryModel::Init(bool async) {
 }
 
 void LibraryModel::SongsDiscovered(const SongList& songs) {
+  UpdateIndex(songs, false);
+
   for (const Song& song : songs) {
     // Sanity check to make sure we don't add songs that are outside the user's
     // filter
     if (!query_options_.Matches(song)) continue;
 
+    if (!filter_song_ids_text_.isEmpty()) {
+      filter_song_ids_.insert(song.id());
+    }
+
     // Hey, we've already got that one!
     if (song_nodes_.contains(song.id())) continue;
 
@@ -179,6 +206,7 @@ void LibraryModel::SongsDiscovered(const SongList& songs) {
 
     // Find parent containers in the tree
     LibraryItem* container = root_;
+    bool container_loading = false;
     for (int i = 0; i < 3; ++i) {
       GroupBy type = group_by_[i];
       if (type == GroupBy_None) break;
@@ -253,9 +281,17 @@ void LibraryModel::SongsDiscovered(const SongList& songs) {
       // If we just created the damn thing then we don't need to continue into
       // it any further because it'll get lazy-loaded properly later.
       if (!container->lazy_loaded) break;
+
+      // If its children are being loaded in the background the query might
+      // have run before this song was added, so run it again.
+      if (CancelLazyPopulateQuery(container)) {
+        QueueLazyPopulateQuery(container);
+        container_loading = true;
+        break;
+      }
     }
 
-    if (!container->lazy_loaded) continue;
+    if (!container->lazy_loaded || container_loading) continue;
 
     // We've gone all the way down to the deepest level and everything was
     // already lazy loaded, so now we have to create the song in the container.
@@ -379,6 +415,8 @@ QString LibraryModel::DividerDisplayText(GroupBy type,
 }
 
 void LibraryModel::SongsDeleted(const SongList& songs) {
+  UpdateIndex(songs, true);
+
   // Delete the actual song nodes first, keeping track of each parent so we
   // might check to see if they're empty later.
   QSet<LibraryItem*> parents;
@@ -458,6 +496,15 @@ void LibraryModel::SongsDeleted(const SongList& songs) {
   }
 }
 
+bool LibraryModel::IsAlbumNode(const LibraryItem* item) const {
+  if (item->type != LibraryItem::Type_Container) return false;
+
+  GroupBy container_type = group_by_[item->container_level];
+  return container_type == GroupBy_Album ||
+         container_type == GroupBy_YearAlbum ||
+         container_type == GroupBy_OriginalYearAlbum;
+}
+
 QString LibraryModel::AlbumIconPixmapCacheKey(const QModelIndex& index) const {
   QStringList path;
   QModelIndex index_copy(index);
@@ -480,41 +527,81 @@ QVariant LibraryModel::AlbumIcon(const QModelIndex& index) {
     return cached_pixmap;
   }
 
-  // Try to load it from the disk cache
-  std::unique_ptr<QIODevice> cache(icon_cache_->data(QUrl(cache_key)));
-  if (cache) {
-    QImage cached_pixmap;
-    if (cached_pixmap.load(cache.get(), "XPM")) {
-      QPixmapCache::insert(cache_key, QPixmap::fromImage(cached_pixmap));
-      return QPixmap::fromImage(cached_pixmap);
+  // Never touch the disk here - load this album's icon and the icons for the
+  // next few albums in the background, so they're ready by the time the user
+  // scrolls to them.
+  LoadAlbumIconAsync(index);
+
+  const int last_row =
+      qMin(index.row() + kIconPrefetchCount, rowCount(index.parent()) - 1);
+  for (int row = index.row() + 1; row <= last_row; ++row) {
+    const QModelIndex sibling = index.sibling(row, 0);
+    if (IsAlbumNode(IndexToItem(sibling))) {
+      LoadAlbumIconAsync(sibling);
     }
   }
 
+  return no_cover_icon_;
+}
+
+void LibraryModel::LoadAlbumIconAsync(const QModelIndex& index) {
+  const QString cache_key = AlbumIconPixmapCacheKey(index);
+
   // Maybe we're loading a pixmap already?
-  if (pending_cache_keys_.contains(cache_key)) {
-    return no_cover_icon_;
+  QPixmap cached_pixmap;
+  if (pending_icon_loads_.contains(cache_key) ||
+      QPixmapCache::find(cache_key, &cached_pixmap)) {
+    return;
   }
 
-  // No art is cached and we're not loading it already.  Load art for the first
-  // Song in the album.
+  pending_icon_loads_[cache_key] = index;
+
+  QFutureWatcher<QImage>* watcher = new QFutureWatcher<QImage>(this);
+  NewClosure(watcher, SIGNAL(finished()), this,
+             SLOT(AlbumIconLoaded(QString, QFutureWatcher<QImage>*)),
+             cache_key, watcher);
+
+  QFuture<QImage> future =
+      QtConcurrent::run(icon_cache_, &AlbumIconCache::Load, cache_key);
+  watcher->setFuture(future);
+}
+
+void LibraryModel::AlbumIconLoaded(const QString& cache_key,
+                                   QFutureWatcher<QImage>* watcher) {
+  watcher->deleteLater();
+
+  // The album might have been removed, or the model reset, while we were
+  // loading.
+  const QModelIndex index = pending_icon_loads_.value(cache_key);
+  if (!index.isValid()) {
+    pending_icon_loads_.remove(cache_key);
+    return;
+  }
+
+  const QImage image = watcher->result();
+  if (!image.isNull()) {
+    pending_icon_loads_.remove(cache_key);
+    QPixmapCache::insert(cache_key, QPixmap::fromImage(image));
+    emit dataChanged(index, index);
+    return;
+  }
+
+  // No art is cached.  Load art for the first Song in the album.
   SongList songs = GetChildSongs(index);
-  if (!songs.isEmpty()) {
-    const quint64 id = app_->album_cover_loader()->LoadImageAsync(
-        cover_loader_options_, songs.first());
-    pending_art_[id] = ItemAndCacheKey(item, cache_key);
-    pending_cache_keys_.insert(cache_key);
+  if (songs.isEmpty()) {
+    pending_icon_loads_.remove(cache_key);
+    return;
   }
 
-  return no_cover_icon_;
+  const quint64 id = app_->album_cover_loader()->LoadImageAsync(
+      cover_loader_options_, songs.first());
+  pending_art_[id] = cache_key;
 }
 
 void LibraryModel::AlbumArtLoaded(quint64 id, const QImage& image) {
-  ItemAndCacheKey item_and_cache_key = pending_art_.take(id);
-  LibraryItem* item = item_and_cache_key.first;
-  const QString& cache_key = item_and_cache_key.second;
-  if (!item) return;
-
-  pending_cache_keys_.remove(cache_key);
+  if (!pending_art_.contains(id)) return;
+  const QString cache_key = pending_art_.take(id);
+  const QModelIndex index = pending_icon_loads_.take(cache_key);
 
   // Insert this image in the cache.
   if (image.isNull()) {
@@ -522,23 +609,12 @@ void LibraryModel::AlbumArtLoaded(quint64 id, const QImage& image) {
     QPixmapCache::insert(cache_key, no_cover_icon_);
   } else {
     QPixmapCache::insert(cache_key, QPixmap::fromImage(image));
+    QtConcurrent::run(icon_cache_, &AlbumIconCache::Save, cache_key, image);
   }
 
-  // if not already in the disk cache
-  std::unique_ptr<QIODevice> cached_img(icon_cache_->data(QUrl(cache_key)));
-  if (!cached_img) {
-    QNetworkCacheMetaData item_metadata;
-    item_metadata.setSaveToDisk(true);
-    item_metadata.setUrl(QUrl(cache_key));
-    QIODevice* cache = icon_cache_->prepare(item_metadata);
-    if (cache) {
-      image.save(cache, "XPM");
-      icon_cache_->insert(cache);
-    }
+  if (index.isValid()) {
+    emit dataChanged(index, index);
   }
-
-  const QModelIndex index = ItemToIndex(item);
-  emit dataChanged(index, index);
 }
 
 QVariant LibraryModel::data(const QModelIndex& index, int role) const {
@@ -550,15 +626,7 @@ QVariant LibraryModel::data(const QModelIndex& index, int role) const {
   // QModelIndex& version of GetChildSongs, which satisfies const-ness, instead
   // of the LibraryItem* version, which doesn't.
   if (use_pretty_covers_) {
-    bool is_album_node = false;
-    if (role == Qt::DecorationRole &&
-        item->type == LibraryItem::Type_Container) {
-      GroupBy container_type = group_by_[item->container_level];
-      is_album_node = container_type == GroupBy_Album ||
-                      container_type == GroupBy_YearAlbum ||
-                      container_type == GroupBy_OriginalYearAlbum;
-    }
-    if (is_album_node) {
+    if (role == Qt::DecorationRole && IsAlbumNode(item)) {
       // It has const behaviour some of the time - that's ok right?
       return const_cast<LibraryModel*>(this)->AlbumIcon(index);
     }
@@ -652,14 +720,22 @@ bool LibraryModel::HasCompilations(const LibraryQuery& query) {
   q.AddCompilationRequirement(true);
   q.SetLimit(1);
 
-  QMutexLocker l(backend_->db()->Mutex());
+  QMutexLocker l(backend_->db()->ReadMutex());
   if (!backend_->ExecQuery(&q)) return false;
 
   return q.Next();
 }
 
 LibraryModel::QueryResult LibraryModel::RunQuery(LibraryItem* parent) {
-  QueryResult result;
+  if (CanQueryIndex(parent)) {
+    return RunIndexQuery(parent);
+  }
+  return RunChildQuery(BuildChildQuery(parent));
+}
+
+LibraryModel::ChildQuery LibraryModel::BuildChildQuery(LibraryItem* parent) {
+  ChildQuery ret;
+  ret.query = LibraryQuery(query_options_);
 
   // Information about what we want the children to be
   int child_level = parent == root_ ? 0 : parent->container_level + 1;
@@ -667,29 +743,41 @@ LibraryModel::QueryResult LibraryModel::RunQuery(LibraryItem* parent) {
 
   // Initialise the query.  child_type says what type of thing we want (artists,
   // songs, etc.)
-  LibraryQuery q(query_options_);
-  InitQuery(child_type, &q);
+  InitQuery(child_type, &ret.query);
 
   // Walk up through the item's parents adding filters as necessary
   LibraryItem* p = parent;
   while (p && p->type == LibraryItem::Type_Container) {
-    FilterQuery(group_by_[p->container_level], p, &q);
+    FilterQuery(group_by_[p->container_level], p, &ret.query);
     p = p->parent;
   }
 
   // Artists GroupBy is special - we don't want compilation albums appearing
   if (IsArtistGroupBy(child_type)) {
-    // Add the special Various artists node
-    if (show_various_artists_ && HasCompilations(q)) {
-      result.create_va = true;
-    }
+    ret.check_va = show_various_artists_;
+    ret.skip_compilations = true;
+  }
+
+  return ret;
+}
+
+LibraryModel::QueryResult LibraryModel::RunChildQuery(
+    const ChildQuery& query) {
+  QueryResult result;
+  LibraryQuery q = query.query;
+
+  // Add the special Various artists node
+  if (query.check_va && HasCompilations(q)) {
+    result.create_va = true;
+  }
 
-    // Don't show compilations again outside the Various artists node
+  // Don't show compilations again outside the Various artists node
+  if (query.skip_compilations) {
     q.AddCompilationRequirement(false);
   }
 
   // Execute the query
-  QMutexLocker l(backend_->db()->Mutex());
+  QMutexLocker l(backend_->db()->ReadMutex());
   if (!backend_->ExecQuery(&q)) return result;
 
   while (q.Next()) {
@@ -724,6 +812,13 @@ void LibraryModel::PostQuery(LibraryItem* parent,
 }
 
 void LibraryModel::LazyPopulate(LibraryItem* parent, bool signal) {
+  // If the children are already being loaded in the background, don't wait
+  // for that - load them again here instead.
+  if (CancelLazyPopulateQuery(parent)) {
+    RemoveLoadingIndicator(parent);
+    parent->lazy_loaded = false;
+  }
+
   if (parent->lazy_loaded) return;
   parent->lazy_loaded = true;
 
@@ -731,9 +826,230 @@ void LibraryModel::LazyPopulate(LibraryItem* parent, bool signal) {
   PostQuery(parent, result, signal);
 }
 
+void LibraryModel::LazyPopulateNow(const QModelIndex& index) {
+  LazyPopulate(IndexToItem(index), true);
+}
+
+void LibraryModel::PrefetchChildren(const QModelIndexList& indexes) {
+  for (const QModelIndex& index : indexes) {
+    LibraryItem* item = IndexToItem(index);
+    if (item->type == LibraryItem::Type_Container) {
+      LazyPopulateAsync(item);
+    }
+  }
+}
+
+void LibraryModel::CancelLazyPopulate(const QModelIndex& index) {
+  LibraryItem* item = IndexToItem(index);
+  if (CancelLazyPopulateQuery(item)) {
+    // Load it again next time it's expanded.
+    RemoveLoadingIndicator(item);
+    item->lazy_loaded = false;
+  }
+}
+
+void LibraryModel::LazyPopulateAsync(LibraryItem* parent) {
+  if (parent->lazy_loaded) return;
+
+  // There's no need to wait if the index can find the children.
+  if (CanQueryIndex(parent)) {
+    LazyPopulate(parent, true);
+    return;
+  }
+  parent->lazy_loaded = true;
+
+  LibraryItem* loading = new LibraryItem(LibraryItem::Type_LoadingIndicator);
+  loading->display_text = tr("Loading...");
+  loading->lazy_loaded = true;
+  loading->InsertNotify(parent);
+
+  QueueLazyPopulateQuery(parent);
+}
+
+void LibraryModel::QueueLazyPopulateQuery(LibraryItem* parent) {
+  const int id = next_lazy_populate_id_++;
+  pending_lazy_populates_[id] = parent;
+  queued_lazy_populates_[id] = BuildChildQuery(parent);
+
+  if (queued_lazy_populates_.count() == 1) {
+    QMetaObject::invokeMethod(this, "StartLazyPopulateQueries",
+                              Qt::QueuedConnection);
+  }
+}
+
+void LibraryModel::StartLazyPopulateQueries() {
+  if (queued_lazy_populates_.isEmpty()) return;
+
+  QFutureWatcher<LazyPopulateResults>* watcher =
+      new QFutureWatcher<LazyPopulateResults>(this);
+  NewClosure(watcher, SIGNAL(finished()), this,
+             SLOT(LazyPopulateQueriesFinished(
+                 QFutureWatcher<LazyPopulateResults>*)),
+             watcher);
+
+  QFuture<LazyPopulateResults> future =
+      QtConcurrent::run(this, &LibraryModel::RunLazyPopulateQueries,
+                        queued_lazy_populates_);
+  queued_lazy_populates_.clear();
+  watcher->setFuture(future);
+}
+
+LibraryModel::LazyPopulateResults LibraryModel::RunLazyPopulateQueries(
+    const QMap<int, ChildQuery>& queries) {
+  LazyPopulateResults ret;
+
+  // Queries for the same type of children return the same columns, so they're
+  // run together as one statement.  A query that might need a "Various
+  // artists" node brings a second one that looks for a compilation.
+  struct Part {
+    int id;
+    bool va_check;
+  };
+  typedef QList<LibraryQuery> QueryList;
+  typedef QList<Part> PartList;
+  QMap<QString, QueryList> statements;
+  QMap<QString, PartList> statement_parts;
+
+  for (QMap<int, ChildQuery>::const_iterator it = queries.constBegin();
+       it != queries.constEnd(); ++it) {
+    {
+      QMutexLocker cancelled_lock(&cancelled_lazy_populates_mutex_);
+      if (cancelled_lazy_populates_.remove(it.key())) continue;
+    }
+
+    const ChildQuery& child_query = it.value();
+    const QString& spec = child_query.query.column_spec();
+    ret[it.key()] = QueryResult();
+
+    if (child_query.check_va) {
+      LibraryQuery va_query = child_query.query;
+      va_query.AddCompilationRequirement(true);
+      va_query.SetLimit(1);
+
+      Part part = {it.key(), true};
+      statements[spec] << va_query;
+      statement_parts[spec] << part;
+    }
+
+    LibraryQuery q = child_query.query;
+    if (child_query.skip_compilations) {
+      q.AddCompilationRequirement(false);
+    }
+
+    Part part = {it.key(), false};
+    statements[spec] << q;
+    statement_parts[spec] << part;
+  }
+
+  QMutexLocker l(backend_->db()->ReadMutex());
+
+  for (const QString& spec : statements.keys()) {
+    const QueryList all_queries = statements.value(spec);
+    const PartList all_parts = statement_parts.value(spec);
+
+    // Keep within sqlite's limits on compound selects and bound values.
+    for (int start = 0; start < all_queries.count();
+         start += kLazyPopulateQueriesPerStatement) {
+      const QueryList batch =
+          all_queries.mid(start, kLazyPopulateQueriesPerStatement);
+      const PartList parts =
+          all_parts.mid(start, kLazyPopulateQueriesPerStatement);
+
+      QSqlQuery q;
+      if (!backend_->ExecQueries(batch, &q)) continue;
+
+      // The index of the query the row came from is in the last column.
+      const int columns = q.record().count() - 1;
+      while (q.next()) {
+        const Part& part = parts[q.value(columns).toInt()];
+        QueryResult& result = ret[part.id];
+
+        if (part.va_check) {
+          result.create_va = true;
+          continue;
+        }
+
+        QList<QVariant> values;
+        for (int i = 0; i < columns; ++i) {
+          values << q.value(i);
+        }
+        result.rows << SqlRow(values);
+      }
+    }
+  }
+  return ret;
+}
+
+void LibraryModel::LazyPopulateQueriesFinished(
+    QFutureWatcher<LazyPopulateResults>* watcher) {
+  watcher->deleteLater();
+  const LazyPopulateResults results = watcher->result();
+
+  for (LazyPopulateResults::const_iterator it = results.constBegin();
+       it != results.constEnd(); ++it) {
+    {
+      QMutexLocker l(&cancelled_lazy_populates_mutex_);
+      cancelled_lazy_populates_.remove(it.key());
+    }
+
+    // The request might have been cancelled, or the model reset, while the
+    // query was running.
+    LibraryItem* parent = pending_lazy_populates_.take(it.key());
+    if (!parent) continue;
+
+    RemoveLoadingIndicator(parent);
+    PostQuery(parent, it.value(), true);
+
+    emit LazyPopulateFinished(ItemToIndex(parent));
+  }
+}
+
+bool LibraryModel::CancelLazyPopulateQuery(LibraryItem* parent) {
+  const int id = pending_lazy_populates_.key(parent, -1);
+  if (id == -1) return false;
+
+  pending_lazy_populates_.remove(id);
+  if (!queued_lazy_populates_.remove(id)) {
+    // It's been sent to a worker thread already.
+    QMutexLocker l(&cancelled_lazy_populates_mutex_);
+    cancelled_lazy_populates_.insert(id);
+  }
+  return true;
+}
+
+void LibraryModel::RemoveLoadingIndicator(LibraryItem* parent) {
+  for (LibraryItem* child : parent->children) {
+    if (child->type == LibraryItem::Type_LoadingIndicator) {
+      parent->DeleteNotify(child->row);
+      return;
+    }
+  }
+}
+
 void LibraryModel::ResetAsync() {
-  RootQueryFuture future =
-      QtConcurrent::run(this, &LibraryModel::RunQuery, root_);
+  if (index_ &&
+      query_options_.query_mode() == QueryOptions::QueryMode_All) {
+    if (query_options_.filter().isEmpty()) {
+      // The index can build the top level straight away.
+      filter_song_ids_.clear();
+      filter_song_ids_text_.clear();
+      ResetWithResult(RunIndexQuery(root_));
+      return;
+    }
+
+    // Find the songs that match the filter first, then build the tree from
+    // the index.
+    QFutureWatcher<QSet<int>>* watcher = new QFutureWatcher<QSet<int>>(this);
+    NewClosure(watcher, SIGNAL(finished()), this,
+               SLOT(FilterQueryFinished(QString, QFutureWatcher<QSet<int>>*)),
+               query_options_.filter(), watcher);
+    watcher->setFuture(QtConcurrent::run(this, &LibraryModel::RunFilterQuery,
+                                         query_options_));
+    return;
+  }
+
+  RootQueryFuture future = QtConcurrent::run(
+      this, &LibraryModel::RunChildQuery, BuildChildQuery(root_));
   RootQueryWatcher* watcher = new RootQueryWatcher(this);
   watcher->setFuture(future);
 
@@ -745,6 +1061,10 @@ void LibraryModel::ResetAsyncQueryFinished() {
   const struct QueryResult result = watcher->result();
   watcher->deleteLater();
 
+  ResetWithResult(result);
+}
+
+void LibraryModel::ResetWithResult(const QueryResult& result) {
   BeginReset();
   root_->lazy_loaded = true;
 
@@ -758,6 +1078,148 @@ void LibraryModel::ResetAsyncQueryFinished() {
   endResetModel();
 }
 
+void LibraryModel::FilterQueryFinished(const QString& filter,
+                                       QFutureWatcher<QSet<int>>* watcher) {
+  watcher->deleteLater();
+
+  // Another query will be along if the filter has changed since.
+  if (!index_ || filter != query_options_.filter()) return;
+
+  filter_song_ids_ = watcher->result();
+  filter_song_ids_text_ = filter;
+  ResetWithResult(RunIndexQuery(root_));
+}
+
+QSet<int> LibraryModel::RunFilterQuery(const QueryOptions& options) {
+  QSet<int> ret;
+
+  LibraryQuery q(options);
+  q.SetColumnSpec("%songs_table.ROWID");
+
+  QMutexLocker l(backend_->db()->ReadMutex());
+  if (!backend_->ExecQuery(&q)) return ret;
+
+  while (q.Next()) {
+    ret.insert(q.Value(0).toInt());
+  }
+  return ret;
+}
+
+void LibraryModel::DatabaseReset() {
+  LoadIndexAsync();
+  Reset();
+}
+
+void LibraryModel::LoadIndexAsync() {
+  // Forget the old index until the new one is loaded.
+  index_.reset();
+  pending_index_updates_.clear();
+  const int generation = ++index_generation_;
+
+  QFutureWatcher<LibraryIndex*>* watcher =
+      new QFutureWatcher<LibraryIndex*>(this);
+  NewClosure(watcher, SIGNAL(finished()), this,
+             SLOT(IndexLoaded(int, QFutureWatcher<LibraryIndex*>*)),
+             generation, watcher);
+  QFuture<LibraryIndex*> future =
+      QtConcurrent::run(this, &LibraryModel::LoadIndex);
+  loading_indexes_[generation] = future;
+  watcher->setFuture(future);
+}
+
+LibraryIndex* LibraryModel::LoadIndex() {
+  LibraryIndex* index = new LibraryIndex;
+
+  LibraryQuery q;
+  q.SetColumnSpec(LibraryIndex::kColumnSpec);
+
+  QMutexLocker l(backend_->db()->ReadMutex());
+  if (!backend_->ExecQuery(&q)) return index;
+
+  while (q.Next()) {
+    index->AddRow(SqlRow(q));
+  }
+  return index;
+}
+
+void LibraryModel::IndexLoaded(int generation,
+                               QFutureWatcher<LibraryIndex*>* watcher) {
+  watcher->deleteLater();
+  loading_indexes_.remove(generation);
+  std::unique_ptr<LibraryIndex> index(watcher->result());
+  if (generation != index_generation_) return;
+
+  index_.swap(index);
+  for (const QPair<SongList, bool>& update : pending_index_updates_) {
+    UpdateIndex(update.first, update.second);
+  }
+  pending_index_updates_.clear();
+
+  qLog(Debug) << "Library index loaded with" << index_->song_count()
+              << "songs";
+}
+
+void LibraryModel::UpdateIndex(const SongList& songs, bool deleted) {
+  if (!index_) {
+    pending_index_updates_ << qMakePair(songs, deleted);
+    return;
+  }
+
+  for (const Song& song : songs) {
+    if (deleted)
+      index_->RemoveSong(song.id());
+    else
+      index_->AddOrUpdateSong(song);
+  }
+}
+
+bool LibraryModel::CanQueryIndex(LibraryItem* parent) const {
+  if (!index_) return false;
+  if (query_options_.query_mode() != QueryOptions::QueryMode_All) return false;
+  if (!query_options_.filter().isEmpty() &&
+      query_options_.filter() != filter_song_ids_text_) {
+    return false;
+  }
+
+  // Songs aren't in the index.
+  const int child_level = parent == root_ ? 0 : parent->container_level + 1;
+  return child_level < 3 && group_by_[child_level] != GroupBy_None;
+}
+
+LibraryModel::QueryResult LibraryModel::RunIndexQuery(LibraryItem* parent) {
+  QueryResult result;
+
+  int child_level = parent == root_ ? 0 : parent->container_level + 1;
+  GroupBy child_type = group_by_[child_level];
+
+  LibraryIndex::Query q;
+  if (query_options_.max_age() != -1) {
+    q.ctime_after =
+        QDateTime::currentDateTime().toTime_t() - query_options_.max_age();
+  }
+  if (!query_options_.filter().isEmpty()) {
+    q.song_ids = &filter_song_ids_;
+  }
+
+  LibraryItem* p = parent;
+  while (p && p->type == LibraryItem::Type_Container) {
+    FilterIndexQuery(group_by_[p->container_level], p, &q);
+    p = p->parent;
+  }
+
+  if (IsArtistGroupBy(child_type)) {
+    if (show_various_artists_) {
+      LibraryIndex::Query va_query = q;
+      va_query.AddCompilationRequirement(true);
+      result.create_va = index_->Contains(va_query);
+    }
+    q.AddCompilationRequirement(false);
+  }
+
+  result.rows = index_->Distinct(q, IndexColumns(child_type));
+  return result;
+}
+
 void LibraryModel::BeginReset() {
   beginResetModel();
   delete root_;
@@ -767,6 +1229,9 @@ void LibraryModel::BeginReset() {
   container_nodes_[2].clear();
   divider_nodes_.clear();
   pending_art_.clear();
+  pending_icon_loads_.clear();
+  pending_lazy_populates_.clear();
+  queued_lazy_populates_.clear();
   smart_playlist_node_ = nullptr;
 
   root_ = new LibraryItem(this);
@@ -910,6 +1375,132 @@ void LibraryModel::FilterQuery(GroupBy type, LibraryItem* item,
   }
 }
 
+QList<LibraryIndex::Column> LibraryModel::IndexColumns(GroupBy type) {
+  // The same columns as InitQuery, in the same order.
+  QList<LibraryIndex::Column> ret;
+  switch (type) {
+    case GroupBy_Artist:
+      ret << LibraryIndex::Column_Artist;
+      break;
+    case GroupBy_Album:
+      ret << LibraryIndex::Column_Album;
+      break;
+    case GroupBy_Composer:
+      ret << LibraryIndex::Column_Composer;
+      break;
+    case GroupBy_Performer:
+      ret << LibraryIndex::Column_Performer;
+      break;
+    case GroupBy_Disc:
+      ret << LibraryIndex::Column_Disc;
+      break;
+    case GroupBy_Grouping:
+      ret << LibraryIndex::Column_Grouping;
+      break;
+    case GroupBy_YearAlbum:
+      ret << LibraryIndex::Column_Year << LibraryIndex::Column_Album
+          << LibraryIndex::Column_Grouping;
+      break;
+    case GroupBy_OriginalYearAlbum:
+      ret << LibraryIndex::Column_Year << LibraryIndex::Column_OriginalYear
+          << LibraryIndex::Column_Album << LibraryIndex::Column_Grouping;
+      break;
+    case GroupBy_Year:
+      ret << LibraryIndex::Column_Year;
+      break;
+    case GroupBy_OriginalYear:
+      ret << LibraryIndex::Column_EffectiveOriginalYear;
+      break;
+    case GroupBy_Genre:
+      ret << LibraryIndex::Column_Genre;
+      break;
+    case GroupBy_AlbumArtist:
+      ret << LibraryIndex::Column_EffectiveAlbumArtist;
+      break;
+    case GroupBy_Bitrate:
+      ret << LibraryIndex::Column_Bitrate;
+      break;
+    case GroupBy_FileType:
+      ret << LibraryIndex::Column_FileType;
+      break;
+    case GroupBy_None:
+      qLog(Error) << "Songs aren't in the library index";
+      break;
+  }
+  return ret;
+}
+
+void LibraryModel::FilterIndexQuery(GroupBy type, LibraryItem* item,
+                                    LibraryIndex::Query* q) {
+  // The same filters as FilterQuery.
+  switch (type) {
+    case GroupBy_Artist:
+      if (IsCompilationArtistNode(item))
+        q->AddCompilationRequirement(true);
+      else {
+        q->AddCompilationRequirement(false);
+        q->AddWhere(LibraryIndex::Column_Artist, item->key);
+      }
+      break;
+    case GroupBy_Album:
+      q->AddWhere(LibraryIndex::Column_Album, item->key);
+      break;
+    case GroupBy_YearAlbum:
+      q->AddWhere(LibraryIndex::Column_Year,
+                  QString::number(item->metadata.year()));
+      q->AddWhere(LibraryIndex::Column_Album, item->metadata.album());
+      q->AddWhere(LibraryIndex::Column_Grouping, item->metadata.grouping());
+      break;
+    case GroupBy_OriginalYearAlbum:
+      q->AddWhere(LibraryIndex::Column_Year,
+                  QString::number(item->metadata.year()));
+      q->AddWhere(LibraryIndex::Column_OriginalYear,
+                  QString::number(item->metadata.originalyear()));
+      q->AddWhere(LibraryIndex::Column_Album, item->metadata.album());
+      q->AddWhere(LibraryIndex::Column_Grouping, item->metadata.grouping());
+      break;
+    case GroupBy_Year:
+      q->AddWhere(LibraryIndex::Column_Year, item->key);
+      break;
+    case GroupBy_OriginalYear:
+      q->AddWhere(LibraryIndex::Column_EffectiveOriginalYear, item->key);
+      break;
+    case GroupBy_Composer:
+      q->AddWhere(LibraryIndex::Column_Composer, item->key);
+      break;
+    case GroupBy_Performer:
+      q->AddWhere(LibraryIndex::Column_Performer, item->key);
+      break;
+    case GroupBy_Disc:
+      q->AddWhere(LibraryIndex::Column_Disc, item->key);
+      break;
+    case GroupBy_Grouping:
+      q->AddWhere(LibraryIndex::Column_Grouping, item->key);
+      break;
+    case GroupBy_Genre:
+      q->AddWhere(LibraryIndex::Column_Genre, item->key);
+      break;
+    case GroupBy_AlbumArtist:
+      if (IsCompilationArtistNode(item))
+        q->AddCompilationRequirement(true);
+      else {
+        q->AddCompilationRequirement(false);
+        q->AddWhere(LibraryIndex::Column_EffectiveAlbumArtist, item->key);
+      }
+      break;
+    case GroupBy_FileType:
+      q->AddWhere(LibraryIndex::Column_FileType,
+                  QString::number(item->metadata.filetype()));
+      break;
+    case GroupBy_Bitrate:
+      q->AddWhere(LibraryIndex::Column_Bitrate, item->key);
+      break;
+    case GroupBy_None:
+      qLog(Error) << "Unknown GroupBy type" << type << "used in filter";
+      break;
+  }
+}
+
 LibraryItem* LibraryModel::InitItem(GroupBy type, bool signal,
                                     LibraryItem* parent, int container_level) {
   LibraryItem::Type item_type = type == GroupBy_None
@@ -1249,7 +1840,7 @@ void LibraryModel::GetChildSongs(LibraryItem* item, QList<QUrl>* urls,
                                  SongList* songs, QSet<int>* song_ids) const {
   switch (item->type) {
     case LibraryItem::Type_Container: {
-      const_cast<LibraryModel*>(this)->LazyPopulate(item);
+      const_cast<LibraryModel*>(this)->LazyPopulate(item, true);
 
       QList<LibraryItem*> children = item->children;
       qSort(children.begin(), children.end(),
@@ -18,10 +18,18 @@
 #ifndef LIBRARYMODEL_H
 #define LIBRARYMODEL_H
 
+#include <memory>
+
 #include <QAbstractItemModel>
+#include <QFutureWatcher>
 #include <QIcon>
-#include <QNetworkDiskCache>
+#include <QImage>
+#include <QMutex>
+#include <QPersistentModelIndex>
+#include <QSet>
 
+#include "albumiconcache.h"
+#include "libraryindex.h"
 #include "libraryitem.h"
 #include "libraryquery.h"
 #include "librarywatcher.h"
@@ -58,6 +66,10 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   static const int kSmartPlaylistsVersion;
   static const int kPrettyCoverSize;
   static const qint64 kIconCacheSize;
+  // How many albums after the one being drawn have their icons loaded too.
+  static const int kIconPrefetchCount;
+  // How many child queries are put in one UNION ALL statement.
+  static const int kLazyPopulateQueriesPerStatement;
 
   enum Role {
     Role_Type = Qt::UserRole + 1,
@@ -114,6 +126,22 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
     bool create_va;
   };
 
+  // The query that finds the children of an item.  It's built on the GUI
+  // thread, since it looks at the item's parents, but can be run on any
+  // thread.
+  struct ChildQuery {
+    ChildQuery() : check_va(false), skip_compilations(false) {}
+
+    LibraryQuery query;
+    // Whether to look for compilations for a "Various artists" node, and
+    // whether to leave them out of the other results.
+    bool check_va;
+    bool skip_compilations;
+  };
+  // Results of the ChildQuerys run together on a worker thread, keyed by the
+  // ID of the lazy populate request.
+  typedef QMap<int, QueryResult> LazyPopulateResults;
+
   LibraryBackend* backend() const { return backend_; }
   LibraryDirectoryModel* directory_model() const { return dir_model_; }
 
@@ -140,6 +168,18 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   // Might be accurate
   int total_song_count() const { return total_song_count_; }
 
+  // When a view asks for the children of a node with fetchMore() they're
+  // loaded in the background, and a "Loading..." item is shown until they're
+  // ready.  These functions let the view manage that.
+  //
+  // Loads the children of the index straight away, waiting for the database.
+  void LazyPopulateNow(const QModelIndex& index);
+  // Starts loading the children of the indexes in the background, if they
+  // haven't been loaded already.
+  void PrefetchChildren(const QModelIndexList& indexes);
+  // Stops loading the children of the index if they're still being loaded.
+  void CancelLazyPopulate(const QModelIndex& index);
+
   // Smart playlists
   smart_playlists::GeneratorPtr CreateGenerator(const QModelIndex& index) const;
   void AddGenerator(smart_playlists::GeneratorPtr gen);
@@ -172,6 +212,9 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
 signals:
   void TotalSongCountUpdated(int count);
   void GroupingChanged(const LibraryModel::Grouping& g);
+  // Emitted when the children of the index have been loaded in the
+  // background.
+  void LazyPopulateFinished(const QModelIndex& index);
 
  public slots:
   void SetFilterAge(int age);
@@ -184,7 +227,9 @@ signals:
   void ResetAsync();
 
  protected:
-  void LazyPopulate(LibraryItem* item) { LazyPopulate(item, true); }
+  // Called by fetchMore() - loads the children in the background.
+  void LazyPopulate(LibraryItem* item) { LazyPopulateAsync(item); }
+  // Loads the children straight away.
   void LazyPopulate(LibraryItem* item, bool signal);
 
  private slots:
@@ -197,14 +242,54 @@ signals:
   // Called after ResetAsync
   void ResetAsyncQueryFinished();
 
+  void AlbumIconLoaded(const QString& cache_key,
+                       QFutureWatcher<QImage>* watcher);
   void AlbumArtLoaded(quint64 id, const QImage& image);
 
+  void StartLazyPopulateQueries();
+  void LazyPopulateQueriesFinished(
+      QFutureWatcher<LazyPopulateResults>* watcher);
+
+  void DatabaseReset();
+  void IndexLoaded(int generation, QFutureWatcher<LibraryIndex*>* watcher);
+  void FilterQueryFinished(const QString& filter,
+                           QFutureWatcher<QSet<int>>* watcher);
+
  private:
   // Provides some optimisations for loading the list of items in the root.
   // This gets called a lot when filtering the playlist, so it's nice to be
   // able to do it in a background thread.
   QueryResult RunQuery(LibraryItem* parent);
+  ChildQuery BuildChildQuery(LibraryItem* parent);
+  QueryResult RunChildQuery(const ChildQuery& query);
   void PostQuery(LibraryItem* parent, const QueryResult& result, bool signal);
+  // Replaces the whole tree with a new top level.
+  void ResetWithResult(const QueryResult& result);
+
+  // Containers can be built from the LibraryIndex once it's loaded, instead
+  // of querying the database.  Songs are still loaded from the database.
+  void LoadIndexAsync();
+  LibraryIndex* LoadIndex();
+  void UpdateIndex(const SongList& songs, bool deleted);
+  // Returns true if the children of the parent can be found in the index with
+  // the current query options.
+  bool CanQueryIndex(LibraryItem* parent) const;
+  QueryResult RunIndexQuery(LibraryItem* parent);
+  // Finds the IDs of the songs that match the filter text with one database
+  // query.  The index doesn't know how to match text like the FTS table does.
+  QSet<int> RunFilterQuery(const QueryOptions& options);
+
+  // Adds a "Loading..." item to the parent and queues a query for its
+  // children.  The queries queued before the GUI thread gets back to the event
+  // loop are run together as one SQL statement by RunLazyPopulateQueries.
+  void LazyPopulateAsync(LibraryItem* parent);
+  void QueueLazyPopulateQuery(LibraryItem* parent);
+  LazyPopulateResults RunLazyPopulateQueries(
+      const QMap<int, ChildQuery>& queries);
+  // Forgets about the query for the parent's children.  Returns false if
+  // there wasn't one.
+  bool CancelLazyPopulateQuery(LibraryItem* parent);
+  void RemoveLoadingIndicator(LibraryItem* parent);
 
   bool HasCompilations(const LibraryQuery& query);
 
@@ -217,6 +302,10 @@ signals:
   // album or artist for example.
   static void InitQuery(GroupBy type, LibraryQuery* q);
   void FilterQuery(GroupBy type, LibraryItem* item, LibraryQuery* q);
+  // The same, for queries on the LibraryIndex.
+  static QList<LibraryIndex::Column> IndexColumns(GroupBy type);
+  void FilterIndexQuery(GroupBy type, LibraryItem* item,
+                        LibraryIndex::Query* q);
 
   // Items can be created either from a query that's been run to populate a
   // node, or by a spontaneous SongsDiscovered emission from the backend.
@@ -246,8 +335,12 @@ signals:
   QString DividerDisplayText(GroupBy type, const QString& key) const;
 
   // Helpers
+  bool IsAlbumNode(const LibraryItem* item) const;
   QString AlbumIconPixmapCacheKey(const QModelIndex& index) const;
   QVariant AlbumIcon(const QModelIndex& index);
+  // Starts loading the icon for an album from the disk cache on a worker
+  // thread, unless it's loaded or being loaded already.
+  void LoadAlbumIconAsync(const QModelIndex& index);
   QVariant data(const LibraryItem* item, int role) const;
   bool CompareItems(const LibraryItem* a, const LibraryItem* b) const;
 
@@ -284,7 +377,7 @@ signals:
   QIcon playlists_dir_icon_;
   QIcon playlist_icon_;
 
-  QNetworkDiskCache* icon_cache_;
+  AlbumIconCache icon_cache_;
 
   int init_task_id_;
 
@@ -293,9 +386,35 @@ signals:
 
   AlbumCoverLoaderOptions cover_loader_options_;
 
-  typedef QPair<LibraryItem*, QString> ItemAndCacheKey;
-  QMap<quint64, ItemAndCacheKey> pending_art_;
-  QSet<QString> pending_cache_keys_;
+  // Album icons being loaded from the disk cache or the AlbumCoverLoader,
+  // keyed by their cache key.  The indexes become invalid if the album is
+  // removed or the model is reset before the icon is loaded.
+  QMap<QString, QPersistentModelIndex> pending_icon_loads_;
+  // AlbumCoverLoader request ID -> cache key.
+  QMap<quint64, QString> pending_art_;
+
+  // Items whose children are being loaded in the background, and the queries
+  // that haven't been sent to a worker thread yet, keyed by request ID.
+  int next_lazy_populate_id_;
+  QMap<int, LibraryItem*> pending_lazy_populates_;
+  QMap<int, ChildQuery> queued_lazy_populates_;
+  // Requests cancelled after their query was sent to a worker thread.
+  QMutex cancelled_lazy_populates_mutex_;
+  QSet<int> cancelled_lazy_populates_;
+
+  std::unique_ptr<LibraryIndex> index_;
+  // Incremented each time the index is reloaded, so an old load that
+  // finishes late is ignored.
+  int index_generation_;
+  // Loads that haven't reached IndexLoaded yet, keyed by generation.
+  QMap<int, QFuture<LibraryIndex*>> loading_indexes_;
+  // Changes to the library made while the index is being loaded.  They're
+  // applied in order once it's loaded, since the load might have missed them.
+  QList<QPair<SongList, bool>> pending_index_updates_;
+  // The songs that match filter_song_ids_text_, when the tree is built from
+  // the index with a filter.
+  QSet<int> filter_song_ids_;
+  QString filter_song_ids_text_;
 };
 
 Q_DECLARE_METATYPE(LibraryModel::Grouping);
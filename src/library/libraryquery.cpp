@@ -94,7 +94,7 @@ LibraryQuery::LibraryQuery(const QueryOptions& options)
   }
 }
 
-QString LibraryQuery::GetInnerQuery() {
+QString LibraryQuery::GetInnerQuery() const {
   return duplicates_only_
              ? QString(
                    " INNER JOIN (select * from duplicated_songs) dsongs        "
@@ -109,7 +109,7 @@ void LibraryQuery::AddWhere(const QString& column, const QVariant& value,
   // ignore 'literal' for IN
   if (!op.compare("IN", Qt::CaseInsensitive)) {
     QStringList final;
-    for (const QString& single_value : value.toStringList()) {
+    for (const QVariant& single_value : value.toList()) {
       final.append("?");
       bound_values_ << single_value;
     }
@@ -138,8 +138,8 @@ void LibraryQuery::AddCompilationRequirement(bool compilation) {
                         .arg(compilation ? 1 : 0);
 }
 
-QSqlQuery LibraryQuery::Exec(QSqlDatabase db, const QString& songs_table,
-                             const QString& fts_table) {
+QString LibraryQuery::GetSql(const QString& songs_table,
+                             const QString& fts_table) const {
   QString sql;
 
   if (join_with_fts_) {
@@ -165,8 +165,12 @@ QSqlQuery LibraryQuery::Exec(QSqlDatabase db, const QString& songs_table,
   sql.replace("%songs_table", songs_table);
   sql.replace("%fts_table_noprefix", fts_table.section('.', -1, -1));
   sql.replace("%fts_table", fts_table);
+  return sql;
+}
 
-  query_ = QSqlQuery(sql, db);
+QSqlQuery LibraryQuery::Exec(QSqlDatabase db, const QString& songs_table,
+                             const QString& fts_table) {
+  query_ = QSqlQuery(GetSql(songs_table, fts_table), db);
 
   // Bind values
   for (const QVariant& value : bound_values_) {
@@ -177,6 +181,30 @@ QSqlQuery LibraryQuery::Exec(QSqlDatabase db, const QString& songs_table,
   return query_;
 }
 
+QSqlQuery LibraryQuery::ExecUnion(const QList<LibraryQuery>& queries,
+                                  QSqlDatabase db, const QString& songs_table,
+                                  const QString& fts_table) {
+  // Each query goes in a subselect so it keeps its own ORDER BY and LIMIT.
+  QStringList selects;
+  for (int i = 0; i < queries.count(); ++i) {
+    selects << QString("SELECT *, %1 FROM (%2)")
+                   .arg(i)
+                   .arg(queries[i].GetSql(songs_table, fts_table));
+  }
+
+  QSqlQuery query(selects.join(" UNION ALL "), db);
+
+  // The placeholders are in the same order as the queries.
+  for (const LibraryQuery& q : queries) {
+    for (const QVariant& value : q.bound_values_) {
+      query.addBindValue(value);
+    }
+  }
+
+  query.exec();
+  return query;
+}
+
 bool LibraryQuery::Next() { return query_.next(); }
 
 QVariant LibraryQuery::Value(int column) const { return query_.value(column); }
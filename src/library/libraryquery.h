@@ -76,7 +76,8 @@ class LibraryQuery {
 
   // Adds a fragment of WHERE clause. When executed, this Query will connect all
   // the fragments with AND operator.
-  // Please note that IN operator expects a QStringList as value.
+  // Please note that IN operator expects a QStringList or a QVariantList as
+  // value.
   void AddWhere(const QString& column, const QVariant& value,
                 const QString& op = "=");
 
@@ -88,13 +89,23 @@ class LibraryQuery {
 
   QSqlQuery Exec(QSqlDatabase db, const QString& songs_table,
                  const QString& fts_table);
+
+  // Runs all the queries as one UNION ALL statement.  Each row gets an extra
+  // column at the end with the index in queries of the query it came from.
+  // The queries must all return the same number of columns.
+  static QSqlQuery ExecUnion(const QList<LibraryQuery>& queries,
+                             QSqlDatabase db, const QString& songs_table,
+                             const QString& fts_table);
+
+  const QString& column_spec() const { return column_spec_; }
   bool Next();
   QVariant Value(int column) const;
 
   operator const QSqlQuery&() const { return query_; }
 
  private:
-  QString GetInnerQuery();
+  QString GetInnerQuery() const;
+  QString GetSql(const QString& songs_table, const QString& fts_table) const;
 
   bool include_unavailable_;
   bool join_with_fts_;
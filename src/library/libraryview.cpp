@@ -49,6 +49,7 @@
 using smart_playlists::Wizard;
 
 const char* LibraryView::kSettingsGroup = "LibraryView";
+const int LibraryView::kPrefetchSiblingCount = 10;
 
 LibraryItemDelegate::LibraryItemDelegate(QObject* parent)
     : QStyledItemDelegate(parent) {}
@@ -180,6 +181,11 @@ LibraryView::LibraryView(QWidget* parent)
   setSelectionMode(QAbstractItemView::ExtendedSelection);
 
   setStyleSheet("QTreeView::item{padding-top:1px;}");
+
+  connect(this, SIGNAL(expanded(QModelIndex)),
+          SLOT(PrefetchSiblings(QModelIndex)));
+  connect(this, SIGNAL(collapsed(QModelIndex)),
+          SLOT(CancelLazyPopulate(QModelIndex)));
 }
 
 LibraryView::~LibraryView() {}
@@ -245,9 +251,7 @@ void LibraryView::RestoreFocus() {
 }
 
 bool LibraryView::RestoreLevelFocus(const QModelIndex& parent) {
-  if (model()->canFetchMore(parent)) {
-    model()->fetchMore(parent);
-  }
+  FetchMoreNow(parent);
   int rows = model()->rowCount(parent);
   for (int i = 0; i < rows; i++) {
     QModelIndex current = model()->index(i, 0, parent);
@@ -310,6 +314,61 @@ void LibraryView::ReloadSettings() {
 void LibraryView::SetApplication(Application* app) {
   app_ = app;
   ReloadSettings();
+
+  connect(app_->library_model(), SIGNAL(LazyPopulateFinished(QModelIndex)),
+          SLOT(LazyPopulateFinished(QModelIndex)));
+}
+
+void LibraryView::FetchMoreNow(const QModelIndex& index) {
+  QSortFilterProxyModel* proxy = qobject_cast<QSortFilterProxyModel*>(model());
+  if (!app_ || !proxy || !index.isValid()) {
+    AutoExpandingTreeView::FetchMoreNow(index);
+    return;
+  }
+
+  // The library model's fetchMore() loads the children in the background.
+  app_->library_model()->LazyPopulateNow(proxy->mapToSource(index));
+}
+
+void LibraryView::PrefetchSiblings(const QModelIndex& index) {
+  QSortFilterProxyModel* proxy = qobject_cast<QSortFilterProxyModel*>(model());
+  if (!app_ || !proxy) return;
+
+  // The user is likely to expand the nodes next to this one as well, so start
+  // loading the children of the ones on the screen now.
+  const QRect visible_rect = viewport()->rect();
+  const QModelIndex parent = index.parent();
+  const int first = qMax(0, index.row() - kPrefetchSiblingCount);
+  const int last =
+      qMin(model()->rowCount(parent) - 1, index.row() + kPrefetchSiblingCount);
+
+  QModelIndexList siblings;
+  for (int row = first; row <= last; ++row) {
+    const QModelIndex sibling = model()->index(row, 0, parent);
+    if (row != index.row() && !isExpanded(sibling) &&
+        visualRect(sibling).intersects(visible_rect)) {
+      siblings << proxy->mapToSource(sibling);
+    }
+  }
+  app_->library_model()->PrefetchChildren(siblings);
+}
+
+void LibraryView::CancelLazyPopulate(const QModelIndex& index) {
+  QSortFilterProxyModel* proxy = qobject_cast<QSortFilterProxyModel*>(model());
+  if (!app_ || !proxy) return;
+
+  app_->library_model()->CancelLazyPopulate(proxy->mapToSource(index));
+}
+
+void LibraryView::LazyPopulateFinished(const QModelIndex& source_index) {
+  QSortFilterProxyModel* proxy = qobject_cast<QSortFilterProxyModel*>(model());
+  if (!proxy) return;
+
+  // Now the children are there, open the node's only child if it has one.
+  const QModelIndex index = proxy->mapFromSource(source_index);
+  if (isExpanded(index)) {
+    ItemExpanded(index);
+  }
 }
 
 void LibraryView::SetFilter(LibraryFilterWidget* filter) { filter_ = filter; }
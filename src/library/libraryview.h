@@ -57,6 +57,9 @@ class LibraryView : public AutoExpandingTreeView {
   ~LibraryView();
 
   static const char* kSettingsGroup;
+  // How many siblings on each side of an expanded node have their children
+  // loaded too, if they're visible.
+  static const int kPrefetchSiblingCount;
 
   // Returns Songs currently selected in the library view. Please note that the
   // selection is recursive meaning that if for example an album is selected
@@ -88,6 +91,9 @@ signals:
   void mouseReleaseEvent(QMouseEvent* e);
   void contextMenuEvent(QContextMenuEvent* e);
 
+  // AutoExpandingTreeView
+  void FetchMoreNow(const QModelIndex& index);
+
  private slots:
   void Load();
   void AddToPlaylist();
@@ -110,6 +116,10 @@ signals:
 
   void DeleteFinished(const SongList& songs_with_errors);
 
+  void PrefetchSiblings(const QModelIndex& index);
+  void CancelLazyPopulate(const QModelIndex& index);
+  void LazyPopulateFinished(const QModelIndex& source_index);
+
  private:
   void RecheckIsEmpty();
   void ShowInVarious(bool on);
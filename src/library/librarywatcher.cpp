@@ -46,6 +46,8 @@
 QStringList LibraryWatcher::sValidImages;
 
 const char* LibraryWatcher::kSettingsGroup = "LibraryWatcher";
+const int LibraryWatcher::kCommitBatchSize = 1000;
+const int LibraryWatcher::kPendingBatchesPerWorker = 2;
 
 LibraryWatcher::LibraryWatcher(QObject* parent)
     : QObject(parent),
@@ -84,7 +86,9 @@ LibraryWatcher::ScanTransaction::ScanTransaction(LibraryWatcher* watcher,
       ignores_mtime_(ignores_mtime),
       watcher_(watcher),
       cached_songs_dirty_(true),
-      known_subdirs_dirty_(true) {
+      known_subdirs_dirty_(true),
+      max_pending_batches_(QThread::idealThreadCount() *
+                           kPendingBatchesPerWorker) {
   QString description;
   if (watcher_->device_name_.isEmpty())
     description = tr("Updating library");
@@ -96,16 +100,15 @@ LibraryWatcher::ScanTransaction::ScanTransaction(LibraryWatcher* watcher,
 }
 
 LibraryWatcher::ScanTransaction::~ScanTransaction() {
+  // The replies still belong to the worker pool until they finish, so wait
+  // for them even if we're stopping.
+  if (!watcher_->stop_requested_) SendTagReads();
+  FinishTagReads();
+
   // If we're stopping then don't commit the transaction
   if (watcher_->stop_requested_) return;
 
-  if (!new_songs.isEmpty()) emit watcher_->NewOrUpdatedSongs(new_songs);
-
-  if (!touched_songs.isEmpty()) emit watcher_->SongsMTimeUpdated(touched_songs);
-
-  if (!deleted_songs.isEmpty()) emit watcher_->SongsDeleted(deleted_songs);
-
-  if (!readded_songs.isEmpty()) emit watcher_->SongsReadded(readded_songs);
+  CommitSongs();
 
   if (!new_subdirs.isEmpty()) emit watcher_->SubdirsDiscovered(new_subdirs);
 
@@ -122,6 +125,96 @@ LibraryWatcher::ScanTransaction::~ScanTransaction() {
   }
 }
 
+void LibraryWatcher::ScanTransaction::CommitSongs() {
+  if (!new_songs.isEmpty()) emit watcher_->NewOrUpdatedSongs(new_songs);
+
+  if (!touched_songs.isEmpty()) emit watcher_->SongsMTimeUpdated(touched_songs);
+
+  if (!deleted_songs.isEmpty()) emit watcher_->SongsDeleted(deleted_songs);
+
+  if (!readded_songs.isEmpty()) emit watcher_->SongsReadded(readded_songs);
+
+  new_songs.clear();
+  touched_songs.clear();
+  deleted_songs.clear();
+  readded_songs.clear();
+}
+
+void LibraryWatcher::ScanTransaction::MaybeCommitSongs() {
+  if (watcher_->stop_requested_) return;
+
+  const int count = new_songs.count() + touched_songs.count() +
+                    deleted_songs.count() + readded_songs.count();
+  if (count >= kCommitBatchSize) CommitSongs();
+}
+
+void LibraryWatcher::ScanTransaction::QueueTagRead(const QString& file,
+                                                   const QString& image,
+                                                   const Song& matching_song) {
+  PendingTagRead read;
+  read.file = file;
+  read.image = image;
+  read.matching_song = matching_song;
+  unsent_reads_ << read;
+
+  if (unsent_reads_.count() >= TagReaderClient::kReadFilesBatchSize) {
+    SendTagReads();
+  }
+}
+
+void LibraryWatcher::ScanTransaction::SendTagReads() {
+  if (unsent_reads_.isEmpty()) return;
+
+  FinishTagReads(max_pending_batches_ - 1);
+
+  QStringList filenames;
+  for (const PendingTagRead& read : unsent_reads_) {
+    filenames << read.file;
+  }
+
+  PendingTagReadBatch batch;
+  batch.reads = unsent_reads_;
+  batch.replies = TagReaderClient::Instance()->ReadFiles(filenames);
+  pending_batches_.enqueue(batch);
+
+  unsent_reads_.clear();
+}
+
+void LibraryWatcher::ScanTransaction::FinishTagReads(int max_pending) {
+  while (pending_batches_.count() > max_pending) {
+    PendingTagReadBatch batch = pending_batches_.dequeue();
+
+    int index = 0;
+    for (TagReaderReply* reply : batch.replies) {
+      const bool success = reply->WaitForFinished();
+      const pb::tagreader::ReadFilesResponse& response =
+          reply->message().read_files_response();
+      const int batch_size = qMin(TagReaderClient::kReadFilesBatchSize,
+                                  batch.reads.count() - index);
+
+      for (int i = 0; i < batch_size; ++i) {
+        const PendingTagRead& read = batch.reads[index + i];
+
+        Song song_on_disk;
+        song_on_disk.set_directory_id(dir_);
+        if (success && i < response.metadata_size()) {
+          song_on_disk.InitFromProtobuf(response.metadata(i));
+        }
+
+        if (watcher_->stop_requested_) continue;
+
+        watcher_->TagReadFinished(read.file, read.image, read.matching_song,
+                                  &song_on_disk, this);
+      }
+
+      reply->deleteLater();
+      index += batch_size;
+    }
+
+    MaybeCommitSongs();
+  }
+}
+
 void LibraryWatcher::ScanTransaction::AddToProgress(int n) {
   progress_ += n;
   watcher_->task_manager_->SetTaskProgress(task_id_, progress_, progress_max_);
@@ -135,32 +228,37 @@ void LibraryWatcher::ScanTransaction::AddToProgressMax(int n) {
 SongList LibraryWatcher::ScanTransaction::FindSongsInSubdirectory(
     const QString& path) {
   if (cached_songs_dirty_) {
-    cached_songs_ = watcher_->backend_->FindSongsInDirectory(dir_);
+    cached_songs_.clear();
+    for (const Song& song : watcher_->backend_->FindSongsInDirectory(dir_)) {
+      cached_songs_[DirectoryPart(song.url().toLocalFile())] << song;
+    }
     cached_songs_dirty_ = false;
   }
 
-  // TODO: Make this faster
-  SongList ret;
-  for (const Song& song : cached_songs_) {
-    if (song.url().toLocalFile().section('/', 0, -2) == path) ret << song;
-  }
-  return ret;
+  return cached_songs_.value(path);
 }
 
 void LibraryWatcher::ScanTransaction::SetKnownSubdirs(
     const SubdirectoryList& subdirs) {
   known_subdirs_ = subdirs;
   known_subdirs_dirty_ = false;
+
+  seen_subdir_paths_.clear();
+  known_subdirs_by_parent_.clear();
+  for (const Subdirectory& subdir : known_subdirs_) {
+    if (subdir.mtime == 0) continue;
+
+    seen_subdir_paths_.insert(subdir.path);
+    known_subdirs_by_parent_[subdir.path.left(
+        subdir.path.lastIndexOf(QDir::separator()))] << subdir;
+  }
 }
 
 bool LibraryWatcher::ScanTransaction::HasSeenSubdir(const QString& path) {
   if (known_subdirs_dirty_)
     SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
 
-  for (const Subdirectory& subdir : known_subdirs_) {
-    if (subdir.path == path && subdir.mtime != 0) return true;
-  }
-  return false;
+  return seen_subdir_paths_.contains(path);
 }
 
 SubdirectoryList LibraryWatcher::ScanTransaction::GetImmediateSubdirs(
@@ -168,15 +266,7 @@ SubdirectoryList LibraryWatcher::ScanTransaction::GetImmediateSubdirs(
   if (known_subdirs_dirty_)
     SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
 
-  SubdirectoryList ret;
-  for (const Subdirectory& subdir : known_subdirs_) {
-    if (subdir.path.left(subdir.path.lastIndexOf(QDir::separator())) == path &&
-        subdir.mtime != 0) {
-      ret << subdir;
-    }
-  }
-
-  return ret;
+  return known_subdirs_by_parent_.value(path);
 }
 
 SubdirectoryList LibraryWatcher::ScanTransaction::GetAllSubdirs() {
@@ -192,10 +282,14 @@ void LibraryWatcher::AddDirectory(const Directory& dir,
   if (subdirs.isEmpty()) {
     // This is a new directory that we've never seen before.
     // Scan it fully.
-    ScanTransaction transaction(this, dir.id, false);
-    transaction.SetKnownSubdirs(subdirs);
-    transaction.AddToProgressMax(1);
-    ScanSubdirectory(dir.path, Subdirectory(), &transaction);
+    emit NewDirectoryScanStarted();
+    {
+      ScanTransaction transaction(this, dir.id, false);
+      transaction.SetKnownSubdirs(subdirs);
+      transaction.AddToProgressMax(1);
+      ScanSubdirectory(dir.path, Subdirectory(), &transaction);
+    }
+    emit NewDirectoryScanFinished();
   } else {
     // We can do an incremental scan - looking at the mtimes of each
     // subdirectory and only rescan if the directory has changed.
@@ -240,6 +334,7 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
 
   QMap<QString, QStringList> album_art;
   QStringList files_on_disk;
+  QSet<QString> files_on_disk_set;
   SubdirectoryList my_new_subdirs;
 
   // If a directory is moved then only its parent gets a changed notification,
@@ -281,8 +376,10 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
 
       if (sValidImages.contains(ext_part))
         album_art[dir_part] << child;
-      else if (!child_info.isHidden())
+      else if (!child_info.isHidden()) {
         files_on_disk << child;
+        files_on_disk_set.insert(child);
+      }
     }
   }
 
@@ -291,6 +388,18 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
   // Ask the database for a list of files in this directory
   SongList songs_in_db = t->FindSongsInSubdirectory(path);
 
+  // Index them by filename so comparing them with the files on disk is linear
+  // even in directories with thousands of files.  For files with several cue
+  // sections the first one is used.
+  QHash<QString, Song> songs_in_db_by_path;
+  songs_in_db_by_path.reserve(songs_in_db.count());
+  for (const Song& song : songs_in_db) {
+    const QString song_path = song.url().toLocalFile();
+    if (!songs_in_db_by_path.contains(song_path)) {
+      songs_in_db_by_path.insert(song_path, song);
+    }
+  }
+
   QSet<QString> cues_processed;
 
   // Now compare the list from the database with the list of files on disk
@@ -300,8 +409,10 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
     // associated cue
     QString matching_cue = NoExtensionPart(file) + ".cue";
 
-    Song matching_song;
-    if (FindSongByPath(songs_in_db, file, &matching_song)) {
+    QHash<QString, Song>::const_iterator matching_it =
+        songs_in_db_by_path.constFind(file);
+    if (matching_it != songs_in_db_by_path.constEnd()) {
+      const Song& matching_song = *matching_it;
       uint matching_cue_mtime = GetMtimeForCue(matching_cue);
 
       // The song is in the database and still on disk.
@@ -311,7 +422,7 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
       if (!file_info.exists()) {
         // Partially fixes race condition - if file was removed between being
         // added to the list and now.
-        files_on_disk.removeAll(file);
+        files_on_disk_set.remove(file);
         continue;
       }
 
@@ -357,16 +468,17 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
 
     } else {
       // The song is on disk but not in the DB
-      SongList song_list =
-          ScanNewFile(file, path, matching_cue, &cues_processed);
+      // choose an image for the song(s)
+      QString image = ImageForSong(file, album_art);
+
+      SongList song_list = ScanNewFile(file, path, matching_cue, image,
+                                       &cues_processed, t);
 
       if (song_list.isEmpty()) {
         continue;
       }
 
       qLog(Debug) << file << "created";
-      // choose an image for the song(s)
-      QString image = ImageForSong(file, album_art);
 
       for (Song song : song_list) {
         song.set_directory_id(t->dir());
@@ -380,12 +492,14 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
   // Look for deleted songs
   for (const Song& song : songs_in_db) {
     if (!song.is_unavailable() &&
-        !files_on_disk.contains(song.url().toLocalFile())) {
+        !files_on_disk_set.contains(song.url().toLocalFile())) {
       qLog(Debug) << "Song deleted from disk:" << song.url().toLocalFile();
       t->deleted_songs << song;
     }
   }
 
+  t->MaybeCommitSongs();
+
   // Add this subdir to the new or touched list
   Subdirectory updated_subdir;
   updated_subdir.directory_id = t->dir();
@@ -465,18 +579,31 @@ void LibraryWatcher::UpdateNonCueAssociatedSong(const QString& file,
     }
   }
 
-  Song song_on_disk;
-  song_on_disk.set_directory_id(t->dir());
-  TagReaderClient::Instance()->ReadFileBlocking(file, &song_on_disk);
+  t->QueueTagRead(file, image, matching_song);
+}
+
+void LibraryWatcher::TagReadFinished(const QString& file, const QString& image,
+                                     const Song& matching_song,
+                                     Song* song_on_disk, ScanTransaction* t) {
+  if (!song_on_disk->is_valid()) return;
 
-  if (song_on_disk.is_valid()) {
-    PreserveUserSetData(file, image, matching_song, &song_on_disk, t);
+  if (matching_song.is_valid()) {
+    PreserveUserSetData(file, image, matching_song, song_on_disk, t);
+  } else {
+    qLog(Debug) << file << "created";
+
+    if (song_on_disk->art_automatic().isEmpty())
+      song_on_disk->set_art_automatic(image);
+
+    t->new_songs << *song_on_disk;
   }
 }
 
 SongList LibraryWatcher::ScanNewFile(const QString& file, const QString& path,
                                      const QString& matching_cue,
-                                     QSet<QString>* cues_processed) {
+                                     const QString& image,
+                                     QSet<QString>* cues_processed,
+                                     ScanTransaction* t) {
   SongList song_list;
 
   uint matching_cue_mtime = GetMtimeForCue(matching_cue);
@@ -505,12 +632,7 @@ SongList LibraryWatcher::ScanNewFile(const QString& file, const QString& path,
 
     // it's a normal media file
   } else {
-    Song song;
-    TagReaderClient::Instance()->ReadFileBlocking(file, &song);
-
-    if (song.is_valid()) {
-      song_list << song;
-    }
+    t->QueueTagRead(file, image, Song());
   }
 
   return song_list;
@@ -582,18 +704,6 @@ void LibraryWatcher::RemoveDirectory(const Directory& dir) {
   }
 }
 
-bool LibraryWatcher::FindSongByPath(const SongList& list, const QString& path,
-                                    Song* out) {
-  // TODO: Make this faster
-  for (const Song& song : list) {
-    if (song.url().toLocalFile() == path) {
-      *out = song;
-      return true;
-    }
-  }
-  return false;
-}
-
 void LibraryWatcher::DirectoryChanged(const QString& subdir) {
   // Find what dir it was in
   QHash<QString, Directory>::const_iterator it =
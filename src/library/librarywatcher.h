@@ -20,9 +20,12 @@
 
 #include "directory.h"
 #include "core/song.h"
+#include "core/tagreaderclient.h"
 
 #include <QHash>
 #include <QObject>
+#include <QQueue>
+#include <QSet>
 #include <QStringList>
 #include <QMap>
 
@@ -42,6 +45,13 @@ class LibraryWatcher : public QObject {
 
   static const char* kSettingsGroup;
 
+  // Number of changed songs a ScanTransaction collects before sending them to
+  // the LibraryBackend.
+  static const int kCommitBatchSize;
+
+  // Number of tag read batches kept in flight per tagreader worker.
+  static const int kPendingBatchesPerWorker;
+
   void set_backend(LibraryBackend* backend) { backend_ = backend; }
   void set_task_manager(TaskManager* task_manager) {
     task_manager_ = task_manager;
@@ -66,6 +76,11 @@ signals:
   void SubdirsMTimeUpdated(const SubdirectoryList& subdirs);
   void CompilationsNeedUpdating();
 
+  // Emitted around the first scan of a directory, which can find a lot of
+  // new songs at once.
+  void NewDirectoryScanStarted();
+  void NewDirectoryScanFinished();
+
   void ScanStarted(int task_id);
 
  public slots:
@@ -79,7 +94,10 @@ signals:
   // Each directory has one or more subdirectories, and any number of
   // subdirectories can be scanned during one transaction.  ScanSubdirectory()
   // adds its results to the members of this transaction class, and they are
-  // "committed" through calls to the LibraryBackend in the transaction's dtor.
+  // "committed" through calls to the LibraryBackend in batches of
+  // kCommitBatchSize songs while the scan is running, and finally in the
+  // transaction's dtor.  Subdirectory mtimes are only committed in the dtor, so
+  // an interrupted scan will look at the same subdirectories again next time.
   // The transaction also caches the list of songs in this directory according
   // to the library.  Multiple calls to FindSongsInSubdirectory during one
   // transaction will only result in one call to
@@ -99,6 +117,28 @@ signals:
     void AddToProgress(int n = 1);
     void AddToProgressMax(int n);
 
+    // Queues the file to have its tags read by the tagreader worker pool and
+    // returns without waiting for the result.  Files are sent to the workers
+    // in batches of TagReaderClient::kReadFilesBatchSize, so several batches
+    // are read in parallel by all the workers.  At most max_pending_batches_
+    // batches are kept in flight - if there are already that many this waits
+    // for the oldest one to finish first.  matching_song is the song already
+    // in the library for this file, or an invalid Song if the file is new.
+    void QueueTagRead(const QString& file, const QString& image,
+                      const Song& matching_song);
+
+    // Sends the files queued so far to the tagreader even if there aren't
+    // enough to fill a batch.
+    void SendTagReads();
+
+    // Waits until no more than max_pending batches are left in flight,
+    // handing each finished file to LibraryWatcher::TagReadFinished.
+    void FinishTagReads(int max_pending = 0);
+
+    // Emits the songs found so far to the backend if there are more than
+    // kCommitBatchSize of them.
+    void MaybeCommitSongs();
+
     int dir() const { return dir_; }
     bool is_incremental() const { return incremental_; }
     bool ignores_mtime() const { return ignores_mtime_; }
@@ -114,6 +154,19 @@ signals:
     ScanTransaction(const ScanTransaction&) {}
     ScanTransaction& operator=(const ScanTransaction&) { return *this; }
 
+    struct PendingTagRead {
+      QString file;
+      QString image;
+      Song matching_song;
+    };
+
+    struct PendingTagReadBatch {
+      QList<PendingTagRead> reads;
+      QList<TagReaderReply*> replies;
+    };
+
+    void CommitSongs();
+
     int task_id_;
     int progress_;
     int progress_max_;
@@ -130,11 +183,20 @@ signals:
 
     LibraryWatcher* watcher_;
 
-    SongList cached_songs_;
+    // Songs in the library keyed by the path of the subdirectory they're in.
+    QHash<QString, SongList> cached_songs_;
     bool cached_songs_dirty_;
 
     SubdirectoryList known_subdirs_;
+    // Paths of known subdirectories that have been scanned before, and known
+    // subdirectories keyed by the path of their parent.
+    QSet<QString> seen_subdir_paths_;
+    QHash<QString, SubdirectoryList> known_subdirs_by_parent_;
     bool known_subdirs_dirty_;
+
+    int max_pending_batches_;
+    QList<PendingTagRead> unsent_reads_;
+    QQueue<PendingTagReadBatch> pending_batches_;
   };
 
  private slots:
@@ -146,8 +208,6 @@ signals:
                         ScanTransaction* t, bool force_noincremental = false);
 
  private:
-  static bool FindSongByPath(const SongList& list, const QString& path,
-                             Song* out);
   inline static QString NoExtensionPart(const QString& fileName);
   inline static QString ExtensionPart(const QString& fileName);
   inline static QString DirectoryPart(const QString& fileName);
@@ -169,6 +229,12 @@ signals:
                                   const Song& matching_song,
                                   const QString& image, bool cue_deleted,
                                   ScanTransaction* t);
+  // Called by the ScanTransaction when the tags of a file queued with
+  // QueueTagRead have been read.  Adds a new song or updates the existing
+  // matching_song.
+  void TagReadFinished(const QString& file, const QString& image,
+                       const Song& matching_song, Song* song_on_disk,
+                       ScanTransaction* t);
   // Updates a new song with some metadata taken from it's equivalent old
   // song (for example rating and score).
   void PreserveUserSetData(const QString& file, const QString& image,
@@ -177,10 +243,12 @@ signals:
   // Scans a single media file that's present on the disk but not yet in the
   // library.
   // It may result in a multiple files added to the library when the media file
-  // has many sections (like a CUE related media file).
+  // has many sections (like a CUE related media file).  Plain media files are
+  // queued on the transaction with QueueTagRead instead, and are added to the
+  // library when the tagreader replies.
   SongList ScanNewFile(const QString& file, const QString& path,
-                       const QString& matching_cue,
-                       QSet<QString>* cues_processed);
+                       const QString& matching_cue, const QString& image,
+                       QSet<QString>* cues_processed, ScanTransaction* t);
 
  private:
   LibraryBackend* backend_;
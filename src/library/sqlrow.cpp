@@ -18,12 +18,19 @@
 #include "libraryquery.h"
 #include "sqlrow.h"
 
+#include <sqlite3.h>
+
 #include <QSqlQuery>
 #include <QSqlRecord>
 
-SqlRow::SqlRow(const QSqlQuery& query) { Init(query); }
+SqlRow::SqlRow(const QSqlQuery& query) : stmt_(nullptr) { Init(query); }
+
+SqlRow::SqlRow(const LibraryQuery& query) : stmt_(nullptr) { Init(query); }
 
-SqlRow::SqlRow(const LibraryQuery& query) { Init(query); }
+SqlRow::SqlRow(sqlite3_stmt* stmt) : stmt_(stmt) {}
+
+SqlRow::SqlRow(const QList<QVariant>& columns)
+    : stmt_(nullptr), columns_(columns) {}
 
 void SqlRow::Init(const QSqlQuery& query) {
   int rows = query.record().count();
@@ -31,3 +38,74 @@ void SqlRow::Init(const QSqlQuery& query) {
     columns_ << query.value(i);
   }
 }
+
+SqlRow SqlRow::Copy() const {
+  if (!stmt_) return *this;
+
+  QList<QVariant> columns;
+  const int count = sqlite3_column_count(stmt_);
+  for (int i = 0; i < count; ++i) {
+    columns << value(i);
+  }
+  return SqlRow(columns);
+}
+
+QVariant SqlRow::value(int i) const {
+  if (!stmt_) return columns_[i];
+
+  switch (sqlite3_column_type(stmt_, i)) {
+    case SQLITE_INTEGER:
+      return ToLongLong(i);
+    case SQLITE_FLOAT:
+      return ToDouble(i);
+    case SQLITE_BLOB:
+      return ToByteArray(i);
+    case SQLITE_NULL:
+      return QVariant(QVariant::String);
+    default:
+      return ToString(i);
+  }
+}
+
+bool SqlRow::IsNull(int i) const {
+  if (!stmt_) return columns_[i].isNull();
+  return sqlite3_column_type(stmt_, i) == SQLITE_NULL;
+}
+
+QString SqlRow::ToString(int i) const {
+  if (!stmt_) return columns_[i].toString();
+  if (sqlite3_column_type(stmt_, i) == SQLITE_NULL) return QString();
+
+  const void* data = sqlite3_column_text16(stmt_, i);
+  const int bytes = sqlite3_column_bytes16(stmt_, i);
+  return QString(reinterpret_cast<const QChar*>(data), bytes / sizeof(QChar));
+}
+
+QByteArray SqlRow::ToByteArray(int i) const {
+  if (!stmt_) {
+    // QVariant would convert a string with toAscii(), but sqlite gives text
+    // columns to the statement path as UTF-8.
+    const QVariant& column = columns_[i];
+    if (column.type() == QVariant::String) return column.toString().toUtf8();
+    return column.toByteArray();
+  }
+
+  const void* data = sqlite3_column_blob(stmt_, i);
+  const int bytes = sqlite3_column_bytes(stmt_, i);
+  return QByteArray(reinterpret_cast<const char*>(data), bytes);
+}
+
+int SqlRow::ToInt(int i) const {
+  if (!stmt_) return columns_[i].toInt();
+  return sqlite3_column_int(stmt_, i);
+}
+
+qint64 SqlRow::ToLongLong(int i) const {
+  if (!stmt_) return columns_[i].toLongLong();
+  return sqlite3_column_int64(stmt_, i);
+}
+
+double SqlRow::ToDouble(int i) const {
+  if (!stmt_) return columns_[i].toDouble();
+  return sqlite3_column_double(stmt_, i);
+}
@@ -25,19 +25,45 @@ class QSqlQuery;
 
 class LibraryQuery;
 
+struct sqlite3_stmt;
+
 class SqlRow {
  public:
   // WARNING: Implicit construction from QSqlQuery and LibraryQuery.
   SqlRow(const QSqlQuery& query);
   SqlRow(const LibraryQuery& query);
 
-  const QVariant& value(int i) const { return columns_[i]; }
+  // A row that reads the columns of the statement's current row straight out
+  // of sqlite when they're asked for, instead of copying them all up front.
+  // It's only valid until the statement moves to another row, so it must not
+  // be kept.  See SqliteQuery.
+  explicit SqlRow(sqlite3_stmt* stmt);
+
+  // A row made up of the given values, as if it had been read from the
+  // database.
+  explicit SqlRow(const QList<QVariant>& columns);
+
+  // Copies the columns out of the statement, so the row can be kept after the
+  // statement has moved on.
+  SqlRow Copy() const;
+
+  QVariant value(int i) const;
+
+  // These avoid going through a QVariant for rows read straight from sqlite.
+  bool IsNull(int i) const;
+  QString ToString(int i) const;
+  QByteArray ToByteArray(int i) const;
+  int ToInt(int i) const;
+  qint64 ToLongLong(int i) const;
+  double ToDouble(int i) const;
+  bool ToBool(int i) const { return ToInt(i) != 0; }
 
  private:
   SqlRow();
 
   void Init(const QSqlQuery& query);
 
+  sqlite3_stmt* stmt_;
   QList<QVariant> columns_;
 };
 
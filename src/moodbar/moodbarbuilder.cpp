@@ -18,6 +18,7 @@
 #include "moodbarbuilder.h"
 #include "core/arraysize.h"
 
+#include <algorithm>
 #include <cmath>
 
 namespace {
@@ -30,6 +31,25 @@ static const int sBarkBandCount = arraysize(sBarkBands);
 
 }  // namespace
 
+// Adds up count values.  The four running totals don't depend on each other,
+// so the compiler can keep them in one or two SIMD registers.
+static double Sum(const double* values, int count) {
+  double sums[4] = {0, 0, 0, 0};
+
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    sums[0] += values[i];
+    sums[1] += values[i + 1];
+    sums[2] += values[i + 2];
+    sums[3] += values[i + 3];
+  }
+  for (; i < count; ++i) {
+    sums[0] += values[i];
+  }
+
+  return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
 MoodbarBuilder::MoodbarBuilder() : bands_(0), rate_hz_(0) {}
 
 int MoodbarBuilder::BandFrequency(int band) const {
@@ -40,63 +60,62 @@ void MoodbarBuilder::Init(int bands, int rate_hz) {
   bands_ = bands;
   rate_hz_ = rate_hz;
 
-  barkband_table_.clear();
-  barkband_table_.reserve(bands + 1);
+  barkband_starts_.clear();
+  barkband_starts_.reserve(sBarkBandCount + 1);
+  barkband_starts_.append(0);
 
+  // The bark band of each frequency band goes up by at most one each time.
   int barkband = 0;
   for (int i = 0; i < bands + 1; ++i) {
     if (barkband < sBarkBandCount - 1 &&
         BandFrequency(i) >= sBarkBands[barkband]) {
       barkband++;
+      barkband_starts_.append(i);
     }
+  }
 
-    barkband_table_.append(barkband);
+  // Bark bands that no frequency band reaches are empty.
+  while (barkband_starts_.count() < sBarkBandCount + 1) {
+    barkband_starts_.append(bands + 1);
   }
 }
 
 void MoodbarBuilder::AddFrame(const double* magnitudes, int size) {
-  if (size > barkband_table_.length()) {
+  if (barkband_starts_.isEmpty() || size > barkband_starts_.last()) {
     return;
   }
 
-  // Calculate total magnitudes for different bark bands.
-  double bands[sBarkBandCount];
-  for (int i = 0; i < sBarkBandCount; ++i) {
-    bands[i] = 0.0;
-  }
-
-  for (int i = 0; i < size; ++i) {
-    bands[barkband_table_[i]] += magnitudes[i];
-  }
-
-  // Now divide the bark bands into thirds and compute their total amplitudes.
+  // Calculate total magnitudes for different bark bands, and divide the bark
+  // bands into thirds and compute their total amplitudes.
   double rgb[] = {0, 0, 0};
   for (int i = 0; i < sBarkBandCount; ++i) {
-    rgb[(i * 3) / sBarkBandCount] += bands[i] * bands[i];
+    const int start = qMin(barkband_starts_[i], size);
+    const int end = qMin(barkband_starts_[i + 1], size);
+    const double band = Sum(magnitudes + start, end - start);
+    rgb[(i * 3) / sBarkBandCount] += band * band;
   }
 
-  frames_.append(Rgb(sqrt(rgb[0]), sqrt(rgb[1]), sqrt(rgb[2])));
+  for (int i = 0; i < ChannelCount; ++i) {
+    frames_[i].append(sqrt(rgb[i]));
+  }
 }
 
-void MoodbarBuilder::Normalize(QList<Rgb>* vals, double Rgb::*member) {
-  double mini = vals->at(0).*member;
-  double maxi = vals->at(0).*member;
-  for (int i = 1; i < vals->count(); i++) {
-    const double value = vals->at(i).*member;
-    if (value > maxi) {
-      maxi = value;
-    } else if (value < mini) {
-      mini = value;
-    }
+void MoodbarBuilder::Normalize(QVector<double>* vals) {
+  double* values = vals->data();
+  const int count = vals->count();
+
+  double mini = values[0];
+  double maxi = values[0];
+  for (int i = 1; i < count; i++) {
+    mini = std::min(mini, values[i]);
+    maxi = std::max(maxi, values[i]);
   }
 
   double avg = 0;
-  int t = 0;
-  for (const Rgb& rgb : *vals) {
-    const double value = rgb.*member;
+  for (int i = 0; i < count; i++) {
+    const double value = values[i];
     if (value != mini && value != maxi) {
-      avg += value / vals->count();
-      t++;
+      avg += value / count;
     }
   }
 
@@ -104,8 +123,8 @@ void MoodbarBuilder::Normalize(QList<Rgb>* vals, double Rgb::*member) {
   double tb = 0;
   double avgu = 0;
   double avgb = 0;
-  for (const Rgb& rgb : *vals) {
-    const double value = rgb.*member;
+  for (int i = 0; i < count; i++) {
+    const double value = values[i];
     if (value != mini && value != maxi) {
       if (value > avg) {
         avgu += value;
@@ -123,8 +142,8 @@ void MoodbarBuilder::Normalize(QList<Rgb>* vals, double Rgb::*member) {
   tb = 0;
   double avguu = 0;
   double avgbb = 0;
-  for (const Rgb& rgb : *vals) {
-    const double value = rgb.*member;
+  for (int i = 0; i < count; i++) {
+    const double value = values[i];
     if (value != mini && value != maxi) {
       if (value > avgu) {
         avguu += value;
@@ -145,10 +164,12 @@ void MoodbarBuilder::Normalize(QList<Rgb>* vals, double Rgb::*member) {
     delta = 1;
   }
 
-  for (auto it = vals->begin(); it != vals->end(); ++it) {
-    double* value = &((*it).*member);
-    *value =
-        std::isfinite(*value) ? qBound(0.0, (*value - mini) / delta, 1.0) : 0;
+  // A plain loop over the array, so the compiler can vectorize it.
+  const double scale = 1.0 / delta;
+  for (int i = 0; i < count; i++) {
+    const double value = values[i];
+    values[i] =
+        std::isfinite(value) ? qBound(0.0, (value - mini) * scale, 1.0) : 0;
   }
 }
 
@@ -156,32 +177,25 @@ QByteArray MoodbarBuilder::Finish(int width) {
   QByteArray ret;
   ret.resize(width * 3);
   char* data = ret.data();
-  if (frames_.count() == 0) return ret;
 
-  Normalize(&frames_, &Rgb::r);
-  Normalize(&frames_, &Rgb::g);
-  Normalize(&frames_, &Rgb::b);
+  const int frame_count = frames_[Channel_Red].count();
+  if (frame_count == 0) return ret;
+
+  for (int i = 0; i < ChannelCount; ++i) {
+    Normalize(&frames_[i]);
+  }
 
   for (int i = 0; i < width; ++i) {
-    Rgb rgb;
-    int start = i * frames_.count() / width;
-    int end = (i + 1) * frames_.count() / width;
+    int start = i * frame_count / width;
+    int end = (i + 1) * frame_count / width;
     if (start == end) {
       end = start + 1;
     }
 
-    for (int j = start; j < end; j++) {
-      const Rgb& frame = frames_[j];
-      rgb.r += frame.r * 255;
-      rgb.g += frame.g * 255;
-      rgb.b += frame.b * 255;
-    }
-
     const int n = end - start;
-
-    *(data++) = rgb.r / n;
-    *(data++) = rgb.g / n;
-    *(data++) = rgb.b / n;
+    for (int channel = 0; channel < ChannelCount; ++channel) {
+      *(data++) = Sum(frames_[channel].constData() + start, n) * 255 / n;
+    }
   }
   return ret;
 }
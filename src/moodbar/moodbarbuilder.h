@@ -18,8 +18,8 @@
 #ifndef MOODBARBUILDER_H
 #define MOODBARBUILDER_H
 
-#include <QColor>
-#include <QList>
+#include <QByteArray>
+#include <QVector>
 
 class MoodbarBuilder {
  public:
@@ -30,21 +30,21 @@ class MoodbarBuilder {
   QByteArray Finish(int width);
 
  private:
-  struct Rgb {
-    Rgb() : r(0), g(0), b(0) {}
-    Rgb(double r_, double g_, double b_) : r(r_), g(g_), b(b_) {}
-
-    double r, g, b;
-  };
+  enum Channel { Channel_Red = 0, Channel_Green, Channel_Blue, ChannelCount };
 
   int BandFrequency(int band) const;
-  static void Normalize(QList<Rgb>* vals, double Rgb::*member);
+  static void Normalize(QVector<double>* vals);
 
-  QList<uint> barkband_table_;
+  // The index of the first frequency band in each bark band, followed by the
+  // total number of frequency bands.  Each bark band is a contiguous range of
+  // frequency bands, so it can be summed with a simple loop.
+  QVector<int> barkband_starts_;
   int bands_;
   int rate_hz_;
 
-  QList<Rgb> frames_;
+  // The red, green and blue values of each frame are kept in separate arrays
+  // so that each one can be normalized in one pass over contiguous memory.
+  QVector<double> frames_[ChannelCount];
 };
 
 #endif // MOODBARBUILDER_H
@@ -26,11 +26,14 @@
 #include "playlist/playlistview.h"
 
 #include <QApplication>
+#include <QEvent>
 #include <QPainter>
 #include <QSettings>
 #include <QSortFilterProxyModel>
 #include <QtConcurrentRun>
 
+const int MoodbarItemDelegate::kMaxCachedColors = 1000000;
+
 MoodbarItemDelegate::Data::Data() : state_(State_None) {}
 
 MoodbarItemDelegate::MoodbarItemDelegate(Application* app, PlaylistView* view,
@@ -38,11 +41,25 @@ MoodbarItemDelegate::MoodbarItemDelegate(Application* app, PlaylistView* view,
     : QItemDelegate(parent),
       app_(app),
       view_(view),
+      colors_cache_(kMaxCachedColors),
+      colors_generation_(0),
       style_(MoodbarRenderer::Style_Normal) {
   connect(app_, SIGNAL(SettingsChanged()), SLOT(ReloadSettings()));
+  view_->installEventFilter(this);
   ReloadSettings();
 }
 
+bool MoodbarItemDelegate::eventFilter(QObject* object, QEvent* event) {
+  // The view isn't an editor, so don't let QItemDelegate see its events.
+  if (object == view_) {
+    if (event->type() == QEvent::PaletteChange) {
+      ReloadAllColors();
+    }
+    return false;
+  }
+  return QItemDelegate::eventFilter(object, event);
+}
+
 void MoodbarItemDelegate::ReloadSettings() {
   QSettings s;
   s.beginGroup("Moodbar");
@@ -112,6 +129,14 @@ QPixmap MoodbarItemDelegate::PixmapForIndex(const QModelIndex& index,
 }
 
 void MoodbarItemDelegate::StartLoadingData(const QUrl& url, Data* data) {
+  // Maybe we've already worked out the colors for this song.
+  const ColorVector* colors = colors_cache_[ColorsKey(url, style_)];
+  if (colors) {
+    data->colors_ = *colors;
+    StartLoadingImage(url, data);
+    return;
+  }
+
   data->state_ = Data::State_LoadingData;
 
   // Load a mood file for this song and generate some colors from it
@@ -148,6 +173,9 @@ bool MoodbarItemDelegate::RemoveFromCacheIfIndexesInvalid(const QUrl& url,
 }
 
 void MoodbarItemDelegate::ReloadAllColors() {
+  colors_cache_.clear();
+  colors_generation_++;
+
   for (const QUrl& url : data_.keys()) {
     Data* data = data_[url];
 
@@ -183,19 +211,28 @@ void MoodbarItemDelegate::StartLoadingColors(const QUrl& url,
   data->state_ = Data::State_LoadingColors;
 
   QFutureWatcher<ColorVector>* watcher = new QFutureWatcher<ColorVector>();
-  NewClosure(watcher, SIGNAL(finished()), this,
-             SLOT(ColorsLoaded(QUrl, QFutureWatcher<ColorVector>*)), url,
-             watcher);
+  NewClosure(
+      watcher, SIGNAL(finished()), this,
+      SLOT(ColorsLoaded(QUrl, int, int, QFutureWatcher<ColorVector>*)), url,
+      int(style_), colors_generation_, watcher);
 
   QFuture<ColorVector> future = QtConcurrent::run(
       MoodbarRenderer::Colors, bytes, style_, qApp->palette());
   watcher->setFuture(future);
 }
 
-void MoodbarItemDelegate::ColorsLoaded(const QUrl& url,
+void MoodbarItemDelegate::ColorsLoaded(const QUrl& url, int style,
+                                       int generation,
                                        QFutureWatcher<ColorVector>* watcher) {
   watcher->deleteLater();
 
+  const ColorVector colors = watcher->result();
+  const bool current = generation == colors_generation_;
+  if (current) {
+    colors_cache_.insert(ColorsKey(url, style), new ColorVector(colors),
+                         qMax(1, colors.size()));
+  }
+
   Data* data = data_[url];
   if (!data) {
     return;
@@ -205,7 +242,14 @@ void MoodbarItemDelegate::ColorsLoaded(const QUrl& url,
     return;
   }
 
-  data->colors_ = watcher->result();
+  if (style != style_ || !current) {
+    // The style or palette was changed while we were working out these
+    // colors.
+    StartLoadingData(url, data);
+    return;
+  }
+
+  data->colors_ = colors;
 
   // Load the image next.
   StartLoadingImage(url, data);
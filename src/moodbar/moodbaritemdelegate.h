@@ -22,6 +22,7 @@
 
 #include <QCache>
 #include <QItemDelegate>
+#include <QPair>
 #include <QFutureWatcher>
 #include <QUrl>
 
@@ -38,14 +39,21 @@ class MoodbarItemDelegate : public QItemDelegate {
   MoodbarItemDelegate(Application* app, PlaylistView* view,
                       QObject* parent = nullptr);
 
+  // Maximum number of colors kept in colors_cache_ - about 16MB.
+  static const int kMaxCachedColors;
+
   void paint(QPainter* painter, const QStyleOptionViewItem& option,
              const QModelIndex& index) const;
 
+ protected:
+  bool eventFilter(QObject* object, QEvent* event);
+
  private slots:
   void ReloadSettings();
 
   void DataLoaded(const QUrl& url, MoodbarPipeline* pipeline);
-  void ColorsLoaded(const QUrl& url, QFutureWatcher<ColorVector>* watcher);
+  void ColorsLoaded(const QUrl& url, int style, int generation,
+                    QFutureWatcher<ColorVector>* watcher);
   void ImageLoaded(const QUrl& url, QFutureWatcher<QImage>* watcher);
 
  private:
@@ -84,6 +92,15 @@ class MoodbarItemDelegate : public QItemDelegate {
   PlaylistView* view_;
   QCache<QUrl, Data> data_;
 
+  // Colors that have already been worked out for a song in a style, so they
+  // don't have to be loaded and computed again when a row scrolls back into
+  // view.  The cost is the number of colors.  Some styles use the palette, so
+  // this is emptied whenever the colors are reloaded, and colors_generation_
+  // is increased so ones that were still being computed are thrown away.
+  typedef QPair<QUrl, int> ColorsKey;
+  QCache<ColorsKey, ColorVector> colors_cache_;
+  int colors_generation_;
+
   MoodbarRenderer::MoodbarStyle style_;
 };
 
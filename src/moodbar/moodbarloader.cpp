@@ -28,33 +28,53 @@
 #include <QUrl>
 
 #include "moodbarpipeline.h"
+#include "moodbarstore.h"
 #include "core/application.h"
 #include "core/closure.h"
+#include "core/concurrentrun.h"
 #include "core/logging.h"
 #include "core/qhash_qurl.h"
+#include "core/taskmanager.h"
 #include "core/utilities.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
 
 #ifdef Q_OS_WIN32
 #include <windows.h>
 #endif
 
+using std::bind;
+
 MoodbarLoader::MoodbarLoader(Application* app, QObject* parent)
     : QObject(parent),
+      app_(app),
       cache_(new QNetworkDiskCache(this)),
+      store_(new MoodbarStore(app->database(), Library::kSongsTable)),
       thread_(new QThread(this)),
       kMaxActiveRequests(qMax(1, QThread::idealThreadCount() / 2)),
       save_alongside_originals_(false),
-      disable_moodbar_calculation_(false) {
+      disable_moodbar_calculation_(false),
+      generate_library_moodbars_(false),
+      finding_library_urls_(false),
+      library_task_id_(-1),
+      library_total_(0),
+      library_done_(0) {
   cache_->setCacheDirectory(
       Utilities::GetConfigPath(Utilities::Path_MoodbarCache));
   cache_->setMaximumCacheSize(60 * 1024 *
                               1024);  // 60MB - enough for 20,000 moodbars
 
+  connect(app->library_backend(), SIGNAL(SongsDeleted(SongList)),
+          SLOT(LibrarySongsDeleted(SongList)));
+
   connect(app, SIGNAL(SettingsChanged()), SLOT(ReloadSettings()));
   ReloadSettings();
 }
 
 MoodbarLoader::~MoodbarLoader() {
+  // The database might be destroyed after us.
+  store_pool_.waitForDone();
+
   thread_->quit();
   thread_->wait(1000);
 }
@@ -66,6 +86,17 @@ void MoodbarLoader::ReloadSettings() {
       s.value("save_alongside_originals", false).toBool();
 
   disable_moodbar_calculation_ = !s.value("calculate", true).toBool();
+
+  const bool generate_library_moodbars =
+      s.value("generate_library_moodbars", false).toBool();
+  if (generate_library_moodbars && !generate_library_moodbars_) {
+    // Wait for the library to finish loading.
+    QTimer::singleShot(10000, this, SLOT(GenerateLibraryMoodbars()));
+  } else if (!generate_library_moodbars && generate_library_moodbars_) {
+    StopLibraryMoodbars();
+  }
+  generate_library_moodbars_ = generate_library_moodbars;
+
   MaybeTakeNextRequest();
 }
 
@@ -116,54 +147,167 @@ MoodbarLoader::Result MoodbarLoader::Load(const QUrl& url, QByteArray* data,
     }
   }
 
+  // Maybe it's a library song that has one already?  This is called for
+  // every row that's painted, so the database is searched in the background.
+  // If there's nothing there the audio file is analyzed.
+  MoodbarPipeline* pipeline = CreatePipeline(url);
+
+  QFutureWatcher<QByteArray>* watcher = new QFutureWatcher<QByteArray>(this);
+  watcher->setFuture(ConcurrentRun::Run<QByteArray>(
+      &store_pool_, bind(&MoodbarStore::Load, store_, url)));
+  NewClosure(watcher, SIGNAL(finished()), this,
+             SLOT(StoreLookupFinished(QFutureWatcher<QByteArray>*, QUrl)),
+             watcher, url);
+
+  *async_pipeline = pipeline;
+  return WillLoadAsync;
+}
+
+void MoodbarLoader::StoreLookupFinished(QFutureWatcher<QByteArray>* watcher,
+                                        const QUrl& url) {
+  watcher->deleteLater();
+
+  const QByteArray data = watcher->result();
+  if (data.isEmpty()) {
+    queued_requests_ << url;
+    MaybeTakeNextRequest();
+    return;
+  }
+
+  stored_requests_ << url;
+  QMetaObject::invokeMethod(requests_[url], "Finish", Qt::QueuedConnection,
+                            Q_ARG(QByteArray, data));
+}
+
+MoodbarPipeline* MoodbarLoader::CreatePipeline(const QUrl& url) {
   if (!thread_->isRunning()) thread_->start(QThread::IdlePriority);
 
-  // There was no existing file, analyze the audio file and create one.
   MoodbarPipeline* pipeline = new MoodbarPipeline(url);
   pipeline->moveToThread(thread_);
   NewClosure(pipeline, SIGNAL(Finished(bool)), this,
              SLOT(RequestFinished(MoodbarPipeline*, QUrl)), pipeline, url);
 
   requests_[url] = pipeline;
-  queued_requests_ << url;
-
-  MaybeTakeNextRequest();
-
-  *async_pipeline = pipeline;
-  return WillLoadAsync;
+  return pipeline;
 }
 
 void MoodbarLoader::MaybeTakeNextRequest() {
   Q_ASSERT(QThread::currentThread() == qApp->thread());
 
-  if (active_requests_.count() >= kMaxActiveRequests ||
-      queued_requests_.isEmpty() || disable_moodbar_calculation_) {
+  while (active_requests_.count() < kMaxActiveRequests &&
+         !disable_moodbar_calculation_) {
+    QUrl url;
+    if (!queued_requests_.isEmpty()) {
+      url = queued_requests_.takeFirst();
+    } else if (!library_queue_.isEmpty()) {
+      // Only work on the library when nothing else is waiting.
+      url = library_queue_.takeFirst();
+      if (requests_.contains(url)) {
+        // Someone asked for this one already.
+        LibraryRequestFinished();
+        continue;
+      }
+      CreatePipeline(url);
+      library_requests_ << url;
+    } else {
+      return;
+    }
+
+    active_requests_ << url;
+
+    qLog(Info) << "Creating moodbar data for" << url.toLocalFile();
+    QMetaObject::invokeMethod(requests_[url], "Start", Qt::QueuedConnection);
+  }
+}
+
+void MoodbarLoader::GenerateLibraryMoodbars() {
+  if (!generate_library_moodbars_ || finding_library_urls_ ||
+      !library_queue_.isEmpty() || !library_requests_.isEmpty()) {
     return;
   }
+  finding_library_urls_ = true;
+
+  QFutureWatcher<QList<QUrl>>* watcher = new QFutureWatcher<QList<QUrl>>(this);
+  watcher->setFuture(ConcurrentRun::Run<QList<QUrl>>(
+      &store_pool_, bind(&MoodbarStore::UrlsWithoutMoodbars, store_)));
+  NewClosure(watcher, SIGNAL(finished()), this,
+             SLOT(LibraryUrlsFound(QFutureWatcher<QList<QUrl>>*)), watcher);
+}
+
+void MoodbarLoader::LibraryUrlsFound(QFutureWatcher<QList<QUrl>>* watcher) {
+  watcher->deleteLater();
+  finding_library_urls_ = false;
+
+  // Turned off while we were looking.
+  if (!generate_library_moodbars_) return;
+
+  library_queue_ = watcher->result();
+  if (library_queue_.isEmpty()) return;
+
+  qLog(Info) << "Generating moodbars for" << library_queue_.count()
+             << "library songs";
+
+  library_total_ = library_queue_.count();
+  library_done_ = 0;
+  library_timer_.start();
+  library_task_id_ = app_->task_manager()->StartTask(tr("Generating moodbars"));
+
+  MaybeTakeNextRequest();
+}
+
+void MoodbarLoader::LibraryRequestFinished() {
+  library_done_++;
+  app_->task_manager()->SetTaskProgress(library_task_id_, library_done_,
+                                        library_total_);
+
+  const bool finished = library_queue_.isEmpty() && library_requests_.isEmpty();
+  if (finished || library_done_ % 100 == 0) {
+    const double minutes = library_timer_.elapsed() / 60000.0;
+    qLog(Info) << "Generated" << library_done_ << "of" << library_total_
+               << "library moodbars,"
+               << (minutes > 0 ? int(library_done_ / minutes) : 0)
+               << "songs per minute";
+  }
+
+  if (finished) {
+    app_->task_manager()->SetTaskFinished(library_task_id_);
+    library_task_id_ = -1;
+  }
+}
 
-  const QUrl url = queued_requests_.takeFirst();
-  active_requests_ << url;
+void MoodbarLoader::StopLibraryMoodbars() {
+  // Moodbars that are being generated already are still saved.
+  library_queue_.clear();
+  library_requests_.clear();
 
-  qLog(Info) << "Creating moodbar data for" << url.toLocalFile();
-  QMetaObject::invokeMethod(requests_[url], "Start", Qt::QueuedConnection);
+  if (library_task_id_ != -1) {
+    app_->task_manager()->SetTaskFinished(library_task_id_);
+    library_task_id_ = -1;
+  }
+}
+
+void MoodbarLoader::LibrarySongsDeleted(const SongList& songs) {
+  ConcurrentRun::Run<void>(&store_pool_,
+                           bind(&MoodbarStore::DeleteSongs, store_, songs));
 }
 
 void MoodbarLoader::RequestFinished(MoodbarPipeline* request, const QUrl& url) {
   Q_ASSERT(QThread::currentThread() == qApp->thread());
 
-  if (request->success()) {
+  // Moodbars that came from the database don't need saving again.
+  const bool from_store = stored_requests_.remove(url);
+  if (request->success() && !from_store) {
     qLog(Info) << "Moodbar data generated successfully for"
                << url.toLocalFile();
 
-    // Save the data in the cache
-    QNetworkCacheMetaData metadata;
-    metadata.setUrl(url);
-
-    QIODevice* cache_file = cache_->prepare(metadata);
-    if (cache_file) {
-      cache_file->write(request->data());
-      cache_->insert(cache_file);
-    }
+    // Save the data in the database if it's a library song, or in the cache
+    // if it isn't.
+    QFutureWatcher<bool>* watcher = new QFutureWatcher<bool>(this);
+    watcher->setFuture(ConcurrentRun::Run<bool>(
+        &store_pool_, bind(&MoodbarStore::Save, store_, url, request->data())));
+    NewClosure(watcher, SIGNAL(finished()), this,
+               SLOT(MoodbarSaved(QFutureWatcher<bool>*, QUrl, QByteArray)),
+               watcher, url, request->data());
 
     // Save the data alongside the original as well if we're configured to.
     if (save_alongside_originals_) {
@@ -192,5 +336,24 @@ void MoodbarLoader::RequestFinished(MoodbarPipeline* request, const QUrl& url) {
 
   QTimer::singleShot(1000, request, SLOT(deleteLater()));
 
+  if (library_requests_.remove(url)) {
+    LibraryRequestFinished();
+  }
+
   MaybeTakeNextRequest();
 }
+
+void MoodbarLoader::MoodbarSaved(QFutureWatcher<bool>* watcher,
+                                 const QUrl& url, const QByteArray& data) {
+  watcher->deleteLater();
+  if (watcher->result()) return;
+
+  QNetworkCacheMetaData metadata;
+  metadata.setUrl(url);
+
+  QIODevice* cache_file = cache_->prepare(metadata);
+  if (cache_file) {
+    cache_file->write(data);
+    cache_->insert(cache_file);
+  }
+}
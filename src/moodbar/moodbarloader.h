@@ -18,15 +18,23 @@
 #ifndef MOODBARLOADER_H
 #define MOODBARLOADER_H
 
+#include <memory>
+
+#include <QElapsedTimer>
+#include <QFutureWatcher>
 #include <QMap>
 #include <QObject>
 #include <QSet>
+#include <QThreadPool>
+#include <QUrl>
+
+#include "core/song.h"
 
 class QNetworkDiskCache;
-class QUrl;
 
 class Application;
 class MoodbarPipeline;
+class MoodbarStore;
 
 class MoodbarLoader : public QObject {
   Q_OBJECT
@@ -51,17 +59,38 @@ class MoodbarLoader : public QObject {
   Result Load(const QUrl& url, QByteArray* data,
               MoodbarPipeline** async_pipeline);
 
+ public slots:
+  // Generates moodbars for all the library songs that don't have one yet, in
+  // the background.  Songs that are loaded with Load() go first.
+  void GenerateLibraryMoodbars();
+
  private slots:
   void ReloadSettings();
 
   void RequestFinished(MoodbarPipeline* request, const QUrl& filename);
   void MaybeTakeNextRequest();
+  void StoreLookupFinished(QFutureWatcher<QByteArray>* watcher,
+                           const QUrl& url);
+  void MoodbarSaved(QFutureWatcher<bool>* watcher, const QUrl& url,
+                    const QByteArray& data);
+
+  void LibraryUrlsFound(QFutureWatcher<QList<QUrl>>* watcher);
+  void LibrarySongsDeleted(const SongList& songs);
 
  private:
   static QStringList MoodFilenames(const QString& song_filename);
 
+  MoodbarPipeline* CreatePipeline(const QUrl& url);
+  void LibraryRequestFinished();
+  void StopLibraryMoodbars();
+
  private:
+  Application* app_;
   QNetworkDiskCache* cache_;
+  // Moodbars of library songs.  The disk cache is used for other files.
+  std::shared_ptr<MoodbarStore> store_;
+  // Runs everything that uses store_, so the destructor can wait for it.
+  QThreadPool store_pool_;
   QThread* thread_;
 
   const int kMaxActiveRequests;
@@ -69,9 +98,22 @@ class MoodbarLoader : public QObject {
   QMap<QUrl, MoodbarPipeline*> requests_;
   QList<QUrl> queued_requests_;
   QSet<QUrl> active_requests_;
+  // Requests that were answered with a moodbar from store_.
+  QSet<QUrl> stored_requests_;
 
   bool save_alongside_originals_;
   bool disable_moodbar_calculation_;
+  bool generate_library_moodbars_;
+
+  // Library songs waiting for GenerateLibraryMoodbars, and the ones being
+  // generated now.
+  QList<QUrl> library_queue_;
+  QSet<QUrl> library_requests_;
+  bool finding_library_urls_;
+  int library_task_id_;
+  int library_total_;
+  int library_done_;
+  QElapsedTimer library_timer_;
 };
 
 #endif  // MOODBARLOADER_H
@@ -175,6 +175,11 @@ GstBusSyncReply MoodbarPipeline::BusCallbackSync(GstBus*, GstMessage* msg,
   return GST_BUS_PASS;
 }
 
+void MoodbarPipeline::Finish(const QByteArray& data) {
+  data_ = data;
+  Stop(true);
+}
+
 void MoodbarPipeline::Stop(bool success) {
   success_ = success;
   if (builder_ != nullptr) {
@@ -43,6 +43,9 @@ class MoodbarPipeline : public QObject {
 
  public slots:
   void Start();
+  // Finishes with moodbar data that was made earlier, instead of analyzing
+  // the file.
+  void Finish(const QByteArray& data);
 
  signals:
   void Finished(bool success);
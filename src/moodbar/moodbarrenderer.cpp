@@ -17,6 +17,9 @@
 
 #include "moodbarrenderer.h"
 
+#include <climits>
+#include <cstring>
+
 #include <QPainter>
 #include <QPalette>
 
@@ -24,6 +27,74 @@
 
 const int MoodbarRenderer::kNumHues = 12;
 
+namespace {
+
+// Rounds a non-negative value the same way qRound does.
+inline int RoundPositive(qreal d) { return int(d + qreal(0.5)); }
+
+// Converts count packed RGB triples to HSV with exactly the same rounding as
+// QColor's hue(), saturation() and value(), except that grey pixels get a hue
+// of 0 instead of -1.  QColor works on 16-bit components, so they're scaled
+// the same way here.  The loop body has no data-dependent branches so the
+// compiler is free to vectorize it.
+void RgbToHsv(const uchar* rgb, int count, int* hue, int* sat, int* val) {
+  for (int i = 0; i < count; ++i, rgb += 3) {
+    const int r8 = rgb[0];
+    const int g8 = rgb[1];
+    const int b8 = rgb[2];
+    const int max8 = qMax(r8, qMax(g8, b8));
+    const int min8 = qMin(r8, qMin(g8, b8));
+    const bool grey = max8 == min8;
+
+    const qreal r = (r8 * 0x101) / qreal(USHRT_MAX);
+    const qreal g = (g8 * 0x101) / qreal(USHRT_MAX);
+    const qreal b = (b8 * 0x101) / qreal(USHRT_MAX);
+    const qreal max = (max8 * 0x101) / qreal(USHRT_MAX);
+    const qreal delta = max - (min8 * 0x101) / qreal(USHRT_MAX);
+
+    const qreal safe_delta = grey ? qreal(1.0) : delta;
+    const qreal safe_max = grey ? qreal(1.0) : max;
+
+    qreal h = r8 == max8 ? (g - b) / safe_delta
+            : g8 == max8 ? qreal(2.0) + (b - r) / safe_delta
+                         : qreal(4.0) + (r - g) / safe_delta;
+    h *= qreal(60.0);
+    h += h < qreal(0.0) ? qreal(360.0) : qreal(0.0);
+
+    hue[i] = grey ? 0 : RoundPositive(h * 100) / 100;
+    sat[i] = grey ? 0 : RoundPositive((delta / safe_max) * USHRT_MAX) >> 8;
+    val[i] = max8;
+  }
+}
+
+// Equivalent to QColor::fromHsv(h, s, v).rgb(), without going through a
+// QColor.  A negative hue means the color is achromatic.
+QRgb HsvToRgb(int h, int s, int v) {
+  if (h < 0 || s == 0) {
+    return qRgb(v, v, v);
+  }
+
+  const qreal hh = (h * 100) / qreal(6000.0);
+  const qreal ss = (s * 0x101) / qreal(USHRT_MAX);
+  const qreal vv = (v * 0x101) / qreal(USHRT_MAX);
+  const int i = int(hh);
+  const qreal f = hh - i;
+  const qreal p = vv * (qreal(1.0) - ss);
+  const qreal q = vv * (qreal(1.0) - (ss * f));
+  const qreal t = vv * (qreal(1.0) - (ss * (qreal(1.0) - f)));
+
+  // The (r, g, b) components for each sextant of the hue circle.
+  const qreal sextants[6][3] = {{vv, t, p}, {q, vv, p}, {p, vv, t},
+                                {p, q, vv}, {t, p, vv}, {vv, p, q}};
+  const qreal* rgb = sextants[i];
+
+  return qRgb(RoundPositive(rgb[0] * USHRT_MAX) >> 8,
+              RoundPositive(rgb[1] * USHRT_MAX) >> 8,
+              RoundPositive(rgb[2] * USHRT_MAX) >> 8);
+}
+
+}  // namespace
+
 ColorVector MoodbarRenderer::Colors(const QByteArray& data, MoodbarStyle style,
                                     const QPalette& palette) {
   const int samples = data.size() / 3;
@@ -56,27 +127,21 @@ ColorVector MoodbarRenderer::Colors(const QByteArray& data, MoodbarStyle style,
     }
   }
 
-  const unsigned char* data_p =
-      reinterpret_cast<const unsigned char*>(data.constData());
+  // Convert all the samples to HSV in one go.
+  QVector<int> hues(samples);
+  QVector<int> sats(samples);
+  QVector<int> vals(samples);
+  RgbToHsv(reinterpret_cast<const uchar*>(data.constData()), samples,
+           hues.data(), sats.data(), vals.data());
 
+  // Keep track of a histogram of the hues
   int hue_distribution[360];
   int total = 0;
 
   memset(hue_distribution, 0, sizeof(hue_distribution));
 
-  ColorVector colors;
-
-  // Read the colors, keeping track of some histograms
   for (int i = 0; i < samples; ++i) {
-    QColor color;
-    color.setRed(int(*data_p++));
-    color.setGreen(int(*data_p++));
-    color.setBlue(int(*data_p++));
-
-    colors << color;
-
-    const int hue = qMax(0, color.hue());
-    if (hue_distribution[hue]++ == properties.threshold_) {
+    if (hue_distribution[hues[i]]++ == properties.threshold_) {
       total++;
     }
   }
@@ -88,22 +153,28 @@ ColorVector MoodbarRenderer::Colors(const QByteArray& data, MoodbarStyle style,
   // above the threshold, increment the output hue by
   // (1/total) * rangeDelta.
   for (int i = 0, n = 0; i < 360; i++) {
-    hue_distribution[i] =
-        ((hue_distribution[i] > properties.threshold_ ? n++ : n) *
-             properties.range_delta_ / total +
-         properties.range_start_) %
-        360;
+    hue_distribution[i] = qBound(
+        0, ((hue_distribution[i] > properties.threshold_ ? n++ : n) *
+                properties.range_delta_ / total +
+            properties.range_start_) %
+               360,
+        359);
   }
 
   // Now huedist is a hue mapper: huedist[h] is the new hue value
-  // for a bar with hue h
-  for (ColorVector::iterator it = colors.begin(); it != colors.end(); ++it) {
-    const int hue = qMax(0, it->hue());
-
-    *it = QColor::fromHsv(
-        qBound(0, hue_distribution[hue], 359),
-        qBound(0, it->saturation() * properties.sat_ / 100, 255),
-        qBound(0, it->value() * properties.val_ / 100, 255));
+  // for a bar with hue h.  The saturation and value are scaled through
+  // lookup tables in the same way.
+  int sat_table[256];
+  int val_table[256];
+  for (int i = 0; i < 256; ++i) {
+    sat_table[i] = qBound(0, i * properties.sat_ / 100, 255);
+    val_table[i] = qBound(0, i * properties.val_ / 100, 255);
+  }
+
+  ColorVector colors(samples);
+  for (int i = 0; i < samples; ++i) {
+    colors[i] = QColor(HsvToRgb(hue_distribution[hues[i]],
+                                sat_table[sats[i]], val_table[vals[i]]));
   }
 
   return colors;
@@ -111,55 +182,66 @@ ColorVector MoodbarRenderer::Colors(const QByteArray& data, MoodbarStyle style,
 
 void MoodbarRenderer::Render(const ColorVector& colors, QPainter* p,
                              const QRect& rect) {
-  // Sample the colors and map them to screen pixels.
-  ColorVector screen_colors;
-  for (int x = 0; x < rect.width(); ++x) {
+  p->drawImage(rect.topLeft(), RenderToImage(colors, rect.size()));
+}
+
+QImage MoodbarRenderer::RenderToImage(const ColorVector& colors,
+                                      const QSize& size) {
+  QImage image(size, QImage::Format_ARGB32_Premultiplied);
+  const int width = size.width();
+  const int height = size.height();
+  if (image.isNull() || colors.isEmpty()) {
+    image.fill(0);
+    return image;
+  }
+
+  // The gradient from the middle of the bar to the edges is the same for every
+  // column, so work out its coefficients once.
+  const int half_height = height / 2;
+  QVector<float> sat_coeffs(half_height + 1);
+  QVector<float> val_coeffs(half_height + 1);
+  for (int y = 0; y <= half_height; ++y) {
+    float coeff = float(y) / float(qMax(1, half_height));
+    float coeff2 = 1.0f - ((1.0f - coeff) * (1.0f - coeff));
+    sat_coeffs[y] = 1.0f - (1.0f - coeff) / 2.0f;
+    val_coeffs[y] = 1.f - (1.f - coeff2) / 2.0f;
+  }
+
+  int hsv[3];
+  for (int x = 0; x < width; ++x) {
+    // Sample the colors and map them to screen pixels.
     int r = 0;
     int g = 0;
     int b = 0;
 
-    int start = x * colors.size() / rect.width();
-    int end = (x + 1) * colors.size() / rect.width();
+    int start = x * colors.size() / width;
+    int end = (x + 1) * colors.size() / width;
 
     if (start == end) end = qMin(start + 1, colors.size() - 1);
 
     for (int j = start; j < end; j++) {
-      r += colors[j].red();
-      g += colors[j].green();
-      b += colors[j].blue();
+      const QRgb rgb = colors[j].rgb();
+      r += qRed(rgb);
+      g += qGreen(rgb);
+      b += qBlue(rgb);
     }
 
     const int n = qMax(1, end - start);
-    screen_colors.append(QColor(r / n, g / n, b / n));
-  }
-
-  // Draw the actual moodbar.
-  for (int x = 0; x < rect.width(); x++) {
-    int h, s, v;
-    screen_colors[x].getHsv(&h, &s, &v);
-
-    for (int y = 0; y <= rect.height() / 2; y++) {
-      float coeff = float(y) / float(rect.height() / 2);
-      float coeff2 = 1.0f - ((1.0f - coeff) * (1.0f - coeff));
-      coeff = 1.0f - (1.0f - coeff) / 2.0f;
-      coeff2 = 1.f - (1.f - coeff2) / 2.0f;
-
-      p->setPen(QColor::fromHsv(
-          h, qBound(0, int(float(s) * coeff), 255),
-          qBound(0, int(255.f - (255.f - float(v)) * coeff2), 255)));
-
-      p->drawPoint(rect.left() + x, rect.top() + y);
-      p->drawPoint(rect.left() + x, rect.top() + rect.height() - 1 - y);
+    const uchar average[] = {uchar(r / n), uchar(g / n), uchar(b / n)};
+    RgbToHsv(average, 1, &hsv[0], &hsv[1], &hsv[2]);
+
+    // Draw the actual moodbar.
+    for (int y = 0; y <= half_height; y++) {
+      const QRgb pixel = HsvToRgb(
+          hsv[0], qBound(0, int(float(hsv[1]) * sat_coeffs[y]), 255),
+          qBound(0, int(255.f - (255.f - float(hsv[2])) * val_coeffs[y]),
+                 255));
+
+      reinterpret_cast<QRgb*>(image.scanLine(y))[x] = pixel;
+      reinterpret_cast<QRgb*>(image.scanLine(height - 1 - y))[x] = pixel;
     }
   }
-}
 
-QImage MoodbarRenderer::RenderToImage(const ColorVector& colors,
-                                      const QSize& size) {
-  QImage image(size, QImage::Format_ARGB32_Premultiplied);
-  QPainter p(&image);
-  Render(colors, &p, image.rect());
-  p.end();
   return image;
 }
 
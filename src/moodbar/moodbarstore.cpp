@@ -0,0 +1,103 @@
+/* This file is part of Clementine.
+   Copyright 2014, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "moodbarstore.h"
+
+#include <QMutexLocker>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QVariant>
+
+#include "core/database.h"
+#include "core/scopedtransaction.h"
+
+MoodbarStore::MoodbarStore(Database* db, const QString& songs_table)
+    : db_(db), songs_table_(songs_table) {}
+
+QByteArray MoodbarStore::Load(const QUrl& url) {
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
+
+  QSqlQuery q(QString(
+                  "SELECT moodbars.data FROM moodbars"
+                  " JOIN %1 ON %1.ROWID = moodbars.song_id"
+                  " WHERE %1.filename = :filename"
+                  " AND %1.mtime = moodbars.mtime").arg(songs_table_),
+              db);
+  q.bindValue(":filename", url.toEncoded());
+  q.exec();
+  if (db_->CheckErrors(q) || !q.next()) return QByteArray();
+
+  return q.value(0).toByteArray();
+}
+
+bool MoodbarStore::Save(const QUrl& url, const QByteArray& data) {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  // A file can be in the library more than once if it has a cue sheet, but
+  // each section gets the same moodbar.
+  QSqlQuery q(QString(
+                  "INSERT OR REPLACE INTO moodbars (song_id, mtime, data)"
+                  " SELECT ROWID, mtime, :data FROM %1"
+                  " WHERE filename = :filename").arg(songs_table_),
+              db);
+  q.bindValue(":data", data);
+  q.bindValue(":filename", url.toEncoded());
+  q.exec();
+  if (db_->CheckErrors(q)) return false;
+
+  return q.numRowsAffected() > 0;
+}
+
+QList<QUrl> MoodbarStore::UrlsWithoutMoodbars() {
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
+
+  QSqlQuery q(QString(
+                  "SELECT DISTINCT %1.filename FROM %1"
+                  " LEFT JOIN moodbars ON moodbars.song_id = %1.ROWID"
+                  " WHERE %1.unavailable = 0"
+                  " AND %1.filename LIKE 'file:%'"
+                  " AND (moodbars.song_id IS NULL"
+                  "      OR moodbars.mtime != %1.mtime)").arg(songs_table_),
+              db);
+  q.exec();
+
+  QList<QUrl> ret;
+  if (db_->CheckErrors(q)) return ret;
+
+  while (q.next()) {
+    ret << QUrl::fromEncoded(q.value(0).toByteArray());
+  }
+  return ret;
+}
+
+void MoodbarStore::DeleteSongs(const SongList& songs) {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery remove("DELETE FROM moodbars WHERE song_id = :id", db);
+
+  ScopedTransaction transaction(&db);
+  for (const Song& song : songs) {
+    remove.bindValue(":id", song.id());
+    remove.exec();
+    db_->CheckErrors(remove);
+  }
+  transaction.Commit();
+}
@@ -0,0 +1,56 @@
+/* This file is part of Clementine.
+   Copyright 2014, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MOODBARSTORE_H
+#define MOODBARSTORE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QUrl>
+
+#include "core/song.h"
+
+class Database;
+
+// Keeps the moodbars of library songs in the database, indexed by the song's
+// ROWID.  Each moodbar remembers the mtime of the file it was made from, so a
+// moodbar for a file that has changed since is ignored.  Thread-safe.
+class MoodbarStore {
+ public:
+  MoodbarStore(Database* db, const QString& songs_table);
+
+  // Returns the moodbar saved for the library song with this URL, or an empty
+  // array if there isn't an up to date one.
+  QByteArray Load(const QUrl& url);
+
+  // Saves the moodbar for the library song with this URL.  Returns false if
+  // the URL isn't in the library.
+  bool Save(const QUrl& url, const QByteArray& data);
+
+  // Returns the URLs of the local library songs that don't have an up to date
+  // moodbar.
+  QList<QUrl> UrlsWithoutMoodbars();
+
+  void DeleteSongs(const SongList& songs);
+
+ private:
+  Database* db_;
+  QString songs_table_;
+};
+
+#endif  // MOODBARSTORE_H
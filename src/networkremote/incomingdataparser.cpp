@@ -168,7 +168,15 @@ void IncomingDataParser::Parse(const pb::remote::Message& msg) {
       client->song_sender()->ResponseSongOffer(msg.response_song_offer().accepted());
       break;
     case pb::remote::GET_LIBRARY:
-      emit SendLibrary(client);
+      if (msg.has_request_library()) {
+        const pb::remote::RequestLibrary& request = msg.request_library();
+        emit SendLibraryChanges(client,
+                                QStringFromStdString(request.database_id()),
+                                request.since_revision(),
+                                request.accepts_compression());
+      } else {
+        emit SendLibrary(client);
+      }
       break;
     case pb::remote::RATE_SONG:
       RateSong(msg);
@@ -49,6 +49,9 @@ signals:
   void RemoveSongs(int id, const QList<int>& indices);
   void SeekTo(int seconds);
   void SendLibrary(RemoteClient* client);
+  void SendLibraryChanges(RemoteClient* client,
+                          const QString& since_database_id,
+                          qint64 since_revision, bool compress);
   void RateCurrentSong(double);
 
   void DoGlobalSearch(QString, RemoteClient*);
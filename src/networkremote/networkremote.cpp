@@ -161,6 +161,10 @@ void NetworkRemote::AcceptConnection() {
 
     connect(incoming_data_parser_.get(), SIGNAL(SendLibrary(RemoteClient*)),
             outgoing_data_creator_.get(), SLOT(SendLibrary(RemoteClient*)));
+    connect(incoming_data_parser_.get(),
+            SIGNAL(SendLibraryChanges(RemoteClient*, QString, qint64, bool)),
+            outgoing_data_creator_.get(),
+            SLOT(SendLibraryChanges(RemoteClient*, QString, qint64, bool)));
 
     connect(incoming_data_parser_.get(),
             SIGNAL(DoGlobalSearch(QString, RemoteClient*)),
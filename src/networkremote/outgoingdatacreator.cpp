@@ -614,8 +614,103 @@ void OutgoingDataCreator::SendLibrary(RemoteClient* client) {
   // Detach the database
   app_->database()->DetachDatabase("songs_export");
 
+  SendLibraryFile(client, temp_file_name, -1, QString(), false, false);
+}
+
+void OutgoingDataCreator::SendLibraryChanges(RemoteClient* client,
+                                             const QString& since_database_id,
+                                             qint64 since_revision,
+                                             bool compress) {
+  QString temp_file_name = Utilities::GetTemporaryFileName();
+
+  QString database_id;
+  bool delta = false;
+  const qint64 revision =
+      ExportLibraryChanges(app_->database(), temp_file_name, since_database_id,
+                           since_revision, &database_id, &delta);
+  if (revision == -1) return;
+
+  qLog(Debug) << "Sending library revision" << revision
+              << (delta ? "as changes since" : "in full, client had")
+              << since_revision;
+
+  SendLibraryFile(client, temp_file_name, revision, database_id, delta,
+                  compress);
+}
+
+qint64 OutgoingDataCreator::ExportLibraryChanges(
+    Database* database, const QString& filename,
+    const QString& since_database_id, qint64 since_revision,
+    QString* database_id, bool* delta) {
+  Database::AttachedDatabase adb(filename, "", true);
+  QSqlDatabase db(database->Connect());
+
+  {
+    QSqlQuery q("SELECT id FROM library_changes_database", db);
+    if (database->CheckErrors(q)) return -1;
+    if (q.next()) *database_id = q.value(0).toString();
+  }
+
+  // Every change to the songs table moves the song to the end of
+  // library_changes, so the newest revision is the one the client will be up
+  // to date with.  Songs changed while we're copying are sent again next
+  // time.
+  qint64 revision = 0;
+  {
+    QSqlQuery q("SELECT MAX(revision) FROM library_changes", db);
+    if (database->CheckErrors(q)) return -1;
+    if (q.next()) revision = q.value(0).toLongLong();
+  }
+
+  // Revisions from another database, even one that has got further than
+  // ours, mean nothing here, so the client has to start again.
+  *delta = since_revision > 0 && since_revision <= revision &&
+           !database_id->isEmpty() && since_database_id == *database_id;
+
+  database->AttachDatabaseOnDbConnection("songs_export", adb, db);
+
+  QStringList commands;
+  if (*delta) {
+    const QString changes = QString(
+                                "FROM library_changes AS c "
+                                "LEFT JOIN songs AS s ON s.ROWID = c.song_id "
+                                "WHERE c.revision > %1 AND c.revision <= %2")
+                                .arg(since_revision)
+                                .arg(revision);
+
+    commands << "CREATE TABLE songs_export.songs AS"
+                " SELECT c.song_id AS song_id, s.* " +
+                    changes + " AND s.unavailable = 0"
+             << "CREATE TABLE songs_export.deleted_songs AS"
+                " SELECT c.song_id AS song_id " +
+                    changes + " AND (s.ROWID IS NULL OR s.unavailable != 0)";
+  } else {
+    commands << "CREATE TABLE songs_export.songs AS"
+                " SELECT ROWID AS song_id, * FROM songs WHERE unavailable = 0"
+             << "CREATE TABLE songs_export.deleted_songs ("
+                " song_id INTEGER PRIMARY KEY)";
+  }
+
+  for (const QString& command : commands) {
+    QSqlQuery q(command, db);
+    if (database->CheckErrors(q)) {
+      database->DetachDatabase("songs_export");
+      QFile::remove(filename);
+      return -1;
+    }
+  }
+
+  database->DetachDatabase("songs_export");
+  return revision;
+}
+
+void OutgoingDataCreator::SendLibraryFile(RemoteClient* client,
+                                          const QString& filename,
+                                          qint64 revision,
+                                          const QString& database_id,
+                                          bool delta, bool compress) {
   // Open the file
-  QFile file(temp_file_name);
+  QFile file(filename);
 
   // Get the sha1 hash
   QByteArray sha1 = Utilities::Sha1File(file).toHex();
@@ -641,9 +736,20 @@ void OutgoingDataCreator::SendLibrary(RemoteClient* client) {
     chunk->set_chunk_count(chunk_count);
     chunk->set_chunk_number(chunk_number);
     chunk->set_size(file.size());
-    chunk->set_data(data.data(), data.size());
     chunk->set_file_hash(sha1.data(), sha1.size());
 
+    if (revision != -1) {
+      chunk->set_revision(revision);
+      chunk->set_database_id(DataCommaSizeFromQString(database_id));
+      chunk->set_delta(delta);
+      chunk->set_compressed(compress);
+    }
+
+    if (compress) {
+      data = qCompress(data);
+    }
+    chunk->set_data(data.data(), data.size());
+
     // Send data directly to the client
     client->SendData(&msg);
 
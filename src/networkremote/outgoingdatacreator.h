@@ -53,6 +53,19 @@ class OutgoingDataCreator : public QObject {
   static void CreateSong(const Song& song, const QImage& art, const int index,
                   pb::remote::SongMetadata* song_metadata);
 
+  // Writes the songs changed since since_revision to a new SQLite file, with
+  // the ids of the songs deleted since then in a deleted_songs table.  If the
+  // revision isn't usable, or came from a database other than
+  // since_database_id, the whole library is written and delta is set to
+  // false.  Returns the revision the file brings a client up to and sets
+  // database_id to the database it belongs to, or returns -1 if there was an
+  // error.
+  static qint64 ExportLibraryChanges(Database* database,
+                                     const QString& filename,
+                                     const QString& since_database_id,
+                                     qint64 since_revision,
+                                     QString* database_id, bool* delta);
+
  public slots:
   void SendClementineInfo();
   void SendAllPlaylists();
@@ -78,6 +91,11 @@ class OutgoingDataCreator : public QObject {
   void GetLyrics();
   void SendLyrics(int id, const SongInfoFetcher::Result& result);
   void SendLibrary(RemoteClient* client);
+  // Sends the songs that changed since the client's since_revision, or the
+  // whole library if the client doesn't have a usable revision.
+  void SendLibraryChanges(RemoteClient* client,
+                          const QString& since_database_id,
+                          qint64 since_revision, bool compress);
   void EnableKittens(bool aww);
   void SendKitten(const QImage& kitten);
 
@@ -106,6 +124,12 @@ class OutgoingDataCreator : public QObject {
   QMap<int, GlobalSearchRequest> global_search_result_map_;
 
   void SendDataToClients(pb::remote::Message* msg);
+  // Sends the file to the client in LIBRARY_CHUNK messages and removes it.
+  // A revision of -1 leaves out the fields that are only for clients that
+  // sent a RequestLibrary.
+  void SendLibraryFile(RemoteClient* client, const QString& filename,
+                       qint64 revision, const QString& database_id,
+                       bool delta, bool compress);
   void SetEngineState(pb::remote::ResponseClementineInfo* msg);
   void CheckEnabledProviders();
   SongInfoProvider* ProviderByName(const QString& name) const;
@@ -24,12 +24,14 @@
 #include <QHash>
 #include <QMutexLocker>
 #include <QSqlQuery>
+#include <QVector>
 #include <QtDebug>
 
 #include "core/application.h"
 #include "core/database.h"
 #include "core/logging.h"
 #include "core/scopedtransaction.h"
+#include "core/sqlitequery.h"
 #include "core/song.h"
 #include "library/librarybackend.h"
 #include "library/sqlrow.h"
@@ -43,10 +45,57 @@ using std::shared_ptr;
 using smart_playlists::GeneratorPtr;
 
 const int PlaylistBackend::kSongTableJoins = 4;
+const qint64 PlaylistBackend::kPositionSpacing = 65536;
+
+namespace {
+
+// Returns which elements of rows are part of the longest strictly increasing
+// subsequence of rows.  Elements that are -1 are never part of it.
+QVector<bool> LongestIncreasingSubsequence(const QVector<int>& rows) {
+  const int count = rows.count();
+
+  // tails[i] is the index of the smallest element that ends an increasing
+  // subsequence of length i + 1.
+  QVector<int> tails;
+  QVector<int> previous(count, -1);
+
+  for (int i = 0; i < count; ++i) {
+    if (rows[i] == -1) continue;
+
+    int low = 0;
+    int high = tails.count();
+    while (low < high) {
+      const int mid = (low + high) / 2;
+      if (rows[tails[mid]] < rows[i]) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+
+    if (low > 0) previous[i] = tails[low - 1];
+    if (low == tails.count()) {
+      tails << i;
+    } else {
+      tails[low] = i;
+    }
+  }
+
+  QVector<bool> ret(count, false);
+  for (int i = tails.isEmpty() ? -1 : tails.last(); i != -1; i = previous[i]) {
+    ret[i] = true;
+  }
+  return ret;
+}
+
+}  // namespace
 
 PlaylistBackend::PlaylistBackend(Application* app, QObject* parent)
     : QObject(parent), app_(app), db_(app_->database()) {}
 
+PlaylistBackend::PlaylistBackend(Database* db, QObject* parent)
+    : QObject(parent), app_(nullptr), db_(db) {}
+
 PlaylistBackend::PlaylistList PlaylistBackend::GetAllPlaylists() {
   return GetPlaylists(GetPlaylists_All);
 }
@@ -61,8 +110,8 @@ PlaylistBackend::PlaylistList PlaylistBackend::GetAllFavoritePlaylists() {
 
 PlaylistBackend::PlaylistList PlaylistBackend::GetPlaylists(
     GetPlaylistsFlags flags) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   PlaylistList ret;
 
@@ -107,8 +156,8 @@ PlaylistBackend::PlaylistList PlaylistBackend::GetPlaylists(
 }
 
 PlaylistBackend::Playlist PlaylistBackend::GetPlaylist(int id) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QSqlQuery q(
       "SELECT ROWID, name, last_played, dynamic_playlist_type,"
@@ -137,9 +186,9 @@ PlaylistBackend::Playlist PlaylistBackend::GetPlaylist(int id) {
   return p;
 }
 
-QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+bool PlaylistBackend::ReadPlaylistRows(int playlist, SqlRowList* rows) {
+  QMutexLocker l(db_->ReadMutex());
+  QSqlDatabase db(db_->ConnectReadOnly());
 
   QString query = "SELECT songs.ROWID, " + Song::JoinSpec("songs") +
                   ","
@@ -152,7 +201,7 @@ QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
                   "       p.ROWID, " +
                   Song::JoinSpec("p") +
                   ","
-                  "       p.type, p.radio_service"
+                  "       p.type, p.radio_service, p.position"
                   " FROM playlist_items AS p"
                   " LEFT JOIN songs"
                   "    ON p.library_id = songs.ROWID"
@@ -160,58 +209,83 @@ QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
                   "    ON p.library_id = magnatune_songs.ROWID"
                   " LEFT JOIN jamendo.songs AS jamendo_songs"
                   "    ON p.library_id = jamendo_songs.ROWID"
-                  " WHERE p.playlist = :playlist";
-  QSqlQuery q(db);
-  // Forward iterations only may be faster
-  q.setForwardOnly(true);
-  q.prepare(query);
-  q.bindValue(":playlist", playlist);
-  q.exec();
-
-  return q;
+                  " WHERE p.playlist = :playlist"
+                  " ORDER BY p.position";
+  SqliteQuery q(db, query);
+  q.BindValue(":playlist", playlist);
+  if (!q.Exec()) return false;
+
+  while (q.Next()) {
+    *rows << q.row().Copy();
+  }
+  return true;
 }
 
 QList<PlaylistItemPtr> PlaylistBackend::GetPlaylistItems(int playlist) {
-  QSqlQuery q = GetPlaylistRows(playlist);
-  // Note that as this only accesses the query, not the db, we don't need the
-  // mutex.
-  if (db_->CheckErrors(q)) return QList<PlaylistItemPtr>();
-
   // it's probable that we'll have a few songs associated with the
   // same CUE so we're caching results of parsing CUEs
   std::shared_ptr<NewSongFromQueryState> state_ptr(new NewSongFromQueryState());
   QList<PlaylistItemPtr> playlistitems;
-  while (q.next()) {
-    playlistitems << NewPlaylistItemFromQuery(SqlRow(q), state_ptr);
+  SavedItemList saved;
+  SqlRowList rows;
+  if (!ReadPlaylistRows(playlist, &rows)) return QList<PlaylistItemPtr>();
+
+  for (const SqlRow& row : rows) {
+    SavedItem saved_item;
+    playlistitems << NewPlaylistItemFromQuery(row, state_ptr, &saved_item);
+    saved << saved_item;
+  }
+
+  // Remember what's in the database so the next save only has to write the
+  // rows that change.  If the playlist has been saved since we read it then
+  // the list from the save is already there and is more recent.
+  QMutexLocker l(&saved_items_mutex_);
+  if (!saved_items_.contains(playlist)) {
+    saved_items_[playlist] = saved;
   }
+
   return playlistitems;
 }
 
 QList<Song> PlaylistBackend::GetPlaylistSongs(int playlist) {
-  QSqlQuery q = GetPlaylistRows(playlist);
-  // Note that as this only accesses the query, not the db, we don't need the
-  // mutex.
-  if (db_->CheckErrors(q)) return QList<Song>();
-
   // it's probable that we'll have a few songs associated with the
   // same CUE so we're caching results of parsing CUEs
   std::shared_ptr<NewSongFromQueryState> state_ptr(new NewSongFromQueryState());
+  SqlRowList rows;
+  if (!ReadPlaylistRows(playlist, &rows)) return QList<Song>();
+
   QList<Song> songs;
-  while (q.next()) {
-    songs << NewSongFromQuery(SqlRow(q), state_ptr);
+  for (const SqlRow& row : rows) {
+    songs << NewSongFromQuery(row, state_ptr);
   }
   return songs;
 }
 
 PlaylistItemPtr PlaylistBackend::NewPlaylistItemFromQuery(
-    const SqlRow& row, std::shared_ptr<NewSongFromQueryState> state) {
+    const SqlRow& row, std::shared_ptr<NewSongFromQueryState> state,
+    SavedItem* saved) {
   // The song tables get joined first, plus one each for the song ROWIDs
   const int playlist_row = (Song::kColumns.count() + 1) * kSongTableJoins;
 
   PlaylistItemPtr item(
-      PlaylistItem::NewFromType(row.value(playlist_row).toString()));
+      PlaylistItem::NewFromType(row.ToString(playlist_row)));
   if (item) {
     item->InitFromQuery(row);
+
+    // Take the saved state before restoring the CUE data, so if that changes
+    // the item it gets written next time the playlist is saved.
+    if (saved) {
+      *saved = SaveState(item);
+    }
+  }
+
+  if (saved) {
+    saved->rowid =
+        row.ToLongLong(playlist_row - Song::kColumns.count() - 1);
+    saved->position = row.ToLongLong(playlist_row + 2);
+  }
+
+  if (item) {
     return RestoreCueData(item, state);
   } else {
     return item;
@@ -232,7 +306,6 @@ PlaylistItemPtr PlaylistBackend::RestoreCueData(
   if (item->type() != "File") {
     return item;
   }
-  CueParser cue_parser(app_->library_backend());
 
   Song song = item->Metadata();
   // we're only interested in .cue songs here
@@ -252,6 +325,7 @@ PlaylistItemPtr PlaylistBackend::RestoreCueData(
     QMutexLocker locker(&state->mutex_);
 
     if (!state->cached_cues_.contains(cue_path)) {
+      CueParser cue_parser(app_ ? app_->library_backend() : nullptr);
       QFile cue(cue_path);
       cue.open(QIODevice::ReadOnly);
 
@@ -293,15 +367,6 @@ void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList& items,
 
   qLog(Debug) << "Saving playlist" << playlist;
 
-  QSqlQuery clear("DELETE FROM playlist_items WHERE playlist = :playlist", db);
-  QSqlQuery insert(
-      "INSERT INTO playlist_items"
-      " (playlist, type, library_id, radio_service, " +
-          Song::kColumnSpec +
-          ")"
-          " VALUES (:playlist, :type, :library_id, :radio_service, " +
-          Song::kBindSpec + ")",
-      db);
   QSqlQuery update(
       "UPDATE playlists SET "
       "   last_played=:last_played,"
@@ -311,22 +376,25 @@ void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList& items,
       " WHERE ROWID=:playlist",
       db);
 
+  QMutexLocker saved_l(&saved_items_mutex_);
   ScopedTransaction transaction(&db);
 
-  // Clear the existing items in the playlist
-  clear.bindValue(":playlist", playlist);
-  clear.exec();
-  if (db_->CheckErrors(clear)) return;
-
-  // Save the new ones
-  for (PlaylistItemPtr item : items) {
-    insert.bindValue(":playlist", playlist);
-    item->BindToQuery(&insert);
-
-    insert.exec();
-    db_->CheckErrors(insert);
+  // If we know what's in the database already then only write the items that
+  // changed, otherwise write all of them.
+  SavedItemList saved;
+  bool ok = false;
+  if (saved_items_.contains(playlist)) {
+    saved = saved_items_[playlist];
+    ok = WriteChangedItems(db, playlist, items, &saved);
+  } else {
+    ok = WriteAllItems(db, playlist, items, &saved);
   }
 
+  // Forget what's in the database until the transaction is committed, in case
+  // it gets rolled back.
+  saved_items_.remove(playlist);
+  if (!ok) return;
+
   // Update the last played track number
   update.bindValue(":last_played", last_played);
   if (dynamic) {
@@ -343,6 +411,220 @@ void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList& items,
   if (db_->CheckErrors(update)) return;
 
   transaction.Commit();
+  saved_items_[playlist] = saved;
+}
+
+PlaylistBackend::SavedItem PlaylistBackend::SaveState(PlaylistItemPtr item) {
+  SavedItem ret;
+  ret.item = item;
+  ret.library_id = item->DatabaseValue(PlaylistItem::Column_LibraryId);
+  ret.metadata = item->DatabaseSongMetadata();
+  return ret;
+}
+
+bool PlaylistBackend::HasChanged(const SavedItem& saved, PlaylistItemPtr item) {
+  if (item->DatabaseValue(PlaylistItem::Column_LibraryId) != saved.library_id) {
+    return true;
+  }
+
+  // Items that don't save any metadata return a new empty Song every time.
+  const Song metadata = item->DatabaseSongMetadata();
+  if (!metadata.is_valid() && !saved.metadata.is_valid()) {
+    return false;
+  }
+  return !metadata.IsSharedWith(saved.metadata);
+}
+
+bool PlaylistBackend::WriteAllItems(QSqlDatabase& db, int playlist,
+                                    const PlaylistItemList& items,
+                                    SavedItemList* saved) {
+  QSqlQuery clear("DELETE FROM playlist_items WHERE playlist = :playlist", db);
+  QSqlQuery insert(
+      "INSERT INTO playlist_items"
+      " (playlist, position, type, library_id, radio_service, " +
+          Song::kColumnSpec +
+          ")"
+          " VALUES (:playlist, :position, :type, :library_id, :radio_service, " +
+          Song::kBindSpec + ")",
+      db);
+
+  // Clear the existing items in the playlist
+  clear.bindValue(":playlist", playlist);
+  clear.exec();
+  if (db_->CheckErrors(clear)) return false;
+
+  // Save the new ones
+  saved->clear();
+  for (int i = 0; i < items.count(); ++i) {
+    const qint64 position = (i + 1) * kPositionSpacing;
+
+    insert.bindValue(":playlist", playlist);
+    insert.bindValue(":position", position);
+    items[i]->BindToQuery(&insert);
+
+    insert.exec();
+    if (db_->CheckErrors(insert)) return false;
+
+    SavedItem saved_item = SaveState(items[i]);
+    saved_item.rowid = insert.lastInsertId().toLongLong();
+    saved_item.position = position;
+    *saved << saved_item;
+  }
+
+  return true;
+}
+
+bool PlaylistBackend::WriteChangedItems(QSqlDatabase& db, int playlist,
+                                        const PlaylistItemList& items,
+                                        SavedItemList* saved) {
+  QSqlQuery remove("DELETE FROM playlist_items WHERE ROWID = :id", db);
+  QSqlQuery insert(
+      "INSERT INTO playlist_items"
+      " (playlist, position, type, library_id, radio_service, " +
+          Song::kColumnSpec +
+          ")"
+          " VALUES (:playlist, :position, :type, :library_id, :radio_service, " +
+          Song::kBindSpec + ")",
+      db);
+  QSqlQuery update(
+      "UPDATE playlist_items SET"
+      " type = :type, library_id = :library_id,"
+      " radio_service = :radio_service, " +
+          Song::kUpdateSpec + ", position = :position WHERE ROWID = :id",
+      db);
+  QSqlQuery move("UPDATE playlist_items SET position = :position"
+                 " WHERE ROWID = :id",
+                 db);
+
+  const SavedItemList& old_items = *saved;
+  const int count = items.count();
+
+  // Match up the items with the rows they were saved in last time.  The same
+  // item can appear more than once, in which case the extras get new rows.
+  QHash<PlaylistItem*, int> old_indices;
+  for (int i = 0; i < old_items.count(); ++i) {
+    PlaylistItemPtr item = old_items[i].item.lock();
+    if (item && !old_indices.contains(item.get())) {
+      old_indices[item.get()] = i;
+    }
+  }
+
+  QVector<int> old_index(count, -1);
+  QVector<bool> kept(old_items.count(), false);
+  for (int i = 0; i < count; ++i) {
+    QHash<PlaylistItem*, int>::const_iterator it =
+        old_indices.find(items[i].get());
+    if (it != old_indices.end() && !kept[it.value()]) {
+      old_index[i] = it.value();
+      kept[it.value()] = true;
+    }
+  }
+
+  // The largest set of items that are still in the same order keep their
+  // positions, and everything else is given a position between them.
+  const QVector<bool> in_place = LongestIncreasingSubsequence(old_index);
+  QVector<qint64> positions(count);
+  bool renumber = false;
+
+  for (int i = 0; i < count && !renumber;) {
+    if (in_place[i]) {
+      positions[i] = old_items[old_index[i]].position;
+      ++i;
+      continue;
+    }
+
+    int end = i;
+    while (end < count && !in_place[end]) ++end;
+    const int run = end - i;
+
+    qint64 low = i > 0 ? positions[i - 1] : 0;
+    qint64 high = end < count ? old_items[old_index[end]].position : 0;
+    if (i == 0 && end == count) {
+      high = (run + 1) * kPositionSpacing;
+    } else if (i == 0) {
+      low = high - (run + 1) * kPositionSpacing;
+    } else if (end == count) {
+      high = low + (run + 1) * kPositionSpacing;
+    }
+
+    // If there isn't enough space left between the two neighbours then give
+    // up and space out the whole playlist again.
+    if (high - low <= run) {
+      renumber = true;
+      break;
+    }
+
+    const qint64 step = (high - low) / (run + 1);
+    for (int j = 0; j < run; ++j) {
+      positions[i + j] = low + step * (j + 1);
+    }
+    i = end;
+  }
+
+  if (renumber) {
+    qLog(Debug) << "Renumbering playlist" << playlist;
+    for (int i = 0; i < count; ++i) {
+      positions[i] = (i + 1) * kPositionSpacing;
+    }
+  }
+
+  // Delete the rows of items that aren't in the playlist any more
+  for (int i = 0; i < old_items.count(); ++i) {
+    if (kept[i]) continue;
+
+    remove.bindValue(":id", old_items[i].rowid);
+    remove.exec();
+    if (db_->CheckErrors(remove)) return false;
+  }
+
+  SavedItemList new_items;
+  new_items.reserve(count);
+
+  for (int i = 0; i < count; ++i) {
+    PlaylistItemPtr item = items[i];
+
+    if (old_index[i] == -1) {
+      insert.bindValue(":playlist", playlist);
+      insert.bindValue(":position", positions[i]);
+      item->BindToQuery(&insert);
+
+      insert.exec();
+      if (db_->CheckErrors(insert)) return false;
+
+      SavedItem saved_item = SaveState(item);
+      saved_item.rowid = insert.lastInsertId().toLongLong();
+      saved_item.position = positions[i];
+      new_items << saved_item;
+      continue;
+    }
+
+    SavedItem saved_item = old_items[old_index[i]];
+
+    if (HasChanged(saved_item, item)) {
+      item->BindToQuery(&update);
+      update.bindValue(":position", positions[i]);
+      update.bindValue(":id", saved_item.rowid);
+
+      update.exec();
+      if (db_->CheckErrors(update)) return false;
+
+      const qint64 rowid = saved_item.rowid;
+      saved_item = SaveState(item);
+      saved_item.rowid = rowid;
+    } else if (saved_item.position != positions[i]) {
+      move.bindValue(":position", positions[i]);
+      move.bindValue(":id", saved_item.rowid);
+
+      move.exec();
+      if (db_->CheckErrors(move)) return false;
+    }
+
+    saved_item.position = positions[i];
+    new_items << saved_item;
+  }
+
+  *saved = new_items;
+  return true;
 }
 
 int PlaylistBackend::CreatePlaylist(const QString& name,
@@ -380,6 +662,9 @@ void PlaylistBackend::RemovePlaylist(int id) {
   if (db_->CheckErrors(delete_items)) return;
 
   transaction.Commit();
+
+  QMutexLocker saved_l(&saved_items_mutex_);
+  saved_items_.remove(id);
 }
 
 void PlaylistBackend::RenamePlaylist(int id, const QString& new_name) {
@@ -18,14 +18,19 @@
 #ifndef PLAYLISTBACKEND_H
 #define PLAYLISTBACKEND_H
 
+#include <memory>
+
 #include <QHash>
 #include <QList>
 #include <QMutex>
 #include <QObject>
 
 #include "playlistitem.h"
+#include "library/sqlrow.h"
 #include "smartplaylists/generator_fwd.h"
 
+class QSqlDatabase;
+
 class Application;
 class Database;
 
@@ -34,6 +39,9 @@ class PlaylistBackend : public QObject {
 
  public:
   Q_INVOKABLE PlaylistBackend(Application* app, QObject* parent = nullptr);
+  // Uses db without an Application.  Songs from CUE sheets are loaded without
+  // looking them up in the library.
+  PlaylistBackend(Database* db, QObject* parent = nullptr);
 
   struct Playlist {
     Playlist() : id(-1), favorite(false), last_played(0) {}
@@ -55,6 +63,11 @@ class PlaylistBackend : public QObject {
 
   static const int kSongTableJoins;
 
+  // Items are ordered by their position column.  New playlists are written
+  // with this much space between each item, so items can be inserted or moved
+  // between two others without renumbering the rest of the playlist.
+  static const qint64 kPositionSpacing;
+
   PlaylistList GetAllPlaylists();
   PlaylistList GetAllOpenPlaylists();
   PlaylistList GetAllFavoritePlaylists();
@@ -81,17 +94,34 @@ class PlaylistBackend : public QObject {
                     int last_played, smart_playlists::GeneratorPtr dynamic);
 
  private:
+  // What was last written to the playlist_items table for one item.  The
+  // backend keeps a list of these for each playlist it has loaded or saved so
+  // SavePlaylist only has to write the rows that changed.
+  struct SavedItem {
+    SavedItem() : rowid(-1), position(0) {}
+
+    std::weak_ptr<PlaylistItem> item;
+    qint64 rowid;
+    qint64 position;
+    QVariant library_id;
+    Song metadata;
+  };
+  typedef QList<SavedItem> SavedItemList;
+
   struct NewSongFromQueryState {
     QHash<QString, SongList> cached_cues_;
     QMutex mutex_;
   };
 
-  QSqlQuery GetPlaylistRows(int playlist);
+  // Copies the playlist's rows, in order, out of the database so the items
+  // can be built after the read lock has been released.
+  bool ReadPlaylistRows(int playlist, SqlRowList* rows);
 
   Song NewSongFromQuery(const SqlRow& row,
                         std::shared_ptr<NewSongFromQueryState> state);
   PlaylistItemPtr NewPlaylistItemFromQuery(
-      const SqlRow& row, std::shared_ptr<NewSongFromQueryState> state);
+      const SqlRow& row, std::shared_ptr<NewSongFromQueryState> state,
+      SavedItem* saved = nullptr);
   PlaylistItemPtr RestoreCueData(PlaylistItemPtr item,
                                  std::shared_ptr<NewSongFromQueryState> state);
 
@@ -102,8 +132,24 @@ class PlaylistBackend : public QObject {
   };
   PlaylistList GetPlaylists(GetPlaylistsFlags flags);
 
+  static SavedItem SaveState(PlaylistItemPtr item);
+  static bool HasChanged(const SavedItem& saved, PlaylistItemPtr item);
+
+  // Replaces all the items in the playlist.
+  bool WriteAllItems(QSqlDatabase& db, int playlist,
+                     const PlaylistItemList& items, SavedItemList* saved);
+  // Inserts, deletes and updates only the rows that are different in items.
+  // saved is what's currently in the database, and is replaced by the new
+  // list.
+  bool WriteChangedItems(QSqlDatabase& db, int playlist,
+                         const PlaylistItemList& items, SavedItemList* saved);
+
   Application* app_;
   Database* db_;
+
+  // Playlist ID -> what's in the database for that playlist, in order.
+  QMutex saved_items_mutex_;
+  QHash<int, SavedItemList> saved_items_;
 };
 
 #endif  // PLAYLISTBACKEND_H
@@ -18,12 +18,18 @@
 #include "playlistfilter.h"
 #include "playlistfilterparser.h"
 
+#include <QPair>
+#include <QtConcurrentMap>
 #include <QtDebug>
 
+const int PlaylistFilter::kRowsPerBatch = 4096;
+
 PlaylistFilter::PlaylistFilter(QObject* parent)
     : QSortFilterProxyModel(parent),
       filter_tree_(new NopFilter),
-      query_hash_(0) {
+      query_hash_(0),
+      values_valid_(false),
+      accepted_valid_(false) {
   setDynamicSortFilter(true);
 
   column_names_["title"] = Playlist::Column_Title;
@@ -52,6 +58,8 @@ PlaylistFilter::PlaylistFilter(QObject* parent)
                      << Playlist::Column_OriginalYear << Playlist::Column_Score
                      << Playlist::Column_BPM << Playlist::Column_Bitrate
                      << Playlist::Column_Rating;
+
+  values_.reset(new FilterValues(column_names_.values(), numerical_columns_));
 }
 
 PlaylistFilter::~PlaylistFilter() {}
@@ -61,6 +69,33 @@ void PlaylistFilter::sort(int column, Qt::SortOrder order) {
   sourceModel()->sort(column, order);
 }
 
+void PlaylistFilter::setSourceModel(QAbstractItemModel* source_model) {
+  if (sourceModel()) {
+    disconnect(sourceModel(), 0, this, 0);
+  }
+
+  values_valid_ = false;
+  accepted_valid_ = false;
+
+  if (source_model) {
+    connect(source_model,
+            SIGNAL(dataChanged(QModelIndex, QModelIndex)),
+            SLOT(SourceDataChanged(QModelIndex, QModelIndex)));
+    connect(source_model, SIGNAL(rowsInserted(QModelIndex, int, int)),
+            SLOT(SourceRowsInserted(QModelIndex, int, int)));
+    connect(source_model, SIGNAL(rowsRemoved(QModelIndex, int, int)),
+            SLOT(SourceRowsRemoved(QModelIndex, int, int)));
+    connect(source_model,
+            SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)),
+            SLOT(SourceLayoutChanged()));
+    connect(source_model, SIGNAL(layoutChanged()),
+            SLOT(SourceLayoutChanged()));
+    connect(source_model, SIGNAL(modelReset()), SLOT(SourceLayoutChanged()));
+  }
+
+  QSortFilterProxyModel::setSourceModel(source_model);
+}
+
 bool PlaylistFilter::filterAcceptsRow(int row,
                                       const QModelIndex& parent) const {
   QString filter = filterRegExp().pattern();
@@ -72,8 +107,91 @@ bool PlaylistFilter::filterAcceptsRow(int row,
     filter_tree_.reset(p.parse());
 
     query_hash_ = hash;
+    accepted_valid_ = false;
+
+    // Don't keep a copy of the playlist around if there's nothing to filter.
+    if (filter_tree_->type() == FilterTree::Nop) {
+      values_->Clear();
+      values_valid_ = false;
+      accepted_.clear();
+    }
+  }
+
+  if (filter_tree_->type() == FilterTree::Nop) return true;
+
+  if (!values_valid_) {
+    values_->Reset(sourceModel());
+    values_valid_ = true;
+    accepted_valid_ = false;
+  }
+
+  // Test all the rows at once the first time we're asked about one of them.
+  if (!accepted_valid_) {
+    accepted_.resize(values_->row_count());
+    FilterRows(0, values_->row_count() - 1);
+    accepted_valid_ = true;
+  }
+
+  return accepted_[row];
+}
+
+void PlaylistFilter::FilterRows(int first, int last) const {
+  const FilterTree* tree = filter_tree_.data();
+  const FilterValues* values = values_.data();
+  bool* accepted = accepted_.data();
+
+  if (last - first < kRowsPerBatch) {
+    for (int row = first; row <= last; ++row) {
+      accepted[row] = tree->accept(row, *values);
+    }
+    return;
+  }
+
+  QList<QPair<int, int>> batches;
+  for (int row = first; row <= last; row += kRowsPerBatch) {
+    batches << qMakePair(row, qMin(row + kRowsPerBatch - 1, last));
+  }
+
+  QtConcurrent::blockingMap(batches, [=](const QPair<int, int>& batch) {
+    for (int row = batch.first; row <= batch.second; ++row) {
+      accepted[row] = tree->accept(row, *values);
+    }
+  });
+}
+
+void PlaylistFilter::SourceDataChanged(const QModelIndex& top_left,
+                                       const QModelIndex& bottom_right) {
+  if (!values_valid_) return;
+
+  values_->Update(sourceModel(), top_left.row(), bottom_right.row());
+  if (accepted_valid_) {
+    FilterRows(top_left.row(), bottom_right.row());
   }
+}
+
+void PlaylistFilter::SourceRowsInserted(const QModelIndex&, int first,
+                                        int last) {
+  if (!values_valid_) return;
+
+  values_->Insert(sourceModel(), first, last);
+  if (accepted_valid_) {
+    accepted_.insert(first, last - first + 1, false);
+    FilterRows(first, last);
+  }
+}
+
+void PlaylistFilter::SourceRowsRemoved(const QModelIndex&, int first,
+                                       int last) {
+  if (!values_valid_) return;
+
+  values_->Remove(first, last);
+  if (accepted_valid_) {
+    accepted_.remove(first, last - first + 1);
+  }
+}
 
-  // Test the row
-  return filter_tree_->accept(row, parent, sourceModel());
+void PlaylistFilter::SourceLayoutChanged() {
+  // Rows could be anywhere now, so read them all again next time.
+  values_valid_ = false;
+  accepted_valid_ = false;
 }
@@ -20,13 +20,13 @@
 
 #include <QScopedPointer>
 #include <QSortFilterProxyModel>
+#include <QVector>
 
 #include "playlist.h"
+#include "playlistfilterparser.h"
 
 #include <QSet>
 
-class FilterTree;
-
 class PlaylistFilter : public QSortFilterProxyModel {
   Q_OBJECT
 
@@ -34,18 +34,44 @@ class PlaylistFilter : public QSortFilterProxyModel {
   PlaylistFilter(QObject* parent = nullptr);
   ~PlaylistFilter();
 
+  // Rows are filtered in parallel in batches of this many.
+  static const int kRowsPerBatch;
+
   // QAbstractItemModel
   void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
 
+  // QAbstractProxyModel
+  void setSourceModel(QAbstractItemModel* source_model);
+
   // QSortFilterProxyModel
   // public so Playlist::NextVirtualIndex and friends can get at it
   bool filterAcceptsRow(int source_row, const QModelIndex& source_parent) const;
 
+ private slots:
+  // These are connected to the source model before QSortFilterProxyModel's own
+  // slots, so the values are up to date by the time it calls
+  // filterAcceptsRow().
+  void SourceDataChanged(const QModelIndex& top_left,
+                         const QModelIndex& bottom_right);
+  void SourceRowsInserted(const QModelIndex& parent, int first, int last);
+  void SourceRowsRemoved(const QModelIndex& parent, int first, int last);
+  void SourceLayoutChanged();
+
  private:
+  // Filters rows first to last into accepted_.
+  void FilterRows(int first, int last) const;
+
   // Mutable because they're modified from filterAcceptsRow() const
   mutable QScopedPointer<FilterTree> filter_tree_;
   mutable uint query_hash_;
 
+  // The values of the source model's rows, and whether each row matches the
+  // filter.  These are only kept while there's a filter.
+  QScopedPointer<FilterValues> values_;
+  mutable bool values_valid_;
+  mutable QVector<bool> accepted_;
+  mutable bool accepted_valid_;
+
   QMap<QString, int> column_names_;
   QSet<int> numerical_columns_;
 };
@@ -20,18 +20,117 @@
 #include "core/logging.h"
 
 #include <QAbstractItemModel>
+#include <QScopedPointer>
+
+FilterValues::FilterValues(const QList<int>& columns,
+                           const QSet<int>& numerical_columns)
+    : columns_(Playlist::ColumnCount), row_count_(0) {
+  for (int column : columns) {
+    if (columns_[column].used) continue;
+
+    columns_[column].used = true;
+    columns_[column].numerical = numerical_columns.contains(column);
+    used_columns_ << column;
+  }
+}
+
+void FilterValues::Clear() { Resize(0); }
+
+void FilterValues::Reset(const QAbstractItemModel* model) {
+  Resize(model->rowCount());
+  for (int row = 0; row < row_count_; ++row) {
+    Read(model, row);
+  }
+}
+
+void FilterValues::Update(const QAbstractItemModel* model, int first,
+                          int last) {
+  for (int row = first; row <= last; ++row) {
+    Read(model, row);
+  }
+}
+
+void FilterValues::Insert(const QAbstractItemModel* model, int first,
+                          int last) {
+  const int count = last - first + 1;
+  for (int column : used_columns_) {
+    Column& c = columns_[column];
+    c.text.insert(first, count, QString());
+    if (c.numerical) {
+      c.numerical_text.insert(first, count, QString());
+      c.number.insert(first, count, 0);
+    }
+  }
+  row_count_ += count;
+
+  Update(model, first, last);
+}
+
+void FilterValues::Remove(int first, int last) {
+  const int count = last - first + 1;
+  for (int column : used_columns_) {
+    Column& c = columns_[column];
+    c.text.remove(first, count);
+    if (c.numerical) {
+      c.numerical_text.remove(first, count);
+      c.number.remove(first, count);
+    }
+  }
+  row_count_ -= count;
+}
+
+void FilterValues::Resize(int row_count) {
+  for (int column : used_columns_) {
+    Column& c = columns_[column];
+    c.text.resize(row_count);
+    if (c.numerical) {
+      c.numerical_text.resize(row_count);
+      c.number.resize(row_count);
+    }
+  }
+  row_count_ = row_count;
+}
+
+void FilterValues::Read(const QAbstractItemModel* model, int row) {
+  for (int column : used_columns_) {
+    Column& c = columns_[column];
+
+    const QString text = model->index(row, column).data().toString().toLower();
+    c.text[row] = text;
+    if (!c.numerical) continue;
+
+    QString numerical_text = text;
+    if (column == Playlist::Column_Length) {
+      // The length field of the playlist (entries) contains a song's running
+      // time in nano seconds.  However, we don't really care about nano
+      // seconds, just seconds, so drop the last 9 digits if that many are
+      // present.
+      if (text.length() > 9) {
+        numerical_text = text.left(text.length() - 9);
+      }
+    } else if (column == Playlist::Column_Rating) {
+      numerical_text =
+          QString::number(static_cast<int>(text.toDouble() * 10.0 + 0.5));
+    }
+
+    c.numerical_text[row] = numerical_text;
+    c.number[row] = numerical_text.toInt();
+  }
+}
 
 class SearchTermComparator {
  public:
   virtual ~SearchTermComparator() {}
-  virtual bool Matches(const QString& element) const = 0;
+  // element is the lowercased text of a field, and number is its numerical
+  // value if it's a numerical column.
+  virtual bool Matches(const QString& element, int number) const = 0;
 };
 
 // "compares" by checking if the field contains the search term
 class DefaultComparator : public SearchTermComparator {
  public:
   explicit DefaultComparator(const QString& value) : search_term_(value) {}
-  virtual bool Matches(const QString& element) const {
+  virtual bool Matches(const QString& element, int) const {
     return element.contains(search_term_);
   }
 
@@ -42,7 +141,7 @@ class DefaultComparator : public SearchTermComparator {
 class EqComparator : public SearchTermComparator {
  public:
   explicit EqComparator(const QString& value) : search_term_(value) {}
-  virtual bool Matches(const QString& element) const {
+  virtual bool Matches(const QString& element, int) const {
     return search_term_ == element;
   }
 
@@ -53,7 +152,7 @@ class EqComparator : public SearchTermComparator {
 class NeComparator : public SearchTermComparator {
  public:
   explicit NeComparator(const QString& value) : search_term_(value) {}
-  virtual bool Matches(const QString& element) const {
+  virtual bool Matches(const QString& element, int) const {
     return search_term_ != element;
   }
 
@@ -64,7 +163,7 @@ class NeComparator : public SearchTermComparator {
 class LexicalGtComparator : public SearchTermComparator {
  public:
   explicit LexicalGtComparator(const QString& value) : search_term_(value) {}
-  virtual bool Matches(const QString& element) const {
+  virtual bool Matches(const QString& element, int) const {
     return element > search_term_;
   }
 
@@ -75,7 +174,7 @@ class LexicalGtComparator : public SearchTermComparator {
 class LexicalGeComparator : public SearchTermComparator {
  public:
   explicit LexicalGeComparator(const QString& value) : search_term_(value) {}
-  virtual bool Matches(const QString& element) const {
+  virtual bool Matches(const QString& element, int) const {
     return element >= search_term_;
   }
 
@@ -86,7 +185,7 @@ class LexicalGeComparator : public SearchTermComparator {
 class LexicalLtComparator : public SearchTermComparator {
  public:
   explicit LexicalLtComparator(const QString& value) : search_term_(value) {}
-  virtual bool Matches(const QString& element) const {
+  virtual bool Matches(const QString& element, int) const {
     return element < search_term_;
   }
 
@@ -97,7 +196,7 @@ class LexicalLtComparator : public SearchTermComparator {
 class LexicalLeComparator : public SearchTermComparator {
  public:
   explicit LexicalLeComparator(const QString& value) : search_term_(value) {}
-  virtual bool Matches(const QString& element) const {
+  virtual bool Matches(const QString& element, int) const {
     return element <= search_term_;
   }
 
@@ -108,8 +207,8 @@ class LexicalLeComparator : public SearchTermComparator {
 class GtComparator : public SearchTermComparator {
  public:
   explicit GtComparator(int value) : search_term_(value) {}
-  virtual bool Matches(const QString& element) const {
-    return element.toInt() > search_term_;
+  virtual bool Matches(const QString&, int number) const {
+    return number > search_term_;
   }
 
  private:
@@ -119,8 +218,8 @@ class GtComparator : public SearchTermComparator {
 class GeComparator : public SearchTermComparator {
  public:
   explicit GeComparator(int value) : search_term_(value) {}
-  virtual bool Matches(const QString& element) const {
-    return element.toInt() >= search_term_;
+  virtual bool Matches(const QString&, int number) const {
+    return number >= search_term_;
   }
 
  private:
@@ -130,8 +229,8 @@ class GeComparator : public SearchTermComparator {
 class LtComparator : public SearchTermComparator {
  public:
   explicit LtComparator(int value) : search_term_(value) {}
-  virtual bool Matches(const QString& element) const {
-    return element.toInt() < search_term_;
+  virtual bool Matches(const QString&, int number) const {
+    return number < search_term_;
   }
 
  private:
@@ -141,46 +240,14 @@ class LtComparator : public SearchTermComparator {
 class LeComparator : public SearchTermComparator {
  public:
   explicit LeComparator(int value) : search_term_(value) {}
-  virtual bool Matches(const QString& element) const {
-    return element.toInt() <= search_term_;
+  virtual bool Matches(const QString&, int number) const {
+    return number <= search_term_;
   }
 
  private:
   int search_term_;
 };
 
-// The length field of the playlist (entries) contains a
-// song's running time in nano seconds. However, We don't
-// really care about nano seconds, just seconds. Thus, with
-// this decorator we drop the last 9 digits, if that many
-// are present.
-class DropTailComparatorDecorator : public SearchTermComparator {
- public:
-  explicit DropTailComparatorDecorator(SearchTermComparator* cmp) : cmp_(cmp) {}
-
-  virtual bool Matches(const QString& element) const {
-    if (element.length() > 9)
-      return cmp_->Matches(element.left(element.length() - 9));
-    else
-      return cmp_->Matches(element);
-  }
-
- private:
-  QScopedPointer<SearchTermComparator> cmp_;
-};
-
-class RatingComparatorDecorator : public SearchTermComparator {
- public:
-  explicit RatingComparatorDecorator(SearchTermComparator* cmp) : cmp_(cmp) {}
-  virtual bool Matches(const QString& element) const {
-    return cmp_->Matches(
-        QString::number(static_cast<int>(element.toDouble() * 10.0 + 0.5)));
-  }
-
- private:
-  QScopedPointer<SearchTermComparator> cmp_;
-};
-
 // filter that applies a SearchTermComparator to all fields of a playlist entry
 class FilterTerm : public FilterTree {
  public:
@@ -188,11 +255,9 @@ class FilterTerm : public FilterTree {
                       const QList<int>& columns)
       : cmp_(comparator), columns_(columns) {}
 
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
+  virtual bool accept(int row, const FilterValues& values) const {
     for (int i : columns_) {
-      QModelIndex idx(model->index(row, i, parent));
-      if (cmp_->Matches(idx.data().toString().toLower())) return true;
+      if (cmp_->Matches(values.text(i, row), 0)) return true;
     }
     return false;
   }
@@ -210,10 +275,26 @@ class FilterColumnTerm : public FilterTree {
   FilterColumnTerm(int column, SearchTermComparator* comparator)
       : col(column), cmp_(comparator) {}
 
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
-    QModelIndex idx(model->index(row, col, parent));
-    return cmp_->Matches(idx.data().toString().toLower());
+  virtual bool accept(int row, const FilterValues& values) const {
+    return cmp_->Matches(values.text(col, row), 0);
+  }
+  virtual FilterType type() { return Column; }
+
+ private:
+  int col;
+  QScopedPointer<SearchTermComparator> cmp_;
+};
+
+// filter that applies a SearchTermComparator to one specific numerical field
+// of a playlist entry
+class FilterNumericalColumnTerm : public FilterTree {
+ public:
+  FilterNumericalColumnTerm(int column, SearchTermComparator* comparator)
+      : col(column), cmp_(comparator) {}
+
+  virtual bool accept(int row, const FilterValues& values) const {
+    return cmp_->Matches(values.numerical_text(col, row),
+                         values.number(col, row));
   }
   virtual FilterType type() { return Column; }
 
@@ -226,9 +307,8 @@ class NotFilter : public FilterTree {
  public:
   explicit NotFilter(const FilterTree* inv) : child_(inv) {}
 
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
-    return !child_->accept(row, parent, model);
+  virtual bool accept(int row, const FilterValues& values) const {
+    return !child_->accept(row, values);
   }
   virtual FilterType type() { return Not; }
 
@@ -240,10 +320,9 @@ class OrFilter : public FilterTree {
  public:
   ~OrFilter() { qDeleteAll(children_); }
   virtual void add(FilterTree* child) { children_.append(child); }
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
+  virtual bool accept(int row, const FilterValues& values) const {
     for (FilterTree* child : children_) {
-      if (child->accept(row, parent, model)) return true;
+      if (child->accept(row, values)) return true;
     }
     return false;
   }
@@ -257,10 +336,9 @@ class AndFilter : public FilterTree {
  public:
   virtual ~AndFilter() { qDeleteAll(children_); }
   virtual void add(FilterTree* child) { children_.append(child); }
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
+  virtual bool accept(int row, const FilterValues& values) const {
     for (FilterTree* child : children_) {
-      if (!child->accept(row, parent, model)) return false;
+      if (!child->accept(row, values)) return false;
     }
     return true;
   }
@@ -457,7 +535,7 @@ FilterTree* FilterParser::createSearchTermTreeNode(
   } else if (!col.isEmpty() && columns_.contains(col) &&
              numerical_columns_.contains(columns_[col])) {
     // the length column contains the time in seconds (nano seconds, actually -
-    //  the "nano" part is handled by the DropTailComparatorDecorator,  though).
+    //  the "nano" part is handled by FilterValues, though).
     int search_value;
     if (columns_[col] == Playlist::Column_Length) {
       search_value = parseTime(search);
@@ -495,10 +573,10 @@ FilterTree* FilterParser::createSearchTermTreeNode(
     }
   }
   if (columns_.contains(col)) {
-    if (columns_[col] == Playlist::Column_Length) {
-      cmp = new DropTailComparatorDecorator(cmp);
-    } else if (columns_[col] == Playlist::Column_Rating) {
-      cmp = new RatingComparatorDecorator(cmp);
+    // Lengths and ratings are compared in seconds and out of 10 - FilterValues
+    // converts them.
+    if (numerical_columns_.contains(columns_[col])) {
+      return new FilterNumericalColumnTerm(columns_[col], cmp);
     }
     return new FilterColumnTerm(columns_[col], cmp);
   } else {
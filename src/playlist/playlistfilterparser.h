@@ -18,19 +18,69 @@
 #ifndef PLAYLISTFILTERPARSER_H
 #define PLAYLISTFILTERPARSER_H
 
+#include <QList>
 #include <QMap>
-#include <QModelIndex>
 #include <QSet>
 #include <QString>
+#include <QVector>
 
 class QAbstractItemModel;
 
+// A copy of the columns of a playlist that the filter looks at, so filtering
+// doesn't have to call QAbstractItemModel::data() for every row and term.
+// Text is stored lowercased, and numerical columns are stored both as the
+// text and the number the filter compares them with - lengths in seconds and
+// ratings out of 10.
+class FilterValues {
+ public:
+  FilterValues(const QList<int>& columns, const QSet<int>& numerical_columns);
+
+  int row_count() const { return row_count_; }
+
+  void Clear();
+  // Reads every row of the model.
+  void Reset(const QAbstractItemModel* model);
+  // Reads the rows first to last again after they've changed in the model.
+  void Update(const QAbstractItemModel* model, int first, int last);
+  // Reads the rows first to last after they've been inserted into the model.
+  void Insert(const QAbstractItemModel* model, int first, int last);
+  void Remove(int first, int last);
+
+  const QString& text(int column, int row) const {
+    return columns_[column].text[row];
+  }
+  const QString& numerical_text(int column, int row) const {
+    return columns_[column].numerical_text[row];
+  }
+  int number(int column, int row) const {
+    return columns_[column].number[row];
+  }
+
+ private:
+  struct Column {
+    Column() : used(false), numerical(false) {}
+
+    bool used;
+    bool numerical;
+    QVector<QString> text;
+    QVector<QString> numerical_text;
+    QVector<int> number;
+  };
+
+  void Resize(int row_count);
+  void Read(const QAbstractItemModel* model, int row);
+
+  // Indexed by Playlist::Column.
+  QVector<Column> columns_;
+  QList<int> used_columns_;
+  int row_count_;
+};
+
 // structure for filter parse tree
 class FilterTree {
  public:
   virtual ~FilterTree() {}
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const = 0;
+  virtual bool accept(int row, const FilterValues& values) const = 0;
   enum FilterType { Nop = 0, Or, And, Not, Column, Term };
   virtual FilterType type() = 0;
 };
@@ -38,8 +88,7 @@ class FilterTree {
 // trivial filter that accepts *anything*
 class NopFilter : public FilterTree {
  public:
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
+  virtual bool accept(int row, const FilterValues& values) const {
     return true;
   }
   virtual FilterType type() { return Nop; }
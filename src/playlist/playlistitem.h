@@ -95,6 +95,10 @@ class PlaylistItem : public std::enable_shared_from_this<PlaylistItem> {
   bool GetShouldSkip() const;
 
  protected:
+  // PlaylistBackend looks at the database values to find out which items have
+  // changed since the playlist was last saved.
+  friend class PlaylistBackend;
+
   bool should_skip_;
 
   enum DatabaseColumn { Column_LibraryId, Column_InternetService, };
@@ -31,10 +31,12 @@ class AsxIniParser : public ParserBase {
 
   bool TryMagic(const QByteArray& data) const;
 
-  SongList Load(QIODevice* device, const QString& playlist_path = "",
-                const QDir& dir = QDir()) const;
   void Save(const SongList& songs, QIODevice* device, const QDir& dir = QDir(),
             Playlist::Path path_type = Playlist::Path_Automatic) const;
+
+ protected:
+  SongList Parse(QIODevice* device, const QString& playlist_path,
+                 const QDir& dir) const;
 };
 
 #endif  // ASXINIPARSER_H
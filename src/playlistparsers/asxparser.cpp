@@ -30,8 +30,8 @@
 ASXParser::ASXParser(LibraryBackendInterface* library, QObject* parent)
     : XMLParser(library, parent) {}
 
-SongList ASXParser::Load(QIODevice* device, const QString& playlist_path,
-                         const QDir& dir) const {
+SongList ASXParser::Parse(QIODevice* device, const QString& playlist_path,
+                          const QDir& dir) const {
   // We have to load everything first so we can munge the "XML".
   QByteArray data = device->readAll();
 
@@ -47,8 +47,8 @@ const char* CueParser::kDisc = "discnumber";
 CueParser::CueParser(LibraryBackendInterface* library, QObject* parent)
     : ParserBase(library, parent) {}
 
-SongList CueParser::Load(QIODevice* device, const QString& playlist_path,
-                         const QDir& dir) const {
+SongList CueParser::Parse(QIODevice* device, const QString& playlist_path,
+                          const QDir& dir) const {
   SongList ret;
 
   QTextStream text_stream(device);
@@ -27,8 +27,8 @@
 M3UParser::M3UParser(LibraryBackendInterface* library, QObject* parent)
     : ParserBase(library, parent) {}
 
-SongList M3UParser::Load(QIODevice* device, const QString& playlist_path,
-                         const QDir& dir) const {
+SongList M3UParser::Parse(QIODevice* device, const QString& playlist_path,
+                          const QDir& dir) const {
   SongList ret;
 
   M3UType type = STANDARD;
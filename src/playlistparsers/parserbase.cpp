@@ -22,10 +22,109 @@
 #include "library/sqlrow.h"
 #include "playlist/playlist.h"
 
+#include <QBuffer>
+#include <QMutexLocker>
 #include <QUrl>
+#include <QtConcurrentMap>
+
+namespace {
+
+QString CanonicalFilename(const QString& filename) {
+  if (QFile::exists(filename)) {
+    return QFileInfo(filename).canonicalFilePath();
+  }
+  return filename;
+}
+
+}  // namespace
 
 ParserBase::ParserBase(LibraryBackendInterface* library, QObject* parent)
-    : QObject(parent), library_(library) {}
+    : QObject(parent), library_(library), state_(nullptr) {}
+
+SongList ParserBase::Load(QIODevice* device, const QString& playlist_path,
+                          const QDir& dir) const {
+  QMutexLocker l(&load_mutex_);
+
+  const QByteArray data = device->readAll();
+
+  LoadState state;
+  state_ = &state;
+
+  QBuffer buffer;
+  buffer.setData(data);
+  buffer.open(QIODevice::ReadOnly);
+  SongList ret = Parse(&buffer, playlist_path, dir);
+
+  // If there were any local files in the playlist then load them all and parse
+  // it again.  Otherwise the songs are complete already.
+  if (!state.sections.isEmpty()) {
+    LoadSections(&state);
+    state.collecting = false;
+
+    buffer.close();
+    buffer.open(QIODevice::ReadOnly);
+    ret = Parse(&buffer, playlist_path, dir);
+  }
+
+  state_ = nullptr;
+  return ret;
+}
+
+void ParserBase::LoadSections(LoadState* state) const {
+  QStringList filenames;
+  for (const FileSection& section : state->sections) {
+    if (!state->canonical_filenames.contains(section.first)) {
+      state->canonical_filenames[section.first] = QString();
+      filenames << section.first;
+    }
+  }
+
+  // Finding canonical paths hits the filesystem, so do them in parallel.
+  const QStringList canonical_filenames =
+      QtConcurrent::blockingMapped(filenames, CanonicalFilename);
+  for (int i = 0; i < filenames.count(); ++i) {
+    state->canonical_filenames[filenames[i]] = canonical_filenames[i];
+  }
+
+  // Look up all the files in the library at once
+  if (library_) {
+    QList<QUrl> urls;
+    for (const QString& filename : canonical_filenames) {
+      urls << QUrl::fromLocalFile(filename);
+    }
+
+    for (const Song& song : library_->GetSongsByUrls(urls)) {
+      state->library_songs[qMakePair(song.url().toEncoded(),
+                                     song.beginning_nanosec())] = song;
+    }
+  }
+
+  // Read the tags of the ones that weren't in the library
+  QStringList missing_filenames;
+  for (const FileSection& section : state->sections) {
+    const QString& filename = state->canonical_filenames[section.first];
+    const QPair<QByteArray, qint64> key(
+        QUrl::fromLocalFile(filename).toEncoded(), section.second);
+
+    if (!state->library_songs.contains(key) &&
+        !state->file_songs.contains(filename)) {
+      state->file_songs[filename] = Song();
+      missing_filenames << filename;
+    }
+  }
+
+  if (!missing_filenames.isEmpty()) {
+    SongList songs;
+    for (int i = 0; i < missing_filenames.count(); ++i) {
+      songs << Song();
+    }
+    TagReaderClient::Instance()->ReadFilesBlocking(missing_filenames, &songs);
+
+    for (int i = 0; i < missing_filenames.count(); ++i) {
+      state->file_songs[missing_filenames[i]] = songs[i];
+    }
+  }
+}
 
 void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
                           const QDir& dir, Song* song) const {
@@ -57,16 +156,32 @@ void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
     filename = dir.absoluteFilePath(filename);
   }
 
+  // The first time through Load we just remember the file, it gets loaded
+  // later along with all the others.
+  if (state_ && state_->collecting) {
+    const FileSection section(filename, beginning);
+    if (!state_->seen_sections.contains(section)) {
+      state_->seen_sections.insert(section);
+      state_->sections << section;
+    }
+    return;
+  }
+
   // Use the canonical path
-  if (QFile::exists(filename)) {
-    filename = QFileInfo(filename).canonicalFilePath();
+  if (state_ && state_->canonical_filenames.contains(filename)) {
+    filename = state_->canonical_filenames[filename];
+  } else {
+    filename = CanonicalFilename(filename);
   }
 
   const QUrl url = QUrl::fromLocalFile(filename);
 
   // Search in the library
   Song library_song;
-  if (library_) {
+  if (state_) {
+    library_song =
+        state_->library_songs.value(qMakePair(url.toEncoded(), beginning));
+  } else if (library_) {
     library_song = library_->GetSongByUrl(url, beginning);
   }
 
@@ -74,6 +189,8 @@ void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
   // disk.
   if (library_song.is_valid()) {
     *song = library_song;
+  } else if (state_ && state_->file_songs.contains(filename)) {
+    *song = state_->file_songs[filename];
   } else {
     TagReaderClient::Instance()->ReadFileBlocking(filename, song);
   }
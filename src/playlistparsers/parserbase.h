@@ -20,6 +20,10 @@
 
 #include <QObject>
 #include <QDir>
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QSet>
 
 #include "core/song.h"
 #include "playlist/playlist.h"
@@ -49,13 +53,20 @@ class ParserBase : public QObject {
   // This means that the final resulting SongList should be considered valid (at
   // least
   // from the parser's point of view).
-  virtual SongList Load(QIODevice* device, const QString& playlist_path = "",
-                        const QDir& dir = QDir()) const = 0;
+  // The playlist is parsed twice: first to find out which local files it
+  // refers to, which are then looked up in the library and have their tags
+  // read all at once, and again to create the songs.
+  SongList Load(QIODevice* device, const QString& playlist_path = "",
+                const QDir& dir = QDir()) const;
   virtual void Save(
       const SongList& songs, QIODevice* device, const QDir& dir = QDir(),
       Playlist::Path path_type = Playlist::Path_Automatic) const = 0;
 
  protected:
+  // Parses the playlist in device, calling LoadSong for each entry.
+  virtual SongList Parse(QIODevice* device, const QString& playlist_path,
+                         const QDir& dir) const = 0;
+
   // Loads a song.  If filename_or_url is a URL (with a scheme other than
   // "file") then it is set on the song and the song marked as a stream.
   // If it is a filename or a file:// URL then it is made absolute and canonical
@@ -75,7 +86,37 @@ class ParserBase : public QObject {
                         Playlist::Path path_type) const;
 
  private:
+  // A local file in the playlist, and the beginning of the section in it.
+  typedef QPair<QString, qint64> FileSection;
+
+  // The files a playlist refers to, and their songs once they're loaded.
+  struct LoadState {
+    LoadState() : collecting(true) {}
+
+    // True while the playlist is parsed the first time, when LoadSong only
+    // remembers which files it's asked for.
+    bool collecting;
+
+    QList<FileSection> sections;
+    QSet<FileSection> seen_sections;
+
+    // Absolute filename -> canonical filename
+    QHash<QString, QString> canonical_filenames;
+    // Keyed on the encoded URL and beginning.
+    QHash<QPair<QByteArray, qint64>, Song> library_songs;
+    // Keyed on the canonical filename.
+    QHash<QString, Song> file_songs;
+  };
+
+  // Resolves all the sections collected in state against the library, and
+  // reads the tags of the rest in parallel.
+  void LoadSections(LoadState* state) const;
+
   LibraryBackendInterface* library_;
+
+  // Held for the duration of Load, which sets state_.
+  mutable QMutex load_mutex_;
+  mutable LoadState* state_;
 };
 
 #endif  // PARSERBASE_H
@@ -25,8 +25,8 @@
 PLSParser::PLSParser(LibraryBackendInterface* library, QObject* parent)
     : ParserBase(library, parent) {}
 
-SongList PLSParser::Load(QIODevice* device, const QString& playlist_path,
-                         const QDir& dir) const {
+SongList PLSParser::Parse(QIODevice* device, const QString& playlist_path,
+                          const QDir& dir) const {
   QMap<int, Song> songs;
   QRegExp n_re("\\d+$");
 
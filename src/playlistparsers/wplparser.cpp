@@ -28,8 +28,8 @@ bool WplParser::TryMagic(const QByteArray& data) const {
   return data.contains("<?wpl") || data.contains("<smil>");
 }
 
-SongList WplParser::Load(QIODevice* device, const QString& playlist_path,
-                         const QDir& dir) const {
+SongList WplParser::Parse(QIODevice* device, const QString& playlist_path,
+                          const QDir& dir) const {
   SongList ret;
 
   QXmlStreamReader reader(device);
@@ -30,11 +30,13 @@ class WplParser : public XMLParser {
 
   bool TryMagic(const QByteArray& data) const;
 
-  SongList Load(QIODevice* device, const QString& playlist_path,
-                const QDir& dir) const;
   void Save(const SongList& songs, QIODevice* device, const QDir& dir,
             Playlist::Path path_type = Playlist::Path_Automatic) const;
 
+ protected:
+  SongList Parse(QIODevice* device, const QString& playlist_path,
+                 const QDir& dir) const;
+
  private:
   void ParseSeq(const QDir& dir, QXmlStreamReader* reader,
                 SongList* songs) const;
@@ -31,8 +31,8 @@
 XSPFParser::XSPFParser(LibraryBackendInterface* library, QObject* parent)
     : XMLParser(library, parent) {}
 
-SongList XSPFParser::Load(QIODevice* device, const QString& playlist_path,
-                          const QDir& dir) const {
+SongList XSPFParser::Parse(QIODevice* device, const QString& playlist_path,
+                           const QDir& dir) const {
   SongList ret;
 
   QXmlStreamReader reader(device);
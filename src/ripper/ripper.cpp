@@ -25,7 +25,7 @@
 #include "core/logging.h"
 #include "core/tagreaderclient.h"
 #include "transcoder/transcoder.h"
-#include "core/utilities.h"
+#include "transcoder/transcoderstream.h"
 
 // winspool.h defines this :(
 #ifdef AddJob
@@ -33,11 +33,17 @@
 #endif
 
 namespace {
-const char kWavHeaderRiffMarker[] = "RIFF";
-const char kWavFileTypeFormatChunk[] = "WAVEfmt ";
-const char kWavDataString[] = "data";
+// An empty device opens the default cd drive.  Other devices can also be disc
+// images, like a .cue file.
+CdIo_t* OpenDevice(const QString& device) {
+  if (device.isEmpty()) return cdio_open(NULL, DRIVER_UNKNOWN);
+  return cdio_open(QFile::encodeName(device).constData(), DRIVER_UNKNOWN);
+}
 }  // namespace
 
+// One second of audio.  Linux won't read more than this in one go.
+const int Ripper::kSectorsPerRead = CDIO_CD_FRAMES_PER_SEC;
+
 Ripper::Ripper(QObject* parent)
     : QObject(parent),
       transcoder_(new Transcoder(this)),
@@ -45,9 +51,23 @@ Ripper::Ripper(QObject* parent)
       finished_success_(0),
       finished_failed_(0),
       files_tagged_(0) {
-  cdio_ = cdio_open(NULL, DRIVER_UNKNOWN);
+  Init();
+}
+
+Ripper::Ripper(const QString& device, QObject* parent)
+    : QObject(parent),
+      device_(device),
+      transcoder_(new Transcoder(this)),
+      cancel_requested_(false),
+      finished_success_(0),
+      finished_failed_(0),
+      files_tagged_(0) {
+  Init();
+}
+
+void Ripper::Init() {
+  cdio_ = OpenDevice(device_);
 
-  connect(this, SIGNAL(RippingComplete()), transcoder_, SLOT(Start()));
   connect(transcoder_, SIGNAL(JobComplete(QString, QString, bool)),
           SLOT(TranscodingJobComplete(QString, QString, bool)));
   connect(transcoder_, SIGNAL(AllJobsComplete()),
@@ -107,7 +127,7 @@ bool Ripper::CheckCDIOIsValid() {
   if (cdio_) {
     cdio_destroy(cdio_);
   }
-  cdio_ = cdio_open(NULL, DRIVER_UNKNOWN);
+  cdio_ = OpenDevice(device_);
   // Refresh the status of the cd media. This will prevent unnecessary
   // rebuilds of the track list table.
   if (cdio_) {
@@ -128,10 +148,26 @@ void Ripper::Start() {
     QMutexLocker l(&mutex_);
     cancel_requested_ = false;
   }
+  finished_success_ = 0;
+  finished_failed_ = 0;
   SetupProgressInterval();
+  UpdateProgress();
+
+  // Queue a transcoder job for every track first, so the transcoder can start
+  // encoding as soon as the first sectors are read.
+  for (TrackInformation& track : tracks_) {
+    const lsn_t first = cdio_get_track_lsn(cdio_, track.track_number);
+    const lsn_t last = cdio_get_track_last_lsn(cdio_, track.track_number);
+    track.stream.reset(
+        new TranscoderStream((last - first + 1) * CDIO_CD_FRAMESIZE_RAW));
+    track.job_name = QString("cdda://%1").arg(track.track_number);
+    transcoder_->AddStreamJob(track.job_name, track.stream, track.preset,
+                              track.transcoded_filename);
+  }
+  transcoder_->Start();
 
   qLog(Debug) << "Ripping" << AddedTracks() << "tracks.";
-  QtConcurrent::run(this, &Ripper::Rip);
+  QtConcurrent::run(this, &Ripper::Rip, tracks_);
 }
 
 void Ripper::Cancel() {
@@ -140,7 +176,6 @@ void Ripper::Cancel() {
     cancel_requested_ = true;
   }
   transcoder_->Cancel();
-  RemoveTemporaryDirectory();
   emit(Cancelled());
 }
 
@@ -158,112 +193,81 @@ void Ripper::TranscodingJobComplete(const QString& input, const QString& output,
   // file later on.
   for (QList<TrackInformation>::iterator it = tracks_.begin();
        it != tracks_.end(); ++it) {
-    if (it->temporary_filename == input) {
+    if (it->job_name == input) {
       it->transcoded_filename = output;
     }
   }
 }
 
-void Ripper::AllTranscodingJobsComplete() {
-  RemoveTemporaryDirectory();
-  TagFiles();
-}
+void Ripper::AllTranscodingJobsComplete() { TagFiles(); }
 
 void Ripper::LogLine(const QString& message) { qLog(Debug) << message; }
 
-/*
- * WAV Header documentation
- * as taken from:
- * http://www.topherlee.com/software/pcm-tut-wavformat.html
- * Pos   Value   Description
- * 0-3 | "RIFF" |  Marks the file as a riff file.
- *              |  Characters are each 1 byte long.
- * 4-7 | File size (integer) | Size of the overall file - 8 bytes,
- *                           | in bytes (32-bit integer).
- * 8-11  | "WAVE" | File Type Header. For our purposes,
- *                | it always equals "WAVE".
- * 13-16 | "fmt " | Format chunk marker. Includes trailing null.
- * 17-20 |  16   | Length of format data as listed above
- * 21-22 |   1   | Type of format (1 is PCM) - 2 byte integer
- * 23-24 |   2   | Number of Channels - 2 byte integer
- * 25-28 | 44100 | Sample Rate - 32 byte integer. Common values
- *               | are 44100 (CD), 48000 (DAT).
- *               | Sample Rate = Number of Samples per second, or Hertz.
- * 29-32 | 176400 |  (Sample Rate * BitsPerSample * Channels) / 8.
- * 33-34 | 4 |  (BitsPerSample * Channels) / 8.1 - 8 bit mono2 - 8 bit stereo/16
- * bit mono4 - 16 bit stereo
- * 35-36 | 16 |  Bits per sample
- * 37-40 | "data" | "data" chunk header.
- *                | Marks the beginning of the data section.
- * 41-44 | File size (data) | Size of the data section.
- */
-void Ripper::WriteWAVHeader(QFile* stream, int32_t i_bytecount) {
-  QDataStream data_stream(stream);
-  data_stream.setByteOrder(QDataStream::LittleEndian);
-  // sizeof() - 1 to avoid including "\0" in the file too
-  data_stream.writeRawData(kWavHeaderRiffMarker,
-                           sizeof(kWavHeaderRiffMarker) - 1); /* 0-3 */
-  data_stream << qint32(i_bytecount + 44 - 8);                /* 4-7 */
-  data_stream.writeRawData(kWavFileTypeFormatChunk,
-                           sizeof(kWavFileTypeFormatChunk) - 1); /*  8-15 */
-  data_stream << (qint32)16;                                     /* 16-19 */
-  data_stream << (qint16)1;                                      /* 20-21 */
-  data_stream << (qint16)2;                                      /* 22-23 */
-  data_stream << (qint32)44100;                                  /* 24-27 */
-  data_stream << (qint32)(44100 * 2 * 2);                        /* 28-31 */
-  data_stream << (qint16)4;                                      /* 32-33 */
-  data_stream << (qint16)16;                                     /* 34-35 */
-  data_stream.writeRawData(kWavDataString,
-                           sizeof(kWavDataString) - 1); /* 36-39 */
-  data_stream << (qint32)i_bytecount;                   /* 40-43 */
+void Ripper::TrackRipped() {
+  finished_success_++;
+  UpdateProgress();
 }
 
-void Ripper::Rip() {
-  temporary_directory_ = Utilities::MakeTempDir() + "/";
-  finished_success_ = 0;
-  finished_failed_ = 0;
+bool Ripper::IsCancelRequested() {
+  QMutexLocker l(&mutex_);
+  return cancel_requested_;
+}
 
-  // Set up progress bar
-  UpdateProgress();
+void Ripper::Rip(const QList<TrackInformation>& tracks) {
+  for (const TrackInformation& track : tracks) {
+    const lsn_t first = cdio_get_track_lsn(cdio_, track.track_number);
+    const lsn_t last = cdio_get_track_last_lsn(cdio_, track.track_number);
 
-  for (QList<TrackInformation>::iterator it = tracks_.begin();
-       it != tracks_.end(); ++it) {
-    QString filename =
-        QString("%1%2.wav").arg(temporary_directory_).arg(it->track_number);
-    QFile destination_file(filename);
-    destination_file.open(QIODevice::WriteOnly);
-
-    lsn_t i_first_lsn = cdio_get_track_lsn(cdio_, it->track_number);
-    lsn_t i_last_lsn = cdio_get_track_last_lsn(cdio_, it->track_number);
-    WriteWAVHeader(&destination_file,
-                   (i_last_lsn - i_first_lsn + 1) * CDIO_CD_FRAMESIZE_RAW);
-
-    QByteArray buffered_input_bytes(CDIO_CD_FRAMESIZE_RAW, '\0');
-    for (lsn_t i_cursor = i_first_lsn; i_cursor <= i_last_lsn; i_cursor++) {
-      {
-        QMutexLocker l(&mutex_);
-        if (cancel_requested_) {
-          qLog(Debug) << "CD ripping canceled.";
-          return;
+    // If the stream was closed the transcoder job failed, and it's counted by
+    // TranscodingJobComplete.  Carry on with the next track.
+    const bool ripped = RipSectors(first, last, track.stream.get());
+    if (ripped) {
+      track.stream->Finish();
+    }
+    if (IsCancelRequested()) {
+      qLog(Debug) << "CD ripping canceled.";
+      return;
+    }
+
+    if (ripped) {
+      QMetaObject::invokeMethod(this, "TrackRipped", Qt::QueuedConnection);
+    }
+  }
+  emit(RippingComplete());
+}
+
+bool Ripper::RipSectors(lsn_t first, lsn_t last, TranscoderStream* stream) {
+  QByteArray buffer(kSectorsPerRead * CDIO_CD_FRAMESIZE_RAW, '\0');
+
+  for (lsn_t cursor = first; cursor <= last;) {
+    if (IsCancelRequested()) return false;
+
+    const int count = qMin<lsn_t>(kSectorsPerRead, last - cursor + 1);
+    if (cdio_read_audio_sectors(cdio_, buffer.data(), cursor, count) !=
+        DRIVER_OP_SUCCESS) {
+      // Some drives won't read more than one sector at a time near the end of
+      // the disc, so try again one by one before giving up.
+      for (int i = 0; i < count; ++i) {
+        if (cdio_read_audio_sector(
+                cdio_, buffer.data() + i * CDIO_CD_FRAMESIZE_RAW,
+                cursor + i) != DRIVER_OP_SUCCESS) {
+          qLog(Error) << "CD read error at sector" << cursor + i;
+          // Keep what was read so far, and end the track there.
+          if (i > 0 && !stream->Write(buffer.constData(),
+                                      i * CDIO_CD_FRAMESIZE_RAW)) {
+            return false;
+          }
+          return true;
         }
       }
-      if (cdio_read_audio_sector(cdio_, buffered_input_bytes.data(),
-                                 i_cursor) == DRIVER_OP_SUCCESS) {
-        destination_file.write(buffered_input_bytes.data(),
-                               buffered_input_bytes.size());
-      } else {
-        qLog(Error) << "CD read error";
-        break;
-      }
     }
-    finished_success_++;
-    UpdateProgress();
 
-    it->temporary_filename = filename;
-    transcoder_->AddJob(it->temporary_filename, it->preset,
-                        it->transcoded_filename);
+    if (!stream->Write(buffer.constData(), count * CDIO_CD_FRAMESIZE_RAW)) {
+      return false;
+    }
+    cursor += count;
   }
-  emit(RippingComplete());
+  return true;
 }
 
 // The progress interval is [0, 200*AddedTracks()], where the first
@@ -284,12 +288,6 @@ void Ripper::UpdateProgress() {
   qLog(Debug) << "Progress:" << progress;
 }
 
-void Ripper::RemoveTemporaryDirectory() {
-  if (!temporary_directory_.isEmpty())
-    Utilities::RemoveRecursive(temporary_directory_);
-  temporary_directory_.clear();
-}
-
 void Ripper::TagFiles() {
   files_tagged_ = 0;
   for (const TrackInformation& track : tracks_) {
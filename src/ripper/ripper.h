@@ -18,6 +18,8 @@
 #ifndef SRC_RIPPER_RIPPER_H_
 #define SRC_RIPPER_RIPPER_H_
 
+#include <memory>
+
 #include <cdio/cdio.h>
 #include <QMutex>
 #include <QObject>
@@ -26,7 +28,7 @@
 #include "core/tagreaderclient.h"
 #include "transcoder/transcoder.h"
 
-class QFile;
+class TranscoderStream;
 
 // Rips selected tracks from an audio CD, transcodes them to a chosen
 // format, and finally tags the files with the supplied metadata.
@@ -35,13 +37,21 @@ class QFile;
 // SetAlbumInformation(). Then start the ripper with Start(). The ripper
 // emits the Finished() signal when it's done or the Cancelled()
 // signal if the ripping has been cancelled.
+//
+// The audio is streamed straight into the transcoder while it's being read,
+// so a track is encoded while the next one is read from the disc.
 class Ripper : public QObject {
   Q_OBJECT
 
  public:
   explicit Ripper(QObject* parent = nullptr);
+  // Opens the given cd device or disc image instead of the default device.
+  explicit Ripper(const QString& device, QObject* parent = nullptr);
   ~Ripper();
 
+  // Number of sectors read from the disc at once.
+  static const int kSectorsPerRead;
+
   // Adds a track to the rip list if the track number corresponds to a
   // track on the audio cd. The track will transcoded according to the
   // chosen TranscoderPreset.
@@ -83,6 +93,7 @@ signals:
   void AllTranscodingJobsComplete();
   void LogLine(const QString& message);
   void FileTagged(TagReaderReply* reply);
+  void TrackRipped();
 
  private:
   struct TrackInformation {
@@ -98,7 +109,9 @@ signals:
     QString title;
     QString transcoded_filename;
     TranscoderPreset preset;
-    QString temporary_filename;
+    // The name of the transcoder job, and the stream the audio is written to.
+    QString job_name;
+    std::shared_ptr<TranscoderStream> stream;
   };
 
   struct AlbumInformation {
@@ -112,16 +125,21 @@ signals:
     Song::FileType type;
   };
 
-  void WriteWAVHeader(QFile* stream, int32_t i_bytecount);
-  void Rip();
+  void Init();
+  // Runs in a background thread, and writes the audio of each track to its
+  // stream.
+  void Rip(const QList<TrackInformation>& tracks);
+  // Reads the sectors [first, last] of the disc and writes them to stream.
+  // Returns false if the rip was cancelled or the stream was closed.
+  bool RipSectors(lsn_t first, lsn_t last, TranscoderStream* stream);
+  bool IsCancelRequested();
   void SetupProgressInterval();
   void UpdateProgress();
-  void RemoveTemporaryDirectory();
   void TagFiles();
 
+  QString device_;
   CdIo_t* cdio_;
   Transcoder* transcoder_;
-  QString temporary_directory_;
   bool cancel_requested_;
   QMutex mutex_;
   int finished_success_;
@@ -18,6 +18,7 @@
 #include "querygenerator.h"
 #include "library/librarybackend.h"
 
+#include <QMap>
 #include <QtDebug>
 
 namespace smart_playlists {
@@ -69,7 +70,13 @@ PlaylistItemList QueryGenerator::GenerateMore(int count) {
     current_pos_ += search_copy.limit_;
   }
 
-  SongList songs = backend_->FindSongs(search_copy);
+  SongList songs;
+  if (search_copy.sort_type_ == Search::Sort_Random) {
+    songs = FindRandomSongs(search_copy);
+  } else {
+    songs = backend_->FindSongs(search_copy);
+  }
+
   PlaylistItemList items;
   for (const Song& song : songs) {
     items << PlaylistItemPtr(PlaylistItem::NewFromSongsTable(
@@ -82,4 +89,28 @@ PlaylistItemList QueryGenerator::GenerateMore(int count) {
   return items;
 }
 
+SongList QueryGenerator::FindRandomSongs(const Search& search) {
+  if (!random_sampler_) {
+    random_sampler_.reset(new RandomSampler(backend_));
+  }
+
+  const QList<int> ids =
+      random_sampler_->Sample(search, search.limit_, search.id_not_in_);
+
+  // GetSongsById returns the songs in whatever order sqlite finds them, so
+  // put them back in the order they were picked.
+  QMap<int, Song> songs_by_id;
+  for (const Song& song : backend_->GetSongsById(ids)) {
+    songs_by_id[song.id()] = song;
+  }
+
+  SongList ret;
+  for (int id : ids) {
+    if (songs_by_id.contains(id)) {
+      ret << songs_by_id[id];
+    }
+  }
+  return ret;
+}
+
 }  // namespace
@@ -18,7 +18,10 @@
 #ifndef QUERYPLAYLISTGENERATOR_H
 #define QUERYPLAYLISTGENERATOR_H
 
+#include <memory>
+
 #include "generator.h"
+#include "randomsampler.h"
 #include "search.h"
 
 namespace smart_playlists {
@@ -44,11 +47,17 @@ class QueryGenerator : public Generator {
   int GetDynamicFuture() { return search_.limit_; }
 
  private:
+  // Picks random songs without making sqlite sort the whole library.
+  SongList FindRandomSongs(const Search& search);
+
   Search search_;
   bool dynamic_;
 
   QList<int> previous_ids_;
   int current_pos_;
+
+  // Created the first time a random playlist is generated.
+  std::unique_ptr<RandomSampler> random_sampler_;
 };
 
 }  // namespace
@@ -0,0 +1,123 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "randomsampler.h"
+#include "library/librarybackend.h"
+
+#include <ctime>
+
+#include <QMutexLocker>
+#include <QSet>
+
+namespace smart_playlists {
+
+RandomSampler::RandomSampler(LibraryBackend* backend, QObject* parent)
+    : QObject(parent),
+      backend_(backend),
+      songs_changed_(0),
+      statistics_changed_(0),
+      valid_(false),
+      random_(std::time(nullptr)) {
+  // These are emitted from the database thread, and just set a flag, so
+  // they're safe to handle there.
+  connect(backend_, SIGNAL(SongsDiscovered(SongList)), SLOT(SongsChanged()),
+          Qt::DirectConnection);
+  connect(backend_, SIGNAL(SongsDeleted(SongList)), SLOT(SongsChanged()),
+          Qt::DirectConnection);
+  connect(backend_, SIGNAL(DatabaseReset()), SLOT(SongsChanged()),
+          Qt::DirectConnection);
+  connect(backend_, SIGNAL(SongsStatisticsChanged(SongList)),
+          SLOT(StatisticsChanged()), Qt::DirectConnection);
+  connect(backend_, SIGNAL(SongsRatingChanged(SongList)),
+          SLOT(StatisticsChanged()), Qt::DirectConnection);
+}
+
+void RandomSampler::SongsChanged() { songs_changed_.fetchAndStoreOrdered(1); }
+
+void RandomSampler::StatisticsChanged() {
+  statistics_changed_.fetchAndStoreOrdered(1);
+}
+
+QList<int> RandomSampler::Sample(const Search& search, int count,
+                                 const QList<int>& exclude) {
+  QMutexLocker l(&mutex_);
+
+  // Statistics change every time a song is played, so they only matter if
+  // the search looks at them.
+  if (songs_changed_.fetchAndStoreOrdered(0)) {
+    valid_ = false;
+  }
+  if (statistics_changed_.fetchAndStoreOrdered(0) &&
+      search_.depends_on_statistics()) {
+    valid_ = false;
+  }
+
+  // Only the terms affect which songs match - the sort order and limit don't.
+  if (!valid_ || search.search_type_ != search_.search_type_ ||
+      search.terms_ != search_.terms_) {
+    search_ = search;
+    ids_ = backend_->FindSongIds(search).toVector();
+    id_set_ = QSet<int>::fromList(ids_.toList());
+    valid_ = true;
+  }
+
+  const int total = ids_.count();
+  const QSet<int> excluded = QSet<int>::fromList(exclude);
+
+  // The excluded ids might not all match the search.  There are usually far
+  // fewer of them than matching songs, so only they are looked at.
+  int available = total;
+  for (int id : excluded) {
+    if (id_set_.contains(id)) --available;
+  }
+  count = count < 0 ? available : qMin(count, available);
+
+  QList<int> ret;
+  if (count <= 0) return ret;
+
+  // Shuffle the first count ids into place with a partial Fisher-Yates
+  // shuffle, skipping the excluded ones.  At least half of the ids in the
+  // unshuffled part are always allowed when available >= total / 2, so this
+  // takes about count steps.  ids_ is unordered so it can be shuffled in
+  // place.
+  if (available * 2 >= total) {
+    for (int i = 0; ret.count() < count;) {
+      std::uniform_int_distribution<int> dist(i, total - 1);
+      std::swap(ids_[i], ids_[dist(random_)]);
+      if (excluded.contains(ids_[i])) continue;
+
+      ret << ids_[i];
+      ++i;
+    }
+    return ret;
+  }
+
+  // Most of the ids are excluded, so pick from the rest.
+  QVector<int> candidates;
+  candidates.reserve(available);
+  for (int id : ids_) {
+    if (!excluded.contains(id)) candidates << id;
+  }
+  for (int i = 0; i < count; ++i) {
+    std::uniform_int_distribution<int> dist(i, candidates.count() - 1);
+    std::swap(candidates[i], candidates[dist(random_)]);
+    ret << candidates[i];
+  }
+  return ret;
+}
+
+}  // namespace
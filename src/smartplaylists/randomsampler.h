@@ -0,0 +1,72 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SMARTPLAYLISTS_RANDOMSAMPLER_H
+#define SMARTPLAYLISTS_RANDOMSAMPLER_H
+
+#include <random>
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QVector>
+
+#include "search.h"
+
+class LibraryBackend;
+
+namespace smart_playlists {
+
+// Picks random songs that match a search.  ORDER BY random() makes sqlite
+// find and sort every matching song each time, so instead this remembers the
+// ROWIDs of the matching songs and picks from those.  The list is fetched
+// again after the library changes.
+class RandomSampler : public QObject {
+  Q_OBJECT
+
+ public:
+  RandomSampler(LibraryBackend* backend, QObject* parent = nullptr);
+
+  // Returns the ROWIDs of up to count random songs that match search and
+  // aren't in exclude, in a random order.  A count of -1 returns all of them.
+  // Thread-safe.
+  QList<int> Sample(const Search& search, int count, const QList<int>& exclude);
+
+ private slots:
+  void SongsChanged();
+  void StatisticsChanged();
+
+ private:
+  LibraryBackend* backend_;
+
+  // Set from whichever thread the backend's signals are emitted in.
+  QAtomicInt songs_changed_;
+  QAtomicInt statistics_changed_;
+
+  QMutex mutex_;
+  bool valid_;
+  Search search_;
+  QVector<int> ids_;
+  QSet<int> id_set_;
+  std::mt19937 random_;
+};
+
+}  // namespace
+
+#endif  // SMARTPLAYLISTS_RANDOMSAMPLER_H
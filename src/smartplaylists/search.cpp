@@ -43,10 +43,7 @@ void Search::Reset() {
   first_item_ = 0;
 }
 
-QString Search::ToSql(const QString& songs_table) const {
-  QString sql = "SELECT ROWID," + Song::kColumnSpec + " FROM " + songs_table;
-
-  // Add search terms
+QStringList Search::TermWhereClauses() const {
   QStringList where_clauses;
   QStringList term_where_clauses;
   for (const SearchTerm& term : terms_) {
@@ -57,6 +54,14 @@ QString Search::ToSql(const QString& songs_table) const {
     QString boolean_op = search_type_ == Type_And ? " AND " : " OR ";
     where_clauses << "(" + term_where_clauses.join(boolean_op) + ")";
   }
+  return where_clauses;
+}
+
+QString Search::ToSql(const QString& songs_table) const {
+  QString sql = "SELECT ROWID," + Song::kColumnSpec + " FROM " + songs_table;
+
+  // Add search terms
+  QStringList where_clauses = TermWhereClauses();
 
   // Restrict the IDs of songs if we're making a dynamic playlist
   if (!id_not_in_.isEmpty()) {
@@ -95,6 +100,32 @@ QString Search::ToSql(const QString& songs_table) const {
   return sql;
 }
 
+QString Search::ToIdSql(const QString& songs_table) const {
+  QStringList where_clauses = TermWhereClauses();
+  where_clauses << "unavailable = 0";
+
+  return "SELECT ROWID FROM " + songs_table + " WHERE " +
+         where_clauses.join(" AND ");
+}
+
+bool Search::depends_on_statistics() const {
+  if (search_type_ == Type_All) return false;
+
+  for (const SearchTerm& term : terms_) {
+    switch (term.field_) {
+      case SearchTerm::Field_Rating:
+      case SearchTerm::Field_Score:
+      case SearchTerm::Field_PlayCount:
+      case SearchTerm::Field_SkipCount:
+      case SearchTerm::Field_LastPlayed:
+        return true;
+      default:
+        break;
+    }
+  }
+  return false;
+}
+
 bool Search::is_valid() const {
   if (search_type_ == Type_All) return true;
   return !terms_.isEmpty();
@@ -18,6 +18,8 @@
 #ifndef SMARTPLAYLISTSEARCH_H
 #define SMARTPLAYLISTSEARCH_H
 
+#include <QStringList>
+
 #include "generator.h"
 #include "searchterm.h"
 
@@ -53,6 +55,16 @@ class Search {
 
   void Reset();
   QString ToSql(const QString& songs_table) const;
+  // Selects just the ROWIDs of all the songs matching the search terms,
+  // ignoring the sort order, limit and id_not_in_.
+  QString ToIdSql(const QString& songs_table) const;
+
+  // True if the search terms look at the play statistics or ratings of songs,
+  // which change while songs are played.
+  bool depends_on_statistics() const;
+
+ private:
+  QStringList TermWhereClauses() const;
 };
 
 }  // namespace
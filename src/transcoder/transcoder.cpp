@@ -29,6 +29,7 @@
 #include "core/logging.h"
 #include "core/signalchecker.h"
 #include "core/utilities.h"
+#include "transcoder/transcoderstream.h"
 
 using std::shared_ptr;
 
@@ -288,12 +289,29 @@ void Transcoder::AddJob(const QString& input, const TranscoderPreset& preset,
   else
     job.output = input.section('.', 0, -2) + '.' + preset.extension_;
 
+  QueueJob(job);
+}
+
+void Transcoder::AddStreamJob(const QString& name,
+                              std::shared_ptr<TranscoderStream> stream,
+                              const TranscoderPreset& preset,
+                              const QString& output) {
+  Job job;
+  job.input = name;
+  job.output = output;
+  job.preset = preset;
+  job.stream = stream;
+
+  QueueJob(job);
+}
+
+void Transcoder::QueueJob(Job job) {
   // Never overwrite existing files
   if (QFile::exists(job.output)) {
     for (int i = 0;; ++i) {
       QString new_filename =
           QString("%1.%2.%3").arg(job.output.section('.', 0, -2)).arg(i).arg(
-              preset.extension_);
+              job.preset.extension_);
       if (!QFile::exists(new_filename)) {
         job.output = new_filename;
         break;
@@ -402,9 +420,12 @@ bool Transcoder::StartJob(const Job& job) {
   state->pipeline_ = gst_pipeline_new("pipeline");
   if (!state->pipeline_) return false;
 
-  // Create all the elements
-  GstElement* src = CreateElement("filesrc", state->pipeline_);
-  GstElement* decode = CreateElement("decodebin", state->pipeline_);
+  // Create all the elements.  Stream jobs get raw audio from an appsrc, so
+  // they don't need to decode anything.
+  GstElement* src = CreateElement(job.stream ? "appsrc" : "filesrc",
+                                  state->pipeline_);
+  GstElement* decode =
+      job.stream ? nullptr : CreateElement("decodebin", state->pipeline_);
   GstElement* convert = CreateElement("audioconvert", state->pipeline_);
   GstElement* resample = CreateElement("audioresample", state->pipeline_);
   GstElement* codec = CreateElementForMimeType(
@@ -413,7 +434,7 @@ bool Transcoder::StartJob(const Job& job) {
       "Codec/Muxer", job.preset.muxer_mimetype_, state->pipeline_);
   GstElement* sink = CreateElement("filesink", state->pipeline_);
 
-  if (!src || !decode || !convert || !sink) return false;
+  if (!src || (!decode && !job.stream) || !convert || !sink) return false;
 
   if (!codec && !job.preset.codec_mimetype_.isEmpty()) {
     LogLine(tr("Couldn't find an encoder for %1, check you have the correct "
@@ -428,7 +449,10 @@ bool Transcoder::StartJob(const Job& job) {
   }
 
   // Join them together
-  gst_element_link(src, decode);
+  if (job.stream)
+    gst_element_link(src, convert);
+  else
+    gst_element_link(src, decode);
   if (codec && muxer)
     gst_element_link_many(convert, resample, codec, muxer, sink, nullptr);
   else if (codec)
@@ -437,13 +461,19 @@ bool Transcoder::StartJob(const Job& job) {
     gst_element_link_many(convert, resample, muxer, sink, nullptr);
 
   // Set properties
-  g_object_set(src, "location", job.input.toUtf8().constData(), nullptr);
+  if (!job.stream) {
+    g_object_set(src, "location", job.input.toUtf8().constData(), nullptr);
+  }
   g_object_set(sink, "location", job.output.toUtf8().constData(), nullptr);
 
   // Set callbacks
   state->convert_element_ = convert;
 
-  CHECKED_GCONNECT(decode, "pad-added", &NewPadCallback, state.get());
+  if (job.stream) {
+    job.stream->Attach(src);
+  } else {
+    CHECKED_GCONNECT(decode, "pad-added", &NewPadCallback, state.get());
+  }
   gst_bus_set_sync_handler(gst_pipeline_get_bus(GST_PIPELINE(state->pipeline_)),
                            BusCallbackSync, state.get(), nullptr);
 
@@ -459,6 +489,12 @@ bool Transcoder::StartJob(const Job& job) {
 }
 
 Transcoder::JobState::~JobState() {
+  // Stop the writer before stopping the pipeline, so it doesn't start
+  // waiting on it again.
+  if (job_.stream) {
+    job_.stream->Close();
+  }
+
   if (pipeline_) {
     gst_element_set_state(pipeline_, GST_STATE_NULL);
     gst_object_unref(pipeline_);
@@ -506,7 +542,10 @@ bool Transcoder::event(QEvent* e) {
 }
 
 void Transcoder::Cancel() {
-  // Remove all pending jobs
+  // Remove all pending jobs, and tell anyone writing to them to give up.
+  for (const Job& job : queued_jobs_) {
+    if (job.stream) job.stream->Close();
+  }
   queued_jobs_.clear();
 
   // Stop the running ones
@@ -542,7 +581,12 @@ QMap<QString, float> Transcoder::GetProgress() const {
     gint64 duration = 0;
 
     gst_element_query_position(state->pipeline_, GST_FORMAT_TIME, &position);
-    gst_element_query_duration(state->pipeline_, GST_FORMAT_TIME, &duration);
+    if (state->job_.stream) {
+      duration = state->job_.stream->duration();
+    } else {
+      gst_element_query_duration(state->pipeline_, GST_FORMAT_TIME,
+                                 &duration);
+    }
 
     ret[state->job_.input] = float(position) / duration;
   }
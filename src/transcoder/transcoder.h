@@ -29,6 +29,8 @@
 
 #include "core/song.h"
 
+class TranscoderStream;
+
 struct TranscoderPreset {
   TranscoderPreset() : type_(Song::Type_Unknown) {}
   TranscoderPreset(Song::FileType type, const QString& name,
@@ -59,6 +61,11 @@ class Transcoder : public QObject {
   void AddJob(const QString& input, const TranscoderPreset& preset,
               const QString& output = QString());
   void AddTemporaryJob(const QString& input, const TranscoderPreset& preset);
+  // Adds a job that encodes the raw audio written to stream instead of reading
+  // a file.  name identifies the job in signals and GetProgress().
+  void AddStreamJob(const QString& name,
+                    std::shared_ptr<TranscoderStream> stream,
+                    const TranscoderPreset& preset, const QString& output);
 
   QMap<QString, float> GetProgress() const;
   int QueuedJobsCount() const { return queued_jobs_.count(); }
@@ -81,6 +88,8 @@ signals:
     QString input;
     QString output;
     TranscoderPreset preset;
+    // Set for stream jobs, which read from this instead of the input file.
+    std::shared_ptr<TranscoderStream> stream;
   };
 
   // State held by a job and shared across gstreamer callbacks - lives in the
@@ -120,6 +129,8 @@ signals:
     AllThreadsBusy,
   };
 
+  // Picks an output filename that doesn't exist yet and queues the job.
+  void QueueJob(Job job);
   StartJobStatus MaybeStartNextJob();
   bool StartJob(const Job& job);
 
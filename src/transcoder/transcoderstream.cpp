@@ -0,0 +1,106 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "transcoderstream.h"
+
+#include <gst/app/gstappsrc.h>
+
+#include <QMutexLocker>
+
+const char* TranscoderStream::kCaps =
+    "audio/x-raw, format=(string)S16LE, layout=(string)interleaved, "
+    "rate=(int)44100, channels=(int)2";
+const int TranscoderStream::kBytesPerSecond = 44100 * 2 * 2;
+const int TranscoderStream::kMaxQueuedBytes = kBytesPerSecond * 4;
+
+TranscoderStream::TranscoderStream(qint64 total_bytes)
+    : appsrc_(nullptr),
+      closed_(false),
+      total_bytes_(total_bytes),
+      written_bytes_(0) {}
+
+GstClockTime TranscoderStream::BytesToTime(qint64 bytes) {
+  return gst_util_uint64_scale(bytes, GST_SECOND, kBytesPerSecond);
+}
+
+void TranscoderStream::Attach(GstElement* appsrc) {
+  QMutexLocker l(&mutex_);
+  appsrc_ = appsrc;
+
+  // The writer blocks in push_buffer while this much is queued.
+  GstCaps* caps = gst_caps_from_string(kCaps);
+  g_object_set(appsrc_, "caps", caps, "format", GST_FORMAT_TIME, "block",
+               TRUE, "max-bytes", guint64(kMaxQueuedBytes), nullptr);
+  gst_caps_unref(caps);
+
+  attached_.wakeAll();
+}
+
+void TranscoderStream::Close() {
+  QMutexLocker l(&mutex_);
+  appsrc_ = nullptr;
+  closed_ = true;
+  attached_.wakeAll();
+}
+
+GstElement* TranscoderStream::WaitForAppSrc() {
+  QMutexLocker l(&mutex_);
+  while (!appsrc_ && !closed_) {
+    attached_.wait(&mutex_);
+  }
+  if (closed_) {
+    return nullptr;
+  }
+
+  // Keep our own reference - the pipeline might be stopped while we're
+  // blocked pushing to it, which makes the push fail rather than hang.
+  return GST_ELEMENT(gst_object_ref(appsrc_));
+}
+
+bool TranscoderStream::Write(const char* data, int size) {
+  GstElement* appsrc = WaitForAppSrc();
+  if (!appsrc) {
+    return false;
+  }
+
+  GstBuffer* buffer = gst_buffer_new_allocate(nullptr, size, nullptr);
+  gst_buffer_fill(buffer, 0, data, size);
+
+  const GstClockTime start = BytesToTime(written_bytes_);
+  written_bytes_ += size;
+  GST_BUFFER_PTS(buffer) = start;
+  GST_BUFFER_DURATION(buffer) = BytesToTime(written_bytes_) - start;
+
+  // Takes ownership of the buffer.
+  const GstFlowReturn ret =
+      gst_app_src_push_buffer(GST_APP_SRC(appsrc), buffer);
+  gst_object_unref(appsrc);
+
+  return ret == GST_FLOW_OK;
+}
+
+bool TranscoderStream::Finish() {
+  GstElement* appsrc = WaitForAppSrc();
+  if (!appsrc) {
+    return false;
+  }
+
+  const GstFlowReturn ret = gst_app_src_end_of_stream(GST_APP_SRC(appsrc));
+  gst_object_unref(appsrc);
+
+  return ret == GST_FLOW_OK;
+}
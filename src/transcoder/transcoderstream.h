@@ -0,0 +1,70 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRANSCODERSTREAM_H
+#define TRANSCODERSTREAM_H
+
+#include <gst/gst.h>
+
+#include <QMutex>
+#include <QWaitCondition>
+
+// Raw audio for a Transcoder stream job, written by another thread.  The audio
+// must be 16-bit signed little-endian stereo at 44.1kHz - the format of an
+// audio CD.
+//
+// Write() and Finish() block until the Transcoder has a free thread to start
+// the job, and while the encoder has more than kMaxQueuedBytes waiting, so the
+// writer never gets far ahead of the encoder.  They return false once the job
+// has been cancelled or has failed, and the writer should give up.
+class TranscoderStream {
+ public:
+  // total_bytes is used to report the job's progress.
+  explicit TranscoderStream(qint64 total_bytes);
+
+  static const char* kCaps;
+  static const int kBytesPerSecond;
+  static const int kMaxQueuedBytes;
+
+  qint64 total_bytes() const { return total_bytes_; }
+  GstClockTime duration() const { return BytesToTime(total_bytes_); }
+
+  bool Write(const char* data, int size);
+  bool Finish();
+
+  // Called by the Transcoder when the job's pipeline has been created, and
+  // before it's destroyed.
+  void Attach(GstElement* appsrc);
+  void Close();
+
+ private:
+  static GstClockTime BytesToTime(qint64 bytes);
+
+  // Waits for the stream to be attached, and returns a new reference to the
+  // appsrc or nullptr if the stream was closed.
+  GstElement* WaitForAppSrc();
+
+  QMutex mutex_;
+  QWaitCondition attached_;
+  GstElement* appsrc_;
+  bool closed_;
+
+  const qint64 total_bytes_;
+  qint64 written_bytes_;
+};
+
+#endif  // TRANSCODERSTREAM_H
@@ -202,6 +202,8 @@ void AlbumCoverManager::Init() {
     ui_->splitter->setSizes(QList<int>() << 200 << width() - 200);
   }
 
+  // Don't hold up covers elsewhere while loading the whole library's.
+  cover_loader_options_.priority_ = AlbumCoverLoaderOptions::Priority_Bulk;
   connect(app_->album_cover_loader(), SIGNAL(ImageLoaded(quint64, QImage)),
           SLOT(CoverImageLoaded(quint64, QImage)));
 
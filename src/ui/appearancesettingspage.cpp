@@ -150,6 +150,8 @@ void AppearanceSettingsPage::Load() {
   ui_->moodbar_calculate->setChecked(!s.value("calculate", true).toBool());
   ui_->moodbar_save->setChecked(
       s.value("save_alongside_originals", false).toBool());
+  ui_->moodbar_generate_library->setChecked(
+      s.value("generate_library_moodbars", false).toBool());
   s.endGroup();
 
   InitMoodbarPreviews();
@@ -195,6 +197,8 @@ void AppearanceSettingsPage::Save() {
   s.setValue("show", ui_->moodbar_show->isChecked());
   s.setValue("style", ui_->moodbar_style->currentIndex());
   s.setValue("save_alongside_originals", ui_->moodbar_save->isChecked());
+  s.setValue("generate_library_moodbars",
+             ui_->moodbar_generate_library->isChecked());
   s.endGroup();
 }
 
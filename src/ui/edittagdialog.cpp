@@ -60,6 +60,8 @@ EditTagDialog::EditTagDialog(Application* app, QWidget* parent)
       cover_art_id_(0),
       cover_art_is_set_(false),
       results_dialog_(new TrackSelectionDialog(this)) {
+  // The original image is kept so it can be saved to a file.
+  cover_options_.use_cover_cache_ = false;
   cover_options_.default_output_image_ =
       AlbumCoverLoader::ScaleAndPad(cover_options_, QImage(":nocover.png"));
 
@@ -165,18 +165,11 @@ void ProjectMVisualisation::SetDuration(int seconds) {
   Save();
 }
 
-void ProjectMVisualisation::ConsumeBuffer(GstBuffer* buffer, int) {
-  GstMapInfo map;
-  gst_buffer_map(buffer, &map, GST_MAP_READ);
-  const int samples_per_channel = map.size / sizeof(short) / 2;
-  const short* data = reinterpret_cast<short*>(map.data);
-
+void ProjectMVisualisation::AddPCMData(const short* data,
+                                       int samples_per_channel) {
   if (projectm_) {
     projectm_->pcm()->addPCM16Data(data, samples_per_channel);
   }
-
-  gst_buffer_unmap(buffer, &map);
-  gst_buffer_unref(buffer);
 }
 
 void ProjectMVisualisation::SetSelected(const QStringList& paths,
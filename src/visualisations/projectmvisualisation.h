@@ -24,15 +24,13 @@
 #include <QBasicTimer>
 #include <QSet>
 
-#include "engines/bufferconsumer.h"
-
 class projectM;
 
 class ProjectMPresetModel;
 
 class QTemporaryFile;
 
-class ProjectMVisualisation : public QGraphicsScene, public BufferConsumer {
+class ProjectMVisualisation : public QGraphicsScene {
   Q_OBJECT
  public:
   ProjectMVisualisation(QObject* parent = nullptr);
@@ -46,8 +44,8 @@ class ProjectMVisualisation : public QGraphicsScene, public BufferConsumer {
   Mode mode() const { return mode_; }
   int duration() const { return duration_; }
 
-  // BufferConsumer
-  void ConsumeBuffer(GstBuffer* buffer, int);
+  // Passes interleaved 16-bit stereo samples to projectM.
+  void AddPCMData(const short* data, int samples_per_channel);
 
  public slots:
   void SetTextureSize(int size);
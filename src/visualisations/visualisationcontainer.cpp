@@ -147,8 +147,6 @@ void VisualisationContainer::AddMenuItem(const QString& name, int value,
 
 void VisualisationContainer::SetEngine(GstEngine* engine) {
   engine_ = engine;
-
-  if (isVisible()) engine_->AddBufferConsumer(vis_);
 }
 
 void VisualisationContainer::showEvent(QShowEvent* e) {
@@ -168,14 +166,13 @@ void VisualisationContainer::showEvent(QShowEvent* e) {
   QGraphicsView::showEvent(e);
   update_timer_.start(1000 / fps_, this);
 
-  if (engine_) engine_->AddBufferConsumer(vis_);
+  // Start from whatever is playing now, not from when it was last shown.
+  audio_cursor_ = AudioRingBuffer::Cursor();
 }
 
 void VisualisationContainer::hideEvent(QHideEvent* e) {
   QGraphicsView::hideEvent(e);
   update_timer_.stop();
-
-  if (engine_) engine_->RemoveBufferConsumer(vis_);
 }
 
 void VisualisationContainer::resizeEvent(QResizeEvent* e) {
@@ -198,7 +195,24 @@ void VisualisationContainer::SizeChanged() {
 
 void VisualisationContainer::timerEvent(QTimerEvent* e) {
   QGraphicsView::timerEvent(e);
-  if (e->timerId() == update_timer_.timerId()) scene()->update();
+  if (e->timerId() == update_timer_.timerId()) {
+    ReadAudio();
+    scene()->update();
+  }
+}
+
+void VisualisationContainer::ReadAudio() {
+  if (!engine_) return;
+
+  if (audio_.empty()) {
+    audio_.resize(AudioRingBuffer::kDefaultCapacity);
+  }
+
+  int count = 0;
+  while ((count = engine_->ReadAudio(&audio_cursor_, audio_.data(),
+                                     audio_.size())) > 0) {
+    vis_->AddPCMData(audio_.data(), count / 2);
+  }
 }
 
 void VisualisationContainer::SetActions(QAction* previous, QAction* play_pause,
@@ -22,6 +22,7 @@
 #include <QBasicTimer>
 
 #include "core/song.h"
+#include "engines/audioringbuffer.h"
 
 class GstEngine;
 class ProjectMVisualisation;
@@ -74,6 +75,8 @@ class VisualisationContainer : public QGraphicsView {
   void Init();
 
   void SizeChanged();
+  // Passes the audio played since the last frame to the visualisation.
+  void ReadAudio();
   void AddMenuItem(const QString& name, int value, int def, QActionGroup* group,
                    QSignalMapper* mapper);
 
@@ -92,6 +95,9 @@ class VisualisationContainer : public QGraphicsView {
   VisualisationOverlay* overlay_;
   QBasicTimer update_timer_;
 
+  AudioRingBuffer::Cursor audio_cursor_;
+  std::vector<AudioRingBuffer::sample_type> audio_;
+
   VisualisationSelector* selector_;
 
   QGraphicsProxyWidget* overlay_proxy_;
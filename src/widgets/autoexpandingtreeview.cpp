@@ -55,7 +55,7 @@ bool AutoExpandingTreeView::RecursivelyExpand(const QModelIndex& index,
                                               int* count) {
   if (!CanRecursivelyExpand(index)) return true;
 
-  if (model()->canFetchMore(index)) model()->fetchMore(index);
+  FetchMoreNow(index);
 
   int children = model()->rowCount(index);
   if (*count + children > kRowsToShow) return false;
@@ -53,8 +53,16 @@ signals:
     return true;
   }
 
- private slots:
+  // Fetches the children of the index before returning, so they can be
+  // counted.  Override this if the model's fetchMore() is asynchronous.
+  virtual void FetchMoreNow(const QModelIndex& index) {
+    if (model()->canFetchMore(index)) model()->fetchMore(index);
+  }
+
+ protected slots:
   void ItemExpanded(const QModelIndex& index);
+
+ private slots:
   void ItemClicked(const QModelIndex& index);
   void ItemDoubleClicked(const QModelIndex& index);
 
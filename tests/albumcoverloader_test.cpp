@@ -0,0 +1,129 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <memory>
+
+#include "gtest/gtest.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QImage>
+#include <QSignalSpy>
+#include <QThreadPool>
+
+#include "covers/albumcoverloader.h"
+#include "test_utils.h"
+
+namespace {
+
+class AlbumCoverLoaderTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    filename_ = QDir::temp().absoluteFilePath(
+        QString("clementine_albumcoverloader_test_%1.png")
+            .arg(QCoreApplication::applicationPid()));
+    QImage image(200, 100, QImage::Format_ARGB32);
+    image.fill(0xff00ff00);
+    ASSERT_TRUE(image.save(filename_));
+
+    // Don't touch the real cover cache.
+    options_.use_cover_cache_ = false;
+    options_.desired_height_ = 50;
+
+    loader_.reset(new AlbumCoverLoader);
+  }
+
+  void TearDown() {
+    QThreadPool::globalInstance()->waitForDone();
+    loader_.reset();
+    QFile::remove(filename_);
+  }
+
+  // Runs the event loop until the spy has seen count signals.
+  static void WaitFor(QSignalSpy* spy, int count) {
+    QElapsedTimer timer;
+    timer.start();
+    while (spy->count() < count && timer.elapsed() < 5000) {
+      QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 100);
+    }
+  }
+
+  QString filename_;
+  AlbumCoverLoaderOptions options_;
+  std::unique_ptr<AlbumCoverLoader> loader_;
+};
+
+TEST_F(AlbumCoverLoaderTest, LoadsLocalImage) {
+  QSignalSpy spy(loader_.get(), SIGNAL(ImageLoaded(quint64, QImage)));
+  const quint64 id = loader_->LoadImageAsync(options_, QString(), filename_);
+  WaitFor(&spy, 1);
+
+  ASSERT_EQ(1, spy.count());
+  EXPECT_EQ(id, spy[0][0].value<quint64>());
+  EXPECT_EQ(QSize(50, 50), spy[0][1].value<QImage>().size());
+}
+
+TEST_F(AlbumCoverLoaderTest, DuplicateRequestsAllGetTheImage) {
+  QSignalSpy spy(loader_.get(), SIGNAL(ImageLoaded(quint64, QImage)));
+  QSet<quint64> ids;
+  for (int i = 0; i < 3; ++i) {
+    ids << loader_->LoadImageAsync(options_, QString(), filename_);
+  }
+  WaitFor(&spy, 3);
+
+  ASSERT_EQ(3, spy.count());
+  QSet<quint64> loaded_ids;
+  for (const QList<QVariant>& args : spy) {
+    loaded_ids << args[0].value<quint64>();
+    EXPECT_FALSE(args[1].value<QImage>().isNull());
+  }
+  EXPECT_EQ(ids, loaded_ids);
+}
+
+TEST_F(AlbumCoverLoaderTest, CancelledDuplicateIsNotLoaded) {
+  QSignalSpy spy(loader_.get(), SIGNAL(ImageLoaded(quint64, QImage)));
+  const quint64 first = loader_->LoadImageAsync(options_, QString(), filename_);
+  const quint64 second =
+      loader_->LoadImageAsync(options_, QString(), filename_);
+  loader_->CancelTask(first);
+  WaitFor(&spy, 1);
+
+  // Give a stray signal for the first request a chance to arrive.
+  QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+  QThreadPool::globalInstance()->waitForDone();
+  QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+
+  ASSERT_EQ(1, spy.count());
+  EXPECT_EQ(second, spy[0][0].value<quint64>());
+}
+
+TEST_F(AlbumCoverLoaderTest, CancelledTaskIsNotLoaded) {
+  QSignalSpy spy(loader_.get(), SIGNAL(ImageLoaded(quint64, QImage)));
+  const quint64 id = loader_->LoadImageAsync(options_, QString(), filename_);
+  loader_->CancelTask(id);
+
+  QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+  QThreadPool::globalInstance()->waitForDone();
+  QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+
+  EXPECT_EQ(0, spy.count());
+}
+
+}  // namespace
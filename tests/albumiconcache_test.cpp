@@ -0,0 +1,138 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFuture>
+#include <QImage>
+#include <QList>
+#include <QtConcurrentRun>
+
+#include "core/utilities.h"
+#include "library/albumiconcache.h"
+#include "test_utils.h"
+
+namespace {
+
+class AlbumIconCacheTest : public ::testing::Test {
+ protected:
+  AlbumIconCacheTest()
+      : path_(QDir::temp().absoluteFilePath(
+            QString("clementine_albumiconcache_test_%1")
+                .arg(QCoreApplication::applicationPid()))),
+        cache_(path_ + "/albumicons") {}
+
+  void SetUp() { QDir().mkpath(cache_.path()); }
+
+  void TearDown() { Utilities::RemoveRecursive(path_); }
+
+  static QImage MakeImage(QRgb color) {
+    QImage image(32, 32, QImage::Format_ARGB32_Premultiplied);
+    image.fill(color);
+    return image;
+  }
+
+  QStringList Files() const {
+    return QDir(cache_.path()).entryList(QDir::Files);
+  }
+
+  QString path_;
+  AlbumIconCache cache_;
+};
+
+TEST_F(AlbumIconCacheTest, SaveAndLoad) {
+  EXPECT_TRUE(cache_.Load("libraryart:Artist/Album").isNull());
+
+  const QImage image = MakeImage(0x80ff0000);
+  cache_.Save("libraryart:Artist/Album", image);
+
+  EXPECT_EQ(image, cache_.Load("libraryart:Artist/Album"));
+  EXPECT_TRUE(cache_.Load("libraryart:Artist/Other album").isNull());
+  EXPECT_EQ(1, Files().count());
+}
+
+TEST_F(AlbumIconCacheTest, IgnoresBrokenFiles) {
+  QFile file(cache_.Filename("key"));
+  file.open(QIODevice::WriteOnly);
+  file.write("not an icon");
+  file.close();
+
+  EXPECT_TRUE(cache_.Load("key").isNull());
+}
+
+TEST_F(AlbumIconCacheTest, ConcurrentSavesOfTheSameAlbum) {
+  QList<QRgb> colors;
+  QList<QFuture<void>> futures;
+  for (int i = 0; i < 16; ++i) {
+    colors << qRgba(i * 16, 0, 0, 255);
+    futures << QtConcurrent::run(cache_, &AlbumIconCache::Save, QString("key"),
+                                 MakeImage(colors.last()));
+  }
+  for (QFuture<void>& future : futures) {
+    future.waitForFinished();
+  }
+
+  // One of the saves won, and nothing else was left behind.
+  const QImage image = cache_.Load("key");
+  ASSERT_FALSE(image.isNull());
+  EXPECT_TRUE(colors.contains(image.pixel(0, 0)));
+  EXPECT_EQ(QStringList() << QFileInfo(cache_.Filename("key")).fileName(),
+            Files());
+}
+
+TEST_F(AlbumIconCacheTest, PrepareTrimsTheCache) {
+  for (int i = 0; i < 10; ++i) {
+    cache_.Save(QString("key %1").arg(i), MakeImage(0xffffffff));
+  }
+  const qint64 file_size = QFileInfo(cache_.Filename("key 0")).size();
+
+  cache_.Prepare(QString(), file_size * 4);
+  EXPECT_EQ(4, Files().count());
+
+  cache_.Prepare(QString(), 0);
+  EXPECT_TRUE(Files().isEmpty());
+}
+
+TEST_F(AlbumIconCacheTest, PrepareKeepsTemporaryFiles) {
+  QFile file(cache_.Filename("key") + ".tmp.abcdef");
+  file.open(QIODevice::WriteOnly);
+  file.write("half an icon");
+  file.close();
+
+  // It might still be being written.
+  cache_.Prepare(QString(), 0);
+  EXPECT_TRUE(file.exists());
+}
+
+TEST_F(AlbumIconCacheTest, PrepareRemovesTheOldCache) {
+  const QString old_path = path_ + "/pixmapcache";
+  QDir().mkpath(old_path + "/data7/a");
+  QFile file(old_path + "/data7/a/entry.d");
+  file.open(QIODevice::WriteOnly);
+  file.write("old");
+  file.close();
+
+  cache_.Prepare(old_path, 1000);
+  EXPECT_FALSE(QFile::exists(old_path));
+  EXPECT_TRUE(QFile::exists(cache_.path()));
+}
+
+}  // namespace
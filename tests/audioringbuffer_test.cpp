@@ -0,0 +1,136 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <vector>
+
+#include "engines/audioringbuffer.h"
+
+namespace {
+
+typedef AudioRingBuffer::sample_type sample_type;
+
+std::vector<sample_type> Samples(int first, int count) {
+  std::vector<sample_type> ret;
+  for (int i = 0; i < count; ++i) {
+    ret.push_back(first + i);
+  }
+  return ret;
+}
+
+TEST(AudioRingBufferTest, CapacityIsPowerOfTwo) {
+  AudioRingBuffer buffer(1000);
+  EXPECT_EQ(1024, buffer.capacity());
+}
+
+TEST(AudioRingBufferTest, NewCursorStartsAtNewestSample) {
+  AudioRingBuffer buffer(16);
+  buffer.Write(Samples(0, 4).data(), 4);
+
+  AudioRingBuffer::Cursor cursor;
+  sample_type dest[16];
+  EXPECT_EQ(0, buffer.Read(&cursor, dest, 16));
+
+  buffer.Write(Samples(4, 3).data(), 3);
+  ASSERT_EQ(3, buffer.Read(&cursor, dest, 16));
+  EXPECT_EQ(4, dest[0]);
+  EXPECT_EQ(6, dest[2]);
+  EXPECT_EQ(0, buffer.Read(&cursor, dest, 16));
+}
+
+TEST(AudioRingBufferTest, ReadersAreIndependent) {
+  AudioRingBuffer buffer(16);
+  AudioRingBuffer::Cursor fast;
+  AudioRingBuffer::Cursor slow;
+  sample_type dest[16];
+  buffer.Read(&fast, dest, 16);
+  buffer.Read(&slow, dest, 16);
+
+  buffer.Write(Samples(0, 8).data(), 8);
+  EXPECT_EQ(8, buffer.Read(&fast, dest, 16));
+
+  buffer.Write(Samples(8, 4).data(), 4);
+  EXPECT_EQ(4, buffer.Read(&fast, dest, 16));
+  EXPECT_EQ(8, dest[0]);
+
+  ASSERT_EQ(5, buffer.Read(&slow, dest, 5));
+  EXPECT_EQ(0, dest[0]);
+  ASSERT_EQ(7, buffer.Read(&slow, dest, 16));
+  EXPECT_EQ(5, dest[0]);
+  EXPECT_EQ(11, dest[6]);
+}
+
+TEST(AudioRingBufferTest, WrapsAround) {
+  AudioRingBuffer buffer(16);
+  AudioRingBuffer::Cursor cursor;
+  sample_type dest[16];
+  buffer.Read(&cursor, dest, 16);
+
+  for (int i = 0; i < 10; ++i) {
+    buffer.Write(Samples(i * 6, 6).data(), 6);
+    ASSERT_EQ(6, buffer.Read(&cursor, dest, 16));
+    for (int j = 0; j < 6; ++j) {
+      EXPECT_EQ(i * 6 + j, dest[j]);
+    }
+  }
+}
+
+TEST(AudioRingBufferTest, SlowReaderSkipsAhead) {
+  AudioRingBuffer buffer(16);
+  AudioRingBuffer::Cursor cursor;
+  sample_type dest[16];
+  buffer.Read(&cursor, dest, 16);
+
+  buffer.Write(Samples(0, 40).data(), 40);
+  ASSERT_EQ(16, buffer.Read(&cursor, dest, 16));
+  EXPECT_EQ(24, dest[0]);
+  EXPECT_EQ(39, dest[15]);
+  EXPECT_EQ(40u, cursor.position);
+}
+
+TEST(AudioRingBufferTest, CursorFromAnotherBufferIsReset) {
+  AudioRingBuffer first(16);
+  AudioRingBuffer second(16);
+  AudioRingBuffer::Cursor cursor;
+  sample_type dest[16];
+  first.Read(&cursor, dest, 16);
+  first.Write(Samples(0, 4).data(), 4);
+  second.Write(Samples(100, 4).data(), 4);
+
+  EXPECT_EQ(0, second.Read(&cursor, dest, 16));
+  second.Write(Samples(104, 2).data(), 2);
+  ASSERT_EQ(2, second.Read(&cursor, dest, 16));
+  EXPECT_EQ(104, dest[0]);
+}
+
+TEST(AudioRingBufferTest, ReadLatest) {
+  AudioRingBuffer buffer(16);
+  sample_type dest[16];
+  EXPECT_EQ(0, buffer.ReadLatest(dest, 4));
+
+  buffer.Write(Samples(0, 2).data(), 2);
+  ASSERT_EQ(2, buffer.ReadLatest(dest, 4));
+  EXPECT_EQ(0, dest[0]);
+
+  buffer.Write(Samples(2, 30).data(), 30);
+  ASSERT_EQ(4, buffer.ReadLatest(dest, 4));
+  EXPECT_EQ(28, dest[0]);
+  EXPECT_EQ(31, dest[3]);
+}
+
+}  // namespace
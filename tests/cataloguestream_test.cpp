@@ -0,0 +1,194 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <QBuffer>
+#include <QEventLoop>
+#include <QFutureWatcher>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryFile>
+#include <QtConcurrentRun>
+
+#include "qtiocompressor.h"
+#include "internet/core/cataloguestream.h"
+
+namespace {
+
+QByteArray MakeCatalogue() {
+  QByteArray ret = "<catalogue>\n";
+  for (int i = 0; i < 100000; ++i) {
+    ret += QString("  <track><id>%1</id></track>\n").arg(i).toUtf8();
+  }
+  ret += "</catalogue>\n";
+  return ret;
+}
+
+QByteArray Compress(const QByteArray& data) {
+  QBuffer buffer;
+  buffer.open(QIODevice::WriteOnly);
+
+  QtIOCompressor gzip(&buffer);
+  gzip.setStreamFormat(QtIOCompressor::GzipFormat);
+  gzip.open(QIODevice::WriteOnly);
+  gzip.write(data);
+  gzip.close();
+
+  return buffer.data();
+}
+
+QByteArray ReadAll(QIODevice* device) {
+  QByteArray ret;
+  char data[4096];
+  qint64 bytes = 0;
+  while ((bytes = device->read(data, sizeof(data))) > 0) {
+    ret.append(data, bytes);
+  }
+  return ret;
+}
+
+// Reads the device chunk_size bytes at a time.
+QByteArray ReadInChunks(QIODevice* device, int chunk_size) {
+  QByteArray ret;
+  QByteArray data(chunk_size, '\0');
+  qint64 bytes = 0;
+  while ((bytes = device->read(data.data(), chunk_size)) > 0) {
+    ret.append(data.constData(), bytes);
+  }
+  return ret;
+}
+
+// Reads the device on a worker thread, like the services do, while running
+// an event loop on this one so the CatalogueStream can read its source.
+QByteArray ReadAllOnWorker(QIODevice* device) {
+  QFutureWatcher<QByteArray> watcher;
+  QEventLoop loop;
+  QObject::connect(&watcher, SIGNAL(finished()), &loop, SLOT(quit()));
+  watcher.setFuture(QtConcurrent::run(&ReadAll, device));
+  loop.exec();
+  return watcher.result();
+}
+
+class CatalogueStreamTest : public ::testing::Test {
+ protected:
+  CatalogueStreamTest()
+      : catalogue_(MakeCatalogue()), compressed_(Compress(catalogue_)) {}
+
+  QByteArray catalogue_;
+  QByteArray compressed_;
+};
+
+TEST_F(CatalogueStreamTest, ReadsFile) {
+  QTemporaryFile file;
+  ASSERT_TRUE(file.open());
+  file.write(compressed_);
+  file.seek(0);
+
+  // A small buffer so the file has to be read many times.
+  CatalogueStream stream(&file, nullptr, 1024);
+  EXPECT_EQ(compressed_.size(), stream.total_bytes());
+
+  QtIOCompressor gzip(&stream);
+  gzip.setStreamFormat(QtIOCompressor::GzipFormat);
+  ASSERT_TRUE(gzip.open(QIODevice::ReadOnly));
+
+  EXPECT_EQ(catalogue_, ReadAllOnWorker(&gzip));
+  EXPECT_EQ(compressed_.size(), stream.bytes_read());
+  EXPECT_EQ(100, stream.progress());
+  EXPECT_FALSE(stream.has_error());
+}
+
+TEST_F(CatalogueStreamTest, ReadsAcrossEndOfBuffer) {
+  QTemporaryFile file;
+  ASSERT_TRUE(file.open());
+  file.write(catalogue_);
+  file.seek(0);
+
+  // Reads that don't divide the buffer size evenly, so the data wraps round
+  // the end of the buffer.
+  CatalogueStream stream(&file, nullptr, 1000);
+
+  QFutureWatcher<QByteArray> watcher;
+  QEventLoop loop;
+  QObject::connect(&watcher, SIGNAL(finished()), &loop, SLOT(quit()));
+  watcher.setFuture(QtConcurrent::run(&ReadInChunks, &stream, 333));
+  loop.exec();
+
+  EXPECT_EQ(catalogue_, watcher.result());
+  EXPECT_EQ(catalogue_.size(), stream.bytes_read());
+}
+
+TEST_F(CatalogueStreamTest, ReadsSocket) {
+  // A local stand-in for the server the catalogue is downloaded from.
+  QTcpServer server;
+  ASSERT_TRUE(server.listen(QHostAddress::LocalHost));
+
+  QTcpSocket socket;
+  socket.connectToHost(QHostAddress::LocalHost, server.serverPort());
+  ASSERT_TRUE(server.waitForNewConnection(5000));
+  ASSERT_TRUE(socket.waitForConnected(5000));
+
+  QTcpSocket* server_socket = server.nextPendingConnection();
+  server_socket->write(compressed_);
+  server_socket->disconnectFromHost();
+
+  CatalogueStream stream(&socket, nullptr, 1024);
+  EXPECT_EQ(-1, stream.total_bytes());
+
+  QtIOCompressor gzip(&stream);
+  gzip.setStreamFormat(QtIOCompressor::GzipFormat);
+  ASSERT_TRUE(gzip.open(QIODevice::ReadOnly));
+
+  EXPECT_EQ(catalogue_, ReadAllOnWorker(&gzip));
+  EXPECT_EQ(compressed_.size(), stream.bytes_read());
+  EXPECT_EQ(-1, stream.progress());
+}
+
+TEST_F(CatalogueStreamTest, EmptySource) {
+  QBuffer buffer;
+  buffer.open(QIODevice::ReadOnly);
+
+  CatalogueStream stream(&buffer);
+  EXPECT_TRUE(ReadAllOnWorker(&stream).isEmpty());
+  EXPECT_EQ(0, stream.bytes_read());
+}
+
+TEST_F(CatalogueStreamTest, Abort) {
+  // A source that never sends anything.
+  QTcpServer server;
+  ASSERT_TRUE(server.listen(QHostAddress::LocalHost));
+
+  QTcpSocket socket;
+  socket.connectToHost(QHostAddress::LocalHost, server.serverPort());
+  ASSERT_TRUE(server.waitForNewConnection(5000));
+
+  CatalogueStream stream(&socket);
+
+  QFutureWatcher<QByteArray> watcher;
+  QEventLoop loop;
+  QObject::connect(&watcher, SIGNAL(finished()), &loop, SLOT(quit()));
+  watcher.setFuture(QtConcurrent::run(&ReadAll, &stream));
+
+  // The worker is waiting for data until the stream is aborted.
+  stream.Abort();
+  loop.exec();
+
+  EXPECT_TRUE(watcher.result().isEmpty());
+}
+
+}  // namespace
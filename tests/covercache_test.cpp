@@ -0,0 +1,136 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <memory>
+
+#include "gtest/gtest.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QThreadPool>
+
+#include "covers/covercache.h"
+#include "test_utils.h"
+
+namespace {
+
+class CoverCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    path_ = QDir::temp().absoluteFilePath(
+        QString("clementine_covercache_test_%1")
+            .arg(QCoreApplication::applicationPid()));
+    cache_.reset(new CoverCache(path_));
+  }
+
+  void TearDown() {
+    QThreadPool::globalInstance()->waitForDone();
+    cache_.reset();
+
+    QDir dir(path_);
+    for (const QString& filename : dir.entryList(QDir::Files)) {
+      dir.remove(filename);
+    }
+    QDir().rmdir(path_);
+  }
+
+  // Has an alpha channel so it's saved losslessly.
+  static QImage MakeImage(int width, int height) {
+    QImage image(width, height, QImage::Format_ARGB32);
+    image.fill(0x80ff0000);
+    return image;
+  }
+
+  QString path_;
+  std::unique_ptr<CoverCache> cache_;
+};
+
+TEST_F(CoverCacheTest, VariantSize) {
+  EXPECT_EQ(32, CoverCache::VariantSize(1));
+  EXPECT_EQ(32, CoverCache::VariantSize(32));
+  EXPECT_EQ(64, CoverCache::VariantSize(33));
+  EXPECT_EQ(128, CoverCache::VariantSize(120));
+  EXPECT_EQ(500, CoverCache::VariantSize(200));
+  EXPECT_EQ(500, CoverCache::VariantSize(500));
+  EXPECT_EQ(-1, CoverCache::VariantSize(501));
+}
+
+TEST_F(CoverCacheTest, SavesScaledVariants) {
+  EXPECT_TRUE(cache_->Load("key", 100).isNull());
+
+  cache_->SaveAsync("key", MakeImage(1000, 800));
+  QThreadPool::globalInstance()->waitForDone();
+
+  QImage image = cache_->Load("key", 100);
+  EXPECT_EQ(QSize(128, 102), image.size());
+
+  image = cache_->Load("key", 32);
+  EXPECT_EQ(QSize(32, 25), image.size());
+
+  EXPECT_TRUE(cache_->Load("key", 1000).isNull());
+}
+
+TEST_F(CoverCacheTest, DoesntScaleUp) {
+  cache_->SaveAsync("key", MakeImage(50, 50));
+  QThreadPool::globalInstance()->waitForDone();
+
+  EXPECT_EQ(QSize(50, 50), cache_->Load("key", 500).size());
+}
+
+TEST_F(CoverCacheTest, ConcurrentSavesOfTheSameCover) {
+  for (int i = 0; i < 8; ++i) {
+    cache_->SaveAsync("key", MakeImage(600, 600));
+  }
+  QThreadPool::globalInstance()->waitForDone();
+
+  EXPECT_EQ(QSize(128, 128), cache_->Load("key", 100).size());
+
+  // Only the variants are left.
+  EXPECT_EQ(CoverCache::kVariantCount,
+            QDir(path_).entryList(QDir::Files).count());
+}
+
+TEST_F(CoverCacheTest, TrimKeepsTemporaryFiles) {
+  QFile file(path_ + "/key-32.tmp.abcdef");
+  ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+  file.write("half a cover");
+  file.close();
+
+  // A new cache trims the directory - a save might still be writing this.
+  cache_.reset(new CoverCache(path_));
+  QThreadPool::globalInstance()->waitForDone();
+
+  EXPECT_TRUE(file.exists());
+}
+
+TEST_F(CoverCacheTest, KeyChangesWithFile) {
+  EXPECT_TRUE(CoverCache::KeyForFile(path_ + "/missing.png", false).isEmpty());
+
+  const QString filename = path_ + "/cover.png";
+  ASSERT_TRUE(MakeImage(10, 10).save(filename));
+  const QString key = CoverCache::KeyForFile(filename, false);
+  EXPECT_FALSE(key.isEmpty());
+  EXPECT_EQ(key, CoverCache::KeyForFile(filename, false));
+  EXPECT_NE(key, CoverCache::KeyForFile(filename, true));
+
+  ASSERT_TRUE(MakeImage(20, 20).save(filename));
+  EXPECT_NE(key, CoverCache::KeyForFile(filename, false));
+}
+
+}  // namespace
@@ -0,0 +1,127 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <memory>
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QTimer>
+#include <QtConcurrentRun>
+
+#include "core/database.h"
+
+namespace {
+
+void AddDirectory(QSqlDatabase db, const QString& path) {
+  QSqlQuery q("INSERT INTO directories (path, subdirs) VALUES (:path, 0)", db);
+  q.bindValue(":path", path);
+  q.exec();
+}
+
+// Reads the directory paths the way the backends read songs.
+QStringList ReadDirectories(Database* database) {
+  QMutexLocker l(database->ReadMutex());
+  QSqlDatabase db(database->ConnectReadOnly());
+
+  QSqlQuery q("SELECT path FROM directories ORDER BY path", db);
+  q.exec();
+
+  QStringList ret;
+  while (q.next()) {
+    ret << q.value(0).toString();
+  }
+  return ret;
+}
+
+class DatabaseWalTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    filename_ = QDir::temp().absoluteFilePath(
+        QString("clementine_databasewal_test_%1.db")
+            .arg(QCoreApplication::applicationPid()));
+    RemoveFiles();
+    database_.reset(new Database(nullptr, nullptr, filename_));
+  }
+
+  void TearDown() {
+    database_.reset();
+    RemoveFiles();
+  }
+
+  void RemoveFiles() {
+    QFile::remove(filename_);
+    QFile::remove(filename_ + "-wal");
+    QFile::remove(filename_ + "-shm");
+  }
+
+  QString filename_;
+  std::unique_ptr<Database> database_;
+};
+
+TEST_F(DatabaseWalTest, FileDatabaseIsInWalMode) {
+  EXPECT_TRUE(database_->is_wal_enabled());
+  EXPECT_TRUE(database_->ReadMutex() == nullptr);
+}
+
+TEST_F(DatabaseWalTest, MemoryDatabaseIsNotInWalMode) {
+  MemoryDatabase memory(nullptr);
+  EXPECT_FALSE(memory.is_wal_enabled());
+  EXPECT_EQ(memory.Mutex(), memory.ReadMutex());
+}
+
+TEST_F(DatabaseWalTest, ReadWhileWriting) {
+  ASSERT_TRUE(database_->is_wal_enabled());
+
+  QMutexLocker l(database_->Mutex());
+  QSqlDatabase db(database_->Connect());
+  AddDirectory(db, "/committed");
+
+  ASSERT_TRUE(db.transaction());
+  AddDirectory(db, "/uncommitted");
+
+  // A reader on another thread must neither wait for the writer's mutex nor
+  // for its transaction.  Give up after a few seconds rather than hang.
+  QFutureWatcher<QStringList> watcher;
+  QEventLoop loop;
+  QObject::connect(&watcher, SIGNAL(finished()), &loop, SLOT(quit()));
+  QTimer::singleShot(5000, &loop, SLOT(quit()));
+  watcher.setFuture(QtConcurrent::run(&ReadDirectories, database_.get()));
+  loop.exec();
+
+  const bool finished_during_write = watcher.isFinished();
+  ASSERT_TRUE(db.commit());
+  l.unlock();
+  watcher.waitForFinished();
+
+  ASSERT_TRUE(finished_during_write);
+  EXPECT_EQ(QStringList() << "/committed", watcher.result());
+
+  // Once the transaction is committed readers see the new row.
+  EXPECT_EQ(QStringList() << "/committed"
+                          << "/uncommitted",
+            QtConcurrent::run(&ReadDirectories, database_.get()).result());
+}
+
+}  // namespace
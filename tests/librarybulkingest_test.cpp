@@ -0,0 +1,176 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <memory>
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include <QElapsedTimer>
+#include <QSignalSpy>
+#include <QtDebug>
+
+#include "core/database.h"
+#include "core/song.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+#include "library/libraryquery.h"
+
+namespace {
+
+class LibraryBulkIngestTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    database_.reset(new MemoryDatabase(nullptr));
+    backend_.reset(new LibraryBackend);
+    backend_->Init(database_.get(), Library::kSongsTable, Library::kDirsTable,
+                   Library::kSubdirsTable, Library::kFtsTable);
+    backend_->AddDirectory("/music");
+  }
+
+  static SongList MakeSongs(int count, int directory_id = 1) {
+    SongList ret;
+    for (int i = 0; i < count; ++i) {
+      Song song;
+      song.Init(QString("Title %1").arg(i), QString("Artist %1").arg(i % 100),
+                QString("Album %1").arg(i % 1000), 1000);
+      song.set_directory_id(directory_id);
+      song.set_url(QUrl::fromLocalFile(QString("/music/%1.mp3").arg(i)));
+      song.set_mtime(1);
+      song.set_ctime(1);
+      song.set_filesize(1);
+      ret << song;
+    }
+    return ret;
+  }
+
+  SongList Search(const QString& filter) {
+    QueryOptions options;
+    options.set_filter(filter);
+    LibraryQuery query(options);
+    return backend_->ExecLibraryQuery(&query);
+  }
+
+  std::unique_ptr<Database> database_;
+  std::unique_ptr<LibraryBackend> backend_;
+};
+
+TEST_F(LibraryBulkIngestTest, AddsSongsWithIds) {
+  // More songs than fit in one INSERT.
+  const SongList songs = MakeSongs(100);
+
+  QSignalSpy added_spy(backend_.get(), SIGNAL(SongsDiscovered(SongList)));
+  backend_->AddOrUpdateSongs(songs);
+
+  ASSERT_EQ(1, added_spy.count());
+  SongList added = added_spy[0][0].value<SongList>();
+  ASSERT_EQ(100, added.count());
+
+  for (const Song& song : added) {
+    Song in_db = backend_->GetSongById(song.id());
+    ASSERT_TRUE(in_db.is_valid());
+    EXPECT_EQ(song.title(), in_db.title());
+    EXPECT_EQ(song.url(), in_db.url());
+  }
+
+  // The songs are in the FTS index straight away.
+  EXPECT_EQ(1, Search("Title 42").count());
+}
+
+TEST_F(LibraryBulkIngestTest, SkipsSongsInMissingDirectories) {
+  SongList songs = MakeSongs(2);
+  songs[1].set_directory_id(2);
+
+  backend_->AddOrUpdateSongs(songs);
+
+  EXPECT_EQ(1, backend_->GetAllSongs().count());
+}
+
+TEST_F(LibraryBulkIngestTest, BulkIngest) {
+  QSignalSpy added_spy(backend_.get(), SIGNAL(SongsDiscovered(SongList)));
+  QSignalSpy reset_spy(backend_.get(), SIGNAL(DatabaseReset()));
+
+  backend_->BeginBulkIngest();
+  backend_->AddOrUpdateSongs(MakeSongs(50));
+  backend_->AddOrUpdateSongs(MakeSongs(50));
+
+  // Nothing is announced or indexed until the end.
+  EXPECT_EQ(0, added_spy.count());
+  EXPECT_EQ(0, reset_spy.count());
+  EXPECT_EQ(0, Search("Title").count());
+
+  backend_->EndBulkIngest();
+
+  EXPECT_EQ(0, added_spy.count());
+  EXPECT_EQ(1, reset_spy.count());
+  EXPECT_EQ(100, backend_->GetAllSongs().count());
+  EXPECT_EQ(2, Search("Title 42").count());
+}
+
+TEST_F(LibraryBulkIngestTest, UpdateDuringBulkIngest) {
+  backend_->BeginBulkIngest();
+  backend_->AddOrUpdateSongs(MakeSongs(1));
+
+  Song song = backend_->GetSongById(1);
+  song.set_title("New title");
+  backend_->AddOrUpdateSongs(SongList() << song);
+
+  backend_->EndBulkIngest();
+
+  EXPECT_EQ(1, Search("title:new").count());
+  EXPECT_EQ(0, Search("title:0").count());
+}
+
+TEST_F(LibraryBulkIngestTest, AbortBulkIngest) {
+  backend_->AddOrUpdateSongs(MakeSongs(10));
+
+  QSignalSpy reset_spy(backend_.get(), SIGNAL(DatabaseReset()));
+
+  backend_->BeginBulkIngest();
+  backend_->AddOrUpdateSongs(MakeSongs(20));
+  backend_->AbortBulkIngest();
+
+  // Only the songs from before are left, and they're still indexed.
+  EXPECT_EQ(1, reset_spy.count());
+  EXPECT_EQ(10, backend_->GetAllSongs().count());
+  EXPECT_EQ(1, Search("Title 5").count());
+  EXPECT_EQ(0, Search("Title 15").count());
+}
+
+// Takes a while, so it only runs with --gtest_also_run_disabled_tests.
+TEST_F(LibraryBulkIngestTest, DISABLED_Benchmark) {
+  const int kSongCount = 100000;
+  const int kBatchSize = 10000;
+  const SongList songs = MakeSongs(kSongCount);
+
+  QElapsedTimer timer;
+  timer.start();
+
+  backend_->BeginBulkIngest();
+  for (int i = 0; i < kSongCount; i += kBatchSize) {
+    backend_->AddOrUpdateSongs(songs.mid(i, kBatchSize));
+  }
+  backend_->EndBulkIngest();
+
+  const qint64 elapsed = qMax(qint64(1), timer.elapsed());
+  qDebug() << "Bulk ingested" << kSongCount << "songs in" << elapsed << "ms,"
+           << kSongCount * 1000 / elapsed << "rows per second";
+
+  EXPECT_EQ(kSongCount, backend_->GetAllSongs().count());
+}
+
+}  // namespace
@@ -0,0 +1,245 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include <memory>
+
+#include <QFile>
+#include <QMap>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QVariant>
+
+#include "core/database.h"
+#include "core/song.h"
+#include "core/utilities.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+#include "networkremote/outgoingdatacreator.h"
+
+namespace {
+
+class LibraryChangesTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    database_.reset(new MemoryDatabase(nullptr));
+    backend_.reset(new LibraryBackend);
+    backend_->Init(database_.get(), Library::kSongsTable, Library::kDirsTable,
+                   Library::kSubdirsTable, Library::kFtsTable);
+    backend_->AddDirectory("/mnt/music");
+  }
+
+  Song MakeSong(const QString& title) {
+    Song song;
+    song.Init(title, "Artist", "Album", 100);
+    song.set_url(QUrl::fromLocalFile("/mnt/music/" + title + ".mp3"));
+    song.set_directory_id(1);
+    song.set_mtime(1);
+    song.set_ctime(1);
+    song.set_filesize(1);
+    return song;
+  }
+
+  // Returns the revision of each song in library_changes keyed by song id.
+  QMap<int, qint64> Changes() {
+    QMap<int, qint64> ret;
+    QSqlDatabase db(database_->Connect());
+    QSqlQuery q("SELECT song_id, revision FROM library_changes", db);
+    while (q.next()) {
+      ret[q.value(0).toInt()] = q.value(1).toLongLong();
+    }
+    return ret;
+  }
+
+  std::unique_ptr<Database> database_;
+  std::unique_ptr<LibraryBackend> backend_;
+};
+
+class LibraryExportTest : public LibraryChangesTest {
+ protected:
+  virtual void SetUp() {
+    LibraryChangesTest::SetUp();
+    filename_ = Utilities::GetTemporaryFileName();
+  }
+
+  virtual void TearDown() { QFile::remove(filename_); }
+
+  QString DatabaseId() {
+    QSqlQuery q("SELECT id FROM library_changes_database",
+                database_->Connect());
+    q.next();
+    return q.value(0).toString();
+  }
+
+  qint64 Export(const QString& since_database_id, qint64 since_revision,
+                bool* delta) {
+    return OutgoingDataCreator::ExportLibraryChanges(
+        database_.get(), filename_, since_database_id, since_revision,
+        &database_id_, delta);
+  }
+
+  qint64 CurrentRevision() {
+    QSqlQuery q("SELECT MAX(revision) FROM library_changes",
+                database_->Connect());
+    q.next();
+    return q.value(0).toLongLong();
+  }
+
+  // Returns the song ids in a table of the exported file.
+  QList<int> ExportedIds(const QString& table) {
+    QList<int> ret;
+    {
+      QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "export");
+      db.setDatabaseName(filename_);
+      EXPECT_TRUE(db.open());
+
+      QSqlQuery q(
+          QString("SELECT song_id FROM %1 ORDER BY song_id").arg(table), db);
+      EXPECT_TRUE(q.exec());
+      while (q.next()) {
+        ret << q.value(0).toInt();
+      }
+    }
+    QSqlDatabase::removeDatabase("export");
+    return ret;
+  }
+
+  QString filename_;
+  QString database_id_;
+};
+
+TEST_F(LibraryChangesTest, AddedSongsAreLogged) {
+  backend_->AddOrUpdateSongs(SongList() << MakeSong("one") << MakeSong("two"));
+
+  QMap<int, qint64> changes = Changes();
+  ASSERT_EQ(2, changes.count());
+  EXPECT_LT(changes[1], changes[2]);
+}
+
+TEST_F(LibraryChangesTest, ChangedSongsMoveToTheEnd) {
+  backend_->AddOrUpdateSongs(SongList() << MakeSong("one") << MakeSong("two"));
+  const qint64 first_revision = Changes()[2];
+
+  Song song = backend_->GetSongById(1);
+  song.set_title("new title");
+  backend_->AddOrUpdateSongs(SongList() << song);
+
+  QMap<int, qint64> changes = Changes();
+  ASSERT_EQ(2, changes.count());
+  EXPECT_GT(changes[1], first_revision);
+}
+
+TEST_F(LibraryChangesTest, DeletedSongsStayLogged) {
+  backend_->AddOrUpdateSongs(SongList() << MakeSong("one") << MakeSong("two"));
+  const qint64 revision_before = Changes()[2];
+
+  backend_->DeleteSongs(SongList() << backend_->GetSongById(1));
+
+  QMap<int, qint64> changes = Changes();
+  ASSERT_EQ(2, changes.count());
+  EXPECT_GT(changes[1], revision_before);
+  EXPECT_FALSE(backend_->GetSongById(1).is_valid());
+}
+
+TEST_F(LibraryExportTest, ExportsChangesSinceRevision) {
+  backend_->AddOrUpdateSongs(SongList() << MakeSong("one") << MakeSong("two")
+                                        << MakeSong("three")
+                                        << MakeSong("four"));
+  const qint64 since_revision = CurrentRevision();
+
+  Song changed = backend_->GetSongById(1);
+  changed.set_title("new title");
+  backend_->AddOrUpdateSongs(SongList() << changed);
+  backend_->DeleteSongs(SongList() << backend_->GetSongById(2));
+  backend_->MarkSongsUnavailable(SongList() << backend_->GetSongById(3));
+
+  bool delta = false;
+  EXPECT_EQ(CurrentRevision(), Export(DatabaseId(), since_revision, &delta));
+  EXPECT_TRUE(delta);
+  EXPECT_EQ(DatabaseId(), database_id_);
+
+  // Song four hasn't changed, and songs that are no longer available look
+  // deleted to the client.
+  EXPECT_EQ(QList<int>() << 1, ExportedIds("songs"));
+  EXPECT_EQ(QList<int>() << 2 << 3, ExportedIds("deleted_songs"));
+}
+
+TEST_F(LibraryExportTest, NothingChanged) {
+  backend_->AddOrUpdateSongs(SongList() << MakeSong("one") << MakeSong("two"));
+
+  bool delta = false;
+  EXPECT_EQ(CurrentRevision(),
+            Export(DatabaseId(), CurrentRevision(), &delta));
+  EXPECT_TRUE(delta);
+  EXPECT_TRUE(ExportedIds("songs").isEmpty());
+  EXPECT_TRUE(ExportedIds("deleted_songs").isEmpty());
+}
+
+TEST_F(LibraryExportTest, ExportsEverythingWithoutARevision) {
+  backend_->AddOrUpdateSongs(SongList() << MakeSong("one") << MakeSong("two")
+                                        << MakeSong("three"));
+  backend_->DeleteSongs(SongList() << backend_->GetSongById(2));
+
+  bool delta = true;
+  EXPECT_EQ(CurrentRevision(), Export(DatabaseId(), 0, &delta));
+  EXPECT_FALSE(delta);
+  EXPECT_EQ(QList<int>() << 1 << 3, ExportedIds("songs"));
+  EXPECT_TRUE(ExportedIds("deleted_songs").isEmpty());
+}
+
+TEST_F(LibraryExportTest, ExportsEverythingForANewerRevision) {
+  backend_->AddOrUpdateSongs(SongList() << MakeSong("one") << MakeSong("two"));
+
+  // The client last synced with a different database.
+  bool delta = true;
+  Export(DatabaseId(), CurrentRevision() + 1, &delta);
+  EXPECT_FALSE(delta);
+  EXPECT_EQ(QList<int>() << 1 << 2, ExportedIds("songs"));
+}
+
+TEST_F(LibraryExportTest, DatabaseIdIsRandom) {
+  MemoryDatabase other(nullptr);
+  QSqlQuery q("SELECT id FROM library_changes_database", other.Connect());
+  ASSERT_TRUE(q.next());
+
+  EXPECT_EQ(32, DatabaseId().length());
+  EXPECT_NE(DatabaseId(), q.value(0).toString());
+}
+
+TEST_F(LibraryExportTest, ExportsEverythingForAnotherDatabase) {
+  backend_->AddOrUpdateSongs(SongList() << MakeSong("one") << MakeSong("two"));
+  const qint64 since_revision = CurrentRevision();
+  backend_->AddOrUpdateSongs(SongList() << MakeSong("three"));
+
+  // The revision would be usable here, but it came from a database that was
+  // since recreated, or from a client that didn't say where it came from.
+  for (const QString& since_database_id :
+       QStringList() << "0123456789abcdef0123456789abcdef" << QString()) {
+    bool delta = true;
+    EXPECT_EQ(CurrentRevision(),
+              Export(since_database_id, since_revision, &delta));
+    EXPECT_FALSE(delta);
+    EXPECT_EQ(DatabaseId(), database_id_);
+    EXPECT_EQ(QList<int>() << 1 << 2 << 3, ExportedIds("songs"));
+    EXPECT_TRUE(ExportedIds("deleted_songs").isEmpty());
+  }
+}
+
+}  // namespace
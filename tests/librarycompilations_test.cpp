@@ -0,0 +1,165 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include <memory>
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+
+#include "core/database.h"
+#include "core/song.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+
+namespace {
+
+class LibraryCompilationsTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    database_.reset(new MemoryDatabase(nullptr));
+    backend_.reset(NewBackend(true));
+    backend_->AddDirectory("/music");
+  }
+
+  LibraryBackend* NewBackend(bool track_dirty_albums) {
+    LibraryBackend* backend = new LibraryBackend;
+    backend->Init(database_.get(), Library::kSongsTable, Library::kDirsTable,
+                  Library::kSubdirsTable, Library::kFtsTable);
+    backend->set_track_dirty_albums(track_dirty_albums);
+    return backend;
+  }
+
+  static Song MakeSong(const QString& artist, const QString& path) {
+    Song song;
+    song.Init("Title", artist, "Album", 100);
+    song.set_url(QUrl::fromLocalFile(path));
+    song.set_directory_id(1);
+    song.set_mtime(1);
+    song.set_ctime(1);
+    song.set_filesize(1);
+    return song;
+  }
+
+  void AddCompilation() {
+    backend_->AddOrUpdateSongs(SongList()
+                               << MakeSong("Artist 1", "/music/album/1.mp3")
+                               << MakeSong("Artist 2", "/music/album/2.mp3"));
+  }
+
+  // Forgets which songs are compilations without telling the backend.
+  void ClearCompilations() {
+    QSqlDatabase db(database_->Connect());
+    QSqlQuery q("UPDATE songs SET sampler = 0, effective_compilation = 0", db);
+    ASSERT_TRUE(q.exec());
+  }
+
+  bool IsCompilation(int id) {
+    return backend_->GetSongById(id).is_compilation();
+  }
+
+  std::unique_ptr<Database> database_;
+  std::unique_ptr<LibraryBackend> backend_;
+};
+
+TEST_F(LibraryCompilationsTest, DetectsCompilation) {
+  AddCompilation();
+  backend_->UpdateCompilations();
+
+  EXPECT_TRUE(IsCompilation(1));
+  EXPECT_TRUE(IsCompilation(2));
+}
+
+TEST_F(LibraryCompilationsTest, SeparateDirectories) {
+  backend_->AddOrUpdateSongs(SongList()
+                             << MakeSong("Artist 1", "/music/one/1.mp3")
+                             << MakeSong("Artist 2", "/music/two/2.mp3"));
+  backend_->UpdateCompilations();
+
+  EXPECT_FALSE(IsCompilation(1));
+  EXPECT_FALSE(IsCompilation(2));
+}
+
+TEST_F(LibraryCompilationsTest, UpdatesChangedAlbumsOnly) {
+  AddCompilation();
+  backend_->UpdateCompilations();
+
+  // Songs changed behind the backend's back aren't looked at again.
+  ClearCompilations();
+  backend_->UpdateCompilations();
+  EXPECT_FALSE(IsCompilation(1));
+
+  // But touching a song in the album is enough to look at the whole album.
+  Song song = backend_->GetSongById(1);
+  song.set_title("New title");
+  backend_->AddOrUpdateSongs(SongList() << song);
+  backend_->UpdateCompilations();
+
+  EXPECT_TRUE(IsCompilation(1));
+  EXPECT_TRUE(IsCompilation(2));
+}
+
+TEST_F(LibraryCompilationsTest, FirstUpdateLooksAtEveryAlbum) {
+  AddCompilation();
+  backend_->UpdateCompilations();
+  ClearCompilations();
+
+  // A backend created later doesn't know what changed before it existed.
+  backend_.reset(NewBackend(true));
+  backend_->UpdateCompilations();
+
+  EXPECT_TRUE(IsCompilation(1));
+  EXPECT_TRUE(IsCompilation(2));
+}
+
+TEST_F(LibraryCompilationsTest, UntrackedBackendLooksAtEveryAlbum) {
+  backend_.reset(NewBackend(false));
+  AddCompilation();
+  backend_->UpdateCompilations();
+  ClearCompilations();
+
+  backend_->UpdateCompilations();
+
+  EXPECT_TRUE(IsCompilation(1));
+  EXPECT_TRUE(IsCompilation(2));
+}
+
+TEST_F(LibraryCompilationsTest, DeletingSongsUpdatesAlbum) {
+  AddCompilation();
+  backend_->UpdateCompilations();
+  ASSERT_TRUE(IsCompilation(1));
+
+  backend_->DeleteSongs(SongList() << backend_->GetSongById(2));
+  backend_->UpdateCompilations();
+
+  EXPECT_FALSE(IsCompilation(1));
+}
+
+TEST_F(LibraryCompilationsTest, MarkingSongsUnavailableUpdatesAlbum) {
+  AddCompilation();
+  backend_->UpdateCompilations();
+  ASSERT_TRUE(IsCompilation(1));
+
+  backend_->MarkSongsUnavailable(SongList() << backend_->GetSongById(2));
+  backend_->UpdateCompilations();
+
+  EXPECT_FALSE(IsCompilation(1));
+}
+
+}  // namespace
@@ -0,0 +1,223 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <QStringList>
+
+#include "core/song.h"
+#include "library/libraryindex.h"
+
+namespace {
+
+class LibraryIndexTest : public ::testing::Test {
+ protected:
+  Song AddSong(int id, const QString& artist, const QString& album,
+               int year = 0, bool compilation = false, int ctime = 0) {
+    Song song;
+    song.Init("Title", artist, album, 1000);
+    song.set_id(id);
+    song.set_year(year);
+    song.set_compilation(compilation);
+    song.set_ctime(ctime);
+    index_.AddOrUpdateSong(song);
+    return song;
+  }
+
+  // The first column of each row, sorted so the order doesn't matter.
+  static QStringList Values(const SqlRowList& rows) {
+    QStringList ret;
+    for (const SqlRow& row : rows) {
+      ret << row.value(0).toString();
+    }
+    ret.sort();
+    return ret;
+  }
+
+  QStringList Artists(const LibraryIndex::Query& q) const {
+    return Values(index_.Distinct(
+        q, QList<LibraryIndex::Column>() << LibraryIndex::Column_Artist));
+  }
+
+  LibraryIndex index_;
+};
+
+TEST_F(LibraryIndexTest, Empty) {
+  EXPECT_EQ(0, index_.song_count());
+  EXPECT_FALSE(index_.Contains(LibraryIndex::Query()));
+  EXPECT_TRUE(Artists(LibraryIndex::Query()).isEmpty());
+}
+
+TEST_F(LibraryIndexTest, Distinct) {
+  AddSong(1, "Artist 2", "Album 1");
+  AddSong(2, "Artist 1", "Album 1");
+  AddSong(3, "Artist 1", "Album 2");
+
+  EXPECT_EQ(3, index_.song_count());
+  EXPECT_EQ(QStringList() << "Artist 1"
+                          << "Artist 2",
+            Artists(LibraryIndex::Query()));
+}
+
+TEST_F(LibraryIndexTest, DistinctSeveralColumns) {
+  AddSong(1, "Artist", "Album 1", 2001);
+  AddSong(2, "Artist", "Album 1", 2001);
+  AddSong(3, "Artist", "Album 2", 2002);
+
+  SqlRowList rows = index_.Distinct(
+      LibraryIndex::Query(), QList<LibraryIndex::Column>()
+                                 << LibraryIndex::Column_Year
+                                 << LibraryIndex::Column_Album);
+  ASSERT_EQ(2, rows.count());
+
+  QStringList values;
+  for (const SqlRow& row : rows) {
+    values << QString("%1 %2").arg(row.value(0).toInt()).arg(
+        row.value(1).toString());
+  }
+  values.sort();
+  EXPECT_EQ(QStringList() << "2001 Album 1"
+                          << "2002 Album 2",
+            values);
+}
+
+TEST_F(LibraryIndexTest, Where) {
+  AddSong(1, "Artist 1", "Album 1", 2001);
+  AddSong(2, "Artist 2", "Album 1", 2002);
+  AddSong(3, "Artist 3", "Album 2", 2002);
+
+  LibraryIndex::Query q;
+  q.AddWhere(LibraryIndex::Column_Album, "Album 1");
+  EXPECT_EQ(QStringList() << "Artist 1"
+                          << "Artist 2",
+            Artists(q));
+
+  // Numbers are compared as text, like the keys of library items.
+  q.AddWhere(LibraryIndex::Column_Year, "2002");
+  EXPECT_EQ(QStringList() << "Artist 2", Artists(q));
+
+  q.AddWhere(LibraryIndex::Column_Artist, "Artist 3");
+  EXPECT_FALSE(index_.Contains(q));
+  EXPECT_TRUE(Artists(q).isEmpty());
+
+  LibraryIndex::Query missing;
+  missing.AddWhere(LibraryIndex::Column_Album, "Missing");
+  EXPECT_FALSE(index_.Contains(missing));
+}
+
+TEST_F(LibraryIndexTest, Compilations) {
+  AddSong(1, "Artist 1", "Album 1");
+  AddSong(2, "Artist 2", "Compilation", 0, true);
+
+  LibraryIndex::Query compilations;
+  compilations.AddCompilationRequirement(true);
+  EXPECT_TRUE(index_.Contains(compilations));
+  EXPECT_EQ(QStringList() << "Artist 2", Artists(compilations));
+
+  LibraryIndex::Query not_compilations;
+  not_compilations.AddCompilationRequirement(false);
+  EXPECT_EQ(QStringList() << "Artist 1", Artists(not_compilations));
+}
+
+TEST_F(LibraryIndexTest, UpdateSong) {
+  Song song = AddSong(1, "Artist 1", "Album 1");
+  AddSong(2, "Artist 2", "Album 1");
+
+  song.set_artist("Artist 3");
+  index_.AddOrUpdateSong(song);
+
+  EXPECT_EQ(2, index_.song_count());
+  EXPECT_EQ(QStringList() << "Artist 2"
+                          << "Artist 3",
+            Artists(LibraryIndex::Query()));
+
+  LibraryIndex::Query q;
+  q.AddWhere(LibraryIndex::Column_Artist, "Artist 1");
+  EXPECT_FALSE(index_.Contains(q));
+}
+
+TEST_F(LibraryIndexTest, RemoveSong) {
+  AddSong(1, "Artist 1", "Album 1");
+  Song song = AddSong(2, "Artist 2", "Album 1");
+
+  index_.RemoveSong(1);
+  EXPECT_EQ(1, index_.song_count());
+  EXPECT_EQ(QStringList() << "Artist 2", Artists(LibraryIndex::Query()));
+
+  // Unavailable songs are removed too.
+  song.set_unavailable(true);
+  index_.AddOrUpdateSong(song);
+  EXPECT_EQ(0, index_.song_count());
+  EXPECT_FALSE(index_.Contains(LibraryIndex::Query()));
+
+  // The free rows are used again.
+  AddSong(3, "Artist 3", "Album 1");
+  EXPECT_EQ(QStringList() << "Artist 3", Artists(LibraryIndex::Query()));
+}
+
+TEST_F(LibraryIndexTest, CTime) {
+  AddSong(1, "Old", "Album", 0, false, 100);
+  AddSong(2, "New", "Album", 0, false, 200);
+
+  LibraryIndex::Query q;
+  q.ctime_after = 150;
+  EXPECT_EQ(QStringList() << "New", Artists(q));
+}
+
+TEST_F(LibraryIndexTest, SongIds) {
+  AddSong(1, "Artist 1", "Album");
+  AddSong(2, "Artist 2", "Album");
+  AddSong(3, "Artist 3", "Album");
+
+  QSet<int> ids;
+  ids << 1 << 3;
+
+  LibraryIndex::Query q;
+  q.song_ids = &ids;
+  EXPECT_EQ(QStringList() << "Artist 1"
+                          << "Artist 3",
+            Artists(q));
+}
+
+TEST_F(LibraryIndexTest, AddRow) {
+  QList<QVariant> columns;
+  columns << 1 << "Artist"
+          << "Album"
+          << "Album artist"
+          << "Composer"
+          << "Performer"
+          << "Grouping"
+          << "Genre" << 2001 << 1999 << 1999 << 1 << 320
+          << int(Song::Type_Mpeg) << false << 100;
+  index_.AddRow(SqlRow(columns));
+
+  EXPECT_EQ(1, index_.song_count());
+
+  LibraryIndex::Query q;
+  q.AddWhere(LibraryIndex::Column_EffectiveAlbumArtist, "Album artist");
+  q.AddWhere(LibraryIndex::Column_Bitrate, "320");
+  q.AddCompilationRequirement(false);
+  EXPECT_EQ(QStringList() << "Artist", Artists(q));
+
+  // Adding the same ID again replaces the song.
+  columns[1] = "Other artist";
+  index_.AddRow(SqlRow(columns));
+  EXPECT_EQ(1, index_.song_count());
+  EXPECT_EQ(QStringList() << "Other artist", Artists(LibraryIndex::Query()));
+}
+
+}  // namespace
@@ -0,0 +1,340 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include <memory>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QSignalSpy>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "core/application.h"
+#include "core/database.h"
+#include "core/song.h"
+#include "core/utilities.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+#include "library/libraryitem.h"
+#include "library/librarymodel.h"
+
+namespace {
+
+// Builds the same trees with and without the LibraryIndex, and checks they
+// match.
+class LibraryModelIndexTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    // The Application keeps its database, settings and caches in the home
+    // directory, so give it one of its own.
+    home_ = QDir::temp().absoluteFilePath(
+        QString("clementine_librarymodelindex_test_%1")
+            .arg(QCoreApplication::applicationPid()));
+    QDir().mkpath(home_);
+    old_home_ = qgetenv("HOME");
+    old_cache_home_ = qgetenv("XDG_CACHE_HOME");
+    qputenv("HOME", QFile::encodeName(home_));
+    qputenv("XDG_CACHE_HOME", QFile::encodeName(home_ + "/.cache"));
+
+    app_ = new Application;
+  }
+
+  static void TearDownTestCase() {
+    delete app_;
+    app_ = nullptr;
+
+    qputenv("HOME", old_home_);
+    qputenv("XDG_CACHE_HOME", old_cache_home_);
+    Utilities::RemoveRecursive(home_);
+  }
+
+  virtual void SetUp() {
+    database_.reset(new MemoryDatabase(nullptr));
+    backend_.reset(new LibraryBackend);
+    backend_->Init(database_.get(), Library::kSongsTable, Library::kDirsTable,
+                   Library::kSubdirsTable, Library::kFtsTable);
+    backend_->AddDirectory("/mnt/music");
+
+    SongList songs;
+    songs << MakeSong("one", "Artist A", "Album 1", 2001)
+          << MakeSong("two", "Artist A", "Album 1", 2001)
+          << MakeSong("three", "Artist A", "Album 2", 2005)
+          << MakeSong("four", "Artist B", "Album 3", 1999)
+          << MakeSong("five", "", "", 0);
+
+    Song grouped = MakeSong("six", "Artist B", "Album 3", 1999);
+    grouped.set_grouping("Grouping");
+    songs << grouped;
+
+    // Two artists on a compilation, which go under Various Artists.
+    Song compilation1 = MakeSong("seven", "Artist C", "Hits", 2010);
+    Song compilation2 = MakeSong("eight", "Artist D", "Hits", 2010);
+    compilation1.set_compilation(true);
+    compilation2.set_compilation(true);
+    songs << compilation1 << compilation2;
+
+    backend_->AddOrUpdateSongs(songs);
+  }
+
+  virtual void TearDown() {
+    model_.reset();
+    QThreadPool::globalInstance()->waitForDone();
+  }
+
+  static Song MakeSong(const QString& title, const QString& artist,
+                       const QString& album, int year) {
+    Song song;
+    song.Init(title, artist, album, 100);
+    song.set_year(year);
+    song.set_url(QUrl::fromLocalFile("/mnt/music/" + title + ".mp3"));
+    song.set_directory_id(1);
+    song.set_mtime(1);
+    song.set_ctime(1);
+    song.set_filesize(1);
+    return song;
+  }
+
+  static void WaitForWorkers() {
+    // Twice, in case the first results start more queries.
+    for (int i = 0; i < 2; ++i) {
+      QThreadPool::globalInstance()->waitForDone();
+      QCoreApplication::processEvents();
+    }
+  }
+
+  QModelIndex Find(const QModelIndex& parent, const QString& text) {
+    for (int row = 0; row < model_->rowCount(parent); ++row) {
+      const QModelIndex index = model_->index(row, 0, parent);
+      if (index.data().toString() == text) return index;
+    }
+    return QModelIndex();
+  }
+
+  QStringList Children(const QModelIndex& parent) {
+    QStringList ret;
+    for (int row = 0; row < model_->rowCount(parent); ++row) {
+      ret << model_->index(row, 0, parent).data().toString();
+    }
+    ret.sort();
+    return ret;
+  }
+
+  // The path to every item in the model, populating containers on the way.
+  // Sorted, since SQL and the index don't return rows in the same order.
+  QStringList Tree() {
+    QStringList ret;
+    AddChildren(QModelIndex(), QString(), &ret);
+    ret.sort();
+    return ret;
+  }
+
+  void AddChildren(const QModelIndex& parent, const QString& path,
+                   QStringList* ret) {
+    for (int row = 0; row < model_->rowCount(parent); ++row) {
+      const QModelIndex index = model_->index(row, 0, parent);
+      if (index.data(LibraryModel::Role_IsDivider).toBool()) continue;
+
+      const QString child_path = path + "/" + index.data().toString();
+      *ret << child_path;
+
+      if (index.data(LibraryModel::Role_Type).toInt() ==
+          LibraryItem::Type_Container) {
+        model_->LazyPopulateNow(index);
+        AddChildren(index, child_path, ret);
+      }
+    }
+  }
+
+  // Builds the tree from SQL while the index is loading, then again from the
+  // index once it has loaded.
+  void BuildTrees(const LibraryModel::Grouping& grouping,
+                  const QString& filter, QStringList* sql,
+                  QStringList* index) {
+    model_.reset(new LibraryModel(backend_.get(), app_));
+    model_->SetGroupBy(grouping);
+    model_->SetFilterText(filter);
+
+    // Nothing is taken from the index until the event loop runs.
+    model_->Init(false);
+    *sql = Tree();
+
+    WaitForWorkers();
+    model_->ResetAsync();
+    WaitForWorkers();
+    *index = Tree();
+  }
+
+  static Application* app_;
+  static QString home_;
+  static QByteArray old_home_;
+  static QByteArray old_cache_home_;
+
+  std::unique_ptr<Database> database_;
+  std::unique_ptr<LibraryBackend> backend_;
+  std::unique_ptr<LibraryModel> model_;
+};
+
+Application* LibraryModelIndexTest::app_ = nullptr;
+QString LibraryModelIndexTest::home_;
+QByteArray LibraryModelIndexTest::old_home_;
+QByteArray LibraryModelIndexTest::old_cache_home_;
+
+TEST_F(LibraryModelIndexTest, ArtistAlbum) {
+  QStringList sql, index;
+  BuildTrees(LibraryModel::Grouping(LibraryModel::GroupBy_Artist,
+                                    LibraryModel::GroupBy_Album),
+             QString(), &sql, &index);
+
+  EXPECT_TRUE(sql.contains("/Various artists/Hits/seven"));
+  EXPECT_TRUE(sql.contains("/Artist A/Album 2/three"));
+  EXPECT_EQ(sql, index);
+}
+
+TEST_F(LibraryModelIndexTest, ArtistYearAlbum) {
+  QStringList sql, index;
+  BuildTrees(LibraryModel::Grouping(LibraryModel::GroupBy_Artist,
+                                    LibraryModel::GroupBy_YearAlbum),
+             QString(), &sql, &index);
+
+  EXPECT_FALSE(sql.isEmpty());
+  EXPECT_EQ(sql, index);
+}
+
+TEST_F(LibraryModelIndexTest, YearAlbumArtist) {
+  QStringList sql, index;
+  BuildTrees(LibraryModel::Grouping(LibraryModel::GroupBy_YearAlbum,
+                                    LibraryModel::GroupBy_Artist),
+             QString(), &sql, &index);
+
+  EXPECT_FALSE(sql.isEmpty());
+  EXPECT_EQ(sql, index);
+}
+
+TEST_F(LibraryModelIndexTest, Filter) {
+  QStringList sql, index;
+  BuildTrees(LibraryModel::Grouping(LibraryModel::GroupBy_Artist,
+                                    LibraryModel::GroupBy_Album),
+             "Album", &sql, &index);
+
+  EXPECT_TRUE(sql.contains("/Artist B/Album 3/six"));
+  EXPECT_FALSE(sql.contains("/Various artists"));
+  EXPECT_EQ(sql, index);
+}
+
+TEST_F(LibraryModelIndexTest, FilterOnCompilation) {
+  QStringList sql, index;
+  BuildTrees(LibraryModel::Grouping(LibraryModel::GroupBy_Artist,
+                                    LibraryModel::GroupBy_YearAlbum),
+             "Hits", &sql, &index);
+
+  EXPECT_TRUE(sql.contains("/Various artists"));
+  EXPECT_FALSE(sql.contains("/Artist A"));
+  EXPECT_EQ(sql, index);
+}
+
+TEST_F(LibraryModelIndexTest, DestroyedWhileIndexLoads) {
+  model_.reset(new LibraryModel(backend_.get(), app_));
+  model_->Init(false);
+
+  // The index is still being loaded from the backend.
+  model_.reset();
+  backend_.reset();
+  database_.reset();
+}
+
+TEST_F(LibraryModelIndexTest, FetchMoreLoadsInBackground) {
+  model_.reset(new LibraryModel(backend_.get(), app_));
+  model_->Init(false);
+
+  QModelIndex artist_index = Find(QModelIndex(), "Artist A");
+  ASSERT_TRUE(artist_index.isValid());
+  model_->fetchMore(artist_index);
+
+  // There's a loading indicator until the query has finished
+  ASSERT_EQ(1, model_->rowCount(artist_index));
+  EXPECT_EQ(LibraryItem::Type_LoadingIndicator,
+            model_->index(0, 0, artist_index)
+                .data(LibraryModel::Role_Type)
+                .toInt());
+
+  QSignalSpy spy(model_.get(), SIGNAL(LazyPopulateFinished(QModelIndex)));
+  QEventLoop loop;
+  QObject::connect(model_.get(), SIGNAL(LazyPopulateFinished(QModelIndex)),
+                   &loop, SLOT(quit()));
+  QTimer::singleShot(5000, &loop, SLOT(quit()));
+  loop.exec();
+
+  ASSERT_EQ(1, spy.count());
+  EXPECT_EQ(QStringList() << "Album 1"
+                          << "Album 2",
+            Children(artist_index));
+}
+
+TEST_F(LibraryModelIndexTest, FetchMoreRunsQueriesTogether) {
+  model_.reset(new LibraryModel(backend_.get(), app_));
+  model_->SetGroupBy(LibraryModel::Grouping(LibraryModel::GroupBy_Album,
+                                            LibraryModel::GroupBy_Artist));
+  model_->Init(false);
+
+  QModelIndex album1 = Find(QModelIndex(), "Album 1");
+  QModelIndex album3 = Find(QModelIndex(), "Album 3");
+  QModelIndex hits = Find(QModelIndex(), "Hits");
+  ASSERT_TRUE(album1.isValid());
+  ASSERT_TRUE(album3.isValid());
+  ASSERT_TRUE(hits.isValid());
+
+  // These are queued in the same event loop iteration, so they're run as one
+  // statement.  Each looks for compilations for a Various artists node too.
+  model_->fetchMore(album1);
+  model_->fetchMore(album3);
+  model_->fetchMore(hits);
+
+  QSignalSpy spy(model_.get(), SIGNAL(LazyPopulateFinished(QModelIndex)));
+  WaitForWorkers();
+
+  EXPECT_EQ(3, spy.count());
+  EXPECT_EQ(QStringList() << "Artist A", Children(album1));
+  EXPECT_EQ(QStringList() << "Artist B", Children(album3));
+  EXPECT_EQ(QStringList() << "Various artists", Children(hits));
+}
+
+TEST_F(LibraryModelIndexTest, CancelLazyPopulate) {
+  model_.reset(new LibraryModel(backend_.get(), app_));
+  model_->Init(false);
+
+  QModelIndex artist_index = Find(QModelIndex(), "Artist A");
+  ASSERT_TRUE(artist_index.isValid());
+  model_->fetchMore(artist_index);
+  model_->CancelLazyPopulate(artist_index);
+
+  // The node can be loaded again later
+  EXPECT_EQ(0, model_->rowCount(artist_index));
+  EXPECT_TRUE(model_->canFetchMore(artist_index));
+
+  model_->LazyPopulateNow(artist_index);
+  EXPECT_EQ(QStringList() << "Album 1"
+                          << "Album 2",
+            Children(artist_index));
+}
+
+}  // namespace
@@ -0,0 +1,215 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <memory>
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include <sqlite3.h>
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSignalSpy>
+#include <QSqlDriver>
+
+#include "core/database.h"
+#include "core/song.h"
+#include "core/taskmanager.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+#include "library/librarywatcher.h"
+
+namespace {
+
+// Counts the statements sqlite runs on a connection while it's alive.
+class StatementCounter {
+ public:
+  explicit StatementCounter(QSqlDatabase db) : handle_(nullptr), count_(0) {
+    const QVariant handle = db.driver()->handle();
+    if (handle.isValid() && qstrcmp(handle.typeName(), "sqlite3*") == 0) {
+      handle_ = *static_cast<sqlite3* const*>(handle.constData());
+      sqlite3_trace(handle_, &StatementCounter::Trace, this);
+    }
+  }
+
+  ~StatementCounter() {
+    if (handle_) sqlite3_trace(handle_, nullptr, nullptr);
+  }
+
+  int count() const { return count_; }
+
+ private:
+  static void Trace(void* self, const char*) {
+    ++reinterpret_cast<StatementCounter*>(self)->count_;
+  }
+
+  sqlite3* handle_;
+  int count_;
+};
+
+class LibraryWatcherTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    database_.reset(new MemoryDatabase(nullptr));
+    backend_.reset(new LibraryBackend);
+    backend_->Init(database_.get(), Library::kSongsTable, Library::kDirsTable,
+                   Library::kSubdirsTable, Library::kFtsTable);
+
+    task_manager_.reset(new TaskManager);
+    watcher_.reset(new LibraryWatcher);
+    watcher_->set_backend(backend_.get());
+    watcher_->set_task_manager(task_manager_.get());
+
+    path_ = QDir::temp().absoluteFilePath(
+        QString("clementine_librarywatcher_test_%1")
+            .arg(QCoreApplication::applicationPid()));
+    QDir().mkpath(path_);
+    path_ = QFileInfo(path_).canonicalFilePath();
+  }
+
+  virtual void TearDown() {
+    watcher_.reset();
+
+    QDir dir(path_);
+    for (const QString& filename : dir.entryList(QDir::Files)) {
+      dir.remove(filename);
+    }
+    QDir().rmdir(path_);
+  }
+
+  // Creates count empty files in path_, numbered from first, and adds a song
+  // to the library for each of them with the same mtime as the file so a
+  // rescan will find that nothing has changed.
+  void AddUnchangedFiles(int first, int count) {
+    if (first == 0) backend_->AddDirectory(path_);
+
+    SongList songs;
+    for (int i = first; i < first + count; ++i) {
+      const QString filename =
+          path_ + QString("/track%1.mp3").arg(i, 5, 10, QChar('0'));
+      QFile file(filename);
+      file.open(QIODevice::WriteOnly);
+      file.close();
+
+      Song song;
+      song.Init(QString("Title %1").arg(i), "Artist", "Album", 1000);
+      song.set_directory_id(1);
+      song.set_url(QUrl::fromLocalFile(filename));
+      song.set_mtime(QFileInfo(filename).lastModified().toTime_t());
+      song.set_ctime(song.mtime());
+      song.set_filesize(1);
+      songs << song;
+    }
+    backend_->AddOrUpdateSongs(songs);
+  }
+
+  // Rescans the whole directory and returns the number of SQL statements the
+  // scan ran.
+  int Rescan() {
+    Directory dir;
+    dir.id = 1;
+    dir.path = path_;
+
+    // An mtime of 0 forces the directory to be looked at again.
+    Subdirectory subdir;
+    subdir.directory_id = 1;
+    subdir.path = path_;
+    subdir.mtime = 0;
+
+    StatementCounter counter(database_->Connect());
+    watcher_->AddDirectory(dir, SubdirectoryList() << subdir);
+    return counter.count();
+  }
+
+  // Rescans the whole directory and returns how long it took in nanoseconds.
+  qint64 TimeRescan() {
+    QElapsedTimer timer;
+    timer.start();
+    Rescan();
+    return timer.nsecsElapsed();
+  }
+
+  std::unique_ptr<Database> database_;
+  std::unique_ptr<LibraryBackend> backend_;
+  std::unique_ptr<TaskManager> task_manager_;
+  std::unique_ptr<LibraryWatcher> watcher_;
+  QString path_;
+};
+
+TEST_F(LibraryWatcherTest, RescanLargeFlatDirectory) {
+  const int kFileCount = 5000;
+  AddUnchangedFiles(0, kFileCount);
+
+  QSignalSpy new_spy(watcher_.get(), SIGNAL(NewOrUpdatedSongs(SongList)));
+  QSignalSpy deleted_spy(watcher_.get(), SIGNAL(SongsDeleted(SongList)));
+  QSignalSpy touched_spy(watcher_.get(), SIGNAL(SongsMTimeUpdated(SongList)));
+
+  const int statements = Rescan();
+  EXPECT_GT(statements, 0);
+
+  // Twice as many files must not need any more queries - the directory's
+  // songs are fetched once and then looked up by path.
+  AddUnchangedFiles(kFileCount, kFileCount);
+  EXPECT_EQ(statements, Rescan());
+
+  EXPECT_EQ(0, new_spy.count());
+  EXPECT_EQ(0, deleted_spy.count());
+  EXPECT_EQ(0, touched_spy.count());
+}
+
+TEST_F(LibraryWatcherTest, RescanTimeGrowsLinearly) {
+  const int kSmallCount = 5000;
+  const int kLargeCount = 50000;
+
+  AddUnchangedFiles(0, kSmallCount);
+  Rescan();  // Warm up the filesystem cache.
+  const qint64 small_time = qMax<qint64>(TimeRescan(), 1000000);
+
+  AddUnchangedFiles(kSmallCount, kLargeCount - kSmallCount);
+  Rescan();
+  const qint64 large_time = TimeRescan();
+
+  // Ten times the files should take about ten times as long.  Comparing each
+  // file with every song in the directory would take about a hundred.
+  EXPECT_LT(large_time, small_time * 30)
+      << "5000 files took " << small_time / 1000000 << "ms, 50000 took "
+      << large_time / 1000000 << "ms";
+}
+
+TEST_F(LibraryWatcherTest, OnlyNewDirectoriesAreScannedInBulk) {
+  QSignalSpy started_spy(watcher_.get(), SIGNAL(NewDirectoryScanStarted()));
+  QSignalSpy finished_spy(watcher_.get(), SIGNAL(NewDirectoryScanFinished()));
+
+  // A directory without any known subdirectories is new.
+  Directory dir;
+  dir.id = 1;
+  dir.path = path_;
+  watcher_->AddDirectory(dir, SubdirectoryList());
+  EXPECT_EQ(1, started_spy.count());
+  EXPECT_EQ(1, finished_spy.count());
+
+  Rescan();
+  EXPECT_EQ(1, started_spy.count());
+  EXPECT_EQ(1, finished_spy.count());
+}
+
+}  // namespace
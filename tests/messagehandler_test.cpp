@@ -0,0 +1,184 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <memory>
+
+#include "gtest/gtest.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSignalSpy>
+
+#include "core/messagehandler.h"
+#include "tagreadermessages.pb.h"
+
+namespace {
+
+typedef pb::tagreader::Message Message;
+
+class TestHandler : public AbstractMessageHandler<Message> {
+ public:
+  explicit TestHandler(QIODevice* device)
+      : AbstractMessageHandler<Message>(device, nullptr) {}
+
+  using _MessageHandlerBase::set_max_message_size;
+
+  QList<Message> messages_;
+
+ protected:
+  void MessageArrived(const Message& message) { messages_ << message; }
+};
+
+// Runs the event loop until condition() is true, or gives up after a few
+// seconds.
+template <typename Condition>
+bool WaitFor(Condition condition) {
+  QElapsedTimer timer;
+  timer.start();
+  while (!condition()) {
+    if (timer.elapsed() > 5000) return false;
+    QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+  }
+  return true;
+}
+
+Message MakeMessage(int id, int size) {
+  Message message;
+  message.set_id(id);
+  message.mutable_load_embedded_art_response()->set_data(
+      std::string(size, 'x'));
+  return message;
+}
+
+class MessageHandlerTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    const QString name = QString("clementine_messagehandler_test_%1")
+                             .arg(QCoreApplication::applicationPid());
+    QLocalServer::removeServer(name);
+    ASSERT_TRUE(server_.listen(name));
+
+    worker_socket_.connectToServer(name);
+    ASSERT_TRUE(worker_socket_.waitForConnected(2000));
+    ASSERT_TRUE(server_.waitForNewConnection(2000));
+
+    worker_.reset(new TestHandler(&worker_socket_));
+    parent_.reset(new TestHandler(server_.nextPendingConnection()));
+  }
+
+  // Sends a message from the worker to the parent and waits for it.
+  void SendAndWait(const Message& message) {
+    const int count = parent_->messages_.count();
+    ASSERT_TRUE(worker_->SendMessage(message));
+    ASSERT_TRUE(WaitFor([&]() { return parent_->messages_.count() > count; }));
+
+    const Message& received = parent_->messages_.last();
+    EXPECT_EQ(message.id(), received.id());
+    EXPECT_EQ(message.load_embedded_art_response().data(),
+              received.load_embedded_art_response().data());
+  }
+
+  void EnableSharedMemory(int size) {
+    ASSERT_TRUE(worker_->EnableSharedMemoryTransport(size));
+    ASSERT_TRUE(
+        WaitFor([&]() { return worker_->is_shared_memory_attached(); }));
+  }
+
+  QLocalServer server_;
+  QLocalSocket worker_socket_;
+  std::unique_ptr<TestHandler> worker_;
+  std::unique_ptr<TestHandler> parent_;
+};
+
+TEST_F(MessageHandlerTest, SmallMessage) {
+  SendAndWait(MakeMessage(1, 100));
+}
+
+TEST_F(MessageHandlerTest, LargeMessageWithoutSharedMemory) {
+  SendAndWait(MakeMessage(1, 4 * 1024 * 1024));
+}
+
+TEST_F(MessageHandlerTest, LargeMessagesThroughSharedMemory) {
+  const int kRingSize = 1024 * 1024;
+  EnableSharedMemory(kRingSize);
+
+  QSignalSpy written_spy(&worker_socket_, SIGNAL(bytesWritten(qint64)));
+
+  // Enough messages to wrap around the ring a few times.
+  const int kMessageSize = kRingSize / 3;
+  for (int i = 0; i < 10; ++i) {
+    SendAndWait(MakeMessage(i, kMessageSize));
+  }
+
+  // Only the positions of the messages went through the socket.
+  qint64 written = 0;
+  for (const QList<QVariant>& args : written_spy) {
+    written += args[0].toLongLong();
+  }
+  EXPECT_LT(written, kMessageSize);
+}
+
+TEST_F(MessageHandlerTest, LargerThanSharedMemory) {
+  EnableSharedMemory(1024 * 1024);
+
+  // Falls back to the socket.
+  SendAndWait(MakeMessage(1, 2 * 1024 * 1024));
+  SendAndWait(MakeMessage(2, 100 * 1024));
+}
+
+TEST_F(MessageHandlerTest, OversizeMessageIsRejected) {
+  worker_->set_max_message_size(1000);
+
+  EXPECT_FALSE(worker_->SendMessage(MakeMessage(1, 2000)));
+
+  // Requests that are too large finish straight away.
+  std::unique_ptr<MessageReply<Message>> reply(
+      new MessageReply<Message>(MakeMessage(2, 2000)));
+  worker_->SendRequest(reply.get());
+  EXPECT_TRUE(reply->is_finished());
+  EXPECT_FALSE(reply->is_successful());
+
+  // Nothing was written, so the next message still gets through.
+  SendAndWait(MakeMessage(3, 100));
+  ASSERT_EQ(1, parent_->messages_.count());
+  EXPECT_EQ(3, parent_->messages_[0].id());
+}
+
+TEST_F(MessageHandlerTest, SharedMemoryFrameLengthIsChecked) {
+  EnableSharedMemory(1024 * 1024);
+
+  // A frame pointing at 2GB of the ring buffer, written by hand.  The length
+  // doesn't fit in an int.
+  QDataStream s(&worker_socket_);
+  s << quint32(0x80000000 | 12) << quint64(0) << quint32(0x80000000);
+
+  // The parent gives up on the connection instead of reading it.
+  EXPECT_TRUE(WaitFor([&]() {
+    return worker_socket_.state() == QLocalSocket::UnconnectedState;
+  }));
+  EXPECT_TRUE(parent_->messages_.isEmpty());
+}
+
+TEST_F(MessageHandlerTest, MaxMessageSizeFitsInFrameLength) {
+  // The top two bits of the frame length are flags.
+  EXPECT_EQ(0x3FFFFFFF, _MessageHandlerBase::kMaxMessageSize);
+}
+
+}  // namespace
@@ -0,0 +1,226 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <cstdlib>
+
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+
+#include "core/arraysize.h"
+#include "moodbar/moodbarbuilder.h"
+
+namespace {
+
+const int kBarkBands[] = {
+    100,  200,  300,  400,  510,  630,  770,  920,  1080, 1270, 1480,  1720,
+    2000, 2320, 2700, 3150, 3700, 4400, 5300, 6400, 7700, 9500, 12000, 15500};
+const int kBarkBandCount = arraysize(kBarkBands);
+
+// The original implementation of MoodbarBuilder, which looked up the bark
+// band of every frequency band and kept each frame's colour in a struct.
+class ReferenceBuilder {
+ public:
+  ReferenceBuilder(int bands, int rate_hz) {
+    int barkband = 0;
+    for (int i = 0; i < bands + 1; ++i) {
+      const int frequency = ((rate_hz / 2) * i + rate_hz / 4) / bands;
+      if (barkband < kBarkBandCount - 1 &&
+          frequency >= kBarkBands[barkband]) {
+        barkband++;
+      }
+      barkband_table_.append(barkband);
+    }
+  }
+
+  void AddFrame(const double* magnitudes, int size) {
+    if (size > barkband_table_.length()) return;
+
+    double bands[kBarkBandCount] = {0};
+    for (int i = 0; i < size; ++i) {
+      bands[barkband_table_[i]] += magnitudes[i];
+    }
+
+    double rgb[] = {0, 0, 0};
+    for (int i = 0; i < kBarkBandCount; ++i) {
+      rgb[(i * 3) / kBarkBandCount] += bands[i] * bands[i];
+    }
+    frames_.append(Rgb(sqrt(rgb[0]), sqrt(rgb[1]), sqrt(rgb[2])));
+  }
+
+  QByteArray Finish(int width) {
+    QByteArray ret;
+    ret.resize(width * 3);
+    char* data = ret.data();
+    if (frames_.count() == 0) return ret;
+
+    Normalize(&Rgb::r);
+    Normalize(&Rgb::g);
+    Normalize(&Rgb::b);
+
+    for (int i = 0; i < width; ++i) {
+      Rgb rgb;
+      int start = i * frames_.count() / width;
+      int end = (i + 1) * frames_.count() / width;
+      if (start == end) end = start + 1;
+
+      for (int j = start; j < end; j++) {
+        rgb.r += frames_[j].r * 255;
+        rgb.g += frames_[j].g * 255;
+        rgb.b += frames_[j].b * 255;
+      }
+
+      const int n = end - start;
+      *(data++) = rgb.r / n;
+      *(data++) = rgb.g / n;
+      *(data++) = rgb.b / n;
+    }
+    return ret;
+  }
+
+ private:
+  struct Rgb {
+    Rgb() : r(0), g(0), b(0) {}
+    Rgb(double r_, double g_, double b_) : r(r_), g(g_), b(b_) {}
+    double r, g, b;
+  };
+
+  void Normalize(double Rgb::*member) {
+    double mini = frames_[0].*member;
+    double maxi = frames_[0].*member;
+    for (const Rgb& rgb : frames_) {
+      mini = qMin(mini, rgb.*member);
+      maxi = qMax(maxi, rgb.*member);
+    }
+
+    double avg = 0;
+    for (const Rgb& rgb : frames_) {
+      const double value = rgb.*member;
+      if (value != mini && value != maxi) avg += value / frames_.count();
+    }
+
+    double tu = 0, tb = 0, avgu = 0, avgb = 0;
+    for (const Rgb& rgb : frames_) {
+      const double value = rgb.*member;
+      if (value == mini || value == maxi) continue;
+      if (value > avg) {
+        avgu += value;
+        tu++;
+      } else {
+        avgb += value;
+        tb++;
+      }
+    }
+    avgu /= tu;
+    avgb /= tb;
+
+    tu = 0;
+    tb = 0;
+    double avguu = 0, avgbb = 0;
+    for (const Rgb& rgb : frames_) {
+      const double value = rgb.*member;
+      if (value == mini || value == maxi) continue;
+      if (value > avgu) {
+        avguu += value;
+        tu++;
+      } else if (value < avgb) {
+        avgbb += value;
+        tb++;
+      }
+    }
+    avguu /= tu;
+    avgbb /= tb;
+
+    mini = qMax(avg + (avgb - avg) * 2, avgbb);
+    maxi = qMin(avg + (avgu - avg) * 2, avguu);
+    double delta = maxi - mini;
+    if (delta == 0) delta = 1;
+
+    for (Rgb& rgb : frames_) {
+      double* value = &(rgb.*member);
+      *value =
+          std::isfinite(*value) ? qBound(0.0, (*value - mini) / delta, 1.0) : 0;
+    }
+  }
+
+  QVector<int> barkband_table_;
+  QList<Rgb> frames_;
+};
+
+// Feeds the same frames to both builders and checks their moodbars match.
+// The new one adds things up in a different order, so a value that lands
+// right on a boundary can come out one lower or higher.
+void ExpectSameAsReference(int bands, int size, int frame_count, int width) {
+  MoodbarBuilder builder;
+  builder.Init(bands, 44100);
+  ReferenceBuilder reference(bands, 44100);
+
+  srand(bands * 1000 + size);
+  QVector<double> magnitudes(size);
+  for (int frame = 0; frame < frame_count; ++frame) {
+    for (int i = 0; i < size; ++i) {
+      magnitudes[i] = double(rand() % 10000) / 100.0;
+    }
+    builder.AddFrame(magnitudes.constData(), size);
+    reference.AddFrame(magnitudes.constData(), size);
+  }
+
+  const QByteArray actual = builder.Finish(width);
+  const QByteArray expected = reference.Finish(width);
+  ASSERT_EQ(expected.size(), actual.size());
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_NEAR(quint8(expected[i]), quint8(actual[i]), 1)
+        << "bands " << bands << " size " << size << " byte " << i;
+  }
+}
+
+TEST(MoodbarBuilderTest, SameAsReference) {
+  // The pipeline uses 128 bands.
+  ExpectSameAsReference(128, 128, 500, 100);
+}
+
+TEST(MoodbarBuilderTest, BandCountsThatArentMultiplesOfFour) {
+  for (int bands : QList<int>() << 1 << 2 << 3 << 5 << 127 << 130 << 257) {
+    ExpectSameAsReference(bands, bands, 300, 50);
+  }
+}
+
+TEST(MoodbarBuilderTest, ShortFrames) {
+  // Frames can have fewer magnitudes than bands, and one more is allowed.
+  ExpectSameAsReference(128, 61, 300, 50);
+  ExpectSameAsReference(128, 129, 300, 50);
+}
+
+TEST(MoodbarBuilderTest, MoreColumnsThanFrames) {
+  ExpectSameAsReference(128, 128, 30, 100);
+}
+
+TEST(MoodbarBuilderTest, IgnoresFramesThatAreTooLong) {
+  MoodbarBuilder builder;
+  builder.Init(16, 44100);
+  QVector<double> magnitudes(18, 1.0);
+  builder.AddFrame(magnitudes.constData(), magnitudes.size());
+
+  // No frames, so the moodbar is left uninitialised, but it's still the
+  // right size.
+  EXPECT_EQ(30, builder.Finish(10).size());
+}
+
+}  // namespace
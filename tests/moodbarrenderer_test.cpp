@@ -0,0 +1,118 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <QApplication>
+#include <QColor>
+#include <QImage>
+#include <QPalette>
+
+#include "moodbar/moodbarrenderer.h"
+
+namespace {
+
+// The original QColor based implementation of MoodbarRenderer::Colors, with
+// the Normal style's parameters.
+QList<QRgb> ReferenceColors(const QByteArray& data) {
+  const int samples = data.size() / 3;
+  const int threshold = samples / 360 * 3;
+  const uchar* data_p = reinterpret_cast<const uchar*>(data.constData());
+
+  int hue_distribution[360] = {0};
+  int total = 0;
+
+  QList<QColor> colors;
+  for (int i = 0; i < samples; ++i, data_p += 3) {
+    const QColor color(data_p[0], data_p[1], data_p[2]);
+    colors << color;
+    if (hue_distribution[qMax(0, color.hue())]++ == threshold) {
+      total++;
+    }
+  }
+
+  total = qMax(total, 1);
+  for (int i = 0, n = 0; i < 360; i++) {
+    hue_distribution[i] =
+        ((hue_distribution[i] > threshold ? n++ : n) * 359 / total) % 360;
+  }
+
+  QList<QRgb> ret;
+  for (const QColor& color : colors) {
+    ret << QColor::fromHsv(
+               qBound(0, hue_distribution[qMax(0, color.hue())], 359),
+               qBound(0, color.saturation(), 255),
+               qBound(0, color.value(), 255)).rgb();
+  }
+  return ret;
+}
+
+QByteArray RandomData(int samples) {
+  QByteArray data(samples * 3, 0);
+  for (int i = 0; i < data.size(); ++i) {
+    data[i] = qrand() % 256;
+  }
+  return data;
+}
+
+TEST(MoodbarRendererTest, ColorsMatchQColor) {
+  qsrand(42);
+  const QByteArray data = RandomData(20000);
+
+  const ColorVector colors = MoodbarRenderer::Colors(
+      data, MoodbarRenderer::Style_Normal, QApplication::palette());
+  const QList<QRgb> expected = ReferenceColors(data);
+
+  ASSERT_EQ(expected.count(), colors.count());
+  for (int i = 0; i < colors.count(); ++i) {
+    ASSERT_EQ(expected[i], colors[i].rgb()) << "sample " << i;
+  }
+}
+
+TEST(MoodbarRendererTest, GreyColors) {
+  QByteArray data;
+  for (int i = 0; i < 256; ++i) {
+    data.append(char(i)).append(char(i)).append(char(i));
+  }
+
+  const ColorVector colors = MoodbarRenderer::Colors(
+      data, MoodbarRenderer::Style_Normal, QApplication::palette());
+  const QList<QRgb> expected = ReferenceColors(data);
+
+  ASSERT_EQ(expected.count(), colors.count());
+  for (int i = 0; i < colors.count(); ++i) {
+    EXPECT_EQ(expected[i], colors[i].rgb());
+  }
+}
+
+TEST(MoodbarRendererTest, RenderToImageIsSymmetric) {
+  qsrand(42);
+  const ColorVector colors = MoodbarRenderer::Colors(
+      RandomData(1000), MoodbarRenderer::Style_Happy, QApplication::palette());
+
+  const QImage image = MoodbarRenderer::RenderToImage(colors, QSize(300, 21));
+  ASSERT_EQ(QSize(300, 21), image.size());
+
+  for (int y = 0; y < image.height() / 2; ++y) {
+    for (int x = 0; x < image.width(); ++x) {
+      EXPECT_EQ(image.pixel(x, y), image.pixel(x, image.height() - 1 - y));
+      EXPECT_EQ(255, qAlpha(image.pixel(x, y)));
+    }
+  }
+}
+
+}  // namespace
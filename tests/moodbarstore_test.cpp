@@ -0,0 +1,193 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include <memory>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QVariant>
+
+#include "core/database.h"
+#include "core/song.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+#include "moodbar/moodbarstore.h"
+
+namespace {
+
+Song MakeSong(const QString& title, int mtime = 1) {
+  Song song;
+  song.Init(title, "Artist", "Album", 100);
+  song.set_url(QUrl::fromLocalFile("/mnt/music/" + title + ".mp3"));
+  song.set_directory_id(1);
+  song.set_mtime(mtime);
+  song.set_ctime(1);
+  song.set_filesize(1);
+  return song;
+}
+
+class MoodbarStoreTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    database_.reset(new MemoryDatabase(nullptr));
+    backend_.reset(new LibraryBackend);
+    backend_->Init(database_.get(), Library::kSongsTable, Library::kDirsTable,
+                   Library::kSubdirsTable, Library::kFtsTable);
+    backend_->AddDirectory("/mnt/music");
+    store_.reset(new MoodbarStore(database_.get(), Library::kSongsTable));
+  }
+
+  static QUrl Url(const QString& title) {
+    return QUrl::fromLocalFile("/mnt/music/" + title + ".mp3");
+  }
+
+  std::unique_ptr<Database> database_;
+  std::unique_ptr<LibraryBackend> backend_;
+  std::unique_ptr<MoodbarStore> store_;
+};
+
+TEST_F(MoodbarStoreTest, SavesLibrarySongs) {
+  backend_->AddOrUpdateSongs(SongList() << MakeSong("one") << MakeSong("two"));
+
+  EXPECT_TRUE(store_->Save(Url("one"), "moodbar one"));
+  EXPECT_EQ(QByteArray("moodbar one"), store_->Load(Url("one")));
+  EXPECT_TRUE(store_->Load(Url("two")).isEmpty());
+}
+
+TEST_F(MoodbarStoreTest, DoesntSaveOtherFiles) {
+  EXPECT_FALSE(store_->Save(Url("elsewhere"), "moodbar"));
+  EXPECT_TRUE(store_->Load(Url("elsewhere")).isEmpty());
+}
+
+TEST_F(MoodbarStoreTest, SaveReplacesOldMoodbar) {
+  backend_->AddOrUpdateSongs(SongList() << MakeSong("one"));
+
+  ASSERT_TRUE(store_->Save(Url("one"), "old"));
+  ASSERT_TRUE(store_->Save(Url("one"), "new"));
+  EXPECT_EQ(QByteArray("new"), store_->Load(Url("one")));
+}
+
+TEST_F(MoodbarStoreTest, IgnoresMoodbarOfChangedFile) {
+  backend_->AddOrUpdateSongs(SongList() << MakeSong("one"));
+  ASSERT_TRUE(store_->Save(Url("one"), "moodbar"));
+
+  Song song = backend_->GetSongById(1);
+  song.set_mtime(2);
+  backend_->AddOrUpdateSongs(SongList() << song);
+
+  EXPECT_TRUE(store_->Load(Url("one")).isEmpty());
+  EXPECT_EQ(QList<QUrl>() << Url("one"), store_->UrlsWithoutMoodbars());
+}
+
+TEST_F(MoodbarStoreTest, UrlsWithoutMoodbars) {
+  Song stream = MakeSong("stream");
+  stream.set_url(QUrl("http://example.com/stream.mp3"));
+  Song unavailable = MakeSong("unavailable");
+  backend_->AddOrUpdateSongs(SongList() << MakeSong("one") << MakeSong("two")
+                                        << stream << unavailable);
+  backend_->MarkSongsUnavailable(SongList() << backend_->GetSongById(4));
+
+  ASSERT_TRUE(store_->Save(Url("one"), "moodbar"));
+
+  // Only local files that are still there need one.
+  EXPECT_EQ(QList<QUrl>() << Url("two"), store_->UrlsWithoutMoodbars());
+}
+
+TEST_F(MoodbarStoreTest, DeleteSongs) {
+  backend_->AddOrUpdateSongs(SongList() << MakeSong("one") << MakeSong("two"));
+  ASSERT_TRUE(store_->Save(Url("one"), "moodbar one"));
+  ASSERT_TRUE(store_->Save(Url("two"), "moodbar two"));
+
+  store_->DeleteSongs(SongList() << backend_->GetSongById(1));
+
+  QSqlQuery q("SELECT song_id FROM moodbars", database_->Connect());
+  ASSERT_TRUE(q.exec());
+  ASSERT_TRUE(q.next());
+  EXPECT_EQ(2, q.value(0).toInt());
+  EXPECT_FALSE(q.next());
+}
+
+class MoodbarStoreMigrationTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    filename_ = QDir::temp().absoluteFilePath(
+        QString("clementine_moodbarstore_test_%1.db")
+            .arg(QCoreApplication::applicationPid()));
+    RemoveFiles();
+  }
+
+  void TearDown() { RemoveFiles(); }
+
+  void RemoveFiles() {
+    QFile::remove(filename_);
+    QFile::remove(filename_ + "-wal");
+    QFile::remove(filename_ + "-shm");
+  }
+
+  QString filename_;
+};
+
+TEST_F(MoodbarStoreMigrationTest, Schema52AddsMoodbarsTable) {
+  {
+    Database database(nullptr, nullptr, filename_);
+    LibraryBackend backend;
+    backend.Init(&database, Library::kSongsTable, Library::kDirsTable,
+                 Library::kSubdirsTable, Library::kFtsTable);
+    backend.AddDirectory("/mnt/music");
+    backend.AddOrUpdateSongs(SongList() << MakeSong("one"));
+
+    // Take the database back to how version 51 left it.
+    QSqlDatabase db(database.Connect());
+    for (const QString& statement :
+         QStringList() << "DROP TRIGGER library_changes_insert"
+                       << "DROP TRIGGER library_changes_update"
+                       << "DROP TRIGGER library_changes_delete"
+                       << "DROP TABLE library_changes"
+                       << "DROP TABLE library_changes_database"
+                       << "DROP TABLE moodbars"
+                       << "UPDATE schema_version SET version=51") {
+      QSqlQuery q(db);
+      ASSERT_TRUE(q.exec(statement)) << statement.toStdString();
+    }
+  }
+
+  Database database(nullptr, nullptr, filename_);
+  EXPECT_EQ(51, database.startup_schema_version());
+
+  QSqlDatabase db(database.Connect());
+  QSqlQuery q("SELECT version FROM schema_version", db);
+  ASSERT_TRUE(q.exec());
+  ASSERT_TRUE(q.next());
+  EXPECT_EQ(Database::kSchemaVersion, q.value(0).toInt());
+  EXPECT_TRUE(db.tables().contains("moodbars"));
+
+  // Songs from before the upgrade can have moodbars.
+  MoodbarStore store(&database, Library::kSongsTable);
+  const QUrl url = QUrl::fromLocalFile("/mnt/music/one.mp3");
+  EXPECT_EQ(QList<QUrl>() << url, store.UrlsWithoutMoodbars());
+  EXPECT_TRUE(store.Save(url, "moodbar"));
+  EXPECT_EQ(QByteArray("moodbar"), store.Load(url));
+}
+
+}  // namespace
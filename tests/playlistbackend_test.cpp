@@ -0,0 +1,262 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <memory>
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include <QSqlQuery>
+#include <QStringList>
+#include <QtAlgorithms>
+
+#include "core/database.h"
+#include "core/song.h"
+#include "playlist/playlistbackend.h"
+#include "playlist/songplaylistitem.h"
+#include "smartplaylists/generator.h"
+
+namespace {
+
+// One row of the playlist_items table.
+struct Row {
+  qint64 rowid;
+  qint64 position;
+  QString title;
+};
+
+class PlaylistBackendTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    database_.reset(new MemoryDatabase(nullptr));
+    backend_.reset(new PlaylistBackend(database_.get()));
+    playlist_ = backend_->CreatePlaylist("Test", QString());
+  }
+
+  static PlaylistItemPtr MakeItem(const QString& title) {
+    Song song;
+    song.Init(title, "Artist", "Album", 123);
+    song.set_url(QUrl("file:///tmp/" + title + ".mp3"));
+    return PlaylistItemPtr(new SongPlaylistItem(song));
+  }
+
+  static PlaylistItemList MakeItems(const QStringList& titles) {
+    PlaylistItemList ret;
+    for (const QString& title : titles) {
+      ret << MakeItem(title);
+    }
+    return ret;
+  }
+
+  static QStringList Titles(const PlaylistItemList& items) {
+    QStringList ret;
+    for (PlaylistItemPtr item : items) {
+      ret << item->Metadata().title();
+    }
+    return ret;
+  }
+
+  static QStringList Titles(const QList<Row>& rows) {
+    QStringList ret;
+    for (const Row& row : rows) {
+      ret << row.title;
+    }
+    return ret;
+  }
+
+  void Save(const PlaylistItemList& items) {
+    backend_->SavePlaylist(playlist_, items, -1,
+                           smart_playlists::GeneratorPtr());
+  }
+
+  // Reads the playlist's rows straight from the table, in order.
+  QList<Row> Rows() {
+    QSqlQuery q(
+        "SELECT ROWID, position, title FROM playlist_items"
+        " WHERE playlist = :playlist ORDER BY position",
+        database_->Connect());
+    q.bindValue(":playlist", playlist_);
+    q.exec();
+
+    QList<Row> ret;
+    while (q.next()) {
+      Row row;
+      row.rowid = q.value(0).toLongLong();
+      row.position = q.value(1).toLongLong();
+      row.title = q.value(2).toString();
+      ret << row;
+    }
+    return ret;
+  }
+
+  std::unique_ptr<Database> database_;
+  std::unique_ptr<PlaylistBackend> backend_;
+  int playlist_;
+};
+
+TEST_F(PlaylistBackendTest, SaveAndLoad) {
+  const QStringList titles = QStringList() << "a"
+                                           << "b"
+                                           << "c";
+  Save(MakeItems(titles));
+
+  const QList<Row> rows = Rows();
+  ASSERT_EQ(3, rows.count());
+  EXPECT_EQ(titles, Titles(rows));
+  for (int i = 0; i < rows.count(); ++i) {
+    EXPECT_EQ((i + 1) * PlaylistBackend::kPositionSpacing, rows[i].position);
+  }
+
+  // A new backend has to read the playlist from the database.
+  PlaylistBackend backend(database_.get());
+  EXPECT_EQ(titles, Titles(backend.GetPlaylistItems(playlist_)));
+}
+
+TEST_F(PlaylistBackendTest, MoveOnlyUpdatesTheMovedRow) {
+  PlaylistItemList items = MakeItems(QStringList() << "a"
+                                                   << "b"
+                                                   << "c"
+                                                   << "d");
+  Save(items);
+  const QList<Row> before = Rows();
+
+  // Move d to the front.
+  items.prepend(items.takeLast());
+  Save(items);
+
+  const QList<Row> after = Rows();
+  ASSERT_EQ(4, after.count());
+  EXPECT_EQ(QStringList() << "d"
+                          << "a"
+                          << "b"
+                          << "c",
+            Titles(after));
+
+  // d kept its row and went before a, and the others weren't touched.
+  EXPECT_EQ(before[3].rowid, after[0].rowid);
+  EXPECT_LT(after[0].position, before[0].position);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(before[i].rowid, after[i + 1].rowid);
+    EXPECT_EQ(before[i].position, after[i + 1].position);
+  }
+
+  EXPECT_EQ(Titles(items),
+            Titles(PlaylistBackend(database_.get()).GetPlaylistItems(
+                playlist_)));
+}
+
+TEST_F(PlaylistBackendTest, InsertAndDelete) {
+  PlaylistItemList items = MakeItems(QStringList() << "a"
+                                                   << "b"
+                                                   << "c");
+  Save(items);
+  const QList<Row> before = Rows();
+
+  // Replace b with a new item.
+  items[1] = MakeItem("x");
+  Save(items);
+
+  const QList<Row> after = Rows();
+  ASSERT_EQ(3, after.count());
+  EXPECT_EQ(QStringList() << "a"
+                          << "x"
+                          << "c",
+            Titles(after));
+
+  EXPECT_EQ(before[0].rowid, after[0].rowid);
+  EXPECT_EQ(before[0].position, after[0].position);
+  EXPECT_EQ(before[2].rowid, after[2].rowid);
+  EXPECT_EQ(before[2].position, after[2].position);
+
+  // x got a new row between a and c, and b's row is gone.
+  EXPECT_NE(before[1].rowid, after[1].rowid);
+  EXPECT_GT(after[1].position, after[0].position);
+  EXPECT_LT(after[1].position, after[2].position);
+
+  // Appending and removing from the front.
+  items.removeFirst();
+  items << MakeItem("y");
+  Save(items);
+
+  const QList<Row> last = Rows();
+  EXPECT_EQ(QStringList() << "x"
+                          << "c"
+                          << "y",
+            Titles(last));
+  EXPECT_EQ(after[1].rowid, last[0].rowid);
+  EXPECT_EQ(after[2].rowid, last[1].rowid);
+  EXPECT_GT(last[2].position, last[1].position);
+}
+
+TEST_F(PlaylistBackendTest, ReorderAfterLoading) {
+  Save(MakeItems(QStringList() << "a"
+                               << "b"
+                               << "c"));
+  const QList<Row> before = Rows();
+
+  // Items read from the database are matched to their rows as well.
+  PlaylistBackend backend(database_.get());
+  PlaylistItemList items = backend.GetPlaylistItems(playlist_);
+  ASSERT_EQ(3, items.count());
+  items.swap(0, 2);
+  backend.SavePlaylist(playlist_, items, -1, smart_playlists::GeneratorPtr());
+
+  const QList<Row> after = Rows();
+  EXPECT_EQ(QStringList() << "c"
+                          << "b"
+                          << "a",
+            Titles(after));
+
+  QList<qint64> before_ids;
+  QList<qint64> after_ids;
+  for (int i = 0; i < 3; ++i) {
+    before_ids << before[i].rowid;
+    after_ids << after[i].rowid;
+  }
+  qSort(before_ids);
+  qSort(after_ids);
+  EXPECT_EQ(before_ids, after_ids);
+
+  // b stays where it was.
+  EXPECT_EQ(before[1].position, after[1].position);
+}
+
+TEST_F(PlaylistBackendTest, RenumbersWhenThereIsNoSpaceLeft) {
+  PlaylistItemList items = MakeItems(QStringList() << "a"
+                                                   << "b"
+                                                   << "c");
+  Save(items);
+
+  // Keep moving the last item to just after the first one, halving the gap
+  // between them every time until there's no space left.
+  for (int i = 0; i < 40; ++i) {
+    items.insert(1, items.takeLast());
+    Save(items);
+
+    const QList<Row> rows = Rows();
+    ASSERT_EQ(Titles(items), Titles(rows));
+    for (int j = 1; j < rows.count(); ++j) {
+      EXPECT_LT(rows[j - 1].position, rows[j].position);
+    }
+  }
+
+  EXPECT_EQ(Titles(items),
+            Titles(PlaylistBackend(database_.get()).GetPlaylistItems(
+                playlist_)));
+}
+
+}  // namespace
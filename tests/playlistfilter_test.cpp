@@ -0,0 +1,187 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <functional>
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include <QStandardItemModel>
+#include <QStringList>
+
+#include "playlist/playlist.h"
+#include "playlist/playlistfilter.h"
+
+namespace {
+
+const char* kArtists[] = {"The Beatles", "Beat Happening", "ABBA",
+                          "Radiohead", "Love"};
+const char* kAlbums[] = {"Abbey Road", "Help", "OK Computer", "Arrival"};
+const char* kGenres[] = {"Rock", "Pop", "Jazz", ""};
+
+// Decides whether one row of the model matches, by reading the model's data
+// the way the filter did before it kept a copy of the columns.
+typedef std::function<bool(const QAbstractItemModel*, int)> RowMatcher;
+
+QString Text(const QAbstractItemModel* model, int row, int column) {
+  return model->index(row, column).data().toString().toLower();
+}
+
+class PlaylistFilterTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    model_.setColumnCount(Playlist::ColumnCount);
+
+    // More than one batch, so the rows are filtered in parallel.
+    const int count = PlaylistFilter::kRowsPerBatch * 2 + 123;
+    for (int i = 0; i < count; ++i) {
+      model_.appendRow(MakeRow(i));
+    }
+
+    filter_.setSourceModel(&model_);
+  }
+
+  static QList<QStandardItem*> MakeRow(int i) {
+    QList<QStandardItem*> ret;
+    for (int column = 0; column < Playlist::ColumnCount; ++column) {
+      ret << new QStandardItem;
+    }
+
+    const QString title =
+        i % 7 == 0 ? QString("Love song %1").arg(i) : QString("Song %1").arg(i);
+    ret[Playlist::Column_Title]->setData(title, Qt::DisplayRole);
+    ret[Playlist::Column_Artist]->setData(kArtists[i % 5], Qt::DisplayRole);
+    ret[Playlist::Column_Album]->setData(kAlbums[i % 4], Qt::DisplayRole);
+    ret[Playlist::Column_Genre]->setData(kGenres[i % 3], Qt::DisplayRole);
+    ret[Playlist::Column_Year]->setData(1960 + i % 60, Qt::DisplayRole);
+    ret[Playlist::Column_Track]->setData(i % 20, Qt::DisplayRole);
+    ret[Playlist::Column_Length]->setData(
+        qint64(60 + i % 300) * 1000000000ll, Qt::DisplayRole);
+    ret[Playlist::Column_Rating]->setData((i % 11) / 10.0, Qt::DisplayRole);
+    return ret;
+  }
+
+  // Returns the source rows the filter shows.
+  QList<int> FilteredRows() const {
+    QList<int> ret;
+    for (int i = 0; i < filter_.rowCount(); ++i) {
+      ret << filter_.mapToSource(filter_.index(i, 0)).row();
+    }
+    return ret;
+  }
+
+  // Returns the source rows the matcher accepts, looking at one at a time.
+  QList<int> ExpectedRows(const RowMatcher& matcher) const {
+    QList<int> ret;
+    for (int row = 0; row < model_.rowCount(); ++row) {
+      if (matcher(&model_, row)) ret << row;
+    }
+    return ret;
+  }
+
+  void ExpectSameRows(const QString& query, const RowMatcher& matcher) {
+    filter_.setFilterFixedString(query);
+    const QList<int> expected = ExpectedRows(matcher);
+    EXPECT_FALSE(expected.isEmpty()) << query;
+    EXPECT_EQ(expected, FilteredRows()) << query;
+  }
+
+  QStandardItemModel model_;
+  PlaylistFilter filter_;
+};
+
+TEST_F(PlaylistFilterTest, NoFilter) {
+  filter_.setFilterFixedString(QString());
+  EXPECT_EQ(model_.rowCount(), filter_.rowCount());
+}
+
+TEST_F(PlaylistFilterTest, AnyColumn) {
+  ExpectSameRows("LOVE", [](const QAbstractItemModel* model, int row) {
+    for (int column = 0; column < Playlist::ColumnCount; ++column) {
+      if (Text(model, row, column).contains("love")) return true;
+    }
+    return false;
+  });
+}
+
+TEST_F(PlaylistFilterTest, TextColumns) {
+  ExpectSameRows("artist:beat", [](const QAbstractItemModel* model, int row) {
+    return Text(model, row, Playlist::Column_Artist).contains("beat");
+  });
+  ExpectSameRows("album:=help", [](const QAbstractItemModel* model, int row) {
+    return Text(model, row, Playlist::Column_Album) == "help";
+  });
+  ExpectSameRows("genre:!=rock", [](const QAbstractItemModel* model, int row) {
+    return Text(model, row, Playlist::Column_Genre) != "rock";
+  });
+  ExpectSameRows("album:>h", [](const QAbstractItemModel* model, int row) {
+    return Text(model, row, Playlist::Column_Album) > "h";
+  });
+}
+
+TEST_F(PlaylistFilterTest, NumericalColumns) {
+  ExpectSameRows("year:>=2000", [](const QAbstractItemModel* model, int row) {
+    return model->index(row, Playlist::Column_Year).data().toInt() >= 2000;
+  });
+  ExpectSameRows("track:5", [](const QAbstractItemModel* model, int row) {
+    return model->index(row, Playlist::Column_Track).data().toInt() == 5;
+  });
+  ExpectSameRows("length:<3:00", [](const QAbstractItemModel* model, int row) {
+    return model->index(row, Playlist::Column_Length).data().toLongLong() /
+               1000000000ll <
+           180;
+  });
+  ExpectSameRows("rating:>=4", [](const QAbstractItemModel* model, int row) {
+    const double rating =
+        model->index(row, Playlist::Column_Rating).data().toDouble();
+    return int(rating * 10.0 + 0.5) >= 8;
+  });
+}
+
+TEST_F(PlaylistFilterTest, Expressions) {
+  ExpectSameRows(
+      "(artist:abba OR album:help) track:<5 -genre:jazz",
+      [](const QAbstractItemModel* model, int row) {
+        const bool artist_or_album =
+            Text(model, row, Playlist::Column_Artist).contains("abba") ||
+            Text(model, row, Playlist::Column_Album).contains("help");
+        return artist_or_album &&
+               model->index(row, Playlist::Column_Track).data().toInt() < 5 &&
+               !Text(model, row, Playlist::Column_Genre).contains("jazz");
+      });
+}
+
+TEST_F(PlaylistFilterTest, SourceChanges) {
+  const RowMatcher matcher = [](const QAbstractItemModel* model, int row) {
+    return Text(model, row, Playlist::Column_Artist).contains("radiohead") &&
+           model->index(row, Playlist::Column_Year).data().toInt() < 1990;
+  };
+  ExpectSameRows("artist:radiohead year:<1990", matcher);
+
+  // Rows that change, get inserted or get removed while the filter is active.
+  model_.item(1, Playlist::Column_Artist)->setText("Radiohead");
+  model_.item(1, Playlist::Column_Year)->setText("1985");
+  model_.item(3, Playlist::Column_Artist)->setText("Someone else");
+  model_.insertRow(10, MakeRow(3));
+  model_.insertRow(0, MakeRow(8));
+  model_.removeRows(100, 500);
+  model_.appendRow(MakeRow(3));
+
+  EXPECT_EQ(ExpectedRows(matcher), FilteredRows());
+}
+
+}  // namespace
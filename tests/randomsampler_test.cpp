@@ -0,0 +1,140 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <memory>
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include <QSet>
+
+#include "core/database.h"
+#include "core/song.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+#include "smartplaylists/randomsampler.h"
+#include "smartplaylists/search.h"
+
+using smart_playlists::RandomSampler;
+using smart_playlists::Search;
+using smart_playlists::SearchTerm;
+
+namespace {
+
+class RandomSamplerTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    database_.reset(new MemoryDatabase(nullptr));
+    backend_.reset(new LibraryBackend);
+    backend_->Init(database_.get(), Library::kSongsTable, Library::kDirsTable,
+                   Library::kSubdirsTable, Library::kFtsTable);
+    backend_->AddDirectory("/music");
+    sampler_.reset(new RandomSampler(backend_.get()));
+  }
+
+  void AddSongs(const QString& artist, int count) {
+    SongList songs;
+    for (int i = 0; i < count; ++i) {
+      Song song;
+      song.Init(QString("Title %1").arg(i), artist, "Album", 1000);
+      song.set_directory_id(1);
+      song.set_url(QUrl(QString("file:///music/%1/%2.mp3").arg(artist).arg(i)));
+      song.set_mtime(1);
+      song.set_ctime(1);
+      song.set_filesize(1);
+      songs << song;
+    }
+    backend_->AddOrUpdateSongs(songs);
+  }
+
+  static Search ArtistSearch(const QString& artist) {
+    return Search(Search::Type_And,
+                  Search::TermList() << SearchTerm(SearchTerm::Field_Artist,
+                                                   SearchTerm::Op_Equals,
+                                                   artist),
+                  Search::Sort_Random, SearchTerm::Field_Title);
+  }
+
+  std::unique_ptr<Database> database_;
+  std::unique_ptr<LibraryBackend> backend_;
+  std::unique_ptr<RandomSampler> sampler_;
+};
+
+TEST_F(RandomSamplerTest, PicksDistinctMatchingSongs) {
+  AddSongs("foo", 100);
+  AddSongs("bar", 100);
+
+  const QSet<int> foo_ids =
+      QSet<int>::fromList(backend_->FindSongIds(ArtistSearch("foo")));
+  ASSERT_EQ(100, foo_ids.count());
+
+  QList<int> ids = sampler_->Sample(ArtistSearch("foo"), 20, QList<int>());
+  ASSERT_EQ(20, ids.count());
+  EXPECT_EQ(20, QSet<int>::fromList(ids).count());
+  for (int id : ids) {
+    EXPECT_TRUE(foo_ids.contains(id));
+  }
+}
+
+TEST_F(RandomSamplerTest, SkipsExcludedSongs) {
+  AddSongs("foo", 100);
+  QList<int> all = backend_->FindSongIds(ArtistSearch("foo"));
+
+  // Exclude few enough songs to use rejection, then so many that the rest
+  // have to be filtered out.
+  for (int excluded_count : QList<int>() << 10 << 90) {
+    const QList<int> excluded = all.mid(0, excluded_count);
+    QList<int> ids = sampler_->Sample(ArtistSearch("foo"), 100, excluded);
+    EXPECT_EQ(100 - excluded_count, ids.count());
+    EXPECT_EQ(100 - excluded_count, QSet<int>::fromList(ids).count());
+    for (int id : ids) {
+      EXPECT_FALSE(excluded.contains(id));
+    }
+  }
+}
+
+TEST_F(RandomSamplerTest, IgnoresExcludedSongsThatDontMatch) {
+  AddSongs("foo", 10);
+  AddSongs("bar", 10);
+  const QList<int> foo = backend_->FindSongIds(ArtistSearch("foo"));
+  const QList<int> bar = backend_->FindSongIds(ArtistSearch("bar"));
+
+  QList<int> excluded = bar;
+  excluded << foo.mid(0, 2) << foo[0];
+  QList<int> ids = sampler_->Sample(ArtistSearch("foo"), -1, excluded);
+  EXPECT_EQ(8, ids.count());
+  EXPECT_EQ(QSet<int>::fromList(foo.mid(2)), QSet<int>::fromList(ids));
+}
+
+TEST_F(RandomSamplerTest, AllSongs) {
+  AddSongs("foo", 50);
+  EXPECT_EQ(50,
+            sampler_->Sample(ArtistSearch("foo"), -1, QList<int>()).count());
+}
+
+TEST_F(RandomSamplerTest, SeesNewSongs) {
+  AddSongs("foo", 10);
+  EXPECT_EQ(10,
+            sampler_->Sample(ArtistSearch("foo"), 100, QList<int>()).count());
+
+  AddSongs("foo2", 10);
+  AddSongs("foo", 5);
+  EXPECT_EQ(15,
+            sampler_->Sample(ArtistSearch("foo"), 100, QList<int>()).count());
+}
+
+}  // namespace
@@ -0,0 +1,158 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <gst/gst.h>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QSignalSpy>
+#include <QTimer>
+#include <QtEndian>
+
+#include "core/tagreaderclient.h"
+#include "ripper/ripper.h"
+#include "transcoder/transcoder.h"
+
+namespace {
+
+// Sector counts of the two tracks in the disc image.
+const int kTrack1Sectors = 2 * CDIO_CD_FRAMES_PER_SEC;
+const int kTrack2Sectors = 100;
+
+class RipperTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    gst_init(nullptr, nullptr);
+
+    // The ripper tags the files it writes through the tag reader's workers.
+    qputenv("PATH", QByteArray(TAGREADER_DIR) + ":" + qgetenv("PATH"));
+    tag_reader_ = new TagReaderClient;
+    tag_reader_->Start();
+  }
+
+  static void TearDownTestCase() {
+    delete tag_reader_;
+    tag_reader_ = nullptr;
+  }
+
+  virtual void SetUp() {
+    path_ = QDir::temp().absoluteFilePath(
+        QString("clementine_ripper_test_%1")
+            .arg(QCoreApplication::applicationPid()));
+    QDir().mkpath(path_);
+
+    // A file-backed disc image: raw 16-bit stereo audio and a cue sheet.
+    QFile bin(path_ + "/disc.bin");
+    bin.open(QIODevice::WriteOnly);
+    QByteArray sector(CDIO_CD_FRAMESIZE_RAW, '\0');
+    for (int i = 0; i < kTrack1Sectors + kTrack2Sectors; ++i) {
+      sector.fill(char(i));
+      bin.write(sector);
+    }
+    bin.close();
+
+    QFile cue(path_ + "/disc.cue");
+    cue.open(QIODevice::WriteOnly);
+    cue.write(
+        "FILE \"disc.bin\" BINARY\n"
+        "  TRACK 01 AUDIO\n"
+        "    INDEX 01 00:00:00\n"
+        "  TRACK 02 AUDIO\n"
+        "    INDEX 01 00:02:00\n");
+    cue.close();
+  }
+
+  virtual void TearDown() {
+    QDir dir(path_);
+    for (const QString& filename : dir.entryList(QDir::Files)) {
+      dir.remove(filename);
+    }
+    QDir().rmdir(path_);
+  }
+
+  // The PCM that was written to the disc image for the sectors from first to
+  // last.
+  static QByteArray SectorsPcm(int first, int last) {
+    QByteArray ret;
+    for (int i = first; i <= last; ++i) {
+      ret.append(QByteArray(CDIO_CD_FRAMESIZE_RAW, char(i)));
+    }
+    return ret;
+  }
+
+  // The contents of the data chunk of a wav file.
+  static QByteArray WavData(const QString& filename) {
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) return QByteArray();
+    const QByteArray wav = file.readAll();
+
+    // Skip the RIFF header, then each chunk until the data.
+    for (int pos = 12; pos + 8 <= wav.size();) {
+      const quint32 size =
+          qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(
+              wav.constData() + pos + 4));
+      if (size > quint32(wav.size())) break;
+      if (wav.mid(pos, 4) == "data") return wav.mid(pos + 8, size);
+      pos += 8 + size + (size & 1);
+    }
+    return QByteArray();
+  }
+
+  static TagReaderClient* tag_reader_;
+  QString path_;
+};
+
+TagReaderClient* RipperTest::tag_reader_ = nullptr;
+
+TEST_F(RipperTest, ReadsDiscImage) {
+  Ripper ripper(path_ + "/disc.cue");
+  ASSERT_TRUE(ripper.CheckCDIOIsValid());
+  EXPECT_EQ(2, ripper.TracksOnDisc());
+  EXPECT_EQ(2, ripper.TrackDurationSecs(1));
+}
+
+TEST_F(RipperTest, StreamsTracksToTranscoder) {
+  Ripper ripper(path_ + "/disc.cue");
+  ASSERT_EQ(2, ripper.TracksOnDisc());
+
+  const TranscoderPreset preset =
+      Transcoder::PresetForFileType(Song::Type_Wav);
+  ripper.AddTrack(1, "One", path_ + "/1.wav", preset);
+  ripper.AddTrack(2, "Two", path_ + "/2.wav", preset);
+
+  QEventLoop loop;
+  QSignalSpy finished(&ripper, SIGNAL(Finished()));
+  QObject::connect(&ripper, SIGNAL(Finished()), &loop, SLOT(quit()));
+  QTimer::singleShot(30000, &loop, SLOT(quit()));
+  ripper.Start();
+  loop.exec();
+
+  // Both files were ripped and tagged.
+  ASSERT_EQ(1, finished.count());
+
+  // Each file holds exactly the PCM of its track.
+  const int last_sector = kTrack1Sectors + kTrack2Sectors - 1;
+  EXPECT_TRUE(SectorsPcm(0, kTrack1Sectors - 1) == WavData(path_ + "/1.wav"));
+  EXPECT_TRUE(SectorsPcm(kTrack1Sectors, last_sector) ==
+              WavData(path_ + "/2.wav"));
+}
+
+}  // namespace
@@ -57,6 +57,7 @@ protected:
 
     // the thing we return is not really important
     EXPECT_CALL(*library_.get(), GetSongByUrl(_, _)).WillRepeatedly(Return(Song()));
+    EXPECT_CALL(*library_.get(), GetSongsByUrls(_)).WillRepeatedly(Return(SongList()));
   }
 
   void LoadLocalDirectory(const QString& dir);
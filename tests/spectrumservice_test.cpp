@@ -0,0 +1,88 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <cmath>
+
+#include "analyzers/fht.h"
+#include "analyzers/spectrumservice.h"
+
+namespace {
+
+Engine::Scope SinePcm(int frames) {
+  Engine::Scope pcm(frames * 2);
+  for (int i = 0; i < frames; ++i) {
+    const int16_t sample = 10000 * std::sin(i * 0.3);
+    pcm[i * 2] = sample;
+    pcm[i * 2 + 1] = sample / 2;
+  }
+  return pcm;
+}
+
+TEST(SpectrumServiceTest, TransformMatchesFHT) {
+  const Engine::Scope pcm = SinePcm(512);
+
+  FHT fht(9);
+  Analyzer::Scope power;
+  Analyzer::SpectrumService::Transform(pcm, &fht, &power);
+  ASSERT_EQ(256, power.size());
+
+  FHT expected_fht(9);
+  Analyzer::Scope expected(512);
+  for (int i = 0; i < 512; ++i) {
+    expected[i] =
+        static_cast<double>(pcm[i * 2] + pcm[i * 2 + 1]) / (2 * (1 << 15));
+  }
+  expected_fht.power2(&expected.front());
+
+  for (int i = 0; i < 256; ++i) {
+    EXPECT_FLOAT_EQ(expected[i], power[i]);
+  }
+}
+
+TEST(SpectrumServiceTest, TransformPadsShortScopes) {
+  FHT fht(9);
+  Analyzer::Scope power;
+  Analyzer::SpectrumService::Transform(Engine::Scope(), &fht, &power);
+
+  ASSERT_EQ(256, power.size());
+  for (float value : power) {
+    EXPECT_EQ(0.0f, value);
+  }
+}
+
+TEST(SpectrumServiceTest, TransformReusesStorage) {
+  const Engine::Scope pcm = SinePcm(512);
+
+  FHT fht(9);
+  Analyzer::Scope power;
+  Analyzer::SpectrumService::Transform(pcm, &fht, &power);
+  const float* data = power.data();
+
+  Analyzer::SpectrumService::Transform(pcm, &fht, &power);
+  EXPECT_EQ(data, power.data());
+}
+
+TEST(SpectrumServiceTest, NoFramesWithoutEngine) {
+  Analyzer::SpectrumService service;
+  service.Request(9);
+  EXPECT_FALSE(service.Latest(9));
+  EXPECT_FALSE(service.Latest(42));
+}
+
+}  // namespace
@@ -0,0 +1,185 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <memory>
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include <QElapsedTimer>
+#include <QSqlQuery>
+#include <QtDebug>
+
+#include "core/database.h"
+#include "core/song.h"
+#include "core/sqlitequery.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+#include "library/sqlrow.h"
+
+namespace {
+
+class SqliteQueryTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    database_.reset(new MemoryDatabase(nullptr));
+    backend_.reset(new LibraryBackend);
+    backend_->Init(database_.get(), Library::kSongsTable, Library::kDirsTable,
+                   Library::kSubdirsTable, Library::kFtsTable);
+    backend_->AddDirectory("/music");
+  }
+
+  void AddSongs(int count) {
+    SongList songs;
+    for (int i = 0; i < count; ++i) {
+      Song song;
+      song.Init(QString("Title %1").arg(i), QString("Artist %1").arg(i % 100),
+                QString("Album %1").arg(i % 1000), 1000);
+      song.set_directory_id(1);
+      song.set_url(QUrl::fromLocalFile(
+          QString("/music/Artist %1/track %2.mp3").arg(i % 100).arg(i)));
+      song.set_track(i % 20);
+      song.set_year(1990 + i % 30);
+      song.set_genre("Rock");
+      song.set_mtime(100);
+      song.set_ctime(100);
+      song.set_filesize(1000);
+      song.set_filetype(Song::Type_Mpeg);
+      songs << song;
+    }
+    backend_->AddOrUpdateSongs(songs);
+  }
+
+  QString SelectAll() const {
+    return "SELECT ROWID, " + Song::kColumnSpec + " FROM songs ORDER BY ROWID";
+  }
+
+  std::unique_ptr<Database> database_;
+  std::unique_ptr<LibraryBackend> backend_;
+};
+
+TEST_F(SqliteQueryTest, ReadsSameSongsAsQSqlQuery) {
+  AddSongs(50);
+
+  QSqlDatabase db(database_->Connect());
+  QSqlQuery old_query(SelectAll(), db);
+  ASSERT_TRUE(old_query.exec());
+
+  SqliteQuery new_query(db, SelectAll());
+  ASSERT_TRUE(new_query.Exec());
+
+  int count = 0;
+  while (old_query.next()) {
+    ASSERT_TRUE(new_query.Next());
+
+    Song old_song;
+    old_song.InitFromQuery(old_query, true);
+    Song new_song;
+    new_song.InitFromQuery(new_query.row(), true);
+
+    EXPECT_EQ(old_song.id(), new_song.id());
+    EXPECT_TRUE(old_song.IsMetadataEqual(new_song));
+    EXPECT_EQ(old_song.url(), new_song.url());
+    EXPECT_EQ(old_song.basefilename(), new_song.basefilename());
+    EXPECT_EQ(old_song.length_nanosec(), new_song.length_nanosec());
+    EXPECT_EQ(old_song.filetype(), new_song.filetype());
+    EXPECT_EQ(old_song.playcount(), new_song.playcount());
+    EXPECT_EQ(old_song.rating(), new_song.rating());
+    ++count;
+  }
+  EXPECT_FALSE(new_query.Next());
+  EXPECT_EQ(50, count);
+}
+
+TEST_F(SqliteQueryTest, NullColumns) {
+  QSqlDatabase db(database_->Connect());
+  SqliteQuery query(db, "SELECT NULL, '', 42, :value");
+  query.BindValue(":value", "bound");
+  ASSERT_TRUE(query.Exec());
+  ASSERT_TRUE(query.Next());
+
+  const SqlRow row = query.row();
+  EXPECT_TRUE(row.IsNull(0));
+  EXPECT_TRUE(row.ToString(0).isNull());
+  EXPECT_FALSE(row.IsNull(1));
+  EXPECT_FALSE(row.ToString(1).isNull());
+  EXPECT_TRUE(row.ToString(1).isEmpty());
+  EXPECT_EQ(42, row.ToInt(2));
+  EXPECT_EQ(42, row.value(2).toInt());
+  EXPECT_EQ("bound", row.ToString(3));
+}
+
+TEST_F(SqliteQueryTest, CopiedRows) {
+  const QString text = QString::fromUtf8("Bj\xc3\xb6rk");
+
+  QSqlDatabase db(database_->Connect());
+  SqliteQuery query(db, "SELECT :text, NULL, 42");
+  query.BindValue(":text", text);
+  ASSERT_TRUE(query.Exec());
+  ASSERT_TRUE(query.Next());
+
+  const SqlRow copy = query.row().Copy();
+  EXPECT_EQ(query.row().ToByteArray(0), copy.ToByteArray(0));
+  EXPECT_EQ(text.toUtf8(), copy.ToByteArray(0));
+  EXPECT_EQ(text, copy.ToString(0));
+  EXPECT_TRUE(copy.IsNull(1));
+  EXPECT_EQ(42, copy.ToInt(2));
+
+  // The copy outlives the statement's row.
+  EXPECT_FALSE(query.Next());
+  EXPECT_EQ(text, copy.ToString(0));
+}
+
+TEST_F(SqliteQueryTest, LoadSongsBenchmark) {
+  const int kSongCount = 50000;
+  AddSongs(kSongCount);
+
+  QSqlDatabase db(database_->Connect());
+  QElapsedTimer timer;
+
+  timer.start();
+  SongList old_songs;
+  QSqlQuery old_query(SelectAll(), db);
+  old_query.exec();
+  while (old_query.next()) {
+    Song song;
+    song.InitFromQuery(old_query, true);
+    // InitFromQuery used to decode the URL straight away.
+    song.url();
+    old_songs << song;
+  }
+  const qint64 old_elapsed = timer.restart();
+
+  SongList new_songs;
+  SqliteQuery new_query(db, SelectAll());
+  new_query.Exec();
+  while (new_query.Next()) {
+    Song song;
+    song.InitFromQuery(new_query.row(), true);
+    new_songs << song;
+  }
+  const qint64 new_elapsed = timer.elapsed();
+
+  qDebug() << "Loaded" << kSongCount << "songs in" << old_elapsed
+           << "ms through QSqlQuery and" << new_elapsed
+           << "ms straight from sqlite";
+
+  EXPECT_EQ(kSongCount, old_songs.count());
+  EXPECT_EQ(kSongCount, new_songs.count());
+}
+
+}  // namespace
@@ -0,0 +1,93 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <QFuture>
+#include <QStringList>
+#include <QtConcurrentRun>
+
+#include "core/stringpool.h"
+#include "test_utils.h"
+
+namespace {
+
+TEST(StringPoolTest, SharesEqualStrings) {
+  // Build the strings at runtime so they don't share data already.
+  const QString first = QString("Artist") + QString::number(1);
+  const QString second = QString("Artist") + QString::number(1);
+  ASSERT_FALSE(first.isSharedWith(second));
+
+  const QString interned_first = StringPool::Intern(first);
+  const QString interned_second = StringPool::Intern(second);
+  EXPECT_EQ(first, interned_second);
+  EXPECT_TRUE(interned_first.isSharedWith(interned_second));
+}
+
+TEST(StringPoolTest, KeepsDifferentStringsApart) {
+  const QString first = StringPool::Intern(QString("Album") + "A");
+  const QString second = StringPool::Intern(QString("Album") + "B");
+  EXPECT_EQ("AlbumA", first);
+  EXPECT_EQ("AlbumB", second);
+}
+
+TEST(StringPoolTest, LeavesEmptyStringsAlone) {
+  EXPECT_TRUE(StringPool::Intern(QString()).isNull());
+  EXPECT_FALSE(StringPool::Intern(QString("")).isNull());
+}
+
+TEST(StringPoolTest, Statistics) {
+  const StringPool::Statistics before = StringPool::statistics();
+
+  const QString value = QString("Genre") + QString::number(42);
+  StringPool::Intern(value);
+  StringPool::Intern(QString("Genre") + QString::number(42));
+  StringPool::Intern(QString("Genre") + QString::number(42));
+
+  const StringPool::Statistics after = StringPool::statistics();
+  EXPECT_EQ(before.lookups + 3, after.lookups);
+  EXPECT_EQ(before.hits + 2, after.hits);
+  EXPECT_EQ(before.strings + 1, after.strings);
+  EXPECT_EQ(before.bytes + value.size() * 2, after.bytes);
+  EXPECT_EQ(before.bytes_saved + value.size() * 2 * 2, after.bytes_saved);
+}
+
+QStringList InternMany(int seed) {
+  QStringList ret;
+  for (int i = 0; i < 1000; ++i) {
+    ret << StringPool::Intern(QString("Composer %1").arg((i + seed) % 100));
+  }
+  return ret;
+}
+
+TEST(StringPoolTest, ThreadSafe) {
+  QList<QFuture<QStringList>> futures;
+  for (int i = 0; i < 8; ++i) {
+    futures << QtConcurrent::run(&InternMany, i);
+  }
+
+  const QString expected = StringPool::Intern("Composer 7");
+  for (QFuture<QStringList> future : futures) {
+    for (const QString& value : future.result()) {
+      if (value == expected) {
+        EXPECT_TRUE(value.isSharedWith(expected));
+      }
+    }
+  }
+}
+
+}  // namespace